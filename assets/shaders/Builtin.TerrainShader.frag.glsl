@@ -39,6 +39,9 @@ layout(set = 0, binding = 0) uniform global_uniform_object {
     int use_pcf;
     float bias;
     vec2 padding;
+    point_light p_lights[POINT_LIGHT_MAX];
+    vec3 padding_lights;
+    int num_p_lights;
 } global_ubo;
 
 struct material_phong_properties {
@@ -56,9 +59,6 @@ struct material_terrain_properties {
 
 layout(set = 1, binding = 0) uniform instance_uniform_object {
     material_terrain_properties properties;
-    point_light p_lights[POINT_LIGHT_MAX];
-    vec3 padding;
-    int num_p_lights;
 } instance_ubo;
 
 
@@ -283,8 +283,8 @@ void main() {
         }
 
         // Point light radiance
-        for(int i = 0; i < instance_ubo.num_p_lights; ++i) {
-            point_light light = instance_ubo.p_lights[i];
+        for(int i = 0; i < global_ubo.num_p_lights; ++i) {
+            point_light light = global_ubo.p_lights[i];
             vec3 light_direction = normalize(light.position.xyz - in_dto.frag_position.xyz);
             vec3 radiance = calculate_point_light_radiance(light, view_direction, in_dto.frag_position.xyz);
 
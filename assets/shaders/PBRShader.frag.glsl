@@ -42,13 +42,14 @@ layout(set = 0, binding = 0) uniform global_uniform_object {
     int use_pcf;
     float bias;
     vec2 padding;
+    directional_light dir_light;
+    point_light p_lights[MAX_POINT_LIGHTS];
+    vec3 padding_lights;
+    int num_p_lights;
 } global_ubo;
 
 layout(set = 1, binding = 0) uniform instance_uniform_object {
-    directional_light dir_light;
-    point_light p_lights[MAX_POINT_LIGHTS]; // TODO: move after props
     pbr_properties properties;
-    int num_p_lights;
 } instance_ubo;
 
 const int PBR_MATERIAL_TEXTURE_COUNT = 3;
@@ -173,11 +174,11 @@ void main() {
     if(cascade_index == -1) {
         cascade_index = MAX_SHADOW_CASCADES;
     }
-    float shadow = calculate_shadow(in_dto.light_space_frag_pos[cascade_index], normal, instance_ubo.dir_light, cascade_index);
+    float shadow = calculate_shadow(in_dto.light_space_frag_pos[cascade_index], normal, global_ubo.dir_light, cascade_index);
 
     // Fade out the shadow map past a certain distance.
-    float fade_start = instance_ubo.dir_light.shadow_distance;
-    float fade_distance = instance_ubo.dir_light.shadow_fade_distance;
+    float fade_start = global_ubo.dir_light.shadow_distance;
+    float fade_distance = global_ubo.dir_light.shadow_fade_distance;
 
     // The end of the fade-out range.
     float fade_end = fade_start + fade_distance;
@@ -212,7 +213,7 @@ void main() {
 
         // Directional light radiance.
         {
-            directional_light light = instance_ubo.dir_light;
+            directional_light light = global_ubo.dir_light;
             vec3 light_direction = normalize(-light.direction.xyz);
             vec3 radiance = calculate_directional_light_radiance(light, view_direction);
 
@@ -221,8 +222,8 @@ void main() {
         }
 
         // Point light radiance
-        for(int i = 0; i < instance_ubo.num_p_lights; ++i) {
-            point_light light = instance_ubo.p_lights[i];
+        for(int i = 0; i < global_ubo.num_p_lights; ++i) {
+            point_light light = global_ubo.p_lights[i];
             vec3 light_direction = normalize(light.position.xyz - in_dto.frag_position.xyz);
             vec3 radiance = calculate_point_light_radiance(light, view_direction, in_dto.frag_position.xyz);
 
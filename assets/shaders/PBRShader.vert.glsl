@@ -5,6 +5,8 @@ layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec2 in_texcoord;
 layout(location = 3) in vec4 in_colour;
 layout(location = 4) in vec3 in_tangent;
+// Per instance.
+layout(location = 5) in mat4 in_model;
 
 const int MAX_SHADOW_CASCADES = 4;
 
@@ -20,12 +22,6 @@ layout(set = 0, binding = 0) uniform global_uniform_object {
     vec2 padding;
 } global_ubo;
 
-layout(push_constant) uniform push_constants {
-	
-	// Only guaranteed a total of 128 bytes.
-	mat4 model; // 64 bytes
-} u_push_constants;
-
 layout(location = 0) out int out_mode;
 layout(location = 1) out int use_pcf;
 
@@ -56,14 +52,14 @@ void main() {
 	out_dto.tex_coord = in_texcoord;
 	out_dto.colour = in_colour;
 	// Fragment position in world space.
-	out_dto.frag_position = vec3(u_push_constants.model * vec4(in_position, 1.0));
+	out_dto.frag_position = vec3(in_model * vec4(in_position, 1.0));
 	// Copy the normal over.
-	mat3 m3_model = mat3(u_push_constants.model);
+	mat3 m3_model = mat3(in_model);
 	out_dto.normal = normalize(m3_model * in_normal);
 	out_dto.tangent = normalize(m3_model * in_tangent);
 	out_dto.cascade_splits = global_ubo.cascade_splits;
 	out_dto.view_position = global_ubo.view_position;
-    gl_Position = global_ubo.projection * global_ubo.view * u_push_constants.model * vec4(in_position, 1.0);
+    gl_Position = global_ubo.projection * global_ubo.view * in_model * vec4(in_position, 1.0);
 
 	// Get a light-space-transformed fragment positions.
     for(int i = 0; i < MAX_SHADOW_CASCADES; ++i) {
@@ -5,6 +5,8 @@ layout(location = 1) in vec3 in_normal;
 layout(location = 2) in vec2 in_texcoord;
 layout(location = 3) in vec4 in_colour;
 layout(location = 4) in vec4 in_tangent;
+// Per instance.
+layout(location = 5) in mat4 in_model;
 
 #define MAX_CASCADES 4
 
@@ -16,7 +18,6 @@ layout(set = 0, binding = 0) uniform global_uniform_object {
 layout(push_constant) uniform push_constants {
 	
 	// Only guaranteed a total of 128 bytes.
-	mat4 model; // 64 bytes
     uint cascade_index;
 } local_ubo;
 
@@ -27,5 +28,5 @@ layout(location = 1) out struct dto {
 
 void main() {
     out_dto.tex_coord = in_texcoord;
-    gl_Position = (global_ubo.projections[local_ubo.cascade_index] * global_ubo.views[local_ubo.cascade_index]) * local_ubo.model * vec4(in_position, 1.0);
+    gl_Position = (global_ubo.projections[local_ubo.cascade_index] * global_ubo.views[local_ubo.cascade_index]) * in_model * vec4(in_position, 1.0);
 }
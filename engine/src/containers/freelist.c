@@ -10,6 +10,8 @@ typedef struct freelist_node {
 } freelist_node;
 
 typedef struct internal_state {
+    // Must be first, as with tlsf_state, so the type can be read from either.
+    freelist_type type;
     u64 total_size;
     u64 max_entries;
     freelist_node* head;
@@ -19,7 +21,404 @@ typedef struct internal_state {
 static freelist_node* get_node(freelist* list);
 static void return_node(freelist_node* node);
 
+// TLSF: the first level bins by power of two, the second splits each of those linearly into
+// TLSF_SL_COUNT bins. Sizes below TLSF_SL_COUNT all live in the first level's bin 0.
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+// Enough first level bins for any 64-bit size.
+#define TLSF_FL_COUNT (64 - TLSF_SL_LOG2 + 1)
+// One tracking node per this many bytes managed, on average.
+#define TLSF_BYTES_PER_NODE 512
+#define TLSF_MIN_NODES 64
+
+typedef struct tlsf_node {
+    u64 offset;
+    u64 size;
+    // Physical neighbours by offset. INVALID_ID if none.
+    u32 prev_phys;
+    u32 next_phys;
+    // For free ranges, neighbours in the same bin. For pooled nodes, next_free chains the pool.
+    u32 prev_free;
+    u32 next_free;
+    b8 is_free;
+} tlsf_node;
+
+typedef struct tlsf_state {
+    // Must be first, as with internal_state, so the type can be read from either.
+    freelist_type type;
+    u32 node_capacity;
+    u64 total_size;
+    u64 free_space;
+    // Bit n set if first level bin n has any free ranges.
+    u64 fl_bitmap;
+    // Bit n set if second level bin n of that first level has any free ranges.
+    u32 sl_bitmaps[TLSF_FL_COUNT];
+    // The head node of each bin's list of free ranges.
+    u32 bins[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    // The node at offset 0 and the node at the end of the range.
+    u32 first_node;
+    u32 last_node;
+    // Unused nodes.
+    u32 node_pool_head;
+    // Allocated ranges by offset, open addressed with linear probing. Holds node indices.
+    u32* used_lookup;
+    u32 used_lookup_mask;
+    u32 used_lookup_shift;
+    tlsf_node* nodes;
+} tlsf_state;
+
+static u32 tlsf_node_capacity(u64 total_size) {
+    u64 capacity = KMAX(total_size / TLSF_BYTES_PER_NODE, TLSF_MIN_NODES);
+    return (u32)KMIN(capacity, 0x7FFFFFFFULL);
+}
+
+static u32 tlsf_lookup_capacity(u32 node_capacity) {
+    // At least twice the nodes, as a power of 2, to keep probe sequences short.
+    u32 capacity = 1;
+    while (capacity < node_capacity * 2) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+static u64 tlsf_memory_requirement(u64 total_size) {
+    u32 node_capacity = tlsf_node_capacity(total_size);
+    return sizeof(tlsf_state) + (sizeof(tlsf_node) * node_capacity) + (sizeof(u32) * tlsf_lookup_capacity(node_capacity));
+}
+
+static u32 tlsf_fls(u64 value) {
+    return 63 - (u32)__builtin_clzll(value);
+}
+
+static void tlsf_mapping(u64 size, u32* out_fl, u32* out_sl) {
+    if (size < TLSF_SL_COUNT) {
+        *out_fl = 0;
+        *out_sl = (u32)size;
+    } else {
+        u32 fl = tlsf_fls(size);
+        *out_sl = (u32)(size >> (fl - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *out_fl = fl - TLSF_SL_LOG2 + 1;
+    }
+}
+
+static void tlsf_insert_free(tlsf_state* state, u32 index) {
+    tlsf_node* node = &state->nodes[index];
+    u32 fl, sl;
+    tlsf_mapping(node->size, &fl, &sl);
+    u32 head = state->bins[fl][sl];
+    node->is_free = true;
+    node->prev_free = INVALID_ID;
+    node->next_free = head;
+    if (head != INVALID_ID) {
+        state->nodes[head].prev_free = index;
+    }
+    state->bins[fl][sl] = index;
+    state->fl_bitmap |= (1ULL << fl);
+    state->sl_bitmaps[fl] |= (1U << sl);
+}
+
+static void tlsf_remove_free(tlsf_state* state, u32 index) {
+    tlsf_node* node = &state->nodes[index];
+    if (node->prev_free != INVALID_ID) {
+        state->nodes[node->prev_free].next_free = node->next_free;
+    } else {
+        u32 fl, sl;
+        tlsf_mapping(node->size, &fl, &sl);
+        state->bins[fl][sl] = node->next_free;
+        if (node->next_free == INVALID_ID) {
+            state->sl_bitmaps[fl] &= ~(1U << sl);
+            if (!state->sl_bitmaps[fl]) {
+                state->fl_bitmap &= ~(1ULL << fl);
+            }
+        }
+    }
+    if (node->next_free != INVALID_ID) {
+        state->nodes[node->next_free].prev_free = node->prev_free;
+    }
+    node->is_free = false;
+    node->prev_free = INVALID_ID;
+    node->next_free = INVALID_ID;
+}
+
+static u32 tlsf_node_acquire(tlsf_state* state) {
+    u32 index = state->node_pool_head;
+    if (index != INVALID_ID) {
+        state->node_pool_head = state->nodes[index].next_free;
+        state->nodes[index].next_free = INVALID_ID;
+    }
+    return index;
+}
+
+static void tlsf_node_release(tlsf_state* state, u32 index) {
+    tlsf_node* node = &state->nodes[index];
+    node->offset = 0;
+    node->size = 0;
+    node->is_free = false;
+    node->prev_phys = INVALID_ID;
+    node->next_phys = INVALID_ID;
+    node->prev_free = INVALID_ID;
+    node->next_free = state->node_pool_head;
+    state->node_pool_head = index;
+}
+
+static u32 tlsf_lookup_slot(tlsf_state* state, u64 offset) {
+    return (u32)((offset * 0x9E3779B97F4A7C15ULL) >> state->used_lookup_shift) & state->used_lookup_mask;
+}
+
+static void tlsf_lookup_insert(tlsf_state* state, u32 index) {
+    u32 slot = tlsf_lookup_slot(state, state->nodes[index].offset);
+    while (state->used_lookup[slot] != INVALID_ID) {
+        slot = (slot + 1) & state->used_lookup_mask;
+    }
+    state->used_lookup[slot] = index;
+}
+
+static u32 tlsf_lookup_find(tlsf_state* state, u64 offset) {
+    u32 slot = tlsf_lookup_slot(state, offset);
+    while (state->used_lookup[slot] != INVALID_ID) {
+        if (state->nodes[state->used_lookup[slot]].offset == offset) {
+            return slot;
+        }
+        slot = (slot + 1) & state->used_lookup_mask;
+    }
+    return INVALID_ID;
+}
+
+static void tlsf_lookup_remove(tlsf_state* state, u32 slot) {
+    // Shift later entries of the probe sequence back, so lookups never need tombstones.
+    u32 mask = state->used_lookup_mask;
+    u32 hole = slot;
+    u32 next = (hole + 1) & mask;
+    while (state->used_lookup[next] != INVALID_ID) {
+        u32 ideal = tlsf_lookup_slot(state, state->nodes[state->used_lookup[next]].offset);
+        if (((next - ideal) & mask) >= ((next - hole) & mask)) {
+            state->used_lookup[hole] = state->used_lookup[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    state->used_lookup[hole] = INVALID_ID;
+}
+
+static void tlsf_setup(tlsf_state* state, void* memory, u64 total_size) {
+    state->type = FREELIST_TYPE_TLSF;
+    state->total_size = total_size;
+    state->node_capacity = tlsf_node_capacity(total_size);
+    u32 lookup_capacity = tlsf_lookup_capacity(state->node_capacity);
+    state->used_lookup_mask = lookup_capacity - 1;
+    state->used_lookup_shift = 64 - tlsf_fls(lookup_capacity);
+    state->nodes = (tlsf_node*)((u8*)memory + sizeof(tlsf_state));
+    state->used_lookup = (u32*)((u8*)state->nodes + (sizeof(tlsf_node) * state->node_capacity));
+}
+
+static void tlsf_reset(tlsf_state* state) {
+    state->free_space = state->total_size;
+    state->fl_bitmap = 0;
+    kzero_memory(state->sl_bitmaps, sizeof(state->sl_bitmaps));
+    kset_memory(state->bins, 0xFF, sizeof(state->bins));
+    kset_memory(state->used_lookup, 0xFF, sizeof(u32) * (state->used_lookup_mask + 1));
+
+    // All but the first node go in the pool.
+    state->node_pool_head = INVALID_ID;
+    for (u32 i = state->node_capacity - 1; i > 0; --i) {
+        tlsf_node_release(state, i);
+    }
+
+    // The first node covers everything.
+    tlsf_node* node = &state->nodes[0];
+    node->offset = 0;
+    node->size = state->total_size;
+    node->prev_phys = INVALID_ID;
+    node->next_phys = INVALID_ID;
+    state->first_node = 0;
+    state->last_node = 0;
+    tlsf_insert_free(state, 0);
+}
+
+static u32 tlsf_find_free(tlsf_state* state, u64 size) {
+    // Round up to the next bin boundary, so any range in the bin found is big enough.
+    u64 search_size = size;
+    if (size >= TLSF_SL_COUNT) {
+        search_size += (1ULL << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+    }
+    u32 fl, sl;
+    tlsf_mapping(search_size, &fl, &sl);
+    if (fl < TLSF_FL_COUNT) {
+        u32 sl_map = state->sl_bitmaps[fl] & (~0U << sl);
+        if (!sl_map) {
+            u64 fl_map = fl + 1 < 64 ? state->fl_bitmap & (~0ULL << (fl + 1)) : 0;
+            if (fl_map) {
+                fl = (u32)__builtin_ctzll(fl_map);
+                sl_map = state->sl_bitmaps[fl];
+            }
+        }
+        if (sl_map) {
+            return state->bins[fl][(u32)__builtin_ctz(sl_map)];
+        }
+    }
+
+    // Nothing in a bin that is guaranteed to fit. The size's own bin may still have a range
+    // that does, which matters when nearly full.
+    tlsf_mapping(size, &fl, &sl);
+    for (u32 index = state->bins[fl][sl]; index != INVALID_ID; index = state->nodes[index].next_free) {
+        if (state->nodes[index].size >= size) {
+            return index;
+        }
+    }
+    return INVALID_ID;
+}
+
+static b8 tlsf_allocate_block(tlsf_state* state, u64 size, u64* out_offset) {
+    u32 index = size && size <= state->free_space ? tlsf_find_free(state, size) : INVALID_ID;
+    if (index == INVALID_ID) {
+        DWARN("freelist_find_block, no block with enough free space found (requested: %lluB, available: %lluB).", size, state->free_space);
+        return false;
+    }
+
+    tlsf_node* node = &state->nodes[index];
+    if (node->size > size) {
+        // Split off the remainder as a new free range just after this one.
+        u32 remainder_index = tlsf_node_acquire(state);
+        if (remainder_index == INVALID_ID) {
+            DWARN("freelist_find_block, out of tracking nodes (capacity: %u). The list is too fragmented for its size.", state->node_capacity);
+            return false;
+        }
+        tlsf_remove_free(state, index);
+        tlsf_node* remainder = &state->nodes[remainder_index];
+        remainder->offset = node->offset + size;
+        remainder->size = node->size - size;
+        remainder->prev_phys = index;
+        remainder->next_phys = node->next_phys;
+        if (node->next_phys != INVALID_ID) {
+            state->nodes[node->next_phys].prev_phys = remainder_index;
+        } else {
+            state->last_node = remainder_index;
+        }
+        node->next_phys = remainder_index;
+        node->size = size;
+        tlsf_insert_free(state, remainder_index);
+    } else {
+        tlsf_remove_free(state, index);
+    }
+
+    tlsf_lookup_insert(state, index);
+    state->free_space -= size;
+    *out_offset = node->offset;
+    return true;
+}
+
+/** Merges the range at index into its physical predecessor, returning the predecessor. */
+static u32 tlsf_merge_into_prev(tlsf_state* state, u32 index) {
+    tlsf_node* node = &state->nodes[index];
+    u32 prev_index = node->prev_phys;
+    tlsf_node* prev = &state->nodes[prev_index];
+    prev->size += node->size;
+    prev->next_phys = node->next_phys;
+    if (node->next_phys != INVALID_ID) {
+        state->nodes[node->next_phys].prev_phys = prev_index;
+    } else {
+        state->last_node = prev_index;
+    }
+    tlsf_node_release(state, index);
+    return prev_index;
+}
+
+static b8 tlsf_free_block(tlsf_state* state, u64 size, u64 offset) {
+    u32 slot = tlsf_lookup_find(state, offset);
+    if (slot == INVALID_ID) {
+        DWARN("Unable to find block to be freed at offset %llu. Already freed, or corruption possible?", offset);
+        return false;
+    }
+    u32 index = state->used_lookup[slot];
+    if (state->nodes[index].size != size) {
+        DWARN("Attempting to free %lluB at offset %llu, but %lluB were allocated there.", size, offset, state->nodes[index].size);
+        return false;
+    }
+    tlsf_lookup_remove(state, slot);
+    state->free_space += size;
+
+    // Coalesce with free neighbours straight away.
+    u32 prev_index = state->nodes[index].prev_phys;
+    if (prev_index != INVALID_ID && state->nodes[prev_index].is_free) {
+        tlsf_remove_free(state, prev_index);
+        index = tlsf_merge_into_prev(state, index);
+    }
+    u32 next_index = state->nodes[index].next_phys;
+    if (next_index != INVALID_ID && state->nodes[next_index].is_free) {
+        tlsf_remove_free(state, next_index);
+        tlsf_merge_into_prev(state, next_index);
+    }
+
+    tlsf_insert_free(state, index);
+    return true;
+}
+
+static b8 tlsf_resize(tlsf_state* old_state, void* new_memory, u64 new_size) {
+    tlsf_state* state = new_memory;
+    // Everything up to the node arrays carries over as-is, as do the nodes themselves.
+    kcopy_memory(state, old_state, sizeof(tlsf_state));
+    tlsf_setup(state, new_memory, new_size);
+    if (state->node_capacity < old_state->node_capacity) {
+        return false;
+    }
+    kcopy_memory(state->nodes, old_state->nodes, sizeof(tlsf_node) * old_state->node_capacity);
+    for (u32 i = state->node_capacity - 1; i >= old_state->node_capacity; --i) {
+        tlsf_node_release(state, i);
+    }
+
+    // The lookup is keyed by capacity, so gets rebuilt.
+    kset_memory(state->used_lookup, 0xFF, sizeof(u32) * (state->used_lookup_mask + 1));
+    for (u32 index = state->first_node; index != INVALID_ID; index = state->nodes[index].next_phys) {
+        if (!state->nodes[index].is_free) {
+            tlsf_lookup_insert(state, index);
+        }
+    }
+
+    // Add the new space at the end, joining the last range if it is free.
+    u64 size_diff = new_size - old_state->total_size;
+    u32 last_index = state->last_node;
+    tlsf_node* last = &state->nodes[last_index];
+    if (last->is_free) {
+        tlsf_remove_free(state, last_index);
+        last->size += size_diff;
+        tlsf_insert_free(state, last_index);
+    } else {
+        u32 index = tlsf_node_acquire(state);
+        tlsf_node* node = &state->nodes[index];
+        node->offset = old_state->total_size;
+        node->size = size_diff;
+        node->prev_phys = last_index;
+        node->next_phys = INVALID_ID;
+        last->next_phys = index;
+        state->last_node = index;
+        tlsf_insert_free(state, index);
+    }
+    state->free_space += size_diff;
+    return true;
+}
+
+static freelist_type get_type(freelist* list) {
+    return *(freelist_type*)list->memory;
+}
+
 void freelist_create(u64 total_size, u64* memory_requirement, void* memory, freelist* out_list) {
+    freelist_create_with_type(total_size, FREELIST_TYPE_FIRST_FIT, memory_requirement, memory, out_list);
+}
+
+void freelist_create_with_type(u64 total_size, freelist_type type, u64* memory_requirement, void* memory, freelist* out_list) {
+    if (type == FREELIST_TYPE_TLSF) {
+        *memory_requirement = tlsf_memory_requirement(total_size);
+        if (!memory) {
+            return;
+        }
+        out_list->memory = memory;
+        kzero_memory(memory, sizeof(tlsf_state));
+        tlsf_state* state = memory;
+        tlsf_setup(state, memory, total_size);
+        tlsf_reset(state);
+        return;
+    }
+
     // Enough space to hold state, plus array for all nodes.
     u64 max_entries = (total_size / (sizeof(void*) * sizeof(freelist_node)));  // NOTE: This might have a remainder, but that's ok.
 
@@ -47,6 +446,7 @@ void freelist_create(u64 total_size, u64* memory_requirement, void* memory, free
     // The block's layout is head* first, then array of available nodes.
     kzero_memory(out_list->memory, *memory_requirement);
     internal_state* state = out_list->memory;
+    state->type = FREELIST_TYPE_FIRST_FIT;
     state->nodes = (void*)(out_list->memory + sizeof(internal_state));
     state->max_entries = max_entries;
     state->total_size = total_size;
@@ -60,7 +460,11 @@ void freelist_create(u64 total_size, u64* memory_requirement, void* memory, free
 }
 
 void freelist_destroy(freelist* list) {
-    if (list && list->memory) {
+    if (list && list->memory && get_type(list) == FREELIST_TYPE_TLSF) {
+        tlsf_state* state = list->memory;
+        kzero_memory(list->memory, tlsf_memory_requirement(state->total_size));
+        list->memory = 0;
+    } else if (list && list->memory) {
         // Just zero out the memory before giving it back.
         internal_state* state = list->memory;
         kzero_memory(list->memory, sizeof(internal_state) + sizeof(freelist_node) * state->max_entries);
@@ -72,6 +476,9 @@ b8 freelist_allocate_block(freelist* list, u64 size, u64* out_offset) {
     if (!list || !out_offset || !list->memory) {
         return false;
     }
+    if (get_type(list) == FREELIST_TYPE_TLSF) {
+        return tlsf_allocate_block(list->memory, size, out_offset);
+    }
     internal_state* state = list->memory;
     freelist_node* node = state->head;
     freelist_node* previous = 0;
@@ -113,6 +520,9 @@ b8 freelist_free_block(freelist* list, u64 size, u64 offset) {
     if (!list || !list->memory || !size) {
         return false;
     }
+    if (get_type(list) == FREELIST_TYPE_TLSF) {
+        return tlsf_free_block(list->memory, size, offset);
+    }
     internal_state* state = list->memory;
     freelist_node* node = state->head;
     freelist_node* previous = 0;
@@ -202,10 +612,27 @@ b8 freelist_free_block(freelist* list, u64 size, u64 offset) {
 }
 
 b8 freelist_resize(freelist* list, u64* memory_requirement, void* new_memory, u64 new_size, void** out_old_memory) {
-    if (!list || !memory_requirement || ((internal_state*)list->memory)->total_size > new_size) {
+    if (!list || !memory_requirement || !list->memory) {
+        return false;
+    }
+    u64 old_total_size = get_type(list) == FREELIST_TYPE_TLSF ? ((tlsf_state*)list->memory)->total_size : ((internal_state*)list->memory)->total_size;
+    if (old_total_size > new_size) {
         return false;
     }
 
+    if (get_type(list) == FREELIST_TYPE_TLSF) {
+        *memory_requirement = tlsf_memory_requirement(new_size);
+        if (!new_memory) {
+            return true;
+        }
+        *out_old_memory = list->memory;
+        if (!tlsf_resize(list->memory, new_memory, new_size)) {
+            return false;
+        }
+        list->memory = new_memory;
+        return true;
+    }
+
     // Enough space to hold state, plus array for all nodes.
     u64 max_entries = (new_size / sizeof(void*));  // NOTE: This might have a remainder, but that's ok.
 
@@ -297,6 +724,11 @@ void freelist_clear(freelist* list) {
         return;
     }
 
+    if (get_type(list) == FREELIST_TYPE_TLSF) {
+        tlsf_reset(list->memory);
+        return;
+    }
+
     internal_state* state = list->memory;
     // Invalidate the offset for all but the first node. The invalid
     // value will be checked for when seeking a new node from the list.
@@ -313,6 +745,10 @@ u64 freelist_free_space(freelist* list) {
         return 0;
     }
 
+    if (get_type(list) == FREELIST_TYPE_TLSF) {
+        return ((tlsf_state*)list->memory)->free_space;
+    }
+
     u64 running_total = 0;
     internal_state* state = list->memory;
     freelist_node* node = state->head;
@@ -12,6 +12,22 @@
 
 #include "defines.h"
 
+/** @brief The strategy a freelist uses to track free ranges. */
+typedef enum freelist_type {
+    /**
+     * @brief First-fit over a single offset-ordered list. Allocation and freeing are
+     * linear in the number of free ranges.
+     */
+    FREELIST_TYPE_FIRST_FIT = 0,
+    /**
+     * @brief Two-level segregated fit (TLSF). Free ranges are binned by size, and neighbours
+     * are coalesced immediately on free, so allocation and freeing take constant time
+     * regardless of fragmentation. Needs one tracking node per free or allocated range,
+     * sized for an average range of 512 bytes; allocations fail with a warning past that.
+     */
+    FREELIST_TYPE_TLSF = 1
+} freelist_type;
+
 /**
  * @brief A data structure to be used alongside an allocator for dynamic memory
  * allocation. Tracks free ranges of memory.
@@ -33,6 +49,19 @@ typedef struct freelist {
  */
 API void freelist_create(u64 total_size, u64* memory_requirement, void* memory, freelist* out_list);
 
+/**
+ * @brief Creates a new freelist of the given type or obtains the memory requirement for one.
+ * Call twice; once passing 0 to memory to obtain memory requirement, and a second
+ * time passing an allocated block to memory.
+ *
+ * @param total_size The total size in bytes that the free list should track.
+ * @param type The strategy the list uses to track free ranges.
+ * @param memory_requirement A pointer to hold memory requirement for the free list itself.
+ * @param memory 0, or a pre-allocated block of memory for the free list to use.
+ * @param out_list A pointer to hold the created free list.
+ */
+API void freelist_create_with_type(u64 total_size, freelist_type type, u64* memory_requirement, void* memory, freelist* out_list);
+
 /**
  * @brief Destroys the provided list.
  * 
@@ -69,8 +98,8 @@ API b8 freelist_free_block(freelist* list, u64 size, u64 offset);
 API void freelist_clear(freelist* list);
 
 /**
- * @brief Returns the amount of free space in this list. NOTE: Since this has
- * to iterate the entire internal list, this can be an expensive operation.
+ * @brief Returns the amount of free space in this list. NOTE: For first-fit lists this
+ * has to iterate the entire internal list, so can be an expensive operation.
  * Use sparingly.
  * 
  * @param list A pointer to the list to obtain from.
@@ -0,0 +1,343 @@
+#include "hashmap.h"
+
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+
+// Probe distances are stored as distance + 1 in each slot's u32 distance. Probes are capped well
+// below that, as a longer one means the table is badly clustered and should grow.
+#define HASHMAP_MAX_DISTANCE 255
+#define HASHMAP_MIN_CAPACITY 8
+
+static u64 hashmap_mix_u64(u64 key) {
+    // The MurmurHash3 64-bit finalizer. Spreads sequential ids across the whole table.
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+u64 hashmap_hash_string(const char* str) {
+    const u64 m = 0xc6a4a7935bd1e995ULL;
+    const i32 r = 47;
+    const u64 seed = 0x9747b28cULL;
+
+    u64 len = string_length(str);
+    u64 h = seed ^ (len * m);
+
+    const u8* data = (const u8*)str;
+    const u8* end = data + (len & ~7ULL);
+    while (data != end) {
+        // Assembled byte-wise so unaligned strings are safe; compiles to a single load.
+        u64 k = (u64)data[0] | ((u64)data[1] << 8) | ((u64)data[2] << 16) | ((u64)data[3] << 24) |
+                ((u64)data[4] << 32) | ((u64)data[5] << 40) | ((u64)data[6] << 48) | ((u64)data[7] << 56);
+        data += 8;
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    switch (len & 7) {
+        case 7: h ^= (u64)data[6] << 48;  // fall through
+        case 6: h ^= (u64)data[5] << 40;  // fall through
+        case 5: h ^= (u64)data[4] << 32;  // fall through
+        case 4: h ^= (u64)data[3] << 24;  // fall through
+        case 3: h ^= (u64)data[2] << 16;  // fall through
+        case 2: h ^= (u64)data[1] << 8;   // fall through
+        case 1:
+            h ^= (u64)data[0];
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
+typedef struct hashmap_slot {
+    u64 key;
+    u32 distance;
+    u32 padding;
+    // Value follows, element_size bytes.
+} hashmap_slot;
+
+// The slot an entry would occupy with no collisions. String keys are already a well-mixed hash.
+INLINE u64 home_of(const hashmap* map, u64 key) {
+    return map->key_type == HASHMAP_KEY_TYPE_STRING ? key : hashmap_mix_u64(key);
+}
+
+INLINE hashmap_slot* slot_at(const hashmap* map, u32 index) {
+    return (hashmap_slot*)((u8*)map->slots + (map->slot_stride * index));
+}
+
+INLINE void* slot_value(hashmap_slot* slot) {
+    return slot + 1;
+}
+
+static void storage_assign(hashmap* map, void* block, u32 capacity) {
+    map->capacity = capacity;
+    // Leave 1/5 of the slots empty so probe sequences stay short.
+    map->max_count = capacity - (capacity / 5);
+    map->slots = block;
+}
+
+static u32 capacity_for(u32 entry_count) {
+    u64 capacity = HASHMAP_MIN_CAPACITY;
+    while (capacity - (capacity / 5) < entry_count) {
+        capacity <<= 1;
+    }
+    return (u32)capacity;
+}
+
+static u32 find_slot(const hashmap* map, u64 key) {
+    u32 mask = map->capacity - 1;
+    u32 index = (u32)(home_of(map, key) & mask);
+    for (u32 distance = 1; distance <= HASHMAP_MAX_DISTANCE; ++distance) {
+        hashmap_slot* slot = slot_at(map, index);
+        // Robin Hood ordering means the key would have displaced any entry closer to home than it.
+        if (slot->distance < distance) {
+            return INVALID_ID;
+        }
+        if (slot->distance == distance && slot->key == key) {
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+    return INVALID_ID;
+}
+
+static b8 grow(hashmap* map, u32 new_capacity, const hashmap_slot* extra);
+
+// Inserts a key known not to be present. Assumes there is room.
+static b8 insert_new(hashmap* map, u64 key, const void* value) {
+    u32 mask = map->capacity - 1;
+    u64 stride = map->slot_stride;
+    hashmap_slot* carry = slot_at(map, map->capacity);
+    hashmap_slot* swap = slot_at(map, map->capacity + 1);
+
+    carry->key = key;
+    carry->distance = 1;
+    kcopy_memory(slot_value(carry), value, map->element_size);
+
+    u32 index = (u32)(home_of(map, key) & mask);
+    while (true) {
+        hashmap_slot* slot = slot_at(map, index);
+        if (slot->distance == 0) {
+            kcopy_memory(slot, carry, stride);
+            map->count++;
+            return true;
+        }
+
+        if (slot->distance < carry->distance) {
+            // The resident is closer to its home than the carried entry. Take its place and carry it on.
+            kcopy_memory(swap, slot, stride);
+            kcopy_memory(slot, carry, stride);
+            kcopy_memory(carry, swap, stride);
+        }
+
+        index = (index + 1) & mask;
+        carry->distance++;
+        if (carry->distance > HASHMAP_MAX_DISTANCE) {
+            // Pathological clustering. The carried entry must not be lost, so grow even if growth is disabled.
+            if (!map->allow_growth) {
+                DWARN("hashmap probe distance exceeded on a fixed-size map. Growing anyway to avoid losing an entry.");
+            }
+            return grow(map, map->capacity * 2, carry);
+        }
+    }
+}
+
+static b8 grow(hashmap* map, u32 new_capacity, const hashmap_slot* extra) {
+    hashmap old = *map;
+
+    void* block = kallocate(map->slot_stride * (new_capacity + 2), MEMORY_TAG_HASHTABLE);
+    storage_assign(map, block, new_capacity);
+    map->count = 0;
+
+    for (u32 i = 0; i < old.capacity; ++i) {
+        hashmap_slot* slot = slot_at(&old, i);
+        if (slot->distance) {
+            insert_new(map, slot->key, slot_value(slot));
+        }
+    }
+    if (extra) {
+        // Inserted before the old block is released, since it lives in its scratch slots.
+        insert_new(map, extra->key, slot_value((hashmap_slot*)extra));
+    }
+
+    kfree(old.slots, old.slot_stride * (old.capacity + 2), MEMORY_TAG_HASHTABLE);
+    return true;
+}
+
+static b8 set_internal(hashmap* map, u64 key, const void* value) {
+    u32 index = find_slot(map, key);
+    if (index != INVALID_ID) {
+        kcopy_memory(slot_value(slot_at(map, index)), value, map->element_size);
+        return true;
+    }
+
+    if (map->count >= map->max_count) {
+        if (!map->allow_growth) {
+            DERROR("hashmap is full (%u entries) and was created without growth. Entry not added.", map->count);
+            return false;
+        }
+        grow(map, map->capacity * 2, 0);
+    }
+
+    return insert_new(map, key, value);
+}
+
+static b8 get_internal(const hashmap* map, u64 key, void* out_value) {
+    u32 index = find_slot(map, key);
+    if (index == INVALID_ID) {
+        return false;
+    }
+    if (out_value) {
+        kcopy_memory(out_value, slot_value(slot_at(map, index)), map->element_size);
+    }
+    return true;
+}
+
+static b8 remove_internal(hashmap* map, u64 key) {
+    u32 index = find_slot(map, key);
+    if (index == INVALID_ID) {
+        return false;
+    }
+
+    // Backward-shift deletion: pull following entries one slot closer to home until one is already there.
+    u32 mask = map->capacity - 1;
+    u32 next = (index + 1) & mask;
+    hashmap_slot* slot = slot_at(map, index);
+    hashmap_slot* next_slot = slot_at(map, next);
+    while (next_slot->distance > 1) {
+        kcopy_memory(slot, next_slot, map->slot_stride);
+        slot->distance--;
+        slot = next_slot;
+        next = (next + 1) & mask;
+        next_slot = slot_at(map, next);
+    }
+    slot->distance = 0;
+    map->count--;
+    return true;
+}
+
+b8 hashmap_create(u64 element_size, u32 entry_count, hashmap_key_type key_type, b8 allow_growth, hashmap* out_map) {
+    if (!out_map) {
+        DERROR("hashmap_create requires a valid pointer to out_map.");
+        return false;
+    }
+    if (!element_size) {
+        DERROR("hashmap_create - element_size must be a positive non-zero value.");
+        return false;
+    }
+
+    kzero_memory(out_map, sizeof(hashmap));
+    out_map->key_type = key_type;
+    out_map->allow_growth = allow_growth;
+    out_map->element_size = element_size;
+
+    out_map->slot_stride = sizeof(hashmap_slot) + get_aligned(element_size, 8);
+
+    u32 capacity = capacity_for(entry_count);
+    void* block = kallocate(out_map->slot_stride * (capacity + 2), MEMORY_TAG_HASHTABLE);
+    storage_assign(out_map, block, capacity);
+    return true;
+}
+
+void hashmap_destroy(hashmap* map) {
+    if (map) {
+        if (map->slots) {
+            kfree(map->slots, map->slot_stride * (map->capacity + 2), MEMORY_TAG_HASHTABLE);
+        }
+        kzero_memory(map, sizeof(hashmap));
+    }
+}
+
+void hashmap_clear(hashmap* map) {
+    if (map && map->slots) {
+        for (u32 i = 0; i < map->capacity; ++i) {
+            slot_at(map, i)->distance = 0;
+        }
+        map->count = 0;
+    }
+}
+
+b8 hashmap_set(hashmap* map, const char* key, const void* value) {
+    if (!map || !key || !value) {
+        DERROR("hashmap_set requires map, key and value to exist.");
+        return false;
+    }
+    if (map->key_type != HASHMAP_KEY_TYPE_STRING) {
+        DERROR("hashmap_set should only be used with string-keyed maps. Use hashmap_set_u64 instead.");
+        return false;
+    }
+    return set_internal(map, hashmap_hash_string(key), value);
+}
+
+b8 hashmap_get(const hashmap* map, const char* key, void* out_value) {
+    if (!map || !key) {
+        DWARN("hashmap_get requires map and key to exist.");
+        return false;
+    }
+    if (map->key_type != HASHMAP_KEY_TYPE_STRING) {
+        DERROR("hashmap_get should only be used with string-keyed maps. Use hashmap_get_u64 instead.");
+        return false;
+    }
+    return get_internal(map, hashmap_hash_string(key), out_value);
+}
+
+b8 hashmap_remove(hashmap* map, const char* key) {
+    if (!map || !key) {
+        DWARN("hashmap_remove requires map and key to exist.");
+        return false;
+    }
+    if (map->key_type != HASHMAP_KEY_TYPE_STRING) {
+        DERROR("hashmap_remove should only be used with string-keyed maps. Use hashmap_remove_u64 instead.");
+        return false;
+    }
+    return remove_internal(map, hashmap_hash_string(key));
+}
+
+b8 hashmap_set_u64(hashmap* map, u64 key, const void* value) {
+    if (!map || !value) {
+        DERROR("hashmap_set_u64 requires map and value to exist.");
+        return false;
+    }
+    if (map->key_type != HASHMAP_KEY_TYPE_U64) {
+        DERROR("hashmap_set_u64 should only be used with integer-keyed maps. Use hashmap_set instead.");
+        return false;
+    }
+    return set_internal(map, key, value);
+}
+
+b8 hashmap_get_u64(const hashmap* map, u64 key, void* out_value) {
+    if (!map) {
+        DWARN("hashmap_get_u64 requires map to exist.");
+        return false;
+    }
+    if (map->key_type != HASHMAP_KEY_TYPE_U64) {
+        DERROR("hashmap_get_u64 should only be used with integer-keyed maps. Use hashmap_get instead.");
+        return false;
+    }
+    return get_internal(map, key, out_value);
+}
+
+b8 hashmap_remove_u64(hashmap* map, u64 key) {
+    if (!map) {
+        DWARN("hashmap_remove_u64 requires map to exist.");
+        return false;
+    }
+    if (map->key_type != HASHMAP_KEY_TYPE_U64) {
+        DERROR("hashmap_remove_u64 should only be used with integer-keyed maps. Use hashmap_remove instead.");
+        return false;
+    }
+    return remove_internal(map, key);
+}
@@ -0,0 +1,154 @@
+/**
+ * @file hashmap.h
+ * @brief An open-addressing hash map using Robin Hood probing.
+ *
+ * @details
+ * Unlike the fixed-size hashtable, entries are identified by their key rather
+ * than by a slot, so colliding keys do not overwrite one another. Keys are
+ * either strings or 64-bit integers, selected at creation time. String keys
+ * are not stored; the map keeps their 64-bit hash instead, so two distinct
+ * strings are only confused if their full 64-bit hashes are equal.
+ *
+ * Probing uses Robin Hood displacement: on insert, an entry that is further
+ * from its home slot takes the place of one that is closer. This keeps probe
+ * sequences short even at high load. Removal uses backward-shift deletion, so
+ * no tombstones are left behind.
+ *
+ * Memory layout of the single internal allocation is (capacity + 2) slots,
+ * the last two being scratch space for inserts. Each slot holds:
+ * - u64 key = string hash or integer key
+ * - u32 distance = probe distance + 1, 0 when the slot is empty
+ * - u32 padding
+ * - the value, padded to a multiple of 8 bytes
+ * Keeping the key and value together means a lookup usually touches a single cache line.
+ */
+
+#pragma once
+
+#include "defines.h"
+
+/** @brief The type of key a hashmap is indexed by. */
+typedef enum hashmap_key_type {
+    /** @brief Keys are null-terminated strings, hashed on insert and lookup. */
+    HASHMAP_KEY_TYPE_STRING,
+    /** @brief Keys are 64-bit integers, such as ids or handles. */
+    HASHMAP_KEY_TYPE_U64
+} hashmap_key_type;
+
+/**
+ * @brief Represents an open-addressing hash map. Members of this structure
+ * should not be modified outside the functions associated with it.
+ *
+ * The map always retains a copy of the value. To hold pointers, use an
+ * element_size of sizeof(void*) and pass the address of the pointer.
+ */
+typedef struct hashmap {
+    /** @brief The type of key used by this map. */
+    hashmap_key_type key_type;
+    /** @brief Indicates if the map may grow once it passes its load limit. */
+    b8 allow_growth;
+    /** @brief The size of each value in bytes. */
+    u64 element_size;
+    /** @brief The number of slots. Always a power of two. */
+    u32 capacity;
+    /** @brief The number of entries currently held. */
+    u32 count;
+    /** @brief The number of entries at which the map is considered full. */
+    u32 max_count;
+    /** @brief The size of each slot in bytes, including the key and distance. */
+    u64 slot_stride;
+    /** @brief The block of slots. */
+    void* slots;
+} hashmap;
+
+/**
+ * @brief Creates a hashmap, performing a dynamic allocation for its storage.
+ *
+ * @param element_size The size of each value in bytes.
+ * @param entry_count The number of entries the map should hold without growing.
+ * @param key_type The type of key used to index the map.
+ * @param allow_growth Indicates if the map may reallocate when it becomes full. If false, inserts fail once entry_count entries are held.
+ * @param out_map A pointer to a hashmap in which to hold relevant data.
+ * @return True on success; otherwise false.
+ */
+API b8 hashmap_create(u64 element_size, u32 entry_count, hashmap_key_type key_type, b8 allow_growth, hashmap* out_map);
+
+/**
+ * @brief Destroys the provided hashmap and frees its storage.
+ *
+ * @param map A pointer to the map to be destroyed.
+ */
+API void hashmap_destroy(hashmap* map);
+
+/**
+ * @brief Removes all entries from the map without releasing its storage.
+ *
+ * @param map A pointer to the map to be cleared.
+ */
+API void hashmap_clear(hashmap* map);
+
+/**
+ * @brief Stores a copy of value under the given string key, replacing any existing entry.
+ *
+ * @param map A pointer to the map. Must use HASHMAP_KEY_TYPE_STRING. Required.
+ * @param key The key to set. Required.
+ * @param value A pointer to the value to be copied. Required.
+ * @return True on success; false if the map is full and cannot grow, or on bad input.
+ */
+API b8 hashmap_set(hashmap* map, const char* key, const void* value);
+
+/**
+ * @brief Obtains a copy of the value held under the given string key.
+ *
+ * @param map A pointer to the map. Must use HASHMAP_KEY_TYPE_STRING. Required.
+ * @param key The key to look up. Required.
+ * @param out_value A pointer to hold a copy of the value. Optional.
+ * @return True if the key exists; otherwise false.
+ */
+API b8 hashmap_get(const hashmap* map, const char* key, void* out_value);
+
+/**
+ * @brief Removes the entry held under the given string key.
+ *
+ * @param map A pointer to the map. Must use HASHMAP_KEY_TYPE_STRING. Required.
+ * @param key The key to remove. Required.
+ * @return True if an entry was removed; false if it did not exist.
+ */
+API b8 hashmap_remove(hashmap* map, const char* key);
+
+/**
+ * @brief Stores a copy of value under the given integer key, replacing any existing entry.
+ *
+ * @param map A pointer to the map. Must use HASHMAP_KEY_TYPE_U64. Required.
+ * @param key The key to set.
+ * @param value A pointer to the value to be copied. Required.
+ * @return True on success; false if the map is full and cannot grow, or on bad input.
+ */
+API b8 hashmap_set_u64(hashmap* map, u64 key, const void* value);
+
+/**
+ * @brief Obtains a copy of the value held under the given integer key.
+ *
+ * @param map A pointer to the map. Must use HASHMAP_KEY_TYPE_U64. Required.
+ * @param key The key to look up.
+ * @param out_value A pointer to hold a copy of the value. Optional.
+ * @return True if the key exists; otherwise false.
+ */
+API b8 hashmap_get_u64(const hashmap* map, u64 key, void* out_value);
+
+/**
+ * @brief Removes the entry held under the given integer key.
+ *
+ * @param map A pointer to the map. Must use HASHMAP_KEY_TYPE_U64. Required.
+ * @param key The key to remove.
+ * @return True if an entry was removed; false if it did not exist.
+ */
+API b8 hashmap_remove_u64(hashmap* map, u64 key);
+
+/**
+ * @brief Computes the 64-bit hash used for string keys (MurmurHash64A).
+ *
+ * @param str The null-terminated string to hash. Required.
+ * @return The 64-bit hash of the string.
+ */
+API u64 hashmap_hash_string(const char* str);
@@ -0,0 +1,95 @@
+#include "mpsc_queue.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+
+// Each cell leads with a sequence number, which tells producers and the consumer whose turn it is.
+#define CELL_SEQUENCE(queue, position) ((volatile u32*)((u8*)(queue)->block + ((u64)((position) & ((queue)->capacity - 1)) * (queue)->cell_size)))
+#define CELL_DATA(cell_sequence) ((void*)((u8*)(cell_sequence) + sizeof(u64)))
+
+b8 mpsc_queue_create(u32 stride, u32 capacity, u64* memory_requirement, void* memory, mpsc_queue* out_queue) {
+    if (!memory_requirement) {
+        DERROR("mpsc_queue_create requires a valid pointer to hold the memory requirement.");
+        return false;
+    }
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        DERROR("mpsc_queue_create requires a power of 2 capacity (got %u).", capacity);
+        return false;
+    }
+
+    // Keep element data 8-byte aligned after the sequence number.
+    u32 cell_size = (u32)get_aligned(sizeof(u64) + stride, sizeof(u64));
+    *memory_requirement = (u64)cell_size * capacity;
+    if (!out_queue) {
+        return true;
+    }
+
+    kzero_memory(out_queue, sizeof(mpsc_queue));
+    out_queue->stride = stride;
+    out_queue->capacity = capacity;
+    out_queue->cell_size = cell_size;
+    if (memory) {
+        out_queue->owns_memory = false;
+        out_queue->block = memory;
+    } else {
+        out_queue->owns_memory = true;
+        out_queue->block = kallocate(*memory_requirement, MEMORY_TAG_RING_QUEUE);
+    }
+
+    // Each cell starts out ready to be written at its own position.
+    for (u32 i = 0; i < capacity; ++i) {
+        *CELL_SEQUENCE(out_queue, i) = i;
+    }
+
+    return true;
+}
+
+void mpsc_queue_destroy(mpsc_queue* queue) {
+    if (queue) {
+        if (queue->owns_memory && queue->block) {
+            kfree(queue->block, (u64)queue->cell_size * queue->capacity, MEMORY_TAG_RING_QUEUE);
+        }
+        kzero_memory(queue, sizeof(mpsc_queue));
+    }
+}
+
+b8 mpsc_queue_enqueue(mpsc_queue* queue, const void* value) {
+    u32 position = katomic_load_relaxed_u32(&queue->enqueue_position);
+    volatile u32* sequence;
+    while (true) {
+        sequence = CELL_SEQUENCE(queue, position);
+        i32 diff = (i32)(katomic_load_u32(sequence) - position);
+        if (diff == 0) {
+            // The cell is free for this position, so try to claim it.
+            if (katomic_compare_exchange_u32(&queue->enqueue_position, &position, position + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The consumer has not yet freed this cell from the previous lap.
+            return false;
+        } else {
+            // Another producer claimed this position first.
+            position = katomic_load_relaxed_u32(&queue->enqueue_position);
+        }
+    }
+
+    kcopy_memory(CELL_DATA(sequence), value, queue->stride);
+    // Publish the element to the consumer.
+    katomic_store_u32(sequence, position + 1);
+    return true;
+}
+
+b8 mpsc_queue_dequeue(mpsc_queue* queue, void* out_value) {
+    u32 position = queue->dequeue_position;
+    volatile u32* sequence = CELL_SEQUENCE(queue, position);
+    if (katomic_load_u32(sequence) != position + 1) {
+        // Empty, or the producer for this position has not published yet.
+        return false;
+    }
+
+    kcopy_memory(out_value, CELL_DATA(sequence), queue->stride);
+    // Hand the cell back to producers for the next lap.
+    katomic_store_u32(sequence, position + queue->capacity);
+    queue->dequeue_position = position + 1;
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core/katomic.h"
+#include "defines.h"
+
+/**
+ * @brief A bounded, lock-free multi-producer/single-consumer queue. Any number of threads
+ * may enqueue concurrently, while a single thread dequeues. Elements are copied in and out
+ * by value. Does not resize dynamically; enqueueing into a full queue fails rather than
+ * blocking or overwriting, so the caller decides how to apply backpressure.
+ */
+typedef struct mpsc_queue {
+    /** @brief The next position to be claimed by a producer. */
+    volatile u32 enqueue_position;
+    u8 enqueue_padding[KCACHE_LINE_SIZE - sizeof(u32)];
+    /** @brief The next position to be read by the consumer. Only touched by the consumer. */
+    u32 dequeue_position;
+    u8 dequeue_padding[KCACHE_LINE_SIZE - sizeof(u32)];
+    /** @brief The size of each element in bytes. */
+    u32 stride;
+    /** @brief The total number of elements available. Always a power of 2. */
+    u32 capacity;
+    /** @brief The size of each cell in bytes (a sequence number followed by the element). */
+    u32 cell_size;
+    /** @brief Indicates if the queue owns its memory block. */
+    b8 owns_memory;
+    /** @brief The block of memory to hold the cells. */
+    void* block;
+} mpsc_queue;
+
+/**
+ * @brief Creates a new multi-producer/single-consumer queue.
+ *
+ * @param stride The size of each element in bytes.
+ * @param capacity The total number of elements available. Must be a power of 2.
+ * @param memory_requirement A pointer to hold the memory requirement for the cells.
+ * @param memory The memory block used to hold the cells, of memory_requirement bytes. If 0
+ * is passed, a block is automatically allocated and freed upon creation/destruction.
+ * @param out_queue A pointer to hold the newly created queue.
+ * @returns True on success; otherwise false.
+ */
+b8 mpsc_queue_create(u32 stride, u32 capacity, u64* memory_requirement, void* memory, mpsc_queue* out_queue);
+
+/**
+ * @brief Destroys the given queue. If memory was not passed in during creation,
+ * it is freed here.
+ *
+ * @param queue A pointer to the queue to destroy.
+ */
+void mpsc_queue_destroy(mpsc_queue* queue);
+
+/**
+ * @brief Adds a copy of value to the queue, if space is available. Safe to call from any thread.
+ *
+ * @param queue A pointer to the queue to add data to.
+ * @param value A pointer to the value to be added.
+ * @return True on success; false if the queue is full.
+ */
+b8 mpsc_queue_enqueue(mpsc_queue* queue, const void* value);
+
+/**
+ * @brief Attempts to retrieve the next value from the queue. Must only be called by the consumer thread.
+ *
+ * @param queue A pointer to the queue to retrieve data from.
+ * @param out_value A pointer to hold the retrieved value.
+ * @return True on success; false if the queue is empty.
+ */
+b8 mpsc_queue_dequeue(mpsc_queue* queue, void* out_value);
@@ -0,0 +1,98 @@
+#include "work_deque.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+
+b8 work_deque_create(u32 capacity, void* memory, work_deque* out_deque) {
+    if (!out_deque) {
+        DERROR("work_deque_create requires a valid pointer to hold the deque.");
+        return false;
+    }
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        DERROR("work_deque_create requires a power of 2 capacity (got %u).", capacity);
+        return false;
+    }
+
+    kzero_memory(out_deque, sizeof(work_deque));
+    out_deque->capacity = capacity;
+    if (memory) {
+        out_deque->owns_memory = false;
+        out_deque->block = memory;
+    } else {
+        out_deque->owns_memory = true;
+        out_deque->block = kallocate(sizeof(u32) * capacity, MEMORY_TAG_RING_QUEUE);
+    }
+
+    return true;
+}
+
+void work_deque_destroy(work_deque* deque) {
+    if (deque) {
+        if (deque->owns_memory && deque->block) {
+            kfree((void*)deque->block, sizeof(u32) * deque->capacity, MEMORY_TAG_RING_QUEUE);
+        }
+        kzero_memory(deque, sizeof(work_deque));
+    }
+}
+
+b8 work_deque_push(work_deque* deque, u32 value) {
+    i64 b = katomic_load_relaxed_i64(&deque->bottom);
+    i64 t = katomic_load_i64(&deque->top);
+    if (b - t >= (i64)deque->capacity) {
+        return false;
+    }
+
+    katomic_store_relaxed_u32(&deque->block[b & (deque->capacity - 1)], value);
+    // Publish the element before the new bottom becomes visible to thieves.
+    katomic_store_i64(&deque->bottom, b + 1);
+    return true;
+}
+
+b8 work_deque_pop(work_deque* deque, u32* out_value) {
+    i64 b = katomic_load_relaxed_i64(&deque->bottom) - 1;
+    katomic_store_relaxed_i64(&deque->bottom, b);
+    // The reservation of the bottom element must be visible before top is read.
+    katomic_thread_fence();
+    i64 t = katomic_load_relaxed_i64(&deque->top);
+
+    if (t > b) {
+        // Empty, restore.
+        katomic_store_relaxed_i64(&deque->bottom, b + 1);
+        return false;
+    }
+
+    *out_value = katomic_load_relaxed_u32(&deque->block[b & (deque->capacity - 1)]);
+    if (t == b) {
+        // Last element, so race any thieves for it.
+        b8 won = katomic_compare_exchange_i64(&deque->top, &t, t + 1);
+        katomic_store_relaxed_i64(&deque->bottom, b + 1);
+        return won;
+    }
+
+    return true;
+}
+
+b8 work_deque_steal(work_deque* deque, u32* out_value) {
+    i64 t = katomic_load_i64(&deque->top);
+    katomic_thread_fence();
+    i64 b = katomic_load_i64(&deque->bottom);
+
+    if (t >= b) {
+        return false;
+    }
+
+    u32 value = katomic_load_relaxed_u32(&deque->block[t & (deque->capacity - 1)]);
+    if (!katomic_compare_exchange_i64(&deque->top, &t, t + 1)) {
+        // Lost the race to the owner or another thief.
+        return false;
+    }
+
+    *out_value = value;
+    return true;
+}
+
+u32 work_deque_length(work_deque* deque) {
+    i64 b = katomic_load_relaxed_i64(&deque->bottom);
+    i64 t = katomic_load_relaxed_i64(&deque->top);
+    return b > t ? (u32)(b - t) : 0;
+}
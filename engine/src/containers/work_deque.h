@@ -0,0 +1,75 @@
+#pragma once
+
+#include "core/katomic.h"
+#include "defines.h"
+
+/**
+ * @brief A bounded, lock-free work-stealing deque of 32-bit values (Chase-Lev).
+ * The owning thread pushes and pops at the bottom without contention, while any
+ * other thread may steal from the top. Does not resize dynamically.
+ */
+typedef struct work_deque {
+    /** @brief The index one past the newest element. Written only by the owner. */
+    volatile i64 bottom;
+    u8 bottom_padding[KCACHE_LINE_SIZE - sizeof(i64)];
+    /** @brief The index of the oldest element. Advanced by the owner and thieves. */
+    volatile i64 top;
+    u8 top_padding[KCACHE_LINE_SIZE - sizeof(i64)];
+    /** @brief The total number of elements available. Always a power of 2. */
+    u32 capacity;
+    /** @brief Indicates if the deque owns its memory block. */
+    b8 owns_memory;
+    /** @brief The block of memory to hold the data. */
+    volatile u32* block;
+} work_deque;
+
+/**
+ * @brief Creates a new work-stealing deque of the given capacity.
+ *
+ * @param capacity The total number of elements available. Must be a power of 2.
+ * @param memory The memory block used to hold the data. Should be sizeof(u32) * capacity.
+ * If 0 is passed, a block is automatically allocated and freed upon creation/destruction.
+ * @param out_deque A pointer to hold the newly created deque.
+ * @returns True on success; otherwise false.
+ */
+b8 work_deque_create(u32 capacity, void* memory, work_deque* out_deque);
+
+/**
+ * @brief Destroys the given deque. If memory was not passed in during creation,
+ * it is freed here.
+ *
+ * @param deque A pointer to the deque to destroy.
+ */
+void work_deque_destroy(work_deque* deque);
+
+/**
+ * @brief Pushes a value onto the bottom of the deque. Must only be called by the owning thread.
+ *
+ * @param deque A pointer to the deque to push to.
+ * @param value The value to be pushed.
+ * @return True on success; false if the deque is full.
+ */
+b8 work_deque_push(work_deque* deque, u32 value);
+
+/**
+ * @brief Pops the newest value off the bottom of the deque. Must only be called by the owning thread.
+ *
+ * @param deque A pointer to the deque to pop from.
+ * @param out_value A pointer to hold the popped value.
+ * @return True on success; false if the deque is empty.
+ */
+b8 work_deque_pop(work_deque* deque, u32* out_value);
+
+/**
+ * @brief Attempts to steal the oldest value from the top of the deque. Safe to call from any thread.
+ *
+ * @param deque A pointer to the deque to steal from.
+ * @param out_value A pointer to hold the stolen value.
+ * @return True on success; false if the deque was empty or another thread won the race.
+ */
+b8 work_deque_steal(work_deque* deque, u32* out_value);
+
+/**
+ * @brief Returns an approximation of the number of elements in the deque. Safe to call from any thread.
+ */
+u32 work_deque_length(work_deque* deque);
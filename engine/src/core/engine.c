@@ -7,6 +7,7 @@
 #include "core/frame_data.h"
 #include "core/input.h"
 #include "core/kmemory.h"
+#include "core/kname.h"
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "core/metrics.h"
@@ -300,6 +301,9 @@ b8 engine_run(application* game_inst) {
     // Shut down all systems.
     systems_manager_shutdown(&engine_state->sys_manager_state);
 
+    // Release interned names, which systems may use right up to their own shutdown.
+    kname_system_shutdown();
+
     game_inst->stage = APPLICATION_STAGE_UNINITIALIZED;
 
     return true;
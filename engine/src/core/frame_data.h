@@ -4,6 +4,9 @@
 
 struct linear_allocator;
 
+/** @brief The maximum number of cascades a directional light's shadow map can be split into. */
+#define MAX_SHADOW_CASCADE_COUNT 4
+
 typedef struct frame_allocator_int {
     void* (*allocate)(u64 size);
     void (*free)(void* block, u64 size);
@@ -23,9 +26,24 @@ typedef struct frame_data {
     /** @brief The number of meshes drawn in the last frame. */
     u32 drawn_mesh_count;
 
-    /** @brief The number of meshes drawn in the shadow pass in the last frame. */
+    /** @brief The number of meshes drawn in the shadow pass in the last frame, across all cascades. */
     u32 drawn_shadow_mesh_count;
 
+    /** @brief The number of meshes drawn into each shadow cascade in the last frame. 0 for a cascade reused from an earlier frame. */
+    u32 drawn_shadow_cascade_mesh_counts[MAX_SHADOW_CASCADE_COUNT];
+
+    /** @brief The number of geometry draw calls issued in the last frame, with each instanced draw counting once. */
+    u32 draw_call_count;
+
+    /** @brief The number of bytes of global uniform data the material system uploaded in the last frame. */
+    u32 material_global_bytes_uploaded;
+
+    /** @brief The number of bytes of instance uniform data the material system uploaded in the last frame. */
+    u32 material_instance_bytes_uploaded;
+
+    /** @brief The number of materials whose instance data was rewritten in the last frame, rather than only bound. */
+    u32 material_instance_update_count;
+
     /** @brief A pointer to the engine's frame allocator. */
     frame_allocator_int allocator;
 
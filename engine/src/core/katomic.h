@@ -0,0 +1,124 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @file katomic.h
+ * @brief Thin wrappers around the compiler's atomic builtins. Loads use acquire semantics,
+ * stores use release semantics and read-modify-write operations are sequentially consistent
+ * unless the name says otherwise.
+ */
+
+#if !defined(__clang__) && !defined(__GNUC__)
+#error "katomic.h requires clang or gcc atomic builtins."
+#endif
+
+/** @brief Size of a cache line in bytes. Used to pad data shared between threads. */
+#define KCACHE_LINE_SIZE 64
+
+/** @brief Issues a full (sequentially consistent) memory fence. */
+INLINE void katomic_thread_fence(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/** @brief Hints to the processor that the caller is spinning. */
+INLINE void katomic_pause(void) {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// u32
+
+INLINE u32 katomic_load_u32(volatile u32* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+INLINE u32 katomic_load_relaxed_u32(volatile u32* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+INLINE void katomic_store_u32(volatile u32* ptr, u32 value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+INLINE void katomic_store_relaxed_u32(volatile u32* ptr, u32 value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+}
+
+/** @brief Adds value to the target and returns the value held before the addition. */
+INLINE u32 katomic_fetch_add_u32(volatile u32* ptr, u32 value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+/** @brief Subtracts value from the target and returns the value held before the subtraction. */
+INLINE u32 katomic_fetch_sub_u32(volatile u32* ptr, u32 value) {
+    return __atomic_fetch_sub(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+/** @brief Stores value into the target and returns the previously-held value. */
+INLINE u32 katomic_exchange_u32(volatile u32* ptr, u32 value) {
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Stores desired into the target if it currently holds *expected. On failure,
+ * *expected is updated with the value actually held.
+ * @returns True if the exchange took place; otherwise false.
+ */
+INLINE b8 katomic_compare_exchange_u32(volatile u32* ptr, u32* expected, u32 desired) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE);
+}
+
+// u64
+
+INLINE u64 katomic_load_u64(volatile u64* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+INLINE void katomic_store_u64(volatile u64* ptr, u64 value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+/** @brief Adds value to the target and returns the value held before the addition. */
+INLINE u64 katomic_fetch_add_u64(volatile u64* ptr, u64 value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Stores desired into the target if it currently holds *expected. On failure,
+ * *expected is updated with the value actually held.
+ * @returns True if the exchange took place; otherwise false.
+ */
+INLINE b8 katomic_compare_exchange_u64(volatile u64* ptr, u64* expected, u64 desired) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE);
+}
+
+// i64
+
+INLINE i64 katomic_load_i64(volatile i64* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+INLINE i64 katomic_load_relaxed_i64(volatile i64* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+INLINE void katomic_store_i64(volatile i64* ptr, i64 value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+INLINE void katomic_store_relaxed_i64(volatile i64* ptr, i64 value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Stores desired into the target if it currently holds *expected. On failure,
+ * *expected is updated with the value actually held.
+ * @returns True if the exchange took place; otherwise false.
+ */
+INLINE b8 katomic_compare_exchange_i64(volatile i64* ptr, i64* expected, i64 desired) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
@@ -1,5 +1,6 @@
 #include "core/kmemory.h"
 
+#include "core/katomic.h"
 #include "core/kstring.h"
 #include "core/mutex.h"
 #include "core/logger.h"
@@ -11,11 +12,60 @@
 #include <string.h>
 
 struct memory_stats {
-    u64 total_allocated;
-    u64 tagged_allocations[MEMORY_TAG_MAX_TAGS];
+    volatile u64 total_allocated;
+    volatile u64 tagged_allocations[MEMORY_TAG_MAX_TAGS];
+    volatile u64 new_tagged_allocations[MEMORY_TAG_MAX_TAGS];
+    volatile u64 new_tagged_deallocations[MEMORY_TAG_MAX_TAGS];
+};
+
+// Small allocations are served from per-thread caches of fixed size classes, carved out of
+// spans of a dedicated arena. Everything else goes to the dynamic allocator under a lock.
+#define SMALL_CLASS_COUNT 14
+#define SMALL_BLOCK_MAX_SIZE 2048
+// Every small block is aligned to this. Only requests made without an alignment of their own are
+// served from the caches though, since a small block has no header to record the alignment asked
+// for, and kmemory_get_size_alignment must return the same alignment a realloc will be asked for.
+#define SMALL_BLOCK_ALIGNMENT 16
+#define SMALL_SPAN_SIZE KIBIBYTES(64)
+// The default small block arena size, as a fraction of the total allocation size, and its cap.
+#define SMALL_ARENA_DEFAULT_DIVISOR 8
+#define SMALL_ARENA_DEFAULT_MAX MEBIBYTES(256)
+// The number of allocations/frees a thread makes before publishing its stats.
+#define STATS_FLUSH_INTERVAL 64
+
+static const u32 small_class_sizes[SMALL_CLASS_COUNT] = {16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048};
+
+// A free small block. Blocks move between threads and the central lists in batches, with the
+// first block of each batch linking to the next batch.
+typedef struct small_block {
+    struct small_block* next;
+    struct small_block* next_batch;
+} small_block;
+
+// Batches of free blocks of one size class, shared by all threads.
+typedef struct small_class_central {
+    kmutex mutex;
+    small_block* batches;
+} small_class_central;
+
+typedef struct small_class_cache {
+    small_block* head;
+    u32 count;
+} small_class_cache;
+
+// Per-thread allocation state. Stats are accumulated here and published in batches.
+typedef struct thread_memory_cache {
+    // The memory system instance this cache belongs to. A mismatch means the cache is stale.
+    u32 epoch;
+    small_class_cache classes[SMALL_CLASS_COUNT];
+
+    u32 pending_stat_count;
+    i64 total_allocated;
+    i64 alloc_count;
+    i64 tagged_allocations[MEMORY_TAG_MAX_TAGS];
     u64 new_tagged_allocations[MEMORY_TAG_MAX_TAGS];
     u64 new_tagged_deallocations[MEMORY_TAG_MAX_TAGS];
-};
+} thread_memory_cache;
 
 static const char* memory_tag_strings[MEMORY_TAG_MAX_TAGS] = {
     "UNKNOWN    ",
@@ -54,17 +104,204 @@ static const char* memory_tag_strings[MEMORY_TAG_MAX_TAGS] = {
 typedef struct memory_system_state {
     memory_system_configuration config;
     struct memory_stats stats;
-    u64 alloc_count;
+    volatile u64 alloc_count;
     u64 allocator_memory_requirement;
     dynamic_allocator allocator;
     void* allocator_block;
-    // A mutex for allocations/frees
+    // A mutex for allocations/frees from the dynamic allocator.
     kmutex allocation_mutex;
+
+    // The arena small blocks are carved from, in spans of SMALL_SPAN_SIZE.
+    u8* small_arena;
+    u64 small_arena_size;
+    u32 small_span_count;
+    volatile u32 small_spans_used;
+    // The size class of each span in use.
+    u8* small_span_classes;
+    small_class_central small_classes[SMALL_CLASS_COUNT];
+    // Maps (size + 15) / 16 to a size class, for sizes up to SMALL_BLOCK_MAX_SIZE.
+    u8 small_class_lookup[SMALL_BLOCK_MAX_SIZE / SMALL_BLOCK_ALIGNMENT + 1];
+    u32 epoch;
 } memory_system_state;
 
 // Pointer to system state.
 static memory_system_state* state_ptr;
 
+// Incremented each time the memory system is initialized, so thread caches can tell they are stale.
+static volatile u32 memory_epoch = 0;
+
+static THREAD_LOCAL thread_memory_cache thread_cache;
+
+/** The number of blocks of a size class moved between a thread and the central list at once. */
+static u32 small_class_batch_size(u32 class_index) {
+    return CLAMP(KIBIBYTES(8) / small_class_sizes[class_index], 4, 64);
+}
+
+static thread_memory_cache* thread_cache_get(void) {
+    thread_memory_cache* cache = &thread_cache;
+    if (cache->epoch != state_ptr->epoch) {
+        // Anything cached belongs to a previous instance of the memory system.
+        kzero_memory(cache, sizeof(thread_memory_cache));
+        cache->epoch = state_ptr->epoch;
+    }
+    return cache;
+}
+
+static void stats_flush(thread_memory_cache* cache) {
+    struct memory_stats* stats = &state_ptr->stats;
+    if (cache->total_allocated) {
+        katomic_fetch_add_u64(&stats->total_allocated, (u64)cache->total_allocated);
+    }
+    if (cache->alloc_count) {
+        katomic_fetch_add_u64(&state_ptr->alloc_count, (u64)cache->alloc_count);
+    }
+    for (u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i) {
+        if (cache->tagged_allocations[i]) {
+            katomic_fetch_add_u64(&stats->tagged_allocations[i], (u64)cache->tagged_allocations[i]);
+        }
+        if (cache->new_tagged_allocations[i]) {
+            katomic_fetch_add_u64(&stats->new_tagged_allocations[i], cache->new_tagged_allocations[i]);
+        }
+        if (cache->new_tagged_deallocations[i]) {
+            katomic_fetch_add_u64(&stats->new_tagged_deallocations[i], cache->new_tagged_deallocations[i]);
+        }
+    }
+    cache->pending_stat_count = 0;
+    cache->total_allocated = 0;
+    cache->alloc_count = 0;
+    kzero_memory(cache->tagged_allocations, sizeof(cache->tagged_allocations));
+    kzero_memory(cache->new_tagged_allocations, sizeof(cache->new_tagged_allocations));
+    kzero_memory(cache->new_tagged_deallocations, sizeof(cache->new_tagged_deallocations));
+}
+
+static void stats_record_allocation(thread_memory_cache* cache, u64 size, memory_tag tag) {
+    cache->total_allocated += size;
+    cache->tagged_allocations[tag] += size;
+    cache->new_tagged_allocations[tag] += size;
+    cache->alloc_count++;
+    if (++cache->pending_stat_count >= STATS_FLUSH_INTERVAL) {
+        stats_flush(cache);
+    }
+}
+
+static void stats_record_free(thread_memory_cache* cache, u64 size, memory_tag tag) {
+    cache->total_allocated -= size;
+    cache->tagged_allocations[tag] -= size;
+    cache->new_tagged_deallocations[tag] += size;
+    cache->alloc_count--;
+    if (++cache->pending_stat_count >= STATS_FLUSH_INTERVAL) {
+        stats_flush(cache);
+    }
+}
+
+static b8 small_block_owned(void* block) {
+    return (u8*)block >= state_ptr->small_arena && (u8*)block < state_ptr->small_arena + state_ptr->small_arena_size;
+}
+
+static u32 small_block_class(void* block) {
+    return state_ptr->small_span_classes[((u8*)block - state_ptr->small_arena) / SMALL_SPAN_SIZE];
+}
+
+static void small_central_push(u32 class_index, small_block* batch) {
+    small_class_central* central = &state_ptr->small_classes[class_index];
+    kmutex_lock(&central->mutex);
+    batch->next_batch = central->batches;
+    central->batches = batch;
+    kmutex_unlock(&central->mutex);
+}
+
+/**
+ * Refills the thread's cache for the given class with a batch from the central list, or from a
+ * newly carved span. Returns false if the arena is exhausted.
+ */
+static b8 small_cache_refill(small_class_cache* class_cache, u32 class_index) {
+    u32 batch_size = small_class_batch_size(class_index);
+
+    small_class_central* central = &state_ptr->small_classes[class_index];
+    kmutex_lock(&central->mutex);
+    small_block* batch = central->batches;
+    if (batch) {
+        central->batches = batch->next_batch;
+    }
+    kmutex_unlock(&central->mutex);
+
+    if (batch) {
+        // Batches flushed from exiting threads may be short, so count what actually arrived.
+        u32 count = 0;
+        for (small_block* b = batch; b; b = b->next) {
+            count++;
+        }
+        class_cache->head = batch;
+        class_cache->count = count;
+        return true;
+    }
+
+    // Nothing free anywhere, so carve a new span into batches. This thread keeps the first.
+    u32 span = katomic_fetch_add_u32(&state_ptr->small_spans_used, 1);
+    if (span >= state_ptr->small_span_count) {
+        return false;
+    }
+    state_ptr->small_span_classes[span] = (u8)class_index;
+
+    u32 block_size = small_class_sizes[class_index];
+    u32 block_count = SMALL_SPAN_SIZE / block_size;
+    u8* span_memory = state_ptr->small_arena + ((u64)span * SMALL_SPAN_SIZE);
+    // Whole batches only; the remainder of the span (if any) is left unused.
+    u32 batch_count = block_count / batch_size;
+    for (u32 b = 0; b < batch_count; ++b) {
+        small_block* first = (small_block*)(span_memory + ((u64)b * batch_size * block_size));
+        small_block* current = first;
+        for (u32 i = 1; i < batch_size; ++i) {
+            small_block* next = (small_block*)((u8*)current + block_size);
+            current->next = next;
+            current = next;
+        }
+        current->next = 0;
+
+        if (b == 0) {
+            class_cache->head = first;
+            class_cache->count = batch_size;
+        } else {
+            small_central_push(class_index, first);
+        }
+    }
+    return true;
+}
+
+static void* small_block_allocate(thread_memory_cache* cache, u32 class_index) {
+    small_class_cache* class_cache = &cache->classes[class_index];
+    if (!class_cache->head && !small_cache_refill(class_cache, class_index)) {
+        return 0;
+    }
+    small_block* block = class_cache->head;
+    class_cache->head = block->next;
+    class_cache->count--;
+    return block;
+}
+
+static void small_block_free(thread_memory_cache* cache, void* block, u32 class_index) {
+    small_class_cache* class_cache = &cache->classes[class_index];
+    small_block* freed = block;
+    freed->next = class_cache->head;
+    class_cache->head = freed;
+    class_cache->count++;
+
+    // Hand a batch back once this thread holds more than two, so memory freed on one thread
+    // becomes available to others.
+    u32 batch_size = small_class_batch_size(class_index);
+    if (class_cache->count > batch_size * 2) {
+        small_block* batch = class_cache->head;
+        small_block* last = batch;
+        for (u32 i = 1; i < batch_size; ++i) {
+            last = last->next;
+        }
+        class_cache->head = last->next;
+        class_cache->count -= batch_size;
+        last->next = 0;
+        small_central_push(class_index, batch);
+    }
+}
+
 b8 memory_system_initialize(memory_system_configuration config) {
     // The amount needed by the system state.
     u64 state_memory_requirement = sizeof(memory_system_state);
@@ -73,9 +310,18 @@ b8 memory_system_initialize(memory_system_configuration config) {
     u64 alloc_requirement = 0;
     dynamic_allocator_create(config.total_alloc_size, &alloc_requirement, 0, 0);
 
+    // The small block arena, plus the class of each of its spans.
+    if (!config.small_block_arena_size) {
+        config.small_block_arena_size = KMIN(config.total_alloc_size / SMALL_ARENA_DEFAULT_DIVISOR, SMALL_ARENA_DEFAULT_MAX);
+    }
+    u32 span_count = (u32)(config.small_block_arena_size / SMALL_SPAN_SIZE);
+    u64 arena_requirement = (u64)span_count * SMALL_SPAN_SIZE;
+    // Extra room to align the arena.
+    u64 small_requirement = arena_requirement + span_count + SMALL_BLOCK_ALIGNMENT;
+
     // Call the platform allocator to get the memory for the whole system, including the state.
     // TODO: memory alignment
-    void* block = platform_allocate(state_memory_requirement + alloc_requirement, true);
+    void* block = platform_allocate(state_memory_requirement + alloc_requirement + small_requirement, true);
     if (!block) {
         DFATAL("Memory system allocation failed and the system cannot continue.");
         return false;
@@ -89,6 +335,12 @@ b8 memory_system_initialize(memory_system_configuration config) {
     platform_zero_memory(&state_ptr->stats, sizeof(state_ptr->stats));
     // The allocator block is in the same block of memory, but after the state.
     state_ptr->allocator_block = ((void*)block + state_memory_requirement);
+    // Then the small block arena and its span classes.
+    state_ptr->small_arena = (u8*)get_aligned((u64)state_ptr->allocator_block + alloc_requirement, SMALL_BLOCK_ALIGNMENT);
+    state_ptr->small_arena_size = arena_requirement;
+    state_ptr->small_span_count = span_count;
+    state_ptr->small_spans_used = 0;
+    state_ptr->small_span_classes = state_ptr->small_arena + arena_requirement;
 
     if (!dynamic_allocator_create(
             config.total_alloc_size,
@@ -105,18 +357,40 @@ b8 memory_system_initialize(memory_system_configuration config) {
         return false;
     }
 
+    for (u32 c = 0; c < SMALL_CLASS_COUNT; ++c) {
+        state_ptr->small_classes[c].batches = 0;
+        if (!kmutex_create(&state_ptr->small_classes[c].mutex)) {
+            DFATAL("Unable to create small block mutex!");
+            return false;
+        }
+    }
+    u32 class_index = 0;
+    for (u32 i = 0; i <= SMALL_BLOCK_MAX_SIZE / SMALL_BLOCK_ALIGNMENT; ++i) {
+        while (small_class_sizes[class_index] < i * SMALL_BLOCK_ALIGNMENT) {
+            class_index++;
+        }
+        state_ptr->small_class_lookup[i] = (u8)class_index;
+    }
+    state_ptr->epoch = katomic_fetch_add_u32(&memory_epoch, 1) + 1;
+
     DDEBUG("Memory system successfully allocated %llu bytes.", config.total_alloc_size);
     return true;
 }
 
 void memory_system_shutdown(void* state) {
     if (state_ptr) {
-        // Destroy allocation mutex
+        // Other threads flush their own caches as they exit, which leaves this one.
+        kmemory_thread_cache_flush();
+
+        // Destroy allocation mutexes
         kmutex_destroy(&state_ptr->allocation_mutex);
+        for (u32 c = 0; c < SMALL_CLASS_COUNT; ++c) {
+            kmutex_destroy(&state_ptr->small_classes[c].mutex);
+        }
 
         dynamic_allocator_destroy(&state_ptr->allocator);
         // Free the entire block.
-        platform_free(state_ptr, state_ptr->allocator_memory_requirement + sizeof(memory_system_state));
+        platform_free(state_ptr, false);
     }
     state_ptr = 0;
 }
@@ -125,7 +399,19 @@ void* kallocate(u64 size, memory_tag tag) {
     return kallocate_aligned(size, 1, tag);
 }
 
+void* kallocate_no_zero(u64 size, memory_tag tag) {
+    return kallocate_aligned_no_zero(size, 1, tag);
+}
+
 void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag) {
+    void* block = kallocate_aligned_no_zero(size, alignment, tag);
+    if (block) {
+        platform_zero_memory(block, size);
+    }
+    return block;
+}
+
+void* kallocate_aligned_no_zero(u64 size, u16 alignment, memory_tag tag) {
     if (tag == MEMORY_TAG_UNKNOWN) {
         DWARN("kallocate_aligned called using MEMORY_TAG_UNKNOWN. Re-class this allocation.");
     }
@@ -134,20 +420,32 @@ void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag) {
     // really happen.
     void* block = 0;
     if (state_ptr) {
+        thread_memory_cache* cache = thread_cache_get();
+
+        // Small requests come from this thread's cache, without taking any lock.
+        if (size <= SMALL_BLOCK_MAX_SIZE && alignment == 1) {
+            u32 class_index = state_ptr->small_class_lookup[(size + SMALL_BLOCK_ALIGNMENT - 1) / SMALL_BLOCK_ALIGNMENT];
+            block = small_block_allocate(cache, class_index);
+            if (block) {
+                // Tracked by class size, as that is what a free of this block can recover.
+                stats_record_allocation(cache, small_class_sizes[class_index], tag);
+                return block;
+            }
+            // The arena is exhausted; fall back to the dynamic allocator.
+        }
+
         // Make sure multithreaded requests don't trample each other.
         if (!kmutex_lock(&state_ptr->allocation_mutex)) {
             DFATAL("Error obtaining mutex lock during allocation.");
             return 0;
         }
-
-        // FIXME: Track aligned alloc offset as part of size.
-        state_ptr->stats.total_allocated += size;
-        state_ptr->stats.tagged_allocations[tag] += size;
-        state_ptr->stats.new_tagged_allocations[tag] += size;
-        state_ptr->alloc_count++;
-
         block = dynamic_allocator_allocate_aligned(&state_ptr->allocator, size, alignment);
         kmutex_unlock(&state_ptr->allocation_mutex);
+
+        if (block) {
+            // FIXME: Track aligned alloc offset as part of size.
+            stats_record_allocation(cache, size, tag);
+        }
     } else {
         // If the system is not up yet, warn about it but give memory for now.
         /* DTRACE("Warning: kallocate_aligned called before the memory system is initialized."); */
@@ -156,7 +454,6 @@ void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag) {
     }
 
     if (block) {
-        platform_zero_memory(block, size);
         return block;
     }
 
@@ -165,16 +462,7 @@ void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag) {
 }
 
 void kallocate_report(u64 size, memory_tag tag) {
-    // Make sure multithreaded requests don't trample each other.
-    if (!kmutex_lock(&state_ptr->allocation_mutex)) {
-        DFATAL("Error obtaining mutex lock during allocation reporting.");
-        return;
-    }
-    state_ptr->stats.total_allocated += size;
-    state_ptr->stats.tagged_allocations[tag] += size;
-    state_ptr->stats.new_tagged_allocations[tag] += size;
-    state_ptr->alloc_count++;
-    kmutex_unlock(&state_ptr->allocation_mutex);
+    stats_record_allocation(thread_cache_get(), size, tag);
 }
 
 void* kreallocate(void* block, u64 old_size, u64 new_size, memory_tag tag) {
@@ -182,10 +470,19 @@ void* kreallocate(void* block, u64 old_size, u64 new_size, memory_tag tag) {
 }
 
 void* kreallocate_aligned(void* block, u64 old_size, u64 new_size, u16 alignment, memory_tag tag) {
-    void* new_block = kallocate_aligned(new_size, alignment, tag);
-    if (block && new_block) {
-        kcopy_memory(new_block, block, old_size);
-        kfree_aligned(block, old_size, alignment, tag);
+    void* new_block = kallocate_aligned_no_zero(new_size, alignment, tag);
+    if (new_block) {
+        // Only the part not copied over needs zeroing.
+        u64 copy_size = block ? KMIN(old_size, new_size) : 0;
+        if (copy_size) {
+            kcopy_memory(new_block, block, copy_size);
+        }
+        if (new_size > copy_size) {
+            platform_zero_memory((u8*)new_block + copy_size, new_size - copy_size);
+        }
+        if (block) {
+            kfree_aligned(block, old_size, alignment, tag);
+        }
     }
     return new_block;
 }
@@ -204,20 +501,26 @@ void kfree_aligned(void* block, u64 size, u16 alignment, memory_tag tag) {
         DWARN("kfree_aligned called using MEMORY_TAG_UNKNOWN. Re-class this allocation.");
     }
     if (state_ptr) {
+        thread_memory_cache* cache = thread_cache_get();
+
+        // Small blocks go back to this thread's cache, whichever thread allocated them.
+        if (small_block_owned(block)) {
+            u32 class_index = small_block_class(block);
+            small_block_free(cache, block, class_index);
+            stats_record_free(cache, small_class_sizes[class_index], tag);
+            return;
+        }
+
         // Make sure multithreaded requests don't trample each other.
         if (!kmutex_lock(&state_ptr->allocation_mutex)) {
             DFATAL("Unable to obtain mutex lock for free operation. Heap corruption is likely.");
             return;
         }
-
-        state_ptr->stats.total_allocated -= size;
-        state_ptr->stats.tagged_allocations[tag] -= size;
-        state_ptr->stats.new_tagged_deallocations[tag] += size;
-        state_ptr->alloc_count--;
         b8 result = dynamic_allocator_free_aligned(&state_ptr->allocator, block);
-
         kmutex_unlock(&state_ptr->allocation_mutex);
 
+        stats_record_free(cache, size, tag);
+
         // If the free failed, it's possible this is because the allocation was made
         // before this system was started up. Since this absolutely should be an exception
         // to the rule, try freeing it on the platform level. If this fails, some other
@@ -233,19 +536,32 @@ void kfree_aligned(void* block, u64 size, u16 alignment, memory_tag tag) {
 }
 
 void kfree_report(u64 size, memory_tag tag) {
-    // Make sure multithreaded requests don't trample each other.
-    if (!kmutex_lock(&state_ptr->allocation_mutex)) {
-        DFATAL("Error obtaining mutex lock during allocation reporting.");
+    stats_record_free(thread_cache_get(), size, tag);
+}
+
+void kmemory_thread_cache_flush(void) {
+    if (!state_ptr) {
         return;
     }
-    state_ptr->stats.total_allocated -= size;
-    state_ptr->stats.tagged_allocations[tag] -= size;
-    state_ptr->stats.new_tagged_deallocations[tag] += size;
-    state_ptr->alloc_count--;
-    kmutex_unlock(&state_ptr->allocation_mutex);
+    thread_memory_cache* cache = thread_cache_get();
+    for (u32 c = 0; c < SMALL_CLASS_COUNT; ++c) {
+        small_class_cache* class_cache = &cache->classes[c];
+        if (class_cache->head) {
+            // This may be a partial batch, which is counted when taken again.
+            small_central_push(c, class_cache->head);
+            class_cache->head = 0;
+            class_cache->count = 0;
+        }
+    }
+    stats_flush(cache);
 }
 
 b8 kmemory_get_size_alignment(void* block, u64* out_size, u16* out_alignment) {
+    if (small_block_owned(block)) {
+        *out_size = small_class_sizes[small_block_class(block)];
+        *out_alignment = 1;
+        return true;
+    }
     if (!kmutex_lock(&state_ptr->allocation_mutex)) {
         DFATAL("Error obtaining mutex lock during kmemory_get_size_alignment.");
         return false;
@@ -284,6 +600,9 @@ const char* get_unit_for_size(u64 size_bytes, f32* out_amount) {
 }
 
 char* get_memory_usage_str(void) {
+    // Stats from other threads are published every few allocations, so may lag slightly.
+    stats_flush(thread_cache_get());
+
     char buffer[8000] = "System memory use (tagged):\n";
     u64 offset = strlen(buffer);
     for (u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i) {
@@ -298,8 +617,10 @@ char* get_memory_usage_str(void) {
                               amounts[0], units[0], amounts[1], units[1], amounts[2], units[2]);
         offset += length;
     }
-    kzero_memory(&state_ptr->stats.new_tagged_allocations, sizeof(state_ptr->stats.new_tagged_allocations));
-    kzero_memory(&state_ptr->stats.new_tagged_deallocations, sizeof(state_ptr->stats.new_tagged_deallocations));
+    for (u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i) {
+        katomic_store_u64(&state_ptr->stats.new_tagged_allocations[i], 0);
+        katomic_store_u64(&state_ptr->stats.new_tagged_deallocations[i], 0);
+    }
     {
         // Compute total usage.
         u64 total_space = dynamic_allocator_total_space(&state_ptr->allocator);
@@ -317,6 +638,19 @@ char* get_memory_usage_str(void) {
         i32 length = snprintf(buffer + offset, 8000, "Total memory usage: %.2f%s of %.2f%s (%.2f%%)\n", used_amount, used_unit, total_amount, total_unit, percent_used);
         offset += length;
     }
+    {
+        // Small block arena usage, counted in whole spans whether or not their blocks are in use.
+        u64 used_space = (u64)KMIN(katomic_load_u32(&state_ptr->small_spans_used), state_ptr->small_span_count) * SMALL_SPAN_SIZE;
+
+        f32 used_amount = 1.0f;
+        const char* used_unit = get_unit_for_size(used_space, &used_amount);
+
+        f32 total_amount = 1.0f;
+        const char* total_unit = get_unit_for_size(state_ptr->small_arena_size, &total_amount);
+
+        i32 length = snprintf(buffer + offset, 8000, "Small block arena: %.2f%s of %.2f%s reserved\n", used_amount, used_unit, total_amount, total_unit);
+        offset += length;
+    }
 
     char* out_string = string_duplicate(buffer);
     return out_string;
@@ -324,7 +658,8 @@ char* get_memory_usage_str(void) {
 
 u64 get_memory_alloc_count(void) {
     if (state_ptr) {
-        return state_ptr->alloc_count;
+        stats_flush(thread_cache_get());
+        return katomic_load_u64(&state_ptr->alloc_count);
     }
     return 0;
 }
\ No newline at end of file
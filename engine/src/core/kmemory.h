@@ -47,6 +47,11 @@ typedef enum memory_tag {
 typedef struct memory_system_configuration {
     /** @brief The total memory size in byes used by the internal allocator for this system. */
     u64 total_alloc_size;
+    /**
+     * @brief The size in bytes of the arena small allocations (2KiB and under) are served from,
+     * through per-thread caches. 0 uses an eighth of total_alloc_size, up to 256MiB.
+     */
+    u64 small_block_arena_size;
 } memory_system_configuration;
 
 /**
@@ -56,7 +61,7 @@ typedef struct memory_system_configuration {
 API b8 memory_system_initialize(memory_system_configuration config);
 
 /**
- * @brief Shuts down the memory system.
+ * @brief Shuts down the memory system. The calling thread's cache is flushed first.
  */
 API void memory_system_shutdown(void* state);
 
@@ -69,6 +74,16 @@ API void memory_system_shutdown(void* state);
  */
 API void* kallocate(u64 size, memory_tag tag);
 
+/**
+ * @brief Performs a memory allocation from the host of the given size, without zeroing it.
+ * Only use this where the caller overwrites the whole block straight away.
+ * The allocation is tracked for the provided tag.
+ * @param size The size of the allocation.
+ * @param tag Indicates the use of the allocated block.
+ * @returns If successful, a pointer to a block of allocated memory; otherwise 0.
+ */
+API void* kallocate_no_zero(u64 size, memory_tag tag);
+
 /**
  * @brief Performs an aligned memory allocation from the host of the given size and alignment.
  * The allocation is tracked for the provided tag. NOTE: Memory allocated this way must be freed
@@ -80,6 +95,17 @@ API void* kallocate(u64 size, memory_tag tag);
  */
 API void* kallocate_aligned(u64 size, u16 alignment, memory_tag tag);
 
+/**
+ * @brief Performs an aligned memory allocation from the host of the given size and alignment,
+ * without zeroing it. Only use this where the caller overwrites the whole block straight away.
+ * NOTE: Memory allocated this way must be freed using kfree_aligned.
+ * @param size The size of the allocation.
+ * @param alignment The alignment in bytes.
+ * @param tag Indicates the use of the allocated block.
+ * @returns If successful, a pointer to a block of allocated memory; otherwise 0.
+ */
+API void* kallocate_aligned_no_zero(u64 size, u16 alignment, memory_tag tag);
+
 /**
  * @brief Reports an allocation associated with the application, but made externally.
  * This can be done for items allocated within 3rd party libraries, for example, to
@@ -152,6 +178,13 @@ API void kfree_aligned(void* block, u64 size, u16 alignment, memory_tag tag);
  */
 API void kfree_report(u64 size, memory_tag tag);
 
+/**
+ * @brief Returns the calling thread's cached small blocks to the shared pool and publishes its
+ * pending allocation stats. Job threads do this as they exit; any other thread which allocates
+ * should call this before it exits, or its cached blocks and stats are lost until shutdown.
+ */
+API void kmemory_thread_cache_flush(void);
+
 /**
  * @brief Returns the size and alignment of the given block of memory.
  * NOTE: A failure result from this method most likely indicates heap corruption.
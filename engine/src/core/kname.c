@@ -0,0 +1,141 @@
+#include "kname.h"
+
+#include "containers/hashmap.h"
+#include "core/katomic.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "platform/platform.h"
+
+// Must be a power of two.
+#define KNAME_TABLE_CAPACITY 65536
+// The most entries the table takes, so that there is always an empty entry to end a probe.
+#define KNAME_TABLE_MAX_COUNT (KNAME_TABLE_CAPACITY / 8 * 7)
+
+typedef struct kname_entry {
+    // The id held by this entry, or INVALID_KNAME if empty. Claimed by compare-exchange.
+    volatile u64 id;
+    // The interned string, stored as an address. Published after id is claimed.
+    volatile u64 str;
+} kname_entry;
+
+// Static so knames are usable before, and remain valid after, the memory system.
+static kname_entry table[KNAME_TABLE_CAPACITY];
+static volatile u32 table_count = 0;
+static volatile u32 table_full_reported = 0;
+
+static const char* entry_string_wait(kname_entry* e) {
+    // The thread that claimed the entry is copying the string; this is brief.
+    u64 str;
+    while ((str = katomic_load_u64(&e->str)) == 0) {
+        katomic_pause();
+    }
+    return (const char*)str;
+}
+
+#if defined(_DEBUG)
+// Ids are compared first, so this only runs for an id already found, and only in debug builds: a
+// 64-bit collision is not expected, and comparing the strings would cost every lookup.
+static void entry_check_collision(kname_entry* e, const char* str) {
+    const char* existing = entry_string_wait(e);
+    if (existing != str && !strings_equal(existing, str)) {
+        DWARN("kname collision: '%s' and '%s' share id %llu. They will be treated as the same name.", existing, str, e->id);
+    }
+}
+#endif
+
+static void report_table_full(void) {
+    // Still a usable id, it just cannot be resolved back to a string.
+    if (katomic_exchange_u32(&table_full_reported, 1) == 0) {
+        DERROR("kname table is full (%u entries). New names will not be resolvable to strings.", KNAME_TABLE_MAX_COUNT);
+    }
+}
+
+kname kname_hash(const char* str) {
+    if (!str || !str[0]) {
+        return INVALID_KNAME;
+    }
+
+    kname id = hashmap_hash_string(str);
+    // INVALID_KNAME is reserved for no name.
+    return id == INVALID_KNAME ? 1 : id;
+}
+
+kname kname_create(const char* str) {
+    kname id = kname_hash(str);
+    if (id == INVALID_KNAME) {
+        return INVALID_KNAME;
+    }
+
+    u32 mask = KNAME_TABLE_CAPACITY - 1;
+    u32 index = (u32)(id & mask);
+    for (u32 probe = 0; probe < KNAME_TABLE_CAPACITY; ++probe) {
+        kname_entry* e = &table[index];
+        u64 current = katomic_load_u64(&e->id);
+        if (current == INVALID_KNAME) {
+            // Reserve room before claiming, so the table never fills and every probe ends early.
+            if (katomic_fetch_add_u32(&table_count, 1) >= KNAME_TABLE_MAX_COUNT) {
+                katomic_fetch_sub_u32(&table_count, 1);
+                report_table_full();
+                return id;
+            }
+            u64 expected = INVALID_KNAME;
+            if (katomic_compare_exchange_u64(&e->id, &expected, id)) {
+                // Claimed. Keep a copy of the string until shutdown.
+                u64 length = string_length(str);
+                char* copy = platform_allocate(length + 1, false);
+                kcopy_memory(copy, str, length + 1);
+                katomic_store_u64(&e->str, (u64)copy);
+                return id;
+            }
+            // Another thread claimed it first, possibly for this same id.
+            katomic_fetch_sub_u32(&table_count, 1);
+            current = expected;
+        }
+        if (current == id) {
+#if defined(_DEBUG)
+            entry_check_collision(e, str);
+#endif
+            return id;
+        }
+        index = (index + 1) & mask;
+    }
+
+    report_table_full();
+    return id;
+}
+
+const char* kname_string_get(kname name) {
+    if (name == INVALID_KNAME) {
+        return 0;
+    }
+
+    u32 mask = KNAME_TABLE_CAPACITY - 1;
+    u32 index = (u32)(name & mask);
+    for (u32 probe = 0; probe < KNAME_TABLE_CAPACITY; ++probe) {
+        kname_entry* e = &table[index];
+        u64 current = katomic_load_u64(&e->id);
+        if (current == name) {
+            return entry_string_wait(e);
+        }
+        if (current == INVALID_KNAME) {
+            // Entries are never removed, so an empty slot ends the probe.
+            return 0;
+        }
+        index = (index + 1) & mask;
+    }
+    return 0;
+}
+
+void kname_system_shutdown(void) {
+    for (u32 i = 0; i < KNAME_TABLE_CAPACITY; ++i) {
+        kname_entry* e = &table[i];
+        if (e->str) {
+            platform_free((void*)e->str, false);
+        }
+        e->str = 0;
+        e->id = INVALID_KNAME;
+    }
+    table_count = 0;
+    table_full_reported = 0;
+}
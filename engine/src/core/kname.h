@@ -0,0 +1,58 @@
+/**
+ * @file kname.h
+ * @brief Interned string ids.
+ *
+ * @details
+ * A kname is a stable 64-bit id for a string, computed once and then used
+ * in place of the string for lookups and comparisons. The first time a
+ * string is seen, a single copy of it is kept in a global table so the id
+ * can be resolved back to text, which is intended for logging and tools
+ * rather than hot paths.
+ *
+ * The table is lock-free: any thread may create or resolve knames at any
+ * time, including before the engine's systems are initialized. Interned
+ * strings live until kname_system_shutdown, which the engine calls once its
+ * systems have shut down.
+ */
+
+#pragma once
+
+#include "defines.h"
+
+/** @brief An interned string id. */
+typedef u64 kname;
+
+/** @brief Represents no name. Returned for null or empty strings. */
+#define INVALID_KNAME 0
+
+/**
+ * @brief Obtains the id for the given string, interning the string if it has not been seen before.
+ * Ids are case-sensitive, and are identical across runs for the same string.
+ *
+ * @param str The string to intern. Null and empty strings yield INVALID_KNAME.
+ * @return The id for the string.
+ */
+API kname kname_create(const char* str);
+
+/**
+ * @brief Obtains the id for the given string without interning it, for lookups and removals by a
+ * name that may never have been created. The id equals the one kname_create returns.
+ *
+ * @param str The string to hash. Null and empty strings yield INVALID_KNAME.
+ * @return The id for the string.
+ */
+API kname kname_hash(const char* str);
+
+/**
+ * @brief Resolves an id back to the string it was created from.
+ *
+ * @param name The id to resolve.
+ * @return The interned string, or 0 if the id is invalid or was never created.
+ */
+API const char* kname_string_get(kname name);
+
+/**
+ * @brief Releases every interned string. Ids stay valid, as they are computed from the string, but
+ * resolve to 0 until created again. Must not be called while any other thread uses knames.
+ */
+API void kname_system_shutdown(void);
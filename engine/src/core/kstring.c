@@ -90,7 +90,7 @@ b8 bytes_to_codepoint(const char* bytes, u32 offset, i32* out_codepoint, u8* out
 
 char* string_duplicate(const char* str) {
     u64 length = string_length(str);
-    char* copy = kallocate(length + 1, MEMORY_TAG_STRING);
+    char* copy = kallocate_no_zero(length + 1, MEMORY_TAG_STRING);
     kcopy_memory(copy, str, length);
     copy[length] = 0;
     return copy;
@@ -24,6 +24,7 @@ static u32 worker_thread_loop(void* params) {
         if (!queue_pop(&thread->work_queue, &w)) {
             DERROR("Failed to pop work from work queue.");
             kmutex_unlock(&thread->queue_mutex);
+            kmemory_thread_cache_flush();
             return 0;
         }
         kmutex_unlock(&thread->queue_mutex);
@@ -32,6 +33,9 @@ static u32 worker_thread_loop(void* params) {
 
     DTRACE("Worker thread work complete.");
 
+    // Hand back any small blocks this thread has cached.
+    kmemory_thread_cache_flush();
+
     return 1;
 }
 
@@ -141,6 +141,13 @@ STATIC_ASSERT(sizeof(b8) == 1, "Expected b32 to be 1 byte");
 #define NOINLINE
 #endif
 
+// Thread-local storage
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
 // GiB
 #define GIBIBYTES(amount) (amount * 1024ULL * 1024ULL * 1024ULL)
 // MiB
@@ -0,0 +1,472 @@
+#include "bvh.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+
+// Deep enough for any balanced tree that fits in memory.
+#define BVH_QUERY_STACK_SIZE 256
+
+#define BVH_ALL_PLANES ((1 << FRUSTUM_SIDE_COUNT) - 1)
+
+INLINE b8 node_is_leaf(const bvh_node* n) {
+    return n->left == INVALID_ID;
+}
+
+INLINE extents_3d aabb_union(extents_3d a, extents_3d b) {
+    extents_3d out;
+    out.min = (vec3){KMIN(a.min.x, b.min.x), KMIN(a.min.y, b.min.y), KMIN(a.min.z, b.min.z)};
+    out.max = (vec3){KMAX(a.max.x, b.max.x), KMAX(a.max.y, b.max.y), KMAX(a.max.z, b.max.z)};
+    return out;
+}
+
+INLINE f32 aabb_surface_area(extents_3d a) {
+    f32 x = a.max.x - a.min.x;
+    f32 y = a.max.y - a.min.y;
+    f32 z = a.max.z - a.min.z;
+    return 2.0f * (x * y + y * z + z * x);
+}
+
+INLINE b8 aabb_contains(extents_3d outer, extents_3d inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+           outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+static void pool_link_free(bvh* tree, u32 first, u32 end) {
+    for (u32 i = first; i < end; ++i) {
+        tree->nodes[i].parent = (i + 1 < end) ? i + 1 : INVALID_ID;
+        tree->nodes[i].height = -1;
+    }
+    tree->free_list = first;
+}
+
+static u32 node_allocate(bvh* tree) {
+    if (tree->free_list == INVALID_ID) {
+        // Grow the pool. Callers hold indices rather than pointers across this.
+        u32 old_capacity = tree->capacity;
+        u32 new_capacity = old_capacity * 2;
+        bvh_node* nodes = kallocate(sizeof(bvh_node) * new_capacity, MEMORY_TAG_SCENE);
+        kcopy_memory(nodes, tree->nodes, sizeof(bvh_node) * old_capacity);
+        kfree(tree->nodes, sizeof(bvh_node) * old_capacity, MEMORY_TAG_SCENE);
+        tree->nodes = nodes;
+        tree->capacity = new_capacity;
+        pool_link_free(tree, old_capacity, new_capacity);
+    }
+
+    u32 index = tree->free_list;
+    bvh_node* n = &tree->nodes[index];
+    tree->free_list = n->parent;
+    n->parent = INVALID_ID;
+    n->left = INVALID_ID;
+    n->right = INVALID_ID;
+    n->height = 0;
+    n->user_data = 0;
+    return index;
+}
+
+static void node_free(bvh* tree, u32 index) {
+    tree->nodes[index].parent = tree->free_list;
+    tree->nodes[index].height = -1;
+    tree->free_list = index;
+}
+
+static void node_replace_child(bvh* tree, u32 parent, u32 old_child, u32 new_child) {
+    if (parent == INVALID_ID) {
+        tree->root = new_child;
+    } else if (tree->nodes[parent].left == old_child) {
+        tree->nodes[parent].left = new_child;
+    } else {
+        tree->nodes[parent].right = new_child;
+    }
+}
+
+// Performs a left or right rotation if node a is imbalanced. Returns the new root of the subtree.
+static u32 balance(bvh* tree, u32 ia) {
+    bvh_node* nodes = tree->nodes;
+    bvh_node* a = &nodes[ia];
+    if (node_is_leaf(a) || a->height < 2) {
+        return ia;
+    }
+
+    u32 ib = a->left;
+    u32 ic = a->right;
+    bvh_node* b = &nodes[ib];
+    bvh_node* c = &nodes[ic];
+    i32 diff = c->height - b->height;
+
+    if (diff > 1) {
+        // Rotate c up.
+        u32 i_f = c->left;
+        u32 i_g = c->right;
+        bvh_node* f = &nodes[i_f];
+        bvh_node* g = &nodes[i_g];
+
+        c->left = ia;
+        c->parent = a->parent;
+        a->parent = ic;
+        node_replace_child(tree, c->parent, ia, ic);
+
+        if (f->height > g->height) {
+            c->right = i_f;
+            a->right = i_g;
+            g->parent = ia;
+            a->aabb = aabb_union(b->aabb, g->aabb);
+            c->aabb = aabb_union(a->aabb, f->aabb);
+            a->height = 1 + KMAX(b->height, g->height);
+            c->height = 1 + KMAX(a->height, f->height);
+        } else {
+            c->right = i_g;
+            a->right = i_f;
+            f->parent = ia;
+            a->aabb = aabb_union(b->aabb, f->aabb);
+            c->aabb = aabb_union(a->aabb, g->aabb);
+            a->height = 1 + KMAX(b->height, f->height);
+            c->height = 1 + KMAX(a->height, g->height);
+        }
+        return ic;
+    }
+
+    if (diff < -1) {
+        // Rotate b up.
+        u32 id = b->left;
+        u32 ie = b->right;
+        bvh_node* d = &nodes[id];
+        bvh_node* e = &nodes[ie];
+
+        b->left = ia;
+        b->parent = a->parent;
+        a->parent = ib;
+        node_replace_child(tree, b->parent, ia, ib);
+
+        if (d->height > e->height) {
+            b->right = id;
+            a->left = ie;
+            e->parent = ia;
+            a->aabb = aabb_union(c->aabb, e->aabb);
+            b->aabb = aabb_union(a->aabb, d->aabb);
+            a->height = 1 + KMAX(c->height, e->height);
+            b->height = 1 + KMAX(a->height, d->height);
+        } else {
+            b->right = ie;
+            a->left = id;
+            d->parent = ia;
+            a->aabb = aabb_union(c->aabb, d->aabb);
+            b->aabb = aabb_union(a->aabb, e->aabb);
+            a->height = 1 + KMAX(c->height, d->height);
+            b->height = 1 + KMAX(a->height, e->height);
+        }
+        return ib;
+    }
+
+    return ia;
+}
+
+// Rebalances and refits every ancestor from index to the root.
+static void refit_upwards(bvh* tree, u32 index) {
+    while (index != INVALID_ID) {
+        index = balance(tree, index);
+        bvh_node* n = &tree->nodes[index];
+        bvh_node* left = &tree->nodes[n->left];
+        bvh_node* right = &tree->nodes[n->right];
+        n->height = 1 + KMAX(left->height, right->height);
+        n->aabb = aabb_union(left->aabb, right->aabb);
+        index = n->parent;
+    }
+}
+
+static void insert_leaf(bvh* tree, u32 leaf) {
+    if (tree->root == INVALID_ID) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = INVALID_ID;
+        return;
+    }
+
+    // Descend towards the sibling that adds the least surface area.
+    extents_3d leaf_aabb = tree->nodes[leaf].aabb;
+    u32 index = tree->root;
+    while (!node_is_leaf(&tree->nodes[index])) {
+        bvh_node* n = &tree->nodes[index];
+        f32 area = aabb_surface_area(n->aabb);
+        f32 combined_area = aabb_surface_area(aabb_union(n->aabb, leaf_aabb));
+
+        // Cost of making a new parent for this node and the leaf.
+        f32 cost = 2.0f * combined_area;
+        // Minimum cost of pushing the leaf further down.
+        f32 inheritance_cost = 2.0f * (combined_area - area);
+
+        f32 child_costs[2];
+        u32 children[2] = {n->left, n->right};
+        for (u32 i = 0; i < 2; ++i) {
+            bvh_node* child = &tree->nodes[children[i]];
+            f32 union_area = aabb_surface_area(aabb_union(leaf_aabb, child->aabb));
+            child_costs[i] = (node_is_leaf(child) ? union_area : union_area - aabb_surface_area(child->aabb)) + inheritance_cost;
+        }
+
+        if (cost < child_costs[0] && cost < child_costs[1]) {
+            break;
+        }
+        index = child_costs[0] < child_costs[1] ? children[0] : children[1];
+    }
+
+    u32 sibling = index;
+    u32 old_parent = tree->nodes[sibling].parent;
+    u32 new_parent = node_allocate(tree);
+    bvh_node* np = &tree->nodes[new_parent];
+    np->parent = old_parent;
+    np->aabb = aabb_union(leaf_aabb, tree->nodes[sibling].aabb);
+    np->height = tree->nodes[sibling].height + 1;
+    np->left = sibling;
+    np->right = leaf;
+    node_replace_child(tree, old_parent, sibling, new_parent);
+    tree->nodes[sibling].parent = new_parent;
+    tree->nodes[leaf].parent = new_parent;
+
+    refit_upwards(tree, new_parent);
+}
+
+static void remove_leaf(bvh* tree, u32 leaf) {
+    if (leaf == tree->root) {
+        tree->root = INVALID_ID;
+        return;
+    }
+
+    u32 parent = tree->nodes[leaf].parent;
+    u32 grand_parent = tree->nodes[parent].parent;
+    u32 sibling = tree->nodes[parent].left == leaf ? tree->nodes[parent].right : tree->nodes[parent].left;
+
+    // The sibling takes the parent's place.
+    node_replace_child(tree, grand_parent, parent, sibling);
+    tree->nodes[sibling].parent = grand_parent;
+    node_free(tree, parent);
+
+    refit_upwards(tree, grand_parent);
+}
+
+b8 bvh_create(u32 leaf_capacity, f32 margin, bvh* out_tree) {
+    if (!out_tree) {
+        DERROR("bvh_create requires a valid pointer to out_tree.");
+        return false;
+    }
+
+    kzero_memory(out_tree, sizeof(bvh));
+    // A tree of n leaves has n - 1 internal nodes.
+    out_tree->capacity = KMAX(leaf_capacity, 8) * 2;
+    out_tree->nodes = kallocate(sizeof(bvh_node) * out_tree->capacity, MEMORY_TAG_SCENE);
+    out_tree->root = INVALID_ID;
+    out_tree->margin = margin;
+    pool_link_free(out_tree, 0, out_tree->capacity);
+    return true;
+}
+
+void bvh_destroy(bvh* tree) {
+    if (tree) {
+        if (tree->nodes) {
+            kfree(tree->nodes, sizeof(bvh_node) * tree->capacity, MEMORY_TAG_SCENE);
+        }
+        kzero_memory(tree, sizeof(bvh));
+        tree->root = INVALID_ID;
+    }
+}
+
+void bvh_clear(bvh* tree) {
+    if (tree && tree->nodes) {
+        tree->root = INVALID_ID;
+        tree->leaf_count = 0;
+        pool_link_free(tree, 0, tree->capacity);
+    }
+}
+
+u32 bvh_insert(bvh* tree, extents_3d aabb, u64 user_data) {
+    u32 leaf = node_allocate(tree);
+    bvh_node* n = &tree->nodes[leaf];
+    vec3 m = (vec3){tree->margin, tree->margin, tree->margin};
+    n->aabb.min = vec3_sub(aabb.min, m);
+    n->aabb.max = vec3_add(aabb.max, m);
+    n->user_data = user_data;
+    n->height = 0;
+
+    insert_leaf(tree, leaf);
+    tree->leaf_count++;
+    return leaf;
+}
+
+void bvh_remove(bvh* tree, u32 leaf_id) {
+    if (!tree || leaf_id >= tree->capacity || !node_is_leaf(&tree->nodes[leaf_id]) || tree->nodes[leaf_id].height != 0) {
+        DWARN("bvh_remove called with an invalid leaf id %u.", leaf_id);
+        return;
+    }
+    remove_leaf(tree, leaf_id);
+    node_free(tree, leaf_id);
+    tree->leaf_count--;
+}
+
+b8 bvh_update(bvh* tree, u32 leaf_id, extents_3d aabb) {
+    bvh_node* n = &tree->nodes[leaf_id];
+    if (aabb_contains(n->aabb, aabb)) {
+        return false;
+    }
+
+    remove_leaf(tree, leaf_id);
+    vec3 m = (vec3){tree->margin, tree->margin, tree->margin};
+    n->aabb.min = vec3_sub(aabb.min, m);
+    n->aabb.max = vec3_add(aabb.max, m);
+    insert_leaf(tree, leaf_id);
+    return true;
+}
+
+// Reports every leaf below index without further tests. Returns false if the callback stopped the query.
+static b8 report_subtree(const bvh* tree, u32 index, pfn_bvh_query_callback callback, void* context) {
+    u32 stack[BVH_QUERY_STACK_SIZE];
+    u32 count = 0;
+    stack[count++] = index;
+    while (count) {
+        const bvh_node* n = &tree->nodes[stack[--count]];
+        if (node_is_leaf(n)) {
+            if (!callback(n->user_data, context)) {
+                return false;
+            }
+        } else if (count + 2 <= BVH_QUERY_STACK_SIZE) {
+            stack[count++] = n->right;
+            stack[count++] = n->left;
+        }
+    }
+    return true;
+}
+
+void bvh_query_frustum(const bvh* tree, const frustum* f, pfn_bvh_query_callback callback, void* context) {
+    if (!tree || !f || !callback || tree->root == INVALID_ID) {
+        return;
+    }
+
+    // Each entry carries the planes its box still straddles; planes a parent is fully inside are not retested.
+    u32 stack[BVH_QUERY_STACK_SIZE];
+    u8 masks[BVH_QUERY_STACK_SIZE];
+    u32 count = 0;
+    stack[count] = tree->root;
+    masks[count++] = BVH_ALL_PLANES;
+
+    while (count) {
+        --count;
+        const bvh_node* n = &tree->nodes[stack[count]];
+        u8 mask = masks[count];
+
+        vec3 center = vec3_mul_scalar(vec3_add(n->aabb.min, n->aabb.max), 0.5f);
+        vec3 half = vec3_mul_scalar(vec3_sub(n->aabb.max, n->aabb.min), 0.5f);
+        b8 outside = false;
+        for (u32 p = 0; p < FRUSTUM_SIDE_COUNT; ++p) {
+            if (!(mask & (1 << p))) {
+                continue;
+            }
+            const plane_3d* plane = &f->sides[p];
+            f32 r = half.x * kabs(plane->normal.x) + half.y * kabs(plane->normal.y) + half.z * kabs(plane->normal.z);
+            f32 d = plane_signed_distance(plane, &center);
+            if (d < -r) {
+                outside = true;
+                break;
+            }
+            if (d >= r) {
+                mask &= ~(1 << p);
+            }
+        }
+        if (outside) {
+            continue;
+        }
+
+        if (mask == 0) {
+            if (!report_subtree(tree, stack[count], callback, context)) {
+                return;
+            }
+        } else if (node_is_leaf(n)) {
+            if (!callback(n->user_data, context)) {
+                return;
+            }
+        } else if (count + 2 <= BVH_QUERY_STACK_SIZE) {
+            stack[count] = n->right;
+            masks[count++] = mask;
+            stack[count] = n->left;
+            masks[count++] = mask;
+        }
+    }
+}
+
+// Slab test, giving the range of t over which origin + t * dir lies within the box.
+// Infinite components of inv_dir give the correct result for axis-parallel directions.
+INLINE void slab_intersect(extents_3d aabb, vec3 origin, vec3 inv_dir, f32* out_tmin, f32* out_tmax) {
+    f32 t1 = (aabb.min.x - origin.x) * inv_dir.x;
+    f32 t2 = (aabb.max.x - origin.x) * inv_dir.x;
+    f32 tmin = KMIN(t1, t2);
+    f32 tmax = KMAX(t1, t2);
+
+    t1 = (aabb.min.y - origin.y) * inv_dir.y;
+    t2 = (aabb.max.y - origin.y) * inv_dir.y;
+    tmin = KMAX(tmin, KMIN(t1, t2));
+    tmax = KMIN(tmax, KMAX(t1, t2));
+
+    t1 = (aabb.min.z - origin.z) * inv_dir.z;
+    t2 = (aabb.max.z - origin.z) * inv_dir.z;
+    tmin = KMAX(tmin, KMIN(t1, t2));
+    tmax = KMIN(tmax, KMAX(t1, t2));
+
+    *out_tmin = tmin;
+    *out_tmax = tmax;
+}
+
+void bvh_query_line(const bvh* tree, vec3 line_start, vec3 line_direction, f32 radius, pfn_bvh_query_callback callback, void* context) {
+    if (!tree || !callback || tree->root == INVALID_ID) {
+        return;
+    }
+
+    vec3 inv_dir = (vec3){1.0f / line_direction.x, 1.0f / line_direction.y, 1.0f / line_direction.z};
+    vec3 grow = (vec3){radius, radius, radius};
+
+    u32 stack[BVH_QUERY_STACK_SIZE];
+    u32 count = 0;
+    stack[count++] = tree->root;
+    while (count) {
+        const bvh_node* n = &tree->nodes[stack[--count]];
+        extents_3d grown = {vec3_sub(n->aabb.min, grow), vec3_add(n->aabb.max, grow)};
+        f32 tmin, tmax;
+        slab_intersect(grown, line_start, inv_dir, &tmin, &tmax);
+        if (tmax < tmin) {
+            continue;
+        }
+
+        if (node_is_leaf(n)) {
+            if (!callback(n->user_data, context)) {
+                return;
+            }
+        } else if (count + 2 <= BVH_QUERY_STACK_SIZE) {
+            stack[count++] = n->right;
+            stack[count++] = n->left;
+        }
+    }
+}
+
+void bvh_query_ray(const bvh* tree, const ray* r, pfn_bvh_query_callback callback, void* context) {
+    if (!tree || !r || !callback || tree->root == INVALID_ID) {
+        return;
+    }
+
+    vec3 inv_dir = (vec3){1.0f / r->direction.x, 1.0f / r->direction.y, 1.0f / r->direction.z};
+
+    u32 stack[BVH_QUERY_STACK_SIZE];
+    u32 count = 0;
+    stack[count++] = tree->root;
+    while (count) {
+        const bvh_node* n = &tree->nodes[stack[--count]];
+        f32 tmin, tmax;
+        slab_intersect(n->aabb, r->origin, inv_dir, &tmin, &tmax);
+        if (tmax < KMAX(tmin, 0.0f)) {
+            continue;
+        }
+
+        if (node_is_leaf(n)) {
+            if (!callback(n->user_data, context)) {
+                return;
+            }
+        } else if (count + 2 <= BVH_QUERY_STACK_SIZE) {
+            stack[count++] = n->right;
+            stack[count++] = n->left;
+        }
+    }
+}
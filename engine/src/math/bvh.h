@@ -0,0 +1,154 @@
+/**
+ * @file bvh.h
+ * @brief A dynamic bounding volume hierarchy of axis-aligned bounding boxes.
+ *
+ * @details
+ * Each leaf holds a "fat" box: the box it was inserted with, grown by a
+ * margin. Moving a leaf only changes the tree when its new box escapes
+ * the fat one, so objects that move a little each frame cost nothing
+ * more than a containment check. Inserts pick the sibling that adds the
+ * least surface area, and the tree is kept height-balanced with
+ * rotations on the way back up, so queries stay logarithmic regardless
+ * of insertion order.
+ *
+ * Leaves are addressed by the id returned from bvh_insert, which stays
+ * valid until the leaf is removed. Each leaf carries a u64 of user data,
+ * typically an index or handle into the caller's own storage.
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/geometry_3d.h"
+#include "math/math_types.h"
+
+/** @brief A node within a bvh. Internal nodes have two children; leaves have none. */
+typedef struct bvh_node {
+    /** @brief The bounds of this node. For leaves, this is the fat box. */
+    extents_3d aabb;
+    /** @brief The user data of a leaf. */
+    u64 user_data;
+    /** @brief The parent node, or INVALID_ID for the root. Links free nodes when unused. */
+    u32 parent;
+    /** @brief The first child, or INVALID_ID for leaves. */
+    u32 left;
+    /** @brief The second child, or INVALID_ID for leaves. */
+    u32 right;
+    /** @brief The height of the subtree. 0 for leaves, -1 for free nodes. */
+    i32 height;
+} bvh_node;
+
+/**
+ * @brief A dynamic bounding volume hierarchy. Members of this structure
+ * should not be modified outside the functions associated with it.
+ */
+typedef struct bvh {
+    /** @brief The node pool. Grows as needed. */
+    bvh_node* nodes;
+    /** @brief The number of nodes the pool can hold. */
+    u32 capacity;
+    /** @brief The root node, or INVALID_ID if empty. */
+    u32 root;
+    /** @brief The head of the free node list. */
+    u32 free_list;
+    /** @brief The number of leaves in the tree. */
+    u32 leaf_count;
+    /** @brief The amount each leaf box is grown by on every side when (re)inserted. */
+    f32 margin;
+} bvh;
+
+/**
+ * @brief Called for each leaf found by a query.
+ *
+ * @param user_data The user data of the leaf.
+ * @param context The context passed to the query.
+ * @return True to continue the query; false to stop it.
+ */
+typedef b8 (*pfn_bvh_query_callback)(u64 user_data, void* context);
+
+/**
+ * @brief Creates a bvh, performing a dynamic allocation for its node pool.
+ *
+ * @param leaf_capacity The number of leaves to reserve room for. The pool grows beyond this as needed.
+ * @param margin The amount leaf boxes are grown by on each side. Larger values mean fewer reinsertions for moving objects, but looser queries.
+ * @param out_tree A pointer to hold the created tree.
+ * @return True on success; otherwise false.
+ */
+API b8 bvh_create(u32 leaf_capacity, f32 margin, bvh* out_tree);
+
+/**
+ * @brief Destroys the given bvh and frees its node pool.
+ *
+ * @param tree A pointer to the tree to destroy.
+ */
+API void bvh_destroy(bvh* tree);
+
+/**
+ * @brief Removes every leaf from the tree without releasing the node pool.
+ *
+ * @param tree A pointer to the tree to clear.
+ */
+API void bvh_clear(bvh* tree);
+
+/**
+ * @brief Inserts a leaf with the given bounds.
+ *
+ * @param tree A pointer to the tree.
+ * @param aabb The bounds of the object.
+ * @param user_data Data returned to query callbacks for this leaf.
+ * @return The id of the new leaf.
+ */
+API u32 bvh_insert(bvh* tree, extents_3d aabb, u64 user_data);
+
+/**
+ * @brief Removes a leaf from the tree.
+ *
+ * @param tree A pointer to the tree.
+ * @param leaf_id The id returned when the leaf was inserted.
+ */
+API void bvh_remove(bvh* tree, u32 leaf_id);
+
+/**
+ * @brief Updates the bounds of a leaf. The tree only changes if the new
+ * bounds are no longer contained by the leaf's fat box.
+ *
+ * @param tree A pointer to the tree.
+ * @param leaf_id The id returned when the leaf was inserted.
+ * @param aabb The new bounds of the object.
+ * @return True if the leaf was reinserted; false if its fat box still contained the bounds.
+ */
+API b8 bvh_update(bvh* tree, u32 leaf_id, extents_3d aabb);
+
+/**
+ * @brief Invokes callback for every leaf whose box intersects or is contained by the frustum.
+ * Subtrees entirely inside the frustum are accepted without further plane tests.
+ *
+ * @param tree A constant pointer to the tree.
+ * @param f A constant pointer to the frustum.
+ * @param callback The function to call for each leaf found.
+ * @param context Passed through to callback.
+ */
+API void bvh_query_frustum(const bvh* tree, const frustum* f, pfn_bvh_query_callback callback, void* context);
+
+/**
+ * @brief Invokes callback for every leaf whose box may lie within radius of an infinite line.
+ * Boxes are grown by radius and tested against the line, so the result is conservative.
+ *
+ * @param tree A constant pointer to the tree.
+ * @param line_start A point on the line.
+ * @param line_direction The direction of the line. Need not be normalized.
+ * @param radius The distance from the line to search.
+ * @param callback The function to call for each leaf found.
+ * @param context Passed through to callback.
+ */
+API void bvh_query_line(const bvh* tree, vec3 line_start, vec3 line_direction, f32 radius, pfn_bvh_query_callback callback, void* context);
+
+/**
+ * @brief Invokes callback for every leaf whose box is hit by the ray.
+ *
+ * @param tree A constant pointer to the tree.
+ * @param r A constant pointer to the ray.
+ * @param callback The function to call for each leaf found.
+ * @param context Passed through to callback.
+ */
+API void bvh_query_ray(const bvh* tree, const ray* r, pfn_bvh_query_callback callback, void* context);
@@ -0,0 +1,308 @@
+#include "culling.h"
+
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/kmath.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#    define KCULL_SSE 1
+#    include <immintrin.h>
+// AVX is used when the compiler already targets it, or chosen at runtime where the compiler allows per-function targets.
+#    if defined(__AVX__)
+#        define KCULL_AVX 1
+#        define KCULL_AVX_TARGET
+#    elif defined(__GNUC__) || defined(__clang__)
+#        define KCULL_AVX 1
+#        define KCULL_AVX_RUNTIME 1
+#        define KCULL_AVX_TARGET __attribute__((target("avx")))
+#    endif
+#endif
+
+// Every array is padded to this many entries, so the widest kernel never reads past the end.
+#define BOUNDS_SOA_GROUP 8
+// Arrays are requested aligned, but loads don't rely on it, since allocations made before the
+// memory system starts are not aligned. Unaligned loads of aligned data cost nothing extra.
+#define BOUNDS_SOA_ALIGNMENT 32
+
+/** @brief A frustum plane with its normal and the absolute value of its normal, ready for the box test. */
+typedef struct cull_plane {
+    f32 nx, ny, nz;
+    f32 ax, ay, az;
+    f32 d;
+} cull_plane;
+
+static void cull_planes_from_frustum(const frustum* f, cull_plane* out_planes) {
+    for (u32 i = 0; i < FRUSTUM_SIDE_COUNT; ++i) {
+        const plane_3d* p = &f->sides[i];
+        out_planes[i].nx = p->normal.x;
+        out_planes[i].ny = p->normal.y;
+        out_planes[i].nz = p->normal.z;
+        out_planes[i].ax = kabs(p->normal.x);
+        out_planes[i].ay = kabs(p->normal.y);
+        out_planes[i].az = kabs(p->normal.z);
+        out_planes[i].d = p->distance;
+    }
+}
+
+static void bounds_soa_assign(bounds_soa* bounds, void* block, u32 capacity) {
+    bounds->block = block;
+    bounds->capacity = capacity;
+    f32* base = block;
+    bounds->center_x = base;
+    bounds->center_y = base + capacity;
+    bounds->center_z = base + capacity * 2;
+    bounds->half_x = base + capacity * 3;
+    bounds->half_y = base + capacity * 4;
+    bounds->half_z = base + capacity * 5;
+}
+
+b8 bounds_soa_create(u32 capacity, bounds_soa* out_bounds) {
+    if (!out_bounds) {
+        DERROR("bounds_soa_create requires a valid pointer to out_bounds.");
+        return false;
+    }
+    kzero_memory(out_bounds, sizeof(bounds_soa));
+    capacity = get_aligned(KMAX(capacity, BOUNDS_SOA_GROUP), BOUNDS_SOA_GROUP);
+    void* block = kallocate_aligned(sizeof(f32) * capacity * 6, BOUNDS_SOA_ALIGNMENT, MEMORY_TAG_SCENE);
+    bounds_soa_assign(out_bounds, block, capacity);
+    return true;
+}
+
+void bounds_soa_destroy(bounds_soa* bounds) {
+    if (bounds) {
+        if (bounds->block) {
+            kfree_aligned(bounds->block, sizeof(f32) * bounds->capacity * 6, BOUNDS_SOA_ALIGNMENT, MEMORY_TAG_SCENE);
+        }
+        kzero_memory(bounds, sizeof(bounds_soa));
+    }
+}
+
+void bounds_soa_clear(bounds_soa* bounds) {
+    if (bounds) {
+        bounds->count = 0;
+    }
+}
+
+u32 bounds_soa_push(bounds_soa* bounds, vec3 center, vec3 half_extents) {
+    if (bounds->count == bounds->capacity) {
+        bounds_soa old = *bounds;
+        u32 new_capacity = old.capacity * 2;
+        void* block = kallocate_aligned(sizeof(f32) * new_capacity * 6, BOUNDS_SOA_ALIGNMENT, MEMORY_TAG_SCENE);
+        bounds_soa_assign(bounds, block, new_capacity);
+        u64 size = sizeof(f32) * old.count;
+        kcopy_memory(bounds->center_x, old.center_x, size);
+        kcopy_memory(bounds->center_y, old.center_y, size);
+        kcopy_memory(bounds->center_z, old.center_z, size);
+        kcopy_memory(bounds->half_x, old.half_x, size);
+        kcopy_memory(bounds->half_y, old.half_y, size);
+        kcopy_memory(bounds->half_z, old.half_z, size);
+        kfree_aligned(old.block, sizeof(f32) * old.capacity * 6, BOUNDS_SOA_ALIGNMENT, MEMORY_TAG_SCENE);
+    }
+
+    u32 index = bounds->count++;
+    bounds->center_x[index] = center.x;
+    bounds->center_y[index] = center.y;
+    bounds->center_z[index] = center.z;
+    bounds->half_x[index] = half_extents.x;
+    bounds->half_y[index] = half_extents.y;
+    bounds->half_z[index] = half_extents.z;
+    return index;
+}
+
+void bounds_soa_set(bounds_soa* bounds, u32 index, vec3 center, vec3 half_extents) {
+    bounds->center_x[index] = center.x;
+    bounds->center_y[index] = center.y;
+    bounds->center_z[index] = center.z;
+    bounds->half_x[index] = half_extents.x;
+    bounds->half_y[index] = half_extents.y;
+    bounds->half_z[index] = half_extents.z;
+}
+
+// Appends the indices of the set bits of mask, for the lanes of a group that hold real boxes.
+// Branch-free: every lane is written, but the count only advances for visible ones. The write
+// position never passes the number of boxes tested so far, so out_visible_indices needs no more
+// than one entry per box tested.
+INLINE u32 compact_group(u32 mask, u32 base, u32 lanes, u32* out_visible_indices, u32 visible_count) {
+    for (u32 j = 0; j < lanes; ++j) {
+        out_visible_indices[visible_count] = base + j;
+        visible_count += (mask >> j) & 1;
+    }
+    return visible_count;
+}
+
+// Each kernel tests the boxes in [start, end) against view_count sets of planes, loading each box
+// once. Visible indices of view v are written from the start of out_visible_indices[v].
+static void cull_scalar(const cull_plane* planes, u32 view_count, const bounds_soa* bounds, u32 start, u32 end, u32** out_visible_indices, u32* out_visible_counts) {
+    for (u32 v = 0; v < view_count; ++v) {
+        out_visible_counts[v] = 0;
+    }
+    for (u32 i = start; i < end; ++i) {
+        f32 cx = bounds->center_x[i], cy = bounds->center_y[i], cz = bounds->center_z[i];
+        f32 hx = bounds->half_x[i], hy = bounds->half_y[i], hz = bounds->half_z[i];
+        for (u32 v = 0; v < view_count; ++v) {
+            const cull_plane* view_planes = planes + v * FRUSTUM_SIDE_COUNT;
+            b8 visible = true;
+            for (u32 p = 0; p < FRUSTUM_SIDE_COUNT; ++p) {
+                const cull_plane* pl = &view_planes[p];
+                f32 dist = pl->nx * cx + pl->ny * cy + pl->nz * cz - pl->d;
+                f32 r = pl->ax * hx + pl->ay * hy + pl->az * hz;
+                visible &= (dist + r >= 0.0f);
+            }
+            out_visible_indices[v][out_visible_counts[v]] = i;
+            out_visible_counts[v] += visible;
+        }
+    }
+}
+
+#if KCULL_SSE
+static void cull_sse(const cull_plane* planes, u32 view_count, const bounds_soa* bounds, u32 start, u32 end, u32** out_visible_indices, u32* out_visible_counts) {
+    for (u32 v = 0; v < view_count; ++v) {
+        out_visible_counts[v] = 0;
+    }
+    __m128 zero = _mm_setzero_ps();
+    for (u32 base = start; base < end; base += 4) {
+        __m128 cx = _mm_loadu_ps(bounds->center_x + base);
+        __m128 cy = _mm_loadu_ps(bounds->center_y + base);
+        __m128 cz = _mm_loadu_ps(bounds->center_z + base);
+        __m128 hx = _mm_loadu_ps(bounds->half_x + base);
+        __m128 hy = _mm_loadu_ps(bounds->half_y + base);
+        __m128 hz = _mm_loadu_ps(bounds->half_z + base);
+
+        for (u32 v = 0; v < view_count; ++v) {
+            const cull_plane* view_planes = planes + v * FRUSTUM_SIDE_COUNT;
+            __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (u32 p = 0; p < FRUSTUM_SIDE_COUNT; ++p) {
+                const cull_plane* pl = &view_planes[p];
+                // dist + r = n.c - d + |n|.h, and the box is behind the plane if that is negative.
+                __m128 dist = _mm_mul_ps(cx, _mm_set1_ps(pl->nx));
+                dist = _mm_add_ps(dist, _mm_mul_ps(cy, _mm_set1_ps(pl->ny)));
+                dist = _mm_add_ps(dist, _mm_mul_ps(cz, _mm_set1_ps(pl->nz)));
+                dist = _mm_sub_ps(dist, _mm_set1_ps(pl->d));
+                __m128 r = _mm_mul_ps(hx, _mm_set1_ps(pl->ax));
+                r = _mm_add_ps(r, _mm_mul_ps(hy, _mm_set1_ps(pl->ay)));
+                r = _mm_add_ps(r, _mm_mul_ps(hz, _mm_set1_ps(pl->az)));
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(dist, r), zero));
+            }
+
+            u32 mask = (u32)_mm_movemask_ps(visible);
+            out_visible_counts[v] = compact_group(mask, base, KMIN(4, end - base), out_visible_indices[v], out_visible_counts[v]);
+        }
+    }
+}
+#endif
+
+#if KCULL_AVX
+KCULL_AVX_TARGET static void cull_avx(const cull_plane* planes, u32 view_count, const bounds_soa* bounds, u32 start, u32 end, u32** out_visible_indices, u32* out_visible_counts) {
+    for (u32 v = 0; v < view_count; ++v) {
+        out_visible_counts[v] = 0;
+    }
+    __m256 zero = _mm256_setzero_ps();
+    __m256 all = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+    for (u32 base = start; base < end; base += 8) {
+        __m256 cx = _mm256_loadu_ps(bounds->center_x + base);
+        __m256 cy = _mm256_loadu_ps(bounds->center_y + base);
+        __m256 cz = _mm256_loadu_ps(bounds->center_z + base);
+        __m256 hx = _mm256_loadu_ps(bounds->half_x + base);
+        __m256 hy = _mm256_loadu_ps(bounds->half_y + base);
+        __m256 hz = _mm256_loadu_ps(bounds->half_z + base);
+
+        for (u32 v = 0; v < view_count; ++v) {
+            const cull_plane* view_planes = planes + v * FRUSTUM_SIDE_COUNT;
+            __m256 visible = all;
+            for (u32 p = 0; p < FRUSTUM_SIDE_COUNT; ++p) {
+                const cull_plane* pl = &view_planes[p];
+                __m256 dist = _mm256_mul_ps(cx, _mm256_set1_ps(pl->nx));
+                dist = _mm256_add_ps(dist, _mm256_mul_ps(cy, _mm256_set1_ps(pl->ny)));
+                dist = _mm256_add_ps(dist, _mm256_mul_ps(cz, _mm256_set1_ps(pl->nz)));
+                dist = _mm256_sub_ps(dist, _mm256_set1_ps(pl->d));
+                __m256 r = _mm256_mul_ps(hx, _mm256_set1_ps(pl->ax));
+                r = _mm256_add_ps(r, _mm256_mul_ps(hy, _mm256_set1_ps(pl->ay)));
+                r = _mm256_add_ps(r, _mm256_mul_ps(hz, _mm256_set1_ps(pl->az)));
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(dist, r), zero, _CMP_GE_OQ));
+            }
+
+            u32 mask = (u32)_mm256_movemask_ps(visible);
+            out_visible_counts[v] = compact_group(mask, base, KMIN(8, end - base), out_visible_indices[v], out_visible_counts[v]);
+        }
+    }
+}
+
+static b8 avx_supported(void) {
+#    if KCULL_AVX_RUNTIME
+    static i32 supported = -1;
+    if (supported < 0) {
+        supported = __builtin_cpu_supports("avx") ? 1 : 0;
+    }
+    return supported;
+#    else
+    return true;
+#    endif
+}
+#endif
+
+// Picks the widest kernel available.
+static void cull_dispatch(const cull_plane* planes, u32 view_count, const bounds_soa* bounds, u32 start, u32 end, u32** out_visible_indices, u32* out_visible_counts) {
+#if KCULL_AVX
+    if (avx_supported()) {
+        cull_avx(planes, view_count, bounds, start, end, out_visible_indices, out_visible_counts);
+        return;
+    }
+#endif
+#if KCULL_SSE
+    cull_sse(planes, view_count, bounds, start, end, out_visible_indices, out_visible_counts);
+#else
+    cull_scalar(planes, view_count, bounds, start, end, out_visible_indices, out_visible_counts);
+#endif
+}
+
+u32 frustum_cull_bounds(const frustum* f, const bounds_soa* bounds, u32* out_visible_indices) {
+    if (!f || !bounds || !out_visible_indices || !bounds->count) {
+        return 0;
+    }
+
+    cull_plane planes[FRUSTUM_SIDE_COUNT];
+    cull_planes_from_frustum(f, planes);
+
+    u32 visible_count = 0;
+    cull_dispatch(planes, 1, bounds, 0, bounds->count, &out_visible_indices, &visible_count);
+    return visible_count;
+}
+
+u32 frustum_cull_bounds_scalar(const frustum* f, const bounds_soa* bounds, u32* out_visible_indices) {
+    if (!f || !bounds || !out_visible_indices || !bounds->count) {
+        return 0;
+    }
+
+    cull_plane planes[FRUSTUM_SIDE_COUNT];
+    cull_planes_from_frustum(f, planes);
+
+    u32 visible_count = 0;
+    cull_scalar(planes, 1, bounds, 0, bounds->count, &out_visible_indices, &visible_count);
+    return visible_count;
+}
+
+void frustum_cull_bounds_range(const frustum* frusta, u32 frustum_count, const bounds_soa* bounds, u32 start, u32 end, u32** out_visible_indices, u32* out_visible_counts) {
+    if (!frusta || !frustum_count || !bounds || !out_visible_indices || !out_visible_counts) {
+        return;
+    }
+    end = KMIN(end, bounds->count);
+    if (start >= end) {
+        kzero_memory(out_visible_counts, sizeof(u32) * frustum_count);
+        return;
+    }
+    if (start % BOUNDS_SOA_GROUP) {
+        DERROR("frustum_cull_bounds_range - start must be a multiple of %u.", BOUNDS_SOA_GROUP);
+        kzero_memory(out_visible_counts, sizeof(u32) * frustum_count);
+        return;
+    }
+
+    // Planes for a few views fit on the stack. Any more are culled a few at a time.
+    cull_plane planes[FRUSTUM_CULL_MAX_VIEWS * FRUSTUM_SIDE_COUNT];
+    for (u32 first = 0; first < frustum_count; first += FRUSTUM_CULL_MAX_VIEWS) {
+        u32 count = KMIN(FRUSTUM_CULL_MAX_VIEWS, frustum_count - first);
+        for (u32 v = 0; v < count; ++v) {
+            cull_planes_from_frustum(&frusta[first + v], planes + v * FRUSTUM_SIDE_COUNT);
+        }
+        cull_dispatch(planes, count, bounds, start, end, out_visible_indices + first, out_visible_counts + first);
+    }
+}
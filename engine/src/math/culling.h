@@ -0,0 +1,132 @@
+/**
+ * @file culling.h
+ * @brief Batched frustum culling of axis-aligned bounding boxes.
+ *
+ * @details
+ * Bounds are kept in structure-of-arrays form (all center x values together,
+ * then all center y values, and so on) so that several boxes can be loaded
+ * into one register and tested against a plane at once. On x86 the kernel
+ * tests 8 boxes at a time with AVX when the CPU supports it, and 4 at a time
+ * with SSE otherwise. Other platforms use a scalar loop producing the same
+ * results.
+ *
+ * Box and plane tests match frustum_intersects_aabb: a box is culled only if
+ * it lies entirely behind one of the six planes.
+ *
+ * Several frusta can be tested in one pass over a range of the boxes, so that
+ * each box is loaded once for all views, and ranges can be culled on
+ * different threads.
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+/** @brief The number of frusta whose planes are tested together per box in frustum_cull_bounds_range. */
+#define FRUSTUM_CULL_MAX_VIEWS 8
+
+/**
+ * @brief A set of world-space axis-aligned bounding boxes, stored as centers
+ * and half extents in structure-of-arrays form. Each array is padded to a
+ * multiple of 8 entries and aligned for SIMD loads.
+ */
+typedef struct bounds_soa {
+    /** @brief The number of boxes held. */
+    u32 count;
+    /** @brief The number of boxes that can be held before growing. Always a multiple of 8. */
+    u32 capacity;
+    /** @brief The single allocation holding all six arrays. */
+    void* block;
+    /** @brief The x coordinate of each box center. */
+    f32* center_x;
+    /** @brief The y coordinate of each box center. */
+    f32* center_y;
+    /** @brief The z coordinate of each box center. */
+    f32* center_z;
+    /** @brief The half extent of each box along x. */
+    f32* half_x;
+    /** @brief The half extent of each box along y. */
+    f32* half_y;
+    /** @brief The half extent of each box along z. */
+    f32* half_z;
+} bounds_soa;
+
+/**
+ * @brief Creates a bounds set, performing a dynamic allocation for its storage.
+ *
+ * @param capacity The number of boxes to reserve room for. Grows as needed.
+ * @param out_bounds A pointer to hold the created bounds set.
+ * @return True on success; otherwise false.
+ */
+API b8 bounds_soa_create(u32 capacity, bounds_soa* out_bounds);
+
+/**
+ * @brief Destroys the given bounds set and frees its storage.
+ *
+ * @param bounds A pointer to the bounds set to destroy.
+ */
+API void bounds_soa_destroy(bounds_soa* bounds);
+
+/**
+ * @brief Removes all boxes without releasing storage.
+ *
+ * @param bounds A pointer to the bounds set to clear.
+ */
+API void bounds_soa_clear(bounds_soa* bounds);
+
+/**
+ * @brief Appends a box to the set, growing it if needed.
+ *
+ * @param bounds A pointer to the bounds set.
+ * @param center The center of the box.
+ * @param half_extents The half extents of the box.
+ * @return The index of the new box.
+ */
+API u32 bounds_soa_push(bounds_soa* bounds, vec3 center, vec3 half_extents);
+
+/**
+ * @brief Replaces an existing box in the set.
+ *
+ * @param bounds A pointer to the bounds set.
+ * @param index The index of the box. Must be less than bounds->count.
+ * @param center The new center of the box.
+ * @param half_extents The new half extents of the box.
+ */
+API void bounds_soa_set(bounds_soa* bounds, u32 index, vec3 center, vec3 half_extents);
+
+/**
+ * @brief Tests every box in the set against the frustum and writes the indices
+ * of those that intersect or are contained by it, in ascending order.
+ *
+ * @param f A constant pointer to the frustum.
+ * @param bounds A constant pointer to the bounds set.
+ * @param out_visible_indices An array to hold visible indices. Must have room for bounds->count entries.
+ * @return The number of visible boxes written to out_visible_indices.
+ */
+API u32 frustum_cull_bounds(const frustum* f, const bounds_soa* bounds, u32* out_visible_indices);
+
+/**
+ * @brief Tests every box in the set against the frustum using the scalar path
+ * only. Exposed for testing and benchmarking against the SIMD paths.
+ *
+ * @param f A constant pointer to the frustum.
+ * @param bounds A constant pointer to the bounds set.
+ * @param out_visible_indices An array to hold visible indices. Must have room for bounds->count entries.
+ * @return The number of visible boxes written to out_visible_indices.
+ */
+API u32 frustum_cull_bounds_scalar(const frustum* f, const bounds_soa* bounds, u32* out_visible_indices);
+
+/**
+ * @brief Tests the boxes in [start, end) against each of the given frusta, loading each box
+ * once for all of them. Writes the indices of the boxes visible to each frustum, in ascending order.
+ *
+ * @param frusta An array of frusta.
+ * @param frustum_count The number of frusta.
+ * @param bounds A constant pointer to the bounds set.
+ * @param start The first box to test. Must be a multiple of 8.
+ * @param end One past the last box to test. Clamped to bounds->count.
+ * @param out_visible_indices One array per frustum, each with room for end - start entries.
+ * @param out_visible_counts An array to hold the number of visible boxes of each frustum.
+ */
+API void frustum_cull_bounds_range(const frustum* frusta, u32 frustum_count, const bounds_soa* bounds, u32 start, u32 end, u32** out_visible_indices, u32* out_visible_counts);
@@ -1,5 +1,6 @@
 #include "geometry_utils.h"
 
+#include "containers/hashmap.h"
 #include "core/asserts.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
@@ -9,6 +10,7 @@
 #include "renderer/renderer_frontend.h"
 #include "resources/terrain.h"
 #include "systems/geometry_system.h"
+#include "utils/ksort.h"
 
 void geometry_generate_normals(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices) {
     for (u32 i = 0; i < index_count; i += 3) {
@@ -64,65 +66,870 @@ void geometry_generate_tangents(u32 vertex_count, vertex_3d *vertices, u32 index
     }
 }
 
-b8 vertex3d_equal(vertex_3d vert_0, vertex_3d vert_1) {
-    return vec3_compare(vert_0.position, vert_1.position, K_FLOAT_EPSILON) &&
-           vec3_compare(vert_0.normal, vert_1.normal, K_FLOAT_EPSILON) &&
-           vec2_compare(vert_0.texcoord, vert_1.texcoord, K_FLOAT_EPSILON) &&
-           vec4_compare(vert_0.colour, vert_1.colour, K_FLOAT_EPSILON) &&
-           vec3_compare(vert_0.tangent, vert_1.tangent, K_FLOAT_EPSILON);
+// The float components of a vertex_3d, in declaration order.
+#define VERTEX_3D_COMPONENT_COUNT (sizeof(vertex_3d) / sizeof(f32))
+
+// The bits of a float, with -0 folded into 0 so that equal values always have equal bits.
+static u32 weld_float_bits(f32 value) {
+    if (value == 0.0f) {
+        return 0;
+    }
+    u32 bits;
+    kcopy_memory(&bits, &value, sizeof(u32));
+    return bits;
 }
 
-void reassign_index(u32 index_count, u32 *indices, u32 from, u32 to) {
-    for (u32 i = 0; i < index_count; ++i) {
-        if (indices[i] == from) {
-            indices[i] = to;
-        } else if (indices[i] > from) {
-            // Pull in all indicies higher than 'from' by 1.
-            indices[i]--;
+static u64 weld_hash_vertex(const vertex_3d *vertex) {
+    // FNV-1a over whole words. The hashmap mixes the result again, so this only needs to be cheap.
+    const f32 *components = (const f32 *)vertex;
+    u64 hash = 0xcbf29ce484222325ULL;
+    for (u32 i = 0; i < VERTEX_3D_COMPONENT_COUNT; ++i) {
+        hash ^= weld_float_bits(components[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static b8 weld_vertex_equal(const vertex_3d *vert_0, const vertex_3d *vert_1) {
+    const f32 *a = (const f32 *)vert_0;
+    const f32 *b = (const f32 *)vert_1;
+    for (u32 i = 0; i < VERTEX_3D_COMPONENT_COUNT; ++i) {
+        if (weld_float_bits(a[i]) != weld_float_bits(b[i])) {
+            return false;
         }
     }
+    return true;
+}
+
+static b8 weld_vertex_near(const vertex_3d *vert_0, const vertex_3d *vert_1, f32 epsilon) {
+    const f32 *a = (const f32 *)vert_0;
+    const f32 *b = (const f32 *)vert_1;
+    for (u32 i = 0; i < VERTEX_3D_COMPONENT_COUNT; ++i) {
+        if (kabs(a[i] - b[i]) > epsilon) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Obtains the coordinate of the grid cell holding the given value, clamped so that the cells of far away values stay distinct from their neighbours.
+static i64 weld_cell(f32 value, f64 cell_size, f64 *out_fraction) {
+    f64 scaled = (f64)value / cell_size;
+    if (scaled > 4.0e18) {
+        scaled = 4.0e18;
+    } else if (scaled < -4.0e18) {
+        scaled = -4.0e18;
+    }
+    i64 cell = (i64)scaled;
+    if ((f64)cell > scaled) {
+        // Truncation rounds negative values up.
+        cell--;
+    }
+    *out_fraction = scaled - (f64)cell;
+    return cell;
+}
+
+static u64 weld_hash_cell(i64 x, i64 y, i64 z) {
+    u64 hash = 0xcbf29ce484222325ULL;
+    hash = (hash ^ (u64)x) * 0x100000001b3ULL;
+    hash = (hash ^ (u64)y) * 0x100000001b3ULL;
+    hash = (hash ^ (u64)z) * 0x100000001b3ULL;
+    return hash;
+}
+
+void geometry_weld_vertices(u32 vertex_count, const vertex_3d *vertices, u32 index_count, u32 *indices, f32 epsilon, u32 *out_vertex_count, vertex_3d **out_vertices) {
+    vertex_3d *unique_verts = kallocate_no_zero(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    // The unique vertex each original vertex was welded to.
+    u32 *remap = kallocate_no_zero(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    // Unique vertices sharing a bucket are chained, newest first. The map holds the head of each chain.
+    u32 *next = kallocate_no_zero(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    hashmap buckets;
+    hashmap_create(sizeof(u32), vertex_count, HASHMAP_KEY_TYPE_U64, true, &buckets);
+
+    u32 unique_count = 0;
+    if (epsilon <= 0.0f) {
+        // Exact: buckets are keyed by every component of the vertex.
+        for (u32 v = 0; v < vertex_count; ++v) {
+            u64 key = weld_hash_vertex(&vertices[v]);
+            u32 head = INVALID_ID;
+            hashmap_get_u64(&buckets, key, &head);
+            u32 match = INVALID_ID;
+            for (u32 u = head; u != INVALID_ID; u = next[u]) {
+                if (weld_vertex_equal(&vertices[v], &unique_verts[u])) {
+                    match = u;
+                    break;
+                }
+            }
+            if (match == INVALID_ID) {
+                match = unique_count++;
+                unique_verts[match] = vertices[v];
+                next[match] = head;
+                hashmap_set_u64(&buckets, key, &match);
+            }
+            remap[v] = match;
+        }
+    } else {
+        // Within epsilon: buckets are cells of a grid over positions, twice epsilon wide. A vertex
+        // within epsilon of another lies in the same cell or the neighbouring one on the nearer
+        // side, so at most 8 cells are searched. The other attributes are compared in full.
+        f64 cell_size = (f64)epsilon * 2.0;
+        for (u32 v = 0; v < vertex_count; ++v) {
+            const vertex_3d *vertex = &vertices[v];
+            f64 fx, fy, fz;
+            i64 cx = weld_cell(vertex->position.x, cell_size, &fx);
+            i64 cy = weld_cell(vertex->position.y, cell_size, &fy);
+            i64 cz = weld_cell(vertex->position.z, cell_size, &fz);
+            i64 nx = fx < 0.5 ? -1 : 1;
+            i64 ny = fy < 0.5 ? -1 : 1;
+            i64 nz = fz < 0.5 ? -1 : 1;
+
+            // Take the earliest match, as the pairwise search did.
+            u32 match = INVALID_ID;
+            for (u32 n = 0; n < 8; ++n) {
+                u64 key = weld_hash_cell(cx + ((n & 1) ? nx : 0), cy + ((n & 2) ? ny : 0), cz + ((n & 4) ? nz : 0));
+                u32 head = INVALID_ID;
+                if (!hashmap_get_u64(&buckets, key, &head)) {
+                    continue;
+                }
+                for (u32 u = head; u != INVALID_ID; u = next[u]) {
+                    if (u < match && weld_vertex_near(vertex, &unique_verts[u], epsilon)) {
+                        match = u;
+                    }
+                }
+            }
+            if (match == INVALID_ID) {
+                u64 key = weld_hash_cell(cx, cy, cz);
+                u32 head = INVALID_ID;
+                hashmap_get_u64(&buckets, key, &head);
+                match = unique_count++;
+                unique_verts[match] = *vertex;
+                next[match] = head;
+                hashmap_set_u64(&buckets, key, &match);
+            }
+            remap[v] = match;
+        }
+    }
+
+    // Rewrite the indices in a single pass.
+    for (u32 i = 0; i < index_count; ++i) {
+        indices[i] = remap[indices[i]];
+    }
+
+    *out_vertex_count = unique_count;
+    *out_vertices = kallocate_no_zero(sizeof(vertex_3d) * unique_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(*out_vertices, unique_verts, sizeof(vertex_3d) * unique_count);
+
+    hashmap_destroy(&buckets);
+    kfree(next, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(unique_verts, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+
+    DDEBUG("geometry_weld_vertices: removed %d vertices, orig/now %d/%d.",
+           vertex_count - *out_vertex_count, vertex_count, *out_vertex_count);
 }
 
 void geometry_deduplicate_vertices(u32 vertex_count, vertex_3d *vertices,
                                    u32 index_count, u32 *indices,
                                    u32 *out_vertex_count,
                                    vertex_3d **out_vertices) {
-    // Create new arrays for the collection to sit in.
-    vertex_3d *unique_verts =
-        kallocate(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
-    *out_vertex_count = 0;
+    geometry_weld_vertices(vertex_count, vertices, index_count, indices, 0.0f, out_vertex_count, out_vertices);
+}
+
+void geometry_analyze_vertex_cache(u32 vertex_count, u32 index_count, const u32 *indices, u32 cache_size, f32 *out_acmr, f32 *out_atvr) {
+    u32 triangle_count = index_count / 3;
+    // A vertex is in the cache if fewer than cache_size vertices have been added since it was.
+    u32 *cache_time = kallocate(sizeof(u32) * (vertex_count ? vertex_count : 1), MEMORY_TAG_ARRAY);
+    u32 timestamp = cache_size + 1;
+    u32 misses = 0;
+    u32 unique_count = 0;
+    for (u32 i = 0; i < triangle_count * 3; ++i) {
+        u32 v = indices[i];
+        if (cache_time[v] == 0) {
+            unique_count++;
+        }
+        if (timestamp - cache_time[v] > cache_size) {
+            cache_time[v] = timestamp++;
+            misses++;
+        }
+    }
+    kfree(cache_time, sizeof(u32) * (vertex_count ? vertex_count : 1), MEMORY_TAG_ARRAY);
+
+    if (out_acmr) {
+        *out_acmr = triangle_count ? (f32)misses / triangle_count : 0.0f;
+    }
+    if (out_atvr) {
+        *out_atvr = unique_count ? (f32)misses / unique_count : 0.0f;
+    }
+}
+
+void geometry_optimize_vertex_cache(u32 vertex_count, u32 index_count, u32 *indices) {
+    // Tipsify (Sander, Nehab and Barczak, 2007). Fans out around one vertex at a time, then moves
+    // on to a neighbouring vertex which will still be in the cache, or else the most recent one
+    // with triangles left.
+    u32 triangle_count = index_count / 3;
+    if (triangle_count < 2 || vertex_count == 0) {
+        return;
+    }
+    const u32 cache_size = GEOMETRY_VERTEX_CACHE_SIZE;
+    u32 corner_count = triangle_count * 3;
+
+    // The triangles using each vertex, and how many of them are yet to be emitted.
+    u32 *live = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *offsets = kallocate(sizeof(u32) * (vertex_count + 1), MEMORY_TAG_ARRAY);
+    u32 *adjacency = kallocate_no_zero(sizeof(u32) * corner_count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < corner_count; ++i) {
+        live[indices[i]]++;
+    }
+    for (u32 v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    // Fill from the end of each range, leaving offsets pointing at the start of each.
+    for (u32 i = corner_count; i > 0; --i) {
+        u32 v = indices[i - 1];
+        adjacency[--offsets[v + 1]] = (i - 1) / 3;
+    }
+    for (u32 v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+
+    u32 *cache_time = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    b8 *emitted = kallocate(sizeof(b8) * triangle_count, MEMORY_TAG_ARRAY);
+    // Every emitted vertex is pushed once. Those pushed while fanning around the current vertex
+    // are the candidates for the next one.
+    u32 *dead_end = kallocate_no_zero(sizeof(u32) * corner_count, MEMORY_TAG_ARRAY);
+    u32 *output = kallocate_no_zero(sizeof(u32) * corner_count, MEMORY_TAG_ARRAY);
+    u32 dead_end_count = 0;
+    u32 output_count = 0;
+    u32 timestamp = cache_size + 1;
+    u32 cursor = 0;
+
+    u32 fanning = INVALID_ID;
+    while (cursor < vertex_count && fanning == INVALID_ID) {
+        if (live[cursor]) {
+            fanning = cursor;
+        }
+        cursor++;
+    }
+    while (fanning != INVALID_ID) {
+        u32 candidates_start = dead_end_count;
+        for (u32 a = offsets[fanning]; a < offsets[fanning + 1]; ++a) {
+            u32 t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (u32 c = 0; c < 3; ++c) {
+                u32 v = indices[t * 3 + c];
+                output[output_count++] = v;
+                dead_end[dead_end_count++] = v;
+                live[v]--;
+                if (timestamp - cache_time[v] > cache_size) {
+                    cache_time[v] = timestamp++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // Prefer the oldest candidate which will still be in the cache once its remaining triangles are emitted.
+        u32 next = INVALID_ID;
+        i64 best_priority = -1;
+        for (u32 i = candidates_start; i < dead_end_count; ++i) {
+            u32 v = dead_end[i];
+            if (!live[v]) {
+                continue;
+            }
+            i64 priority = 0;
+            i64 age = (i64)timestamp - cache_time[v];
+            if (age + 2 * (i64)live[v] <= cache_size) {
+                priority = age;
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = v;
+            }
+        }
+        // Otherwise back up to the most recent vertex with triangles left, or failing that any vertex.
+        while (next == INVALID_ID && dead_end_count > 0) {
+            u32 v = dead_end[--dead_end_count];
+            if (live[v]) {
+                next = v;
+            }
+        }
+        while (next == INVALID_ID && cursor < vertex_count) {
+            if (live[cursor]) {
+                next = cursor;
+            }
+            cursor++;
+        }
+        fanning = next;
+    }
+
+    kcopy_memory(indices, output, sizeof(u32) * corner_count);
+
+    kfree(output, sizeof(u32) * corner_count, MEMORY_TAG_ARRAY);
+    kfree(dead_end, sizeof(u32) * corner_count, MEMORY_TAG_ARRAY);
+    kfree(emitted, sizeof(b8) * triangle_count, MEMORY_TAG_ARRAY);
+    kfree(cache_time, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(adjacency, sizeof(u32) * corner_count, MEMORY_TAG_ARRAY);
+    kfree(offsets, sizeof(u32) * (vertex_count + 1), MEMORY_TAG_ARRAY);
+    kfree(live, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+}
+
+// Maps a float to a key which sorts in descending order of the float.
+static u64 overdraw_sort_key(f32 value) {
+    u32 bits;
+    kcopy_memory(&bits, &value, sizeof(u32));
+    bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    return ~bits & 0xFFFFFFFFu;
+}
+
+void geometry_optimize_overdraw(u32 vertex_count, const vertex_3d *vertices, u32 index_count, u32 *indices, f32 threshold) {
+    u32 triangle_count = index_count / 3;
+    if (triangle_count < 2 || vertex_count == 0) {
+        return;
+    }
+    const u32 cache_size = GEOMETRY_VERTEX_CACHE_SIZE;
+    f32 acmr = 0;
+    geometry_analyze_vertex_cache(vertex_count, index_count, indices, cache_size, &acmr, 0);
+
+    // Split the triangles into clusters, each starting with a cold cache. A cluster ends where the
+    // order jumps away (all three vertices miss), or as soon as its own cache miss ratio is within
+    // the threshold of the whole mesh's, so that reordering clusters costs little in the cache.
+    u32 *cluster_starts = kallocate_no_zero(sizeof(u32) * (triangle_count + 1), MEMORY_TAG_ARRAY);
+    u32 *cache_time = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 cluster_count = 0;
+    u32 timestamp = cache_size + 1;
+    u32 cluster_misses = 0;
+    u32 cluster_start = 0;
+    cluster_starts[cluster_count++] = 0;
+    for (u32 t = 0; t < triangle_count; ++t) {
+        u32 misses = 0;
+        for (u32 c = 0; c < 3; ++c) {
+            u32 v = indices[t * 3 + c];
+            if (timestamp - cache_time[v] > cache_size) {
+                cache_time[v] = timestamp++;
+                misses++;
+            }
+        }
+        if (misses == 3 && t > cluster_start) {
+            cluster_starts[cluster_count++] = t;
+            cluster_start = t;
+            cluster_misses = 0;
+        }
+        cluster_misses += misses;
+        if (t + 1 < triangle_count && (f32)cluster_misses <= acmr * threshold * (f32)(t + 1 - cluster_start)) {
+            cluster_starts[cluster_count++] = t + 1;
+            cluster_start = t + 1;
+            cluster_misses = 0;
+            // Start the next cluster cold.
+            timestamp += cache_size + 1;
+        }
+    }
+    cluster_starts[cluster_count] = triangle_count;
+    kfree(cache_time, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+
+    if (cluster_count > 1) {
+        // The area-weighted centroid and normal of each cluster, and of the mesh.
+        vec3 *centroids = kallocate(sizeof(vec3) * cluster_count, MEMORY_TAG_ARRAY);
+        vec3 *normals = kallocate(sizeof(vec3) * cluster_count, MEMORY_TAG_ARRAY);
+        vec3 mesh_centroid = vec3_zero();
+        f32 mesh_area = 0;
+        for (u32 k = 0; k < cluster_count; ++k) {
+            f32 cluster_area = 0;
+            for (u32 t = cluster_starts[k]; t < cluster_starts[k + 1]; ++t) {
+                vec3 p0 = vertices[indices[t * 3 + 0]].position;
+                vec3 p1 = vertices[indices[t * 3 + 1]].position;
+                vec3 p2 = vertices[indices[t * 3 + 2]].position;
+                vec3 normal = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+                f32 area = vec3_length(normal) * 0.5f;
+                vec3 centre = vec3_mul_scalar(vec3_add(vec3_add(p0, p1), p2), 1.0f / 3.0f);
+                centroids[k] = vec3_add(centroids[k], vec3_mul_scalar(centre, area));
+                normals[k] = vec3_add(normals[k], normal);
+                cluster_area += area;
+            }
+            mesh_centroid = vec3_add(mesh_centroid, centroids[k]);
+            mesh_area += cluster_area;
+            centroids[k] = cluster_area > 0 ? vec3_mul_scalar(centroids[k], 1.0f / cluster_area) : vec3_zero();
+        }
+        mesh_centroid = mesh_area > 0 ? vec3_mul_scalar(mesh_centroid, 1.0f / mesh_area) : vec3_zero();
+
+        // Clusters facing out from the centre of the mesh are the most likely to hide others, so are drawn first.
+        u64 *keys = kallocate_no_zero(sizeof(u64) * cluster_count * 2, MEMORY_TAG_ARRAY);
+        u32 *order = kallocate_no_zero(sizeof(u32) * cluster_count * 2, MEMORY_TAG_ARRAY);
+        for (u32 k = 0; k < cluster_count; ++k) {
+            vec3 normal = normals[k];
+            f32 length = vec3_length(normal);
+            f32 facing = length > 0 ? vec3_dot(vec3_sub(centroids[k], mesh_centroid), vec3_mul_scalar(normal, 1.0f / length)) : 0.0f;
+            keys[k] = overdraw_sort_key(facing);
+            order[k] = k;
+        }
+        kradix_sort_u64(keys, order, cluster_count, keys + cluster_count, order + cluster_count);
+
+        u32 *output = kallocate_no_zero(sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+        u32 output_count = 0;
+        for (u32 i = 0; i < cluster_count; ++i) {
+            u32 k = order[i];
+            u32 count = (cluster_starts[k + 1] - cluster_starts[k]) * 3;
+            kcopy_memory(output + output_count, indices + cluster_starts[k] * 3, sizeof(u32) * count);
+            output_count += count;
+        }
+        kcopy_memory(indices, output, sizeof(u32) * output_count);
 
-    u32 found_count = 0;
+        kfree(output, sizeof(u32) * triangle_count * 3, MEMORY_TAG_ARRAY);
+        kfree(order, sizeof(u32) * cluster_count * 2, MEMORY_TAG_ARRAY);
+        kfree(keys, sizeof(u64) * cluster_count * 2, MEMORY_TAG_ARRAY);
+        kfree(normals, sizeof(vec3) * cluster_count, MEMORY_TAG_ARRAY);
+        kfree(centroids, sizeof(vec3) * cluster_count, MEMORY_TAG_ARRAY);
+    }
+
+    kfree(cluster_starts, sizeof(u32) * (triangle_count + 1), MEMORY_TAG_ARRAY);
+}
+
+void geometry_optimize_vertex_fetch(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices) {
+    if (vertex_count == 0) {
+        return;
+    }
+    // Number vertices in the order they are first used. Any that are unused go at the end.
+    u32 *remap = kallocate_no_zero(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kset_memory(remap, 0xFF, sizeof(u32) * vertex_count);
+    u32 next = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 v = indices[i];
+        if (remap[v] == INVALID_ID) {
+            remap[v] = next++;
+        }
+        indices[i] = remap[v];
+    }
+    for (u32 v = 0; v < vertex_count; ++v) {
+        if (remap[v] == INVALID_ID) {
+            remap[v] = next++;
+        }
+    }
+
+    vertex_3d *original = kallocate_no_zero(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(original, vertices, sizeof(vertex_3d) * vertex_count);
     for (u32 v = 0; v < vertex_count; ++v) {
-        b8 found = false;
-        for (u32 u = 0; u < *out_vertex_count; ++u) {
-            if (vertex3d_equal(vertices[v], unique_verts[u])) {
-                // Reassign indices, do _not_ copy
-                reassign_index(index_count, indices, v - found_count, u);
-                found = true;
-                found_count++;
+        vertices[remap[v]] = original[v];
+    }
+    kfree(original, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+}
+
+// A quadric error metric (Garland and Heckbert, 1997): the sum of the squared distances of a
+// point from a set of planes, each weighted by the area of the triangle it came from.
+typedef struct simplify_quadric {
+    f64 a00, a11, a22, a10, a20, a21;
+    f64 b0, b1, b2;
+    f64 c;
+    f64 weight;
+} simplify_quadric;
+
+static void simplify_quadric_add_triangle(simplify_quadric *q, vec3 p0, vec3 p1, vec3 p2) {
+    vec3 normal = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+    f64 length = vec3_length(normal);
+    if (length <= 0) {
+        return;
+    }
+    f64 x = normal.x / length;
+    f64 y = normal.y / length;
+    f64 z = normal.z / length;
+    f64 d = -(x * p0.x + y * p0.y + z * p0.z);
+    f64 w = length * 0.5;
+    q->a00 += w * x * x;
+    q->a11 += w * y * y;
+    q->a22 += w * z * z;
+    q->a10 += w * x * y;
+    q->a20 += w * x * z;
+    q->a21 += w * y * z;
+    q->b0 += w * x * d;
+    q->b1 += w * y * d;
+    q->b2 += w * z * d;
+    q->c += w * d * d;
+    q->weight += w;
+}
+
+static void simplify_quadric_add(simplify_quadric *q, const simplify_quadric *other) {
+    q->a00 += other->a00;
+    q->a11 += other->a11;
+    q->a22 += other->a22;
+    q->a10 += other->a10;
+    q->a20 += other->a20;
+    q->a21 += other->a21;
+    q->b0 += other->b0;
+    q->b1 += other->b1;
+    q->b2 += other->b2;
+    q->c += other->c;
+    q->weight += other->weight;
+}
+
+// The area-weighted sum of the squared distances of the given point from the quadric's planes.
+static f64 simplify_quadric_evaluate(const simplify_quadric *q, vec3 p) {
+    f64 x = p.x;
+    f64 y = p.y;
+    f64 z = p.z;
+    f64 rx = q->a00 * x + q->a10 * y + q->a20 * z;
+    f64 ry = q->a10 * x + q->a11 * y + q->a21 * z;
+    f64 rz = q->a20 * x + q->a21 * y + q->a22 * z;
+    f64 r = rx * x + ry * y + rz * z + 2.0 * (q->b0 * x + q->b1 * y + q->b2 * z) + q->c;
+    // Rounding can take a point on every plane slightly below 0.
+    return r < 0 ? 0 : r;
+}
+
+// Maps each vertex to the first vertex with the same position. Vertices sharing a position, such as
+// either side of a texture seam, are one point of the surface.
+static void simplify_points_build(u32 vertex_count, const vertex_3d *vertices, u32 *out_point_of) {
+    u32 *next = kallocate_no_zero(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    hashmap buckets;
+    hashmap_create(sizeof(u32), vertex_count, HASHMAP_KEY_TYPE_U64, true, &buckets);
+    for (u32 v = 0; v < vertex_count; ++v) {
+        vec3 p = vertices[v].position;
+        u64 key = 0xcbf29ce484222325ULL;
+        for (u32 i = 0; i < 3; ++i) {
+            key = (key ^ weld_float_bits(p.elements[i])) * 0x100000001b3ULL;
+        }
+        u32 head = INVALID_ID;
+        hashmap_get_u64(&buckets, key, &head);
+        u32 match = INVALID_ID;
+        for (u32 u = head; u != INVALID_ID; u = next[u]) {
+            vec3 q = vertices[u].position;
+            if (weld_float_bits(p.x) == weld_float_bits(q.x) && weld_float_bits(p.y) == weld_float_bits(q.y) && weld_float_bits(p.z) == weld_float_bits(q.z)) {
+                match = u;
                 break;
             }
         }
+        if (match == INVALID_ID) {
+            match = v;
+            next[v] = head;
+            hashmap_set_u64(&buckets, key, &match);
+        }
+        out_point_of[v] = match;
+    }
+    hashmap_destroy(&buckets);
+    kfree(next, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+}
 
-        if (!found) {
-            // Copy over to unique.
-            unique_verts[*out_vertex_count] = vertices[v];
-            (*out_vertex_count)++;
+// Lists the triangles around each point, as offsets into one array. offsets holds point_count + 1 entries.
+static void simplify_adjacency_build(u32 point_count, const u32 *point_of, u32 index_count, const u32 *indices, u32 *offsets, u32 *triangles) {
+    kzero_memory(offsets, sizeof(u32) * (point_count + 1));
+    for (u32 i = 0; i < index_count; ++i) {
+        offsets[point_of[indices[i]] + 1]++;
+    }
+    for (u32 p = 0; p < point_count; ++p) {
+        offsets[p + 1] += offsets[p];
+    }
+    // Filling moves each offset on to the start of the next point's range, so shift them back after.
+    for (u32 i = 0; i < index_count; ++i) {
+        triangles[offsets[point_of[indices[i]]]++] = i / 3;
+    }
+    for (u32 p = point_count; p > 0; --p) {
+        offsets[p] = offsets[p - 1];
+    }
+    offsets[0] = 0;
+}
+
+u32 geometry_simplify(u32 vertex_count, const vertex_3d *vertices, u32 index_count, const u32 *indices, u32 target_index_count, f32 target_error, u32 *out_indices, f32 *out_error) {
+    if (out_error) {
+        *out_error = 0;
+    }
+    if (vertex_count == 0) {
+        return 0;
+    }
+
+    u32 *point_of = kallocate_no_zero(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    simplify_points_build(vertex_count, vertices, point_of);
+
+    // Start from the triangles which have an area to lose.
+    u32 result_count = 0;
+    for (u32 t = 0; t < index_count / 3; ++t) {
+        u32 a = indices[t * 3 + 0];
+        u32 b = indices[t * 3 + 1];
+        u32 c = indices[t * 3 + 2];
+        if (point_of[a] != point_of[b] && point_of[b] != point_of[c] && point_of[a] != point_of[c]) {
+            out_indices[result_count++] = a;
+            out_indices[result_count++] = b;
+            out_indices[result_count++] = c;
         }
     }
+    if (result_count <= target_index_count) {
+        kfree(point_of, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+        return result_count;
+    }
 
-    // Allocate new vertices array
-    *out_vertices =
-        kallocate(sizeof(vertex_3d) * (*out_vertex_count), MEMORY_TAG_ARRAY);
-    // Copy over unique
-    kcopy_memory(*out_vertices, unique_verts,
-                 sizeof(vertex_3d) * (*out_vertex_count));
-    // Destroy temp array
-    kfree(unique_verts, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *offsets = kallocate_no_zero(sizeof(u32) * (vertex_count + 1), MEMORY_TAG_ARRAY);
+    u32 *adjacency = kallocate_no_zero(sizeof(u32) * result_count, MEMORY_TAG_ARRAY);
+    simplify_adjacency_build(vertex_count, point_of, result_count, out_indices, offsets, adjacency);
 
-    DDEBUG("geometry_deduplicate_vertices: removed %d vertices, orig/now %d/%d.",
-           vertex_count - *out_vertex_count, vertex_count, *out_vertex_count);
+    // Points which stay where they are, so that the outline and attributes of the surface are kept:
+    // those on a seam, where the point has more than one vertex, and those on an open or
+    // non-manifold edge, which does not have exactly one edge running the other way.
+    b8 *locked = kallocate(sizeof(b8) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *point_vertex = kallocate_no_zero(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kset_memory(point_vertex, 0xFF, sizeof(u32) * vertex_count);
+    for (u32 i = 0; i < result_count; ++i) {
+        u32 v = out_indices[i];
+        u32 p = point_of[v];
+        if (point_vertex[p] == INVALID_ID) {
+            point_vertex[p] = v;
+        } else if (point_vertex[p] != v) {
+            locked[p] = true;
+        }
+    }
+    kfree(point_vertex, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    for (u32 t = 0; t < result_count / 3; ++t) {
+        for (u32 c = 0; c < 3; ++c) {
+            u32 a = point_of[out_indices[t * 3 + c]];
+            u32 b = point_of[out_indices[t * 3 + (c + 1) % 3]];
+            u32 opposite = 0;
+            for (u32 i = offsets[b]; i < offsets[b + 1]; ++i) {
+                const u32 *tri = &out_indices[adjacency[i] * 3];
+                for (u32 k = 0; k < 3; ++k) {
+                    if (point_of[tri[k]] == b && point_of[tri[(k + 1) % 3]] == a) {
+                        opposite++;
+                    }
+                }
+            }
+            if (opposite != 1) {
+                locked[a] = true;
+                locked[b] = true;
+            }
+        }
+    }
+
+    simplify_quadric *quadrics = kallocate(sizeof(simplify_quadric) * vertex_count, MEMORY_TAG_ARRAY);
+    for (u32 t = 0; t < result_count / 3; ++t) {
+        simplify_quadric q = {0};
+        simplify_quadric_add_triangle(&q, vertices[out_indices[t * 3 + 0]].position, vertices[out_indices[t * 3 + 1]].position, vertices[out_indices[t * 3 + 2]].position);
+        for (u32 c = 0; c < 3; ++c) {
+            simplify_quadric_add(&quadrics[point_of[out_indices[t * 3 + c]]], &q);
+        }
+    }
+
+    // Collapse edges in passes. Each pass collapses the cheapest edges first, each moving one vertex
+    // onto the other end of an edge, and skips any edge near one already collapsed in the pass, so
+    // that the checks for each are made against the surface as it is.
+    u32 capacity = result_count;
+    u64 *keys = kallocate_no_zero(sizeof(u64) * capacity * 2, MEMORY_TAG_ARRAY);
+    u32 *order = kallocate_no_zero(sizeof(u32) * capacity * 2, MEMORY_TAG_ARRAY);
+    u32 *candidates = kallocate_no_zero(sizeof(u32) * capacity * 2, MEMORY_TAG_ARRAY);
+    f32 *errors = kallocate_no_zero(sizeof(f32) * capacity, MEMORY_TAG_ARRAY);
+    u32 *remap = kallocate_no_zero(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    b8 *touched = kallocate_no_zero(sizeof(b8) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *marks = kallocate(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 mark = 0;
+    for (u32 v = 0; v < vertex_count; ++v) {
+        remap[v] = v;
+    }
+    f64 error_limit = target_error > 0 ? (f64)target_error * target_error : 0;
+    f64 result_error = 0;
+    u32 target_triangles = target_index_count / 3;
+    u32 triangle_count = result_count / 3;
+
+    while (triangle_count > target_triangles) {
+        // Every edge appears once in each direction, so each half-edge offers its first vertex.
+        u32 candidate_count = 0;
+        for (u32 t = 0; t < triangle_count; ++t) {
+            for (u32 c = 0; c < 3; ++c) {
+                u32 u = out_indices[t * 3 + c];
+                u32 v = out_indices[t * 3 + (c + 1) % 3];
+                u32 pu = point_of[u];
+                u32 pv = point_of[v];
+                if (locked[pu]) {
+                    continue;
+                }
+                const simplify_quadric *qu = &quadrics[pu];
+                const simplify_quadric *qv = &quadrics[pv];
+                f64 weight = qu->weight + qv->weight;
+                f64 error = weight > 0 ? (simplify_quadric_evaluate(qu, vertices[v].position) + simplify_quadric_evaluate(qv, vertices[v].position)) / weight : 0;
+                if (error > error_limit) {
+                    continue;
+                }
+                candidates[candidate_count * 2 + 0] = u;
+                candidates[candidate_count * 2 + 1] = v;
+                errors[candidate_count] = (f32)error;
+                // Non-negative floats sort by their bits.
+                u32 bits;
+                kcopy_memory(&bits, &errors[candidate_count], sizeof(u32));
+                keys[candidate_count] = bits;
+                order[candidate_count] = candidate_count;
+                candidate_count++;
+            }
+        }
+        if (candidate_count == 0) {
+            break;
+        }
+        kradix_sort_u64(keys, order, candidate_count, keys + capacity, order + capacity);
+
+        kzero_memory(touched, sizeof(b8) * vertex_count);
+        u32 collapse_count = 0;
+        for (u32 i = 0; i < candidate_count && triangle_count > target_triangles; ++i) {
+            u32 candidate = order[i];
+            u32 u = candidates[candidate * 2 + 0];
+            u32 v = candidates[candidate * 2 + 1];
+            u32 pu = point_of[u];
+            u32 pv = point_of[v];
+            if (touched[pu] || touched[pv]) {
+                continue;
+            }
+
+            // The ends of the edge may only share the two points opposite it, or the surface would fold
+            // onto itself. Points around pv are marked, then those around pu counted once each.
+            mark += 2;
+            for (u32 a = offsets[pv]; a < offsets[pv + 1]; ++a) {
+                const u32 *tri = &out_indices[adjacency[a] * 3];
+                for (u32 k = 0; k < 3; ++k) {
+                    marks[point_of[tri[k]]] = mark;
+                }
+            }
+            u32 shared = 0;
+            for (u32 a = offsets[pu]; a < offsets[pu + 1]; ++a) {
+                const u32 *tri = &out_indices[adjacency[a] * 3];
+                for (u32 k = 0; k < 3; ++k) {
+                    u32 p = point_of[tri[k]];
+                    if (p != pu && p != pv && marks[p] == mark) {
+                        marks[p] = mark + 1;
+                        shared++;
+                    }
+                }
+            }
+            if (shared != 2) {
+                continue;
+            }
+
+            // The triangles on the edge disappear. No other may turn far, turn over or collapse to a line.
+            vec3 target = vertices[v].position;
+            u32 removed = 0;
+            b8 flipped = false;
+            for (u32 a = offsets[pu]; a < offsets[pu + 1] && !flipped; ++a) {
+                const u32 *tri = &out_indices[adjacency[a] * 3];
+                vec3 p[3];
+                b8 on_edge = false;
+                for (u32 k = 0; k < 3; ++k) {
+                    on_edge |= point_of[tri[k]] == pv;
+                    p[k] = vertices[tri[k]].position;
+                }
+                if (on_edge) {
+                    removed++;
+                    continue;
+                }
+                vec3 before = vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0]));
+                for (u32 k = 0; k < 3; ++k) {
+                    if (point_of[tri[k]] == pu) {
+                        p[k] = target;
+                    }
+                }
+                vec3 after = vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0]));
+                flipped = vec3_dot(before, after) <= 0.25f * vec3_length(before) * vec3_length(after);
+            }
+            if (flipped) {
+                continue;
+            }
+
+            remap[u] = v;
+            simplify_quadric_add(&quadrics[pv], &quadrics[pu]);
+            for (u32 a = offsets[pu]; a < offsets[pu + 1]; ++a) {
+                const u32 *tri = &out_indices[adjacency[a] * 3];
+                touched[point_of[tri[0]]] = true;
+                touched[point_of[tri[1]]] = true;
+                touched[point_of[tri[2]]] = true;
+            }
+            result_error = KMAX(result_error, (f64)errors[candidate]);
+            triangle_count -= removed;
+            collapse_count++;
+        }
+        if (collapse_count == 0) {
+            break;
+        }
+
+        // Move the collapsed vertices and drop the triangles left without an area.
+        u32 write = 0;
+        for (u32 t = 0; t < result_count / 3; ++t) {
+            u32 a = remap[out_indices[t * 3 + 0]];
+            u32 b = remap[out_indices[t * 3 + 1]];
+            u32 c = remap[out_indices[t * 3 + 2]];
+            if (point_of[a] != point_of[b] && point_of[b] != point_of[c] && point_of[a] != point_of[c]) {
+                out_indices[write++] = a;
+                out_indices[write++] = b;
+                out_indices[write++] = c;
+            }
+        }
+        result_count = write;
+        triangle_count = write / 3;
+        simplify_adjacency_build(vertex_count, point_of, result_count, out_indices, offsets, adjacency);
+    }
+
+    kfree(marks, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(touched, sizeof(b8) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(remap, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(errors, sizeof(f32) * capacity, MEMORY_TAG_ARRAY);
+    kfree(candidates, sizeof(u32) * capacity * 2, MEMORY_TAG_ARRAY);
+    kfree(order, sizeof(u32) * capacity * 2, MEMORY_TAG_ARRAY);
+    kfree(keys, sizeof(u64) * capacity * 2, MEMORY_TAG_ARRAY);
+    kfree(quadrics, sizeof(simplify_quadric) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(locked, sizeof(b8) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(adjacency, sizeof(u32) * capacity, MEMORY_TAG_ARRAY);
+    kfree(offsets, sizeof(u32) * (vertex_count + 1), MEMORY_TAG_ARRAY);
+    kfree(point_of, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+
+    if (out_error) {
+        *out_error = (f32)ksqrt((f32)result_error);
+    }
+    return result_count;
+}
+
+void geometry_generate_lods(geometry_config *config, u8 max_lod_count, f32 max_error) {
+    if (!config || config->index_size != sizeof(u32) || config->vertex_size != sizeof(vertex_3d) || config->index_count < 3) {
+        return;
+    }
+    max_lod_count = KMIN(max_lod_count, GEOMETRY_MAX_LODS);
+    u32 full_count = config->index_count;
+    config->lod_count = 1;
+    config->lods[0].index_offset = 0;
+    config->lods[0].index_count = full_count;
+    config->lods[0].error = 0;
+
+    // Each level is simplified from the one before, so its error is at most the sum of theirs.
+    f32 size = vec3_distance(config->min_extents, config->max_extents);
+    f32 error_limit = max_error * size;
+    u32 capacity = full_count * GEOMETRY_MAX_LODS;
+    u32 *indices = kallocate_no_zero(sizeof(u32) * capacity, MEMORY_TAG_ARRAY);
+    kcopy_memory(indices, config->indices, sizeof(u32) * full_count);
+    u32 total_count = full_count;
+    for (u8 l = 1; l < max_lod_count; ++l) {
+        const geometry_lod *source = &config->lods[l - 1];
+        u32 target = (source->index_count / 6) * 3;
+        f32 error = 0;
+        u32 count = geometry_simplify(config->vertex_count, config->vertices, source->index_count, indices + source->index_offset, target,
+                                      KMAX(error_limit - source->error, 0.0f), indices + total_count, &error);
+        // A level which saves little is not worth drawing or storing.
+        if (count == 0 || count > source->index_count / 4 * 3) {
+            break;
+        }
+        geometry_optimize_vertex_cache(config->vertex_count, count, indices + total_count);
+        geometry_lod *lod = &config->lods[config->lod_count++];
+        lod->index_offset = total_count;
+        lod->index_count = count;
+        lod->error = source->error + error;
+        total_count += count;
+    }
+
+    if (config->lod_count > 1) {
+        kfree(config->indices, sizeof(u32) * full_count, MEMORY_TAG_ARRAY);
+        config->indices = kallocate_no_zero(sizeof(u32) * total_count, MEMORY_TAG_ARRAY);
+        kcopy_memory(config->indices, indices, sizeof(u32) * total_count);
+        config->index_count = total_count;
+    }
+    kfree(indices, sizeof(u32) * capacity, MEMORY_TAG_ARRAY);
+}
+
+u8 geometry_lod_select(u8 lod_count, const geometry_lod *lods, f32 pixels_per_unit, f32 max_error_pixels) {
+    // Errors grow with each level, so take the last within the limit.
+    u8 lod = 0;
+    for (u8 l = 1; l < lod_count; ++l) {
+        if (lods[l].error * pixels_per_unit > max_error_pixels) {
+            break;
+        }
+        lod = l;
+    }
+    return lod;
 }
 
 void terrain_geometry_generate_normals(u32 vertex_count, terrain_vertex *vertices, u32 index_count, u32 *indices) {
@@ -3,6 +3,8 @@
 #include "math_types.h"
 
 struct geometry;
+struct geometry_config;
+struct geometry_lod;
 struct frame_data;
 typedef struct nine_slice {
     struct geometry *g;
@@ -42,7 +44,24 @@ API void geometry_generate_normals(u32 vertex_count, vertex_3d *vertices, u32 in
  */
 API void geometry_generate_tangents(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices);
 /**
- * @brief De-duplicates vertices, leaving only unique ones. Leaves the original
+ * @brief Welds vertices which are equal, or within epsilon of one another in every
+ * component, leaving only unique ones in the order they first appear. Vertices are
+ * bucketed in a hash map, so this runs in linear time. Leaves the original vertices
+ * array intact. Allocates a new array in out_vertices. Modifies indices in-place.
+ * Original vertex array should be freed by caller.
+ *
+ * @param vertex_count The number of vertices in the array.
+ * @param vertices The original array of vertices to be welded. Not modified.
+ * @param index_count The number of indices in the array.
+ * @param indices The array of indices. Modified in-place to refer to the welded vertices.
+ * @param epsilon The largest difference in any component for vertices to be welded. 0 welds only exactly equal vertices.
+ * @param out_vertex_count A pointer to hold the final vertex count.
+ * @param out_vertices A pointer to hold the array of welded vertices.
+ */
+API void geometry_weld_vertices(u32 vertex_count, const vertex_3d *vertices, u32 index_count, u32 *indices, f32 epsilon, u32 *out_vertex_count, vertex_3d **out_vertices);
+/**
+ * @brief De-duplicates vertices, merging those which are exactly equal and leaving
+ * only unique ones. Equivalent to geometry_weld_vertices with an epsilon of 0. Leaves the original
  * vertices array intact. Allocates a new array in out_vertices. Modifies
  * indices in-place. Original vertex array should be freed by caller.
  *
@@ -57,6 +76,94 @@ API void geometry_generate_tangents(u32 vertex_count, vertex_3d *vertices, u32 i
  */
 API void geometry_deduplicate_vertices(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices, u32 *out_vertex_count, vertex_3d **out_vertices);
 
+
+/** @brief The size of the FIFO post-transform vertex cache assumed when optimizing and measuring index data. */
+#define GEOMETRY_VERTEX_CACHE_SIZE 16
+
+/**
+ * @brief Reorders triangles so that their vertices are more often found in the post-transform
+ * vertex cache, using the Tipsify algorithm. Triangles keep their winding. Modifies indices in place.
+ *
+ * @param vertex_count The number of vertices the indices refer to.
+ * @param index_count The number of indices in the array.
+ * @param indices The array of indices to reorder.
+ */
+API void geometry_optimize_vertex_cache(u32 vertex_count, u32 index_count, u32 *indices);
+/**
+ * @brief Reorders clusters of triangles so that those most likely to hide others are drawn first,
+ * which reduces overdraw from any view. Clusters are split so that the vertex cache miss ratio
+ * grows by no more than roughly the given threshold. Should follow
+ * geometry_optimize_vertex_cache. Modifies indices in place.
+ *
+ * @param vertex_count The number of vertices in the array.
+ * @param vertices The array of vertices. Not modified.
+ * @param index_count The number of indices in the array.
+ * @param indices The array of indices to reorder.
+ * @param threshold The factor the cache miss ratio may grow by, such as 1.05.
+ */
+API void geometry_optimize_overdraw(u32 vertex_count, const vertex_3d *vertices, u32 index_count, u32 *indices, f32 threshold);
+/**
+ * @brief Reorders vertices into the order they are first used by the indices, so that vertex
+ * fetches run through memory in order. Should be the last optimization, as it follows the order of
+ * the triangles. Modifies both arrays in place.
+ *
+ * @param vertex_count The number of vertices in the array.
+ * @param vertices The array of vertices to reorder.
+ * @param index_count The number of indices in the array.
+ * @param indices The array of indices, rewritten to refer to the reordered vertices.
+ */
+API void geometry_optimize_vertex_fetch(u32 vertex_count, vertex_3d *vertices, u32 index_count, u32 *indices);
+/**
+ * @brief Measures how well the given indices use a FIFO post-transform vertex cache of the given size.
+ *
+ * @param vertex_count The number of vertices the indices refer to.
+ * @param index_count The number of indices in the array.
+ * @param indices The array of indices.
+ * @param cache_size The number of vertices held by the cache, typically GEOMETRY_VERTEX_CACHE_SIZE.
+ * @param out_acmr A pointer to hold the average cache miss ratio: vertices transformed per triangle. 0.5 is ideal, 3 the worst. Optional.
+ * @param out_atvr A pointer to hold the average transform to vertex ratio: vertices transformed per vertex used. 1 is ideal. Optional.
+ */
+API void geometry_analyze_vertex_cache(u32 vertex_count, u32 index_count, const u32 *indices, u32 cache_size, f32 *out_acmr, f32 *out_atvr);
+
+/**
+ * @brief Simplifies a surface by collapsing edges in order of the quadric error each adds, until
+ * the target index count is reached or no edge can be collapsed within the target error. Only the
+ * existing vertices are used, so the result can share their buffer. Points on open edges and
+ * texture seams are kept in place, as are any with more than one vertex.
+ *
+ * @param vertex_count The number of vertices in the array.
+ * @param vertices The array of vertices. Not modified.
+ * @param index_count The number of indices in the array.
+ * @param indices The array of indices to simplify. Not modified.
+ * @param target_index_count The number of indices to stop at or below.
+ * @param target_error The furthest, in local units, the result may stray from the surface.
+ * @param out_indices An array to hold the simplified indices. Must have room for index_count.
+ * @param out_error A pointer to hold roughly how far the result strays from the surface, in local units. Optional.
+ * @return The number of indices written to out_indices.
+ */
+API u32 geometry_simplify(u32 vertex_count, const vertex_3d *vertices, u32 index_count, const u32 *indices, u32 target_index_count, f32 target_error, u32 *out_indices, f32 *out_error);
+/**
+ * @brief Generates levels of detail for the given geometry config, each simplified from the one
+ * before to about half of its triangles, for as long as that saves at least a quarter of them and
+ * the error stays within the given limit. The indices of each level are appended to the config's
+ * index data, which must be 32-bit, and every level, including the full detail, is recorded in its
+ * lods. Indices of the new levels are ordered for the vertex cache.
+ *
+ * @param config A pointer to the config. Its vertex data is not modified.
+ * @param max_lod_count The greatest number of levels to have, including the full detail. At most GEOMETRY_MAX_LODS.
+ * @param max_error The furthest any level may stray from the full detail, as a fraction of the size of the geometry's extents.
+ */
+API void geometry_generate_lods(struct geometry_config *config, u8 max_lod_count, f32 max_error);
+/**
+ * @brief Chooses the coarsest of the given levels of detail whose error, when drawn, is within the given number of pixels.
+ *
+ * @param lod_count The number of levels of detail.
+ * @param lods The levels of detail, from the full detail down.
+ * @param pixels_per_unit The size in pixels of a local unit of the geometry where it is drawn.
+ * @param max_error_pixels The largest error allowed, in pixels.
+ * @return The index of the level of detail to draw.
+ */
+API u8 geometry_lod_select(u8 lod_count, const struct geometry_lod *lods, f32 pixels_per_unit, f32 max_error_pixels);
 struct terrain_vertex;
 
 API void terrain_geometry_generate_normals(u32 vertex_count, struct terrain_vertex *vertices, u32 index_count, u32 *indices);
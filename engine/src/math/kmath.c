@@ -129,6 +129,22 @@ frustum frustum_create(const vec3 *position, const vec3 *forward,
     return f;
 }
 
+frustum frustum_create_orthographic(const vec3 *position, const vec3 *forward,
+                                    const vec3 *right, const vec3 *up,
+                                    extents_3d view_extents) {
+    frustum f;
+
+    // Each side faces inward, placed at its bound along the matching axis.
+    f.sides[FRUSTUM_SIDE_LEFT] = plane_3d_create(vec3_add(*position, vec3_mul_scalar(*right, view_extents.min.x)), *right);
+    f.sides[FRUSTUM_SIDE_RIGHT] = plane_3d_create(vec3_add(*position, vec3_mul_scalar(*right, view_extents.max.x)), vec3_mul_scalar(*right, -1.0f));
+    f.sides[FRUSTUM_SIDE_BOTTOM] = plane_3d_create(vec3_add(*position, vec3_mul_scalar(*up, view_extents.min.y)), *up);
+    f.sides[FRUSTUM_SIDE_TOP] = plane_3d_create(vec3_add(*position, vec3_mul_scalar(*up, view_extents.max.y)), vec3_mul_scalar(*up, -1.0f));
+    f.sides[FRUSTUM_SIDE_NEAR] = plane_3d_create(vec3_add(*position, vec3_mul_scalar(*forward, view_extents.min.z)), *forward);
+    f.sides[FRUSTUM_SIDE_FAR] = plane_3d_create(vec3_add(*position, vec3_mul_scalar(*forward, view_extents.max.z)), vec3_mul_scalar(*forward, -1.0f));
+
+    return f;
+}
+
 f32 plane_signed_distance(const plane_3d *p, const vec3 *position) {
     return vec3_dot(p->normal, *position) - p->distance;
 }
@@ -185,4 +201,77 @@ void frustum_corner_points_world_space(matrix4 projection_view, vec4 *corners) {
 f32 vec3_distance_to_line(vec3 point, vec3 line_start, vec3 line_direction) {
     f32 magnitude = vec3_length(vec3_cross(vec3_sub(point, line_start), line_direction));
     return magnitude / vec3_length(line_direction);
-}
\ No newline at end of file
+}
+void mat4_mul_array(const matrix4 *matrices_0, const matrix4 *matrices_1, u32 count, matrix4 *out_matrices) {
+    for (u32 i = 0; i < count; ++i) {
+#if KMATH_SIMD_AVX
+        // Two rows of the result at a time: each 128-bit half broadcasts from its own row of matrix_0.
+        const f32 *a = matrices_0[i].data;
+        const f32 *b = matrices_1[i].data;
+        __m256 b0 = _mm256_broadcast_ps((const __m128 *)b);
+        __m256 b1 = _mm256_broadcast_ps((const __m128 *)(b + 4));
+        __m256 b2 = _mm256_broadcast_ps((const __m128 *)(b + 8));
+        __m256 b3 = _mm256_broadcast_ps((const __m128 *)(b + 12));
+        __m256 a01 = _mm256_loadu_ps(a);
+        __m256 a23 = _mm256_loadu_ps(a + 8);
+
+        __m256 r01 = _mm256_mul_ps(_mm256_permute_ps(a01, 0x00), b0);
+        r01 = KMATH_MADD256(_mm256_permute_ps(a01, 0x55), b1, r01);
+        r01 = KMATH_MADD256(_mm256_permute_ps(a01, 0xAA), b2, r01);
+        r01 = KMATH_MADD256(_mm256_permute_ps(a01, 0xFF), b3, r01);
+        __m256 r23 = _mm256_mul_ps(_mm256_permute_ps(a23, 0x00), b0);
+        r23 = KMATH_MADD256(_mm256_permute_ps(a23, 0x55), b1, r23);
+        r23 = KMATH_MADD256(_mm256_permute_ps(a23, 0xAA), b2, r23);
+        r23 = KMATH_MADD256(_mm256_permute_ps(a23, 0xFF), b3, r23);
+
+        _mm256_storeu_ps(out_matrices[i].data, r01);
+        _mm256_storeu_ps(out_matrices[i].data + 8, r23);
+#else
+        out_matrices[i] = mat4_mul(matrices_0[i], matrices_1[i]);
+#endif
+    }
+}
+
+void vec3_transform_array(matrix4 m, const vec3 *points, u32 count, vec3 *out_points) {
+    u32 i = 0;
+#if KMATH_SIMD_SSE
+    __m128 m0 = _mm_set1_ps(m.data[0]), m1 = _mm_set1_ps(m.data[1]), m2 = _mm_set1_ps(m.data[2]);
+    __m128 m4 = _mm_set1_ps(m.data[4]), m5 = _mm_set1_ps(m.data[5]), m6 = _mm_set1_ps(m.data[6]);
+    __m128 m8 = _mm_set1_ps(m.data[8]), m9 = _mm_set1_ps(m.data[9]), m10 = _mm_set1_ps(m.data[10]);
+    __m128 m12 = _mm_set1_ps(m.data[12]), m13 = _mm_set1_ps(m.data[13]), m14 = _mm_set1_ps(m.data[14]);
+    for (; i + 4 <= count; i += 4) {
+        // Four points are 12 floats: {x0 y0 z0 x1}, {y1 z1 x2 y2}, {z2 x3 y3 z3}. Gather them into
+        // {x0 x1 x2 x3}, {y0 ...} and {z0 ...}, transform, then scatter them back the same way.
+        const f32 *src = points[i].elements;
+        __m128 v0 = _mm_loadu_ps(src);
+        __m128 v1 = _mm_loadu_ps(src + 4);
+        __m128 v2 = _mm_loadu_ps(src + 8);
+        __m128 x = KMATH_SHUFFLE(KMATH_SHUFFLE(v0, v1, 0, 3, 2, 2), KMATH_SHUFFLE(v1, v2, 2, 2, 1, 1), 0, 1, 0, 2);
+        __m128 y = KMATH_SHUFFLE(KMATH_SHUFFLE(v0, v1, 1, 1, 0, 0), KMATH_SHUFFLE(v1, v2, 3, 3, 2, 2), 0, 2, 0, 2);
+        __m128 z = KMATH_SHUFFLE(KMATH_SHUFFLE(v0, v1, 2, 2, 1, 1), KMATH_SWIZZLE(v2, 0, 0, 3, 3), 0, 2, 0, 2);
+
+        __m128 ox = _mm_add_ps(KMATH_MADD(z, m8, KMATH_MADD(y, m4, _mm_mul_ps(x, m0))), m12);
+        __m128 oy = _mm_add_ps(KMATH_MADD(z, m9, KMATH_MADD(y, m5, _mm_mul_ps(x, m1))), m13);
+        __m128 oz = _mm_add_ps(KMATH_MADD(z, m10, KMATH_MADD(y, m6, _mm_mul_ps(x, m2))), m14);
+
+        f32 *dst = out_points[i].elements;
+        _mm_storeu_ps(dst, KMATH_SHUFFLE(KMATH_SHUFFLE(ox, oy, 0, 0, 0, 0), KMATH_SHUFFLE(oz, ox, 0, 0, 1, 1), 0, 2, 0, 2));
+        _mm_storeu_ps(dst + 4, KMATH_SHUFFLE(KMATH_SHUFFLE(oy, oz, 1, 1, 1, 1), KMATH_SHUFFLE(ox, oy, 2, 2, 2, 2), 0, 2, 0, 2));
+        _mm_storeu_ps(dst + 8, KMATH_SHUFFLE(KMATH_SHUFFLE(oz, ox, 2, 2, 3, 3), KMATH_SHUFFLE(oy, oz, 3, 3, 3, 3), 0, 2, 0, 2));
+    }
+#elif KMATH_SIMD_NEON
+    float32x4_t r0 = vld1q_f32(m.data), r1 = vld1q_f32(m.data + 4), r2 = vld1q_f32(m.data + 8), r3 = vld1q_f32(m.data + 12);
+    for (; i + 4 <= count; i += 4) {
+        // De-interleaving loads and stores handle the gather and scatter.
+        float32x4x3_t v = vld3q_f32(points[i].elements);
+        float32x4x3_t o;
+        o.val[0] = vaddq_f32(vmlaq_laneq_f32(vmlaq_laneq_f32(vmulq_laneq_f32(v.val[0], r0, 0), v.val[1], r1, 0), v.val[2], r2, 0), vdupq_laneq_f32(r3, 0));
+        o.val[1] = vaddq_f32(vmlaq_laneq_f32(vmlaq_laneq_f32(vmulq_laneq_f32(v.val[0], r0, 1), v.val[1], r1, 1), v.val[2], r2, 1), vdupq_laneq_f32(r3, 1));
+        o.val[2] = vaddq_f32(vmlaq_laneq_f32(vmlaq_laneq_f32(vmulq_laneq_f32(v.val[0], r0, 2), v.val[1], r1, 2), v.val[2], r2, 2), vdupq_laneq_f32(r3, 2));
+        vst3q_f32(out_points[i].elements, o);
+    }
+#endif
+    for (; i < count; ++i) {
+        out_points[i] = vec3_mul_mat4(points[i], m);
+    }
+}
@@ -4,6 +4,57 @@
 #include "defines.h"
 #include "math_types.h"
 
+// SIMD implementations are chosen at compile time from the instruction sets the compiler is
+// targeting. SSE2 is always available on x86-64, while AVX and FMA are used when the build
+// enables them (i.e. -mavx2 -mfma). NEON is used on 64-bit ARM. Define KMATH_NO_SIMD to use
+// the scalar versions only.
+// The scalar versions (the *_scalar functions) are always available as a reference.
+#if !defined(KMATH_NO_SIMD)
+#    if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#        define KMATH_SIMD_SSE 1
+#        include <immintrin.h>
+#        if defined(__AVX__)
+#            define KMATH_SIMD_AVX 1
+#        endif
+#        if defined(__FMA__)
+#            define KMATH_SIMD_FMA 1
+#        endif
+#    elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#        define KMATH_SIMD_NEON 1
+#        include <arm_neon.h>
+#    endif
+#endif
+
+#if KMATH_SIMD_SSE
+// Builds an _mm_shuffle_ps mask picking lanes p0 and p1 from the first operand, then p2 and p3 from the second.
+#    define KMATH_SHUFFLE_MASK(p0, p1, p2, p3) ((p0) | ((p1) << 2) | ((p2) << 4) | ((p3) << 6))
+#    define KMATH_SHUFFLE(a, b, p0, p1, p2, p3) _mm_shuffle_ps(a, b, KMATH_SHUFFLE_MASK(p0, p1, p2, p3))
+#    define KMATH_SWIZZLE(a, p0, p1, p2, p3) _mm_shuffle_ps(a, a, KMATH_SHUFFLE_MASK(p0, p1, p2, p3))
+// a * b + c, fused where the target supports it.
+#    if KMATH_SIMD_FMA
+#        define KMATH_MADD(a, b, c) _mm_fmadd_ps(a, b, c)
+#        define KMATH_MADD256(a, b, c) _mm256_fmadd_ps(a, b, c)
+#    else
+#        define KMATH_MADD(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#        define KMATH_MADD256(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+#    endif
+#endif
+
+/** @brief The name of the SIMD implementation kmath was compiled with. */
+#if KMATH_SIMD_AVX && KMATH_SIMD_FMA
+#    define KMATH_SIMD_NAME "AVX+FMA"
+#elif KMATH_SIMD_AVX
+#    define KMATH_SIMD_NAME "AVX"
+#elif KMATH_SIMD_SSE && KMATH_SIMD_FMA
+#    define KMATH_SIMD_NAME "SSE+FMA"
+#elif KMATH_SIMD_SSE
+#    define KMATH_SIMD_NAME "SSE2"
+#elif KMATH_SIMD_NEON
+#    define KMATH_SIMD_NAME "NEON"
+#else
+#    define KMATH_SIMD_NAME "scalar"
+#endif
+
 /** @brief An approximate representation of PI. */
 #define K_PI 3.14159265358979323846f
 
@@ -778,14 +829,10 @@ INLINE vec3 vec3_transform(vec3 v, f32 w, matrix4 m) {
  */
 INLINE vec4 vec4_create(f32 x, f32 y, f32 z, f32 w) {
     vec4 out_vector;
-#if defined(KUSE_SIMD)
-    out_vector.data = _mm_setr_ps(x, y, z, w);
-#else
     out_vector.x = x;
     out_vector.y = y;
     out_vector.z = z;
     out_vector.w = w;
-#endif
     return out_vector;
 }
 
@@ -809,13 +856,7 @@ INLINE vec3 vec4_to_vec3(vec4 vector) {
  * @return A new vec4
  */
 INLINE vec4 vec4_from_vec3(vec3 vector, f32 w) {
-#if defined(KUSE_SIMD)
-    vec4 out_vector;
-    out_vector.data = _mm_setr_ps(x, y, z, w);
-    return out_vector;
-#else
     return (vec4){vector.x, vector.y, vector.z, w};
-#endif
 }
 
 /**
@@ -1036,24 +1077,22 @@ INLINE b8 vec4_compare(vec4 vector_0, vec4 vector_1, f32 tolerance) {
  * @return A new identity matrix
  */
 INLINE matrix4 mat4_identity(void) {
-    matrix4 out_matrix;
-    kzero_memory(out_matrix.data, sizeof(f32) * 16);
-    out_matrix.data[0] = 1.0f;
-    out_matrix.data[5] = 1.0f;
-    out_matrix.data[10] = 1.0f;
-    out_matrix.data[15] = 1.0f;
-    return out_matrix;
+    return (matrix4){{1.0f, 0.0f, 0.0f, 0.0f,
+                      0.0f, 1.0f, 0.0f, 0.0f,
+                      0.0f, 0.0f, 1.0f, 0.0f,
+                      0.0f, 0.0f, 0.0f, 1.0f}};
 }
 
 /**
- * @brief Returns the result of multiplying matrix_0 and matrix_1.
+ * @brief Returns the result of multiplying matrix_0 and matrix_1, without
+ * using SIMD. The reference for mat4_mul.
  *
  * @param matrix_0 The first matrix to be multiplied.
  * @param matrix_1 The second matrix to be multiplied.
  * @return The result of the matrix multiplication.
  */
-INLINE matrix4 mat4_mul(matrix4 matrix_0, matrix4 matrix_1) {
-    matrix4 out_matrix = mat4_identity();
+INLINE matrix4 mat4_mul_scalar(matrix4 matrix_0, matrix4 matrix_1) {
+    matrix4 out_matrix;
 
     const f32 *m1_ptr = matrix_0.data;
     const f32 *m2_ptr = matrix_1.data;
@@ -1070,6 +1109,50 @@ INLINE matrix4 mat4_mul(matrix4 matrix_0, matrix4 matrix_1) {
     return out_matrix;
 }
 
+/**
+ * @brief Returns the result of multiplying matrix_0 and matrix_1.
+ *
+ * @param matrix_0 The first matrix to be multiplied.
+ * @param matrix_1 The second matrix to be multiplied.
+ * @return The result of the matrix multiplication.
+ */
+INLINE matrix4 mat4_mul(matrix4 matrix_0, matrix4 matrix_1) {
+#if KMATH_SIMD_SSE
+    // Each row of the result is a combination of the rows of matrix_1, weighted by a row of matrix_0.
+    __m128 b0 = _mm_loadu_ps(matrix_1.data);
+    __m128 b1 = _mm_loadu_ps(matrix_1.data + 4);
+    __m128 b2 = _mm_loadu_ps(matrix_1.data + 8);
+    __m128 b3 = _mm_loadu_ps(matrix_1.data + 12);
+    matrix4 out_matrix;
+    for (u32 i = 0; i < 16; i += 4) {
+        const f32 *a = matrix_0.data + i;
+        __m128 row = _mm_mul_ps(_mm_set1_ps(a[0]), b0);
+        row = KMATH_MADD(_mm_set1_ps(a[1]), b1, row);
+        row = KMATH_MADD(_mm_set1_ps(a[2]), b2, row);
+        row = KMATH_MADD(_mm_set1_ps(a[3]), b3, row);
+        _mm_storeu_ps(out_matrix.data + i, row);
+    }
+    return out_matrix;
+#elif KMATH_SIMD_NEON
+    float32x4_t b0 = vld1q_f32(matrix_1.data);
+    float32x4_t b1 = vld1q_f32(matrix_1.data + 4);
+    float32x4_t b2 = vld1q_f32(matrix_1.data + 8);
+    float32x4_t b3 = vld1q_f32(matrix_1.data + 12);
+    matrix4 out_matrix;
+    for (u32 i = 0; i < 16; i += 4) {
+        const f32 *a = matrix_0.data + i;
+        float32x4_t row = vmulq_n_f32(b0, a[0]);
+        row = vmlaq_n_f32(row, b1, a[1]);
+        row = vmlaq_n_f32(row, b2, a[2]);
+        row = vmlaq_n_f32(row, b3, a[3]);
+        vst1q_f32(out_matrix.data + i, row);
+    }
+    return out_matrix;
+#else
+    return mat4_mul_scalar(matrix_0, matrix_1);
+#endif
+}
+
 /**
  * @brief Creates and returns an orthographic projection matrix. Typically used
  * to render flat or 2D scenes.
@@ -1252,12 +1335,13 @@ INLINE f32 mat4_determinant(matrix4 matrix) {
 }
 
 /**
- * @brief Creates and returns an inverse of the provided matrix.
+ * @brief Creates and returns an inverse of the provided matrix, without using
+ * SIMD. The reference for mat4_inverse.
  *
  * @param matrix The matrix to be inverted.
  * @return A inverted copy of the provided matrix.
  */
-INLINE matrix4 mat4_inverse(matrix4 matrix) {
+INLINE matrix4 mat4_inverse_scalar(matrix4 matrix) {
     const f32 *m = matrix.data;
 
     f32 t0 = m[10] * m[15];
@@ -1331,6 +1415,89 @@ INLINE matrix4 mat4_inverse(matrix4 matrix) {
     return out_matrix;
 }
 
+#if KMATH_SIMD_SSE
+// Helpers for mat4_inverse, each operating on a 2x2 matrix held in one register as {m00, m01, m10, m11}.
+
+// a * b
+INLINE __m128 kmath_mat2_mul(__m128 a, __m128 b) {
+    return _mm_add_ps(_mm_mul_ps(a, KMATH_SWIZZLE(b, 0, 3, 0, 3)),
+                      _mm_mul_ps(KMATH_SWIZZLE(a, 1, 0, 3, 2), KMATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// adjugate(a) * b
+INLINE __m128 kmath_mat2_adj_mul(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(KMATH_SWIZZLE(a, 3, 3, 0, 0), b),
+                      _mm_mul_ps(KMATH_SWIZZLE(a, 1, 1, 2, 2), KMATH_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// a * adjugate(b)
+INLINE __m128 kmath_mat2_mul_adj(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(a, KMATH_SWIZZLE(b, 3, 0, 3, 0)),
+                      _mm_mul_ps(KMATH_SWIZZLE(a, 1, 0, 3, 2), KMATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+#endif
+
+/**
+ * @brief Creates and returns an inverse of the provided matrix.
+ *
+ * @param matrix The matrix to be inverted.
+ * @return A inverted copy of the provided matrix.
+ */
+INLINE matrix4 mat4_inverse(matrix4 matrix) {
+#if KMATH_SIMD_SSE
+    // Block-wise inversion: the matrix is split into four 2x2 blocks | A B |
+    //                                                               | C D |
+    // and the inverse is built from their determinants and adjugates.
+    __m128 r0 = _mm_loadu_ps(matrix.data);
+    __m128 r1 = _mm_loadu_ps(matrix.data + 4);
+    __m128 r2 = _mm_loadu_ps(matrix.data + 8);
+    __m128 r3 = _mm_loadu_ps(matrix.data + 12);
+
+    __m128 a = _mm_movelh_ps(r0, r1);
+    __m128 b = _mm_movehl_ps(r1, r0);
+    __m128 c = _mm_movelh_ps(r2, r3);
+    __m128 d = _mm_movehl_ps(r3, r2);
+
+    // The determinants of each block, as {|A|, |B|, |C|, |D|}.
+    __m128 det_sub = _mm_sub_ps(
+        _mm_mul_ps(KMATH_SHUFFLE(r0, r2, 0, 2, 0, 2), KMATH_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+        _mm_mul_ps(KMATH_SHUFFLE(r0, r2, 1, 3, 1, 3), KMATH_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+    __m128 det_a = KMATH_SWIZZLE(det_sub, 0, 0, 0, 0);
+    __m128 det_b = KMATH_SWIZZLE(det_sub, 1, 1, 1, 1);
+    __m128 det_c = KMATH_SWIZZLE(det_sub, 2, 2, 2, 2);
+    __m128 det_d = KMATH_SWIZZLE(det_sub, 3, 3, 3, 3);
+
+    __m128 d_c = kmath_mat2_adj_mul(d, c);
+    __m128 a_b = kmath_mat2_adj_mul(a, b);
+    __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), kmath_mat2_mul(b, d_c));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), kmath_mat2_mul(c, a_b));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), kmath_mat2_mul_adj(d, a_b));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), kmath_mat2_mul_adj(a, d_c));
+
+    // |M| = |A||D| + |B||C| - trace((A#B)(D#C)), with the trace summed into every lane.
+    __m128 tr = _mm_mul_ps(a_b, KMATH_SWIZZLE(d_c, 0, 2, 1, 3));
+    tr = _mm_add_ps(tr, KMATH_SWIZZLE(tr, 2, 3, 0, 1));
+    tr = _mm_add_ps(tr, KMATH_SWIZZLE(tr, 1, 0, 3, 2));
+    __m128 det_m = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), tr);
+
+    __m128 r_det_m = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det_m);
+    x = _mm_mul_ps(x, r_det_m);
+    y = _mm_mul_ps(y, r_det_m);
+    z = _mm_mul_ps(z, r_det_m);
+    w = _mm_mul_ps(w, r_det_m);
+
+    // Apply the adjugate of each block while storing it.
+    matrix4 out_matrix;
+    _mm_storeu_ps(out_matrix.data, KMATH_SHUFFLE(x, y, 3, 1, 3, 1));
+    _mm_storeu_ps(out_matrix.data + 4, KMATH_SHUFFLE(x, y, 2, 0, 2, 0));
+    _mm_storeu_ps(out_matrix.data + 8, KMATH_SHUFFLE(z, w, 3, 1, 3, 1));
+    _mm_storeu_ps(out_matrix.data + 12, KMATH_SHUFFLE(z, w, 2, 0, 2, 0));
+    return out_matrix;
+#else
+    return mat4_inverse_scalar(matrix);
+#endif
+}
+
 /**
  * @brief Creates and returns a translation matrix from the given position.
  *
@@ -1551,13 +1718,13 @@ INLINE vec3 mat4_mul_vec3(matrix4 m, vec3 v) {
 }
 
 /**
- * @brief Performs v * m
+ * @brief Performs v * m, without using SIMD. The reference for vec3_mul_mat4.
  *
  * @param v The vector to bemultiplied.
  * @param m The matrix to be multiply by.
  * @return The transformed vector.
  */
-INLINE vec3 vec3_mul_mat4(vec3 v, matrix4 m) {
+INLINE vec3 vec3_mul_mat4_scalar(vec3 v, matrix4 m) {
     return (vec3){
         v.x * m.data[0] + v.y * m.data[4] + v.z * m.data[8] + m.data[12],
         v.x * m.data[1] + v.y * m.data[5] + v.z * m.data[9] + m.data[13],
@@ -1565,13 +1732,41 @@ INLINE vec3 vec3_mul_mat4(vec3 v, matrix4 m) {
 }
 
 /**
- * @brief Performs m * v
+ * @brief Performs v * m
+ *
+ * @param v The vector to bemultiplied.
+ * @param m The matrix to be multiply by.
+ * @return The transformed vector.
+ */
+INLINE vec3 vec3_mul_mat4(vec3 v, matrix4 m) {
+#if KMATH_SIMD_SSE
+    __m128 r = KMATH_MADD(_mm_set1_ps(v.y), _mm_loadu_ps(m.data + 4), _mm_mul_ps(_mm_set1_ps(v.x), _mm_loadu_ps(m.data)));
+    r = KMATH_MADD(_mm_set1_ps(v.z), _mm_loadu_ps(m.data + 8), r);
+    r = _mm_add_ps(r, _mm_loadu_ps(m.data + 12));
+    vec4 out_vector;
+    _mm_storeu_ps(out_vector.elements, r);
+    return (vec3){out_vector.x, out_vector.y, out_vector.z};
+#elif KMATH_SIMD_NEON
+    float32x4_t r = vmulq_n_f32(vld1q_f32(m.data), v.x);
+    r = vmlaq_n_f32(r, vld1q_f32(m.data + 4), v.y);
+    r = vmlaq_n_f32(r, vld1q_f32(m.data + 8), v.z);
+    r = vaddq_f32(r, vld1q_f32(m.data + 12));
+    vec4 out_vector;
+    vst1q_f32(out_vector.elements, r);
+    return (vec3){out_vector.x, out_vector.y, out_vector.z};
+#else
+    return vec3_mul_mat4_scalar(v, m);
+#endif
+}
+
+/**
+ * @brief Performs m * v, without using SIMD. The reference for mat4_mul_vec4.
  *
  * @param m The matrix to be multiplied.
  * @param v The vector to multiply by.
  * @return The transformed vector.
  */
-INLINE vec4 mat4_mul_vec4(matrix4 m, vec4 v) {
+INLINE vec4 mat4_mul_vec4_scalar(matrix4 m, vec4 v) {
     return (vec4){
         v.x * m.data[0] + v.y * m.data[1] + v.z * m.data[2] + v.w * m.data[3],
         v.x * m.data[4] + v.y * m.data[5] + v.z * m.data[6] + v.w * m.data[7],
@@ -1580,13 +1775,49 @@ INLINE vec4 mat4_mul_vec4(matrix4 m, vec4 v) {
 }
 
 /**
- * @brief Performs v * m
+ * @brief Performs m * v
+ *
+ * @param m The matrix to be multiplied.
+ * @param v The vector to multiply by.
+ * @return The transformed vector.
+ */
+INLINE vec4 mat4_mul_vec4(matrix4 m, vec4 v) {
+#if KMATH_SIMD_SSE
+    // Work on the columns, so that each lane produces one row's dot product.
+    __m128 c0 = _mm_loadu_ps(m.data);
+    __m128 c1 = _mm_loadu_ps(m.data + 4);
+    __m128 c2 = _mm_loadu_ps(m.data + 8);
+    __m128 c3 = _mm_loadu_ps(m.data + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    __m128 r = KMATH_MADD(_mm_set1_ps(v.y), c1, _mm_mul_ps(_mm_set1_ps(v.x), c0));
+    r = KMATH_MADD(_mm_set1_ps(v.z), c2, r);
+    r = KMATH_MADD(_mm_set1_ps(v.w), c3, r);
+    vec4 out_vector;
+    _mm_storeu_ps(out_vector.elements, r);
+    return out_vector;
+#elif KMATH_SIMD_NEON
+    // De-interleaving load, giving the columns.
+    float32x4x4_t c = vld4q_f32(m.data);
+    float32x4_t r = vmulq_n_f32(c.val[0], v.x);
+    r = vmlaq_n_f32(r, c.val[1], v.y);
+    r = vmlaq_n_f32(r, c.val[2], v.z);
+    r = vmlaq_n_f32(r, c.val[3], v.w);
+    vec4 out_vector;
+    vst1q_f32(out_vector.elements, r);
+    return out_vector;
+#else
+    return mat4_mul_vec4_scalar(m, v);
+#endif
+}
+
+/**
+ * @brief Performs v * m, without using SIMD. The reference for vec4_mul_mat4.
  *
  * @param v The vector to bemultiplied.
  * @param m The matrix to be multiply by.
  * @return The transformed vector.
  */
-INLINE vec4 vec4_mul_mat4(vec4 v, matrix4 m) {
+INLINE vec4 vec4_mul_mat4_scalar(vec4 v, matrix4 m) {
     return (vec4){
         v.x * m.data[0] + v.y * m.data[4] + v.z * m.data[8] + v.w * m.data[12],
         v.x * m.data[1] + v.y * m.data[5] + v.z * m.data[9] + v.w * m.data[13],
@@ -1594,6 +1825,57 @@ INLINE vec4 vec4_mul_mat4(vec4 v, matrix4 m) {
         v.x * m.data[3] + v.y * m.data[7] + v.z * m.data[11] + v.w * m.data[15]};
 }
 
+/**
+ * @brief Performs v * m
+ *
+ * @param v The vector to bemultiplied.
+ * @param m The matrix to be multiply by.
+ * @return The transformed vector.
+ */
+INLINE vec4 vec4_mul_mat4(vec4 v, matrix4 m) {
+#if KMATH_SIMD_SSE
+    __m128 r = KMATH_MADD(_mm_set1_ps(v.y), _mm_loadu_ps(m.data + 4), _mm_mul_ps(_mm_set1_ps(v.x), _mm_loadu_ps(m.data)));
+    r = KMATH_MADD(_mm_set1_ps(v.z), _mm_loadu_ps(m.data + 8), r);
+    r = KMATH_MADD(_mm_set1_ps(v.w), _mm_loadu_ps(m.data + 12), r);
+    vec4 out_vector;
+    _mm_storeu_ps(out_vector.elements, r);
+    return out_vector;
+#elif KMATH_SIMD_NEON
+    float32x4_t r = vmulq_n_f32(vld1q_f32(m.data), v.x);
+    r = vmlaq_n_f32(r, vld1q_f32(m.data + 4), v.y);
+    r = vmlaq_n_f32(r, vld1q_f32(m.data + 8), v.z);
+    r = vmlaq_n_f32(r, vld1q_f32(m.data + 12), v.w);
+    vec4 out_vector;
+    vst1q_f32(out_vector.elements, r);
+    return out_vector;
+#else
+    return vec4_mul_mat4_scalar(v, m);
+#endif
+}
+
+/**
+ * @brief Multiplies each pair of matrices from the given arrays, as mat4_mul
+ * does, so that out_matrices[i] = matrices_0[i] * matrices_1[i]. Uses AVX to
+ * produce two rows at once when available.
+ *
+ * @param matrices_0 An array of the first matrices to be multiplied.
+ * @param matrices_1 An array of the second matrices to be multiplied.
+ * @param count The number of matrices in each array.
+ * @param out_matrices An array to hold the results. May be either of the inputs.
+ */
+API void mat4_mul_array(const matrix4 *matrices_0, const matrix4 *matrices_1, u32 count, matrix4 *out_matrices);
+
+/**
+ * @brief Transforms each of the given points by the matrix, as vec3_mul_mat4
+ * does (treating w as 1). Points are processed four at a time.
+ *
+ * @param m The matrix to transform by.
+ * @param points An array of the points to be transformed.
+ * @param count The number of points.
+ * @param out_points An array to hold the transformed points. May be the same as points.
+ */
+API void vec3_transform_array(matrix4 m, const vec3 *points, u32 count, vec3 *out_points);
+
 // ------------------------------------------
 // Quaternion
 // ------------------------------------------
@@ -1709,12 +1991,13 @@ INLINE vec3 vec3_rotate(vec3 v, quaterion q) {
 }
 
 /**
- * @brief Creates a rotation matrix from the given quaternion.
+ * @brief Creates a rotation matrix from the given quaternion, without using
+ * SIMD. The reference for quat_to_mat4.
  *
  * @param q The quaternion to be used.
  * @return A rotation matrix.
  */
-INLINE matrix4 quat_to_mat4(quaterion q) {
+INLINE matrix4 quat_to_mat4_scalar(quaterion q) {
     matrix4 out_matrix = mat4_identity();
 
     // https://stackoverflow.com/questions/1556260/convert-quaternion-rotation-to-rotation-matrix
@@ -1736,6 +2019,44 @@ INLINE matrix4 quat_to_mat4(quaterion q) {
     return out_matrix;
 }
 
+/**
+ * @brief Creates a rotation matrix from the given quaternion.
+ *
+ * @param q The quaternion to be used.
+ * @return A rotation matrix.
+ */
+INLINE matrix4 quat_to_mat4(quaterion q) {
+#if KMATH_SIMD_SSE
+    quaterion n = quat_normalize(q);
+    __m128 v = _mm_loadu_ps(n.elements);
+    __m128 v2 = _mm_add_ps(v, v);
+
+    // Each of the first three rows is e + (p * q) * sign_a + (u * w) * sign_b, where p, q, u and w
+    // are swizzles of {x, y, z, w} and {2x, 2y, 2z, 2w}. The zero in the fourth lane of the signs
+    // keeps the last column clear, and the order of operations matches quat_to_mat4_scalar.
+    __m128 r0 = _mm_mul_ps(_mm_mul_ps(KMATH_SWIZZLE(v, 1, 0, 0, 3), KMATH_SWIZZLE(v2, 1, 1, 2, 3)), _mm_setr_ps(-1.0f, 1.0f, 1.0f, 0.0f));
+    r0 = _mm_add_ps(_mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f), r0);
+    r0 = _mm_add_ps(r0, _mm_mul_ps(_mm_mul_ps(KMATH_SWIZZLE(v, 2, 2, 1, 3), KMATH_SWIZZLE(v2, 2, 3, 3, 3)), _mm_setr_ps(-1.0f, -1.0f, 1.0f, 0.0f)));
+
+    __m128 r1 = _mm_mul_ps(_mm_mul_ps(KMATH_SWIZZLE(v, 0, 0, 1, 3), KMATH_SWIZZLE(v2, 1, 0, 2, 3)), _mm_setr_ps(1.0f, -1.0f, 1.0f, 0.0f));
+    r1 = _mm_add_ps(_mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f), r1);
+    r1 = _mm_add_ps(r1, _mm_mul_ps(_mm_mul_ps(KMATH_SWIZZLE(v, 2, 2, 0, 3), KMATH_SWIZZLE(v2, 3, 2, 3, 3)), _mm_setr_ps(1.0f, -1.0f, -1.0f, 0.0f)));
+
+    __m128 r2 = _mm_mul_ps(_mm_mul_ps(KMATH_SWIZZLE(v, 0, 1, 0, 3), KMATH_SWIZZLE(v2, 2, 2, 0, 3)), _mm_setr_ps(1.0f, 1.0f, -1.0f, 0.0f));
+    r2 = _mm_add_ps(_mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f), r2);
+    r2 = _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(KMATH_SWIZZLE(v, 1, 0, 1, 3), KMATH_SWIZZLE(v2, 3, 3, 1, 3)), _mm_setr_ps(-1.0f, 1.0f, -1.0f, 0.0f)));
+
+    matrix4 out_matrix;
+    _mm_storeu_ps(out_matrix.data, r0);
+    _mm_storeu_ps(out_matrix.data + 4, r1);
+    _mm_storeu_ps(out_matrix.data + 8, r2);
+    _mm_storeu_ps(out_matrix.data + 12, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+    return out_matrix;
+#else
+    return quat_to_mat4_scalar(q);
+#endif
+}
+
 /**
  * @brief Calculates a rotation matrix based on the quaternion and the passed in
  * center point.
@@ -1959,6 +2280,22 @@ API frustum frustum_create(const vec3 *position, const vec3 *forward,
                             const vec3 *right, const vec3 *up, f32 aspect,
                             f32 fov, f32 near, f32 far);
 
+/**
+ * @brief Creates and returns the box-shaped frustum of an orthographic
+ * projection, such as a directional light's shadow camera.
+ *
+ * @param position A constant pointer to the position of the projection.
+ * @param forward A constant pointer to the forward vector to be used.
+ * @param right A constant pointer to the right vector to be used.
+ * @param up A constant pointer to the up vector to be used.
+ * @param view_extents The box in view space: x and y are the left/right and
+ * bottom/top bounds, z is the near/far distance along forward.
+ * @return A shiny new frustum.
+ */
+API frustum frustum_create_orthographic(const vec3 *position, const vec3 *forward,
+                                        const vec3 *right, const vec3 *up,
+                                        extents_3d view_extents);
+
 API frustum frustum_from_view_projection(matrix4 view_projection);
 
 /**
@@ -219,7 +219,31 @@ typedef struct transform {
      */
     matrix4 local;
 
+    /**
+     * @brief Indicates if the local matrix or the parent has changed since the
+     * world matrix was last calculated.
+     */
+    b8 is_world_dirty;
+    /**
+     * @brief The cached world matrix, recalculated only when this transform or
+     * one of its ancestors has changed.
+     */
+    matrix4 world;
+    /** @brief The determinant of the cached world matrix. Negative when it flips winding. */
     f32 determinant;
+    /** @brief Incremented each time the world matrix is recalculated. */
+    u32 world_version;
+    /**
+     * @brief The parent's world_version at the time the world matrix was last
+     * calculated. A mismatch means the parent has moved since.
+     */
+    u32 parent_world_version;
+    /**
+     * @brief The value of the global transform change counter when the world
+     * matrix was last known to be current. While it still matches, nothing
+     * can have moved and the cached world matrix is returned as is.
+     */
+    u32 world_epoch;
 
     /** @brief A pointer to a parent transform if one is assigned. Can also be null. */
     struct transform* parent;
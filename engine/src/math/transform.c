@@ -2,43 +2,59 @@
 
 #include "kmath.h"
 
+// Incremented whenever any transform changes. A transform whose world matrix was confirmed current
+// at the present value can skip checking its ancestors. Transforms are modified from one thread.
+static u32 transform_epoch = 1;
+
+static void transform_mark_dirty(transform* t) {
+    t->is_dirty = true;
+    transform_epoch++;
+}
+
+// Clears the cached matrices of a newly created transform, leaving both marked dirty.
+static void transform_caches_reset(transform* t) {
+    t->local = mat4_identity();
+    t->is_world_dirty = true;
+    t->world = mat4_identity();
+    t->determinant = 1.0f;
+    t->world_version = 0;
+    t->parent_world_version = 0;
+    t->world_epoch = 0;
+    t->parent = 0;
+}
+
 transform transform_create(void) {
     transform t;
     transform_position_rotation_scale_set(&t, vec3_zero(), quat_identity(), vec3_one());
-    t.local = mat4_identity();
-    t.parent = 0;
+    transform_caches_reset(&t);
     return t;
 }
 
 transform transform_from_position(vec3 position) {
     transform t;
     transform_position_rotation_scale_set(&t, position, quat_identity(), vec3_one());
-    t.local = mat4_identity();
-    t.parent = 0;
+    transform_caches_reset(&t);
     return t;
 }
 
 transform transform_from_rotation(quaterion rotation) {
     transform t;
     transform_position_rotation_scale_set(&t, vec3_zero(), rotation, vec3_one());
-    t.local = mat4_identity();
-    t.parent = 0;
+    transform_caches_reset(&t);
     return t;
 }
 
 transform transform_from_position_rotation(vec3 position, quaterion rotation) {
     transform t;
     transform_position_rotation_scale_set(&t, position, rotation, vec3_one());
-    t.local = mat4_identity();
-    t.parent = 0;
+    transform_caches_reset(&t);
     return t;
 }
 
 transform transform_from_position_rotation_scale(vec3 position, quaterion rotation, vec3 scale) {
     transform t;
     transform_position_rotation_scale_set(&t, position, rotation, scale);
-    t.local = mat4_identity();
-    t.parent = 0;
+    transform_caches_reset(&t);
     return t;
 }
 
@@ -50,8 +66,10 @@ transform* transform_parent_get(transform* t) {
 }
 
 void transform_parent_set(transform* t, transform* parent) {
-    if (t) {
+    if (t && t->parent != parent) {
         t->parent = parent;
+        t->is_world_dirty = true;
+        transform_epoch++;
     }
 }
 
@@ -61,12 +79,12 @@ vec3 transform_position_get(const transform* t) {
 
 void transform_position_set(transform* t, vec3 position) {
     t->position = position;
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 void transform_translate(transform* t, vec3 translation) {
     t->position = vec3_add(t->position, translation);
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 quaterion transform_rotation_get(const transform* t) {
@@ -75,12 +93,12 @@ quaterion transform_rotation_get(const transform* t) {
 
 void transform_rotation_set(transform* t, quaterion rotation) {
     t->rotation = rotation;
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 void transform_rotate(transform* t, quaterion rotation) {
     t->rotation = quat_mul(t->rotation, rotation);
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 vec3 transform_scale_get(const transform* t) {
@@ -89,31 +107,31 @@ vec3 transform_scale_get(const transform* t) {
 
 void transform_scale_set(transform* t, vec3 scale) {
     t->scale = scale;
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 void transform_scale(transform* t, vec3 scale) {
     t->scale = vec3_mul(t->scale, scale);
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 void transform_position_rotation_set(transform* t, vec3 position, quaterion rotation) {
     t->position = position;
     t->rotation = rotation;
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 void transform_position_rotation_scale_set(transform* t, vec3 position, quaterion rotation, vec3 scale) {
     t->position = position;
     t->rotation = rotation;
     t->scale = scale;
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 void transform_translate_rotate(transform* t, vec3 translation, quaterion rotation) {
     t->position = vec3_add(t->position, translation);
     t->rotation = quat_mul(t->rotation, rotation);
-    t->is_dirty = true;
+    transform_mark_dirty(t);
 }
 
 matrix4 transform_local_get(transform* t) {
@@ -123,6 +141,7 @@ matrix4 transform_local_get(transform* t) {
             tr = mat4_mul(mat4_scale(t->scale), tr);
             t->local = tr;
             t->is_dirty = false;
+            t->is_world_dirty = true;
         }
 
         return t->local;
@@ -130,19 +149,58 @@ matrix4 transform_local_get(transform* t) {
     return mat4_identity();
 }
 
+b8 transform_world_update(transform* t) {
+    if (!t) {
+        return false;
+    }
+    matrix4 l = transform_local_get(t);
+    b8 recalculate;
+    if (t->parent) {
+        recalculate = t->is_world_dirty || t->parent_world_version != t->parent->world_version;
+        if (recalculate) {
+            t->world = mat4_mul(l, t->parent->world);
+            t->parent_world_version = t->parent->world_version;
+        }
+    } else {
+        // If no parent, the local matrix is the world matrix.
+        recalculate = t->is_world_dirty;
+        if (recalculate) {
+            t->world = l;
+        }
+    }
+    if (recalculate) {
+        t->determinant = mat4_determinant(t->world);
+        t->is_world_dirty = false;
+        t->world_version++;
+    }
+    // Only known to be current if the parent was.
+    if (!t->parent || t->parent->world_epoch == transform_epoch) {
+        t->world_epoch = transform_epoch;
+    }
+    return recalculate;
+}
+
 matrix4 transform_world_get(transform* t) {
     if (t) {
-        matrix4 l = transform_local_get(t);
+        // Nothing anywhere has changed since this was last confirmed current.
+        if (t->world_epoch == transform_epoch && !t->is_dirty) {
+            return t->world;
+        }
+        // Otherwise, make sure every ancestor is current first, then recalculate (only) what has
+        // changed on the way back down.
         if (t->parent) {
-            matrix4 p = transform_world_get(t->parent);
-            matrix4 r = mat4_mul(l, p);
-            // Save off the determinant at the bottom-most level.
-            t->determinant = mat4_determinant(r);
-            return r;
+            transform_world_get(t->parent);
         }
-        // If no parent, do it against the local matrix instead.
-        t->determinant = mat4_determinant(l);
-        return l;
+        transform_world_update(t);
+        return t->world;
     }
     return mat4_identity();
-}
\ No newline at end of file
+}
+
+f32 transform_determinant_get(transform* t) {
+    if (t) {
+        transform_world_get(t);
+        return t->determinant;
+    }
+    return 1.0f;
+}
@@ -179,9 +179,34 @@ API matrix4 transform_local_get(transform* t);
 /**
  * @brief Obtains the world matrix of the given transform
  * by examining its parent (if there is one) and multiplying it
- * against the local matrix.
+ * against the local matrix. The result is cached, and is only
+ * recalculated when this transform or one of its ancestors has
+ * changed since. If no transform at all has changed since the last
+ * call, the cached matrix is returned without looking at the parent
+ * chain.
  *
  * @param t A pointer to the transform whose world matrix to retrieve.
  * @return A copy of the world matrix.
  */
-API matrix4 transform_world_get(transform* t);
\ No newline at end of file
+API matrix4 transform_world_get(transform* t);
+
+/**
+ * @brief Recalculates the cached world matrix and determinant of the given
+ * transform if it or its parent has changed, assuming the parent's own
+ * cache is already current. Used by transform hierarchies, which visit
+ * parents before their children; prefer transform_world_get otherwise.
+ *
+ * @param t A pointer to the transform to be updated.
+ * @return True if the world matrix was recalculated; otherwise false.
+ */
+API b8 transform_world_update(transform* t);
+
+/**
+ * @brief Obtains the determinant of the world matrix of the given transform,
+ * bringing the cached world matrix up to date first if needed. A negative
+ * determinant means the world matrix flips triangle winding.
+ *
+ * @param t A pointer to the transform whose determinant to retrieve.
+ * @return The determinant of the world matrix.
+ */
+API f32 transform_determinant_get(transform* t);
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "transform_hierarchy.h"
+
+#include "containers/hashmap.h"
+#include "core/katomic.h"
+#include "core/kmemory.h"
+#include "core/logger.h"
+#include "math/transform.h"
+#include "systems/job_system.h"
+
+// Levels at least this large are split across the job threads, in chunks of this size.
+#define TRANSFORM_HIERARCHY_PARALLEL_GRAIN 2048
+
+// Marks a transform whose depth is still being worked out, used to detect cycles.
+#define DEPTH_PENDING (INVALID_ID - 1)
+
+typedef struct transform_hierarchy_level_context {
+    transform** transforms;
+    volatile u32 updated_count;
+} transform_hierarchy_level_context;
+
+static void level_update(u32 start, u32 end, void* userdata) {
+    transform_hierarchy_level_context* context = userdata;
+    u32 updated = 0;
+    for (u32 i = start; i < end; ++i) {
+        updated += transform_world_update(context->transforms[i]);
+    }
+    katomic_fetch_add_u32(&context->updated_count, updated);
+}
+
+static void transform_hierarchy_reserve(transform_hierarchy* hierarchy, u32 count, u32 level_count) {
+    if (count > hierarchy->capacity) {
+        if (hierarchy->transforms) {
+            kfree(hierarchy->transforms, sizeof(transform*) * hierarchy->capacity, MEMORY_TAG_SCENE);
+        }
+        hierarchy->capacity = KMAX(count, hierarchy->capacity * 2);
+        hierarchy->transforms = kallocate(sizeof(transform*) * hierarchy->capacity, MEMORY_TAG_SCENE);
+    }
+    if (level_count + 1 > hierarchy->level_capacity) {
+        if (hierarchy->level_offsets) {
+            kfree(hierarchy->level_offsets, sizeof(u32) * hierarchy->level_capacity, MEMORY_TAG_SCENE);
+        }
+        hierarchy->level_capacity = KMAX(level_count + 1, hierarchy->level_capacity * 2);
+        hierarchy->level_offsets = kallocate(sizeof(u32) * hierarchy->level_capacity, MEMORY_TAG_SCENE);
+    }
+}
+
+b8 transform_hierarchy_create(u32 capacity, transform_hierarchy* out_hierarchy) {
+    if (!out_hierarchy) {
+        DERROR("transform_hierarchy_create requires a valid pointer to out_hierarchy.");
+        return false;
+    }
+    kzero_memory(out_hierarchy, sizeof(transform_hierarchy));
+    transform_hierarchy_reserve(out_hierarchy, KMAX(capacity, 1), 1);
+    return true;
+}
+
+void transform_hierarchy_destroy(transform_hierarchy* hierarchy) {
+    if (hierarchy) {
+        if (hierarchy->transforms) {
+            kfree(hierarchy->transforms, sizeof(transform*) * hierarchy->capacity, MEMORY_TAG_SCENE);
+        }
+        if (hierarchy->level_offsets) {
+            kfree(hierarchy->level_offsets, sizeof(u32) * hierarchy->level_capacity, MEMORY_TAG_SCENE);
+        }
+        kzero_memory(hierarchy, sizeof(transform_hierarchy));
+    }
+}
+
+b8 transform_hierarchy_build(transform_hierarchy* hierarchy, transform** transforms, u32 count) {
+    if (!hierarchy) {
+        return false;
+    }
+    hierarchy->count = 0;
+    hierarchy->level_count = 0;
+    if (!count || !transforms) {
+        return true;
+    }
+
+    // Scratch: the index of each transform's parent within the input, its depth, a stack for
+    // walking up parent chains, and the number of transforms at each depth.
+    u32* scratch = kallocate(sizeof(u32) * count * 4, MEMORY_TAG_ARRAY);
+    u32* parents = scratch;
+    u32* depths = scratch + count;
+    u32* stack = scratch + count * 2;
+    u32* level_sizes = scratch + count * 3;
+
+    hashmap lookup;
+    hashmap_create(sizeof(u32), count, HASHMAP_KEY_TYPE_U64, false, &lookup);
+    for (u32 i = 0; i < count; ++i) {
+        hashmap_set_u64(&lookup, (u64)transforms[i], &i);
+    }
+    for (u32 i = 0; i < count; ++i) {
+        u32 parent = INVALID_ID;
+        if (transforms[i]->parent) {
+            hashmap_get_u64(&lookup, (u64)transforms[i]->parent, &parent);
+        }
+        parents[i] = parent;
+        depths[i] = INVALID_ID;
+    }
+    hashmap_destroy(&lookup);
+
+    // Walk up from each transform until reaching a root or one whose depth is already known, then
+    // assign depths on the way back down. Each transform is pushed only once, so this is linear.
+    b8 cycle = false;
+    u32 level_count = 0;
+    for (u32 i = 0; i < count && !cycle; ++i) {
+        u32 top = 0;
+        u32 current = i;
+        u32 depth = 0;
+        while (current != INVALID_ID) {
+            if (depths[current] == DEPTH_PENDING) {
+                cycle = true;
+                break;
+            }
+            if (depths[current] != INVALID_ID) {
+                depth = depths[current] + 1;
+                break;
+            }
+            depths[current] = DEPTH_PENDING;
+            stack[top++] = current;
+            current = parents[current];
+        }
+        if (cycle) {
+            break;
+        }
+        while (top) {
+            depths[stack[--top]] = depth++;
+        }
+        level_count = KMAX(level_count, depth);
+    }
+
+    if (cycle) {
+        DERROR("transform_hierarchy_build - The given transforms have a cycle in their parents. Hierarchy is empty.");
+        kfree(scratch, sizeof(u32) * count * 4, MEMORY_TAG_ARRAY);
+        return false;
+    }
+
+    transform_hierarchy_reserve(hierarchy, count, level_count);
+
+    // Counting sort by depth. Transforms keep their given order within a level.
+    kzero_memory(level_sizes, sizeof(u32) * level_count);
+    for (u32 i = 0; i < count; ++i) {
+        level_sizes[depths[i]]++;
+    }
+    u32 offset = 0;
+    for (u32 level = 0; level < level_count; ++level) {
+        hierarchy->level_offsets[level] = offset;
+        offset += level_sizes[level];
+        level_sizes[level] = hierarchy->level_offsets[level];
+    }
+    hierarchy->level_offsets[level_count] = count;
+    for (u32 i = 0; i < count; ++i) {
+        hierarchy->transforms[level_sizes[depths[i]]++] = transforms[i];
+    }
+
+    hierarchy->count = count;
+    hierarchy->level_count = level_count;
+    kfree(scratch, sizeof(u32) * count * 4, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u32 transform_hierarchy_update(transform_hierarchy* hierarchy) {
+    if (!hierarchy || !hierarchy->count) {
+        return 0;
+    }
+
+    // Roots may have parents outside of the hierarchy, possibly shared between several of them,
+    // so they are brought up to date on this thread.
+    u32 updated_count = 0;
+    for (u32 i = 0; i < hierarchy->level_offsets[1]; ++i) {
+        transform* t = hierarchy->transforms[i];
+        if (t->parent) {
+            transform_world_get(t->parent);
+        }
+        updated_count += transform_world_update(t);
+    }
+
+    // Every parent of a level is in the level before it, which is already complete.
+    for (u32 level = 1; level < hierarchy->level_count; ++level) {
+        u32 start = hierarchy->level_offsets[level];
+        u32 size = hierarchy->level_offsets[level + 1] - start;
+        if (size < TRANSFORM_HIERARCHY_PARALLEL_GRAIN) {
+            for (u32 i = start; i < start + size; ++i) {
+                updated_count += transform_world_update(hierarchy->transforms[i]);
+            }
+        } else {
+            transform_hierarchy_level_context context = {hierarchy->transforms + start, 0};
+            job_parallel_for(size, TRANSFORM_HIERARCHY_PARALLEL_GRAIN, level_update, &context);
+            updated_count += context.updated_count;
+        }
+    }
+    return updated_count;
+}
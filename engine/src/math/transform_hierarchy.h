@@ -0,0 +1,87 @@
+/**
+ * @file transform_hierarchy.h
+ * @brief A flattened, topologically sorted view over a set of transforms,
+ * used to bring all of their world matrices up to date in one pass.
+ *
+ * @details
+ * Transforms are sorted by their depth in the parent chain, so that every
+ * parent comes before its children and all transforms at the same depth
+ * sit next to each other. An update then visits each level in turn, and
+ * since transforms within a level never depend on one another, large levels
+ * are split across the job threads.
+ *
+ * A transform is only recalculated when its local matrix or parent has
+ * changed, or when its parent was recalculated earlier in the same pass,
+ * so changes propagate down exactly the subtrees they affect. Results are
+ * cached in the transforms themselves, so transform_world_get and
+ * transform_determinant_get are cheap afterwards.
+ *
+ * The hierarchy holds pointers to the transforms, and so must be rebuilt
+ * whenever a transform is added, removed or moved in memory. It should also
+ * be rebuilt when a transform is reparented; until then, anything the sweep
+ * gets out of order is still fixed up lazily by transform_world_get.
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "math/math_types.h"
+
+/** @brief A flattened hierarchy of transforms, sorted by depth. */
+typedef struct transform_hierarchy {
+    /** @brief The number of transforms held. */
+    u32 count;
+    /** @brief The number of transforms that can be held before growing. */
+    u32 capacity;
+    /** @brief The transforms, sorted by depth. */
+    transform** transforms;
+    /** @brief The number of distinct depths. */
+    u32 level_count;
+    /** @brief The number of entries level_offsets can hold. */
+    u32 level_capacity;
+    /**
+     * @brief The index of the first transform of each level, followed by one
+     * final entry holding count. Level i is [level_offsets[i], level_offsets[i + 1]).
+     */
+    u32* level_offsets;
+} transform_hierarchy;
+
+/**
+ * @brief Creates a transform hierarchy, performing a dynamic allocation for its storage.
+ *
+ * @param capacity The number of transforms to reserve room for. Grows as needed.
+ * @param out_hierarchy A pointer to hold the created hierarchy.
+ * @return True on success; otherwise false.
+ */
+API b8 transform_hierarchy_create(u32 capacity, transform_hierarchy* out_hierarchy);
+
+/**
+ * @brief Destroys the given hierarchy and frees its storage. Does not touch
+ * the transforms it referenced.
+ *
+ * @param hierarchy A pointer to the hierarchy to destroy.
+ */
+API void transform_hierarchy_destroy(transform_hierarchy* hierarchy);
+
+/**
+ * @brief Replaces the contents of the hierarchy with the given transforms,
+ * sorted by depth. The transforms may be given in any order. A transform
+ * whose parent is not among them is treated as a root; its parent is then
+ * brought up to date via transform_world_get during updates.
+ *
+ * @param hierarchy A pointer to the hierarchy.
+ * @param transforms An array of pointers to the transforms to include. Each may appear only once.
+ * @param count The number of transforms in the array.
+ * @return True on success; false if the parent chains contain a cycle, in which case the hierarchy is left empty.
+ */
+API b8 transform_hierarchy_build(transform_hierarchy* hierarchy, transform** transforms, u32 count);
+
+/**
+ * @brief Brings the world matrix and determinant of every transform in the
+ * hierarchy up to date, recalculating only those that have changed or whose
+ * ancestors have.
+ *
+ * @param hierarchy A pointer to the hierarchy.
+ * @return The number of transforms whose world matrix was recalculated.
+ */
+API u32 transform_hierarchy_update(transform_hierarchy* hierarchy);
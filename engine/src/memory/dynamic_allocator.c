@@ -30,8 +30,9 @@ b8 dynamic_allocator_create(u64 total_size, u64* memory_requirement, void* memor
         return false;
     }
     u64 freelist_requirement = 0;
-    // Grab the memory requirement for the free list first.
-    freelist_create(total_size, &freelist_requirement, 0, 0);
+    // Grab the memory requirement for the free list first. TLSF keeps allocation and freeing
+    // constant time however fragmented the heap gets.
+    freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &freelist_requirement, 0, 0);
 
     *memory_requirement = freelist_requirement + sizeof(dynamic_allocator_state) + total_size;
 
@@ -51,7 +52,7 @@ b8 dynamic_allocator_create(u64 total_size, u64* memory_requirement, void* memor
     state->memory_block = (void*)(state->freelist_block + freelist_requirement);
 
     // Actually create the freelist
-    freelist_create(total_size, &freelist_requirement, state->freelist_block, &state->list);
+    freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &freelist_requirement, state->freelist_block, &state->list);
 
     kzero_memory(state->memory_block, total_size);
     return true;
@@ -2,11 +2,15 @@
 
 #include "core/logger.h"
 #include "core/kmemory.h"
+#include "platform/platform.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 
+// The alignment of file contents read into an allocated block, matching what a mapping gives.
+#define FILE_MAPPING_FALLBACK_ALIGNMENT 16
+
 b8 filesystem_exists(const char* path) {
 #ifdef _MSC_VER
     struct _stat buffer;
@@ -17,6 +21,18 @@ b8 filesystem_exists(const char* path) {
 #endif
 }
 
+b8 filesystem_delete(const char* path) {
+    return remove(path) == 0;
+}
+
+b8 filesystem_rename(const char* path, const char* new_path) {
+    // Not every platform's rename replaces an existing file, so remove it first.
+    if (filesystem_exists(new_path) && !filesystem_delete(new_path)) {
+        return false;
+    }
+    return rename(path, new_path) == 0;
+}
+
 b8 filesystem_open(const char* path, file_modes mode, b8 binary, file_handle* out_handle) {
     out_handle->is_valid = false;
     out_handle->handle = 0;
@@ -140,4 +156,54 @@ b8 filesystem_write(file_handle* handle, u64 data_size, const void* data, u64* o
         return true;
     }
     return false;
-}
\ No newline at end of file
+}
+
+b8 filesystem_map(const char* path, file_mapping* out_mapping) {
+    out_mapping->data = 0;
+    out_mapping->size = 0;
+    out_mapping->is_mapped = false;
+
+    if (platform_file_map(path, &out_mapping->data, &out_mapping->size)) {
+        out_mapping->is_mapped = true;
+        return true;
+    }
+
+    // Fall back to reading the whole file.
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, true, &f)) {
+        return false;
+    }
+    u64 size = 0;
+    if (!filesystem_size(&f, &size)) {
+        filesystem_close(&f);
+        return false;
+    }
+    u8* data = kallocate_aligned(size ? size : 1, FILE_MAPPING_FALLBACK_ALIGNMENT, MEMORY_TAG_RESOURCE);
+    u64 bytes_read = 0;
+    if (size && !filesystem_read_all_bytes(&f, data, &bytes_read)) {
+        DERROR("Failed to read file '%s'.", path);
+        kfree_aligned(data, size ? size : 1, FILE_MAPPING_FALLBACK_ALIGNMENT, MEMORY_TAG_RESOURCE);
+        filesystem_close(&f);
+        return false;
+    }
+    filesystem_close(&f);
+
+    out_mapping->data = data;
+    out_mapping->size = size;
+    return true;
+}
+
+void filesystem_unmap(file_mapping* mapping) {
+    if (!mapping->data) {
+        return;
+    }
+    if (mapping->is_mapped) {
+        platform_file_unmap(mapping->data, mapping->size);
+    } else {
+        u64 size = mapping->size ? mapping->size : 1;
+        kfree_aligned((void*)mapping->data, size, FILE_MAPPING_FALLBACK_ALIGNMENT, MEMORY_TAG_RESOURCE);
+    }
+    mapping->data = 0;
+    mapping->size = 0;
+    mapping->is_mapped = false;
+}
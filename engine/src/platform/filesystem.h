@@ -14,6 +14,16 @@ typedef enum file_modes {
     FILE_MODE_WRITE = 0x2
 } file_modes;
 
+/** @brief A read-only view of the whole contents of a file. */
+typedef struct file_mapping {
+    /** @brief The contents of the file. Aligned to at least 16 bytes. */
+    const void* data;
+    /** @brief The size of the file in bytes. */
+    u64 size;
+    /** @brief Indicates if the file is memory-mapped, rather than read into an allocated block. */
+    b8 is_mapped;
+} file_mapping;
+
 /**
  * @brief If func returns false, closes the provided file handle and logs an error.
  * Also returns false, so the calling function must return a boolean. Calling file
@@ -36,6 +46,24 @@ typedef enum file_modes {
  */
 API b8 filesystem_exists(const char* path);
 
+/**
+ * @brief Deletes the file at the given path.
+ *
+ * @param path The path of the file to be deleted.
+ * @return True if successful; otherwise false.
+ */
+API b8 filesystem_delete(const char* path);
+
+/**
+ * @brief Moves the file at the given path to another, replacing any file already there.
+ * Neither file may be open or mapped.
+ *
+ * @param path The path of the file to be moved.
+ * @param new_path The path to move it to.
+ * @return True if successful; otherwise false.
+ */
+API b8 filesystem_rename(const char* path, const char* new_path);
+
 /** 
  * Attempt to open file located at path.
  * @param path The path of the file to be opened.
@@ -116,4 +144,22 @@ API b8 filesystem_read_all_text(file_handle* handle, char* out_text, u64* out_by
  * @param out_bytes_written A pointer to a number which will be populated with the number of bytes actually written to the file.
  * @returns True if successful; otherwise false.
  */
-API b8 filesystem_write(file_handle* handle, u64 data_size, const void* data, u64* out_bytes_written);
\ No newline at end of file
+API b8 filesystem_write(file_handle* handle, u64 data_size, const void* data, u64* out_bytes_written);
+
+/**
+ * @brief Maps the whole file at the given path into memory for reading. Pages are only read from
+ * disk as they are first touched. If the file cannot be mapped, it is read into an allocated
+ * block instead, so the contents are available either way.
+ *
+ * @param path The path of the file to be mapped.
+ * @param out_mapping A pointer to hold the mapping. Must be released with filesystem_unmap.
+ * @return True if successful; otherwise false.
+ */
+API b8 filesystem_map(const char* path, file_mapping* out_mapping);
+
+/**
+ * @brief Releases a mapping created by filesystem_map. Any pointers into its data become invalid.
+ *
+ * @param mapping A pointer to the mapping to be released.
+ */
+API void filesystem_unmap(file_mapping* mapping);
\ No newline at end of file
@@ -56,7 +56,7 @@ void* platform_set_memory(void* dest, i32 value, u64 size);
 void platform_console_write(const char* message, u8 colour);
 void platform_console_write_error(const char* message, u8 colour);
 
-f64 platform_get_absolute_time(void);
+API f64 platform_get_absolute_time(void);
 
 // Sleep on the thread for the provided ms.
 API void platform_sleep(u64 ms);
@@ -66,7 +66,7 @@ API void platform_sleep(u64 ms);
  *
  * @return The number of logical processor cores.
  */
-i32 platform_get_processor_count(void);
+API i32 platform_get_processor_count(void);
 
 /**
  * @brief Obtains the required memory amount for platform-specific handle data,
@@ -144,4 +144,22 @@ API b8 platform_watch_file(const char* file_path, u32* out_watch_id);
  * @param watch_id The watch identifier
  * @return True on success; otherwise false.
  */
-API b8 platform_unwatch_file(u32 watch_id);
\ No newline at end of file
+API b8 platform_unwatch_file(u32 watch_id);
+
+/**
+ * @brief Maps the whole file at the given path into memory for reading.
+ *
+ * @param file_path The file path. Required.
+ * @param out_data A pointer to hold the start of the file's contents.
+ * @param out_size A pointer to hold the size of the file in bytes.
+ * @return True on success; otherwise false, including for empty files, which cannot be mapped.
+ */
+API b8 platform_file_map(const char* file_path, const void** out_data, u64* out_size);
+
+/**
+ * @brief Releases a mapping created by platform_file_map.
+ *
+ * @param data The start of the mapped contents, as obtained from platform_file_map.
+ * @param size The size of the mapping in bytes.
+ */
+API void platform_file_unmap(const void* data, u64 size);
\ No newline at end of file
@@ -1,8 +1,40 @@
 
-#include "platform\platform.h"
+#include "platform/platform.h"
 
 #include "core/logger.h"
 
 #if PLATFORM_LINUX
 
-#endif
\ No newline at end of file
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+b8 platform_file_map(const char* file_path, const void** out_data, u64* out_size) {
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file open, so the descriptor can be closed straight away.
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    // Mapped files are usually read front to back in full, so start reading ahead.
+    posix_madvise(data, (size_t)info.st_size, POSIX_MADV_WILLNEED);
+    *out_data = data;
+    *out_size = (u64)info.st_size;
+    return true;
+}
+
+void platform_file_unmap(const void* data, u64 size) {
+    munmap((void*)data, (size_t)size);
+}
+
+#endif
@@ -417,7 +417,7 @@ b8 ksemaphore_create(ksemaphore *out_semaphore, u32 max_count, u32 start_count)
         return false;
     }
 
-    out_semaphore->internal_data = CreateSemaphore(0, start_count, max_count, "semaphore");
+    out_semaphore->internal_data = CreateSemaphore(0, start_count, max_count, 0);
 
     return true;
 }
@@ -593,6 +593,36 @@ platform_error_code platform_copy_file(const char *source, const char *dest, b8
     return PLATFORM_ERROR_SUCCESS;
 }
 
+b8 platform_file_map(const char *file_path, const void **out_data, u64 *out_size) {
+    HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+    // The view keeps the mapping alive, so its handle can be closed straight away.
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) {
+        return false;
+    }
+    *out_data = data;
+    *out_size = (u64)size.QuadPart;
+    return true;
+}
+
+void platform_file_unmap(const void *data, u64 size) {
+    UnmapViewOfFile(data);
+}
+
 static b8 register_watch(const char *file_path, u32 *out_watch_id) {
     if (!state_ptr || !file_path || !out_watch_id) {
         if (out_watch_id) {
@@ -16,6 +16,12 @@
 #include "renderer/passes/shadow_map_pass.h"
 #include "renderer/passes/skybox_pass.h"
 
+// The largest error, in pixels, a mesh level of detail may show in the camera.
+#define FORWARD_RENDERGRAPH_LOD_ERROR_PIXELS 1.0f
+// The largest error, in pixels, a mesh level of detail may show in the camera when casting shadows.
+// Shadows are filtered and soft-edged, so casters can be much coarser than what is seen directly.
+#define FORWARD_RENDERGRAPH_SHADOW_LOD_ERROR_PIXELS 4.0f
+
 b8 forward_rendergraph_create(const forward_rendergraph_config* config, forward_rendergraph* out_graph) {
     if (!rendergraph_create("forward_rendergraph", &out_graph->internal_graph)) {
         DERROR("Failed to create rendergraph.");
@@ -41,7 +47,9 @@ b8 forward_rendergraph_create(const forward_rendergraph_config* config, forward_
     // Shadowmap pass
     const char* shadowmap_pass_name = "shadowmap_pass";
     shadow_map_pass_config shadow_pass_config = {0};
-    shadow_pass_config.resolution = 2048;
+    out_graph->shadowmap_resolution = config->shadowmap_resolution ? config->shadowmap_resolution : 2048;
+    shadow_pass_config.resolution = out_graph->shadowmap_resolution;
+    shadow_pass_config.cache_far_cascades = config->cache_far_shadow_cascades;
     RG_CHECK(rendergraph_pass_create(&out_graph->internal_graph, shadowmap_pass_name, shadow_map_pass_create, &shadow_pass_config, &out_graph->shadowmap_pass));
     RG_CHECK(rendergraph_pass_source_add(&out_graph->internal_graph, shadowmap_pass_name, "depthbuffer", RENDERGRAPH_SOURCE_TYPE_RENDER_TARGET_DEPTH_STENCIL, RENDERGRAPH_SOURCE_ORIGIN_SELF));
 
@@ -145,6 +153,24 @@ b8 forward_rendergraph_frame_prepare(forward_rendergraph* graph, struct frame_da
             shadow_camera_positions[i] = vec3_zero();
         }
 
+        // Every view of the frame is culled against the scene in one stage: the camera first,
+        // followed by one view per shadow cascade when there is a directional light. Picking is not
+        // part of this graph; the old pick view (views_deprecated) is not built and culls nothing.
+        simple_scene_view views[1 + MAX_CASCADE_COUNT];
+        b8 views_culled = false;
+        {
+            viewport* v = current_viewport;
+            vec3 forward = camera_forward(current_camera);
+            vec3 right = camera_right(current_camera);
+            vec3 up = camera_up(current_camera);
+            views[0].f = frustum_create(&current_camera->position, &forward, &right,
+                                        &up, v->rect.width / v->rect.height, v->fov, v->near_clip, v->far_clip);
+            // Levels of detail are chosen by their error on screen, in the camera, for every view.
+            views[0].lod_position = current_camera->position;
+            views[0].lod_scale = v->fov > 0 ? v->rect.height / (2.0f * ktan(v->fov * 0.5f)) : 0;
+            views[0].lod_error_pixels = FORWARD_RENDERGRAPH_LOD_ERROR_PIXELS;
+        }
+
         // Skybox pass
         {
             skybox_pass_ext_data->sb = scene->sb;
@@ -164,9 +190,16 @@ b8 forward_rendergraph_frame_prepare(forward_rendergraph* graph, struct frame_da
             shadow_map_pass_extended_data* ext_data = pass->pass_data.ext_data;
             ext_data->light = dir_light;
 
-            /* frustum culling_frustum; */
-            vec3 culling_center;
-            f32 culling_radius;
+            // One box-shaped frustum per cascade for culling its casters, along with the center each
+            // cascade's casters are sorted from.
+            frustum cascade_frusta[MAX_CASCADE_COUNT];
+            vec3 cascade_centers[MAX_CASCADE_COUNT];
+
+            // The light-space basis, which only depends on the light direction. Cascade centers are
+            // snapped to whole texels along it.
+            vec3 shadow_forward = light_dir;
+            vec3 shadow_right = vec3_normalized(vec3_cross(shadow_forward, vec3_up()));
+            vec3 shadow_up = vec3_cross(shadow_right, shadow_forward);
 
             // Get the view-projection matrix
             matrix4 shadow_dist_projection = mat4_perspective(
@@ -203,9 +236,6 @@ b8 forward_rendergraph_frame_prepare(forward_rendergraph* graph, struct frame_da
                     center = vec3_add(center, vec3_from_vec4(corners[i]));
                 }
                 center = vec3_div_scalar(center, 8.0f);  // size
-                if (c == MAX_CASCADE_COUNT - 1) {
-                    culling_center = center;
-                }
 
                 // Get the furthest-out point from the center and use that as the extents.
                 f32 radius = 0.0f;
@@ -213,9 +243,17 @@ b8 forward_rendergraph_frame_prepare(forward_rendergraph* graph, struct frame_da
                     f32 distance = vec3_distance(vec3_from_vec4(corners[i]), center);
                     radius = KMAX(radius, distance);
                 }
-                if (c == MAX_CASCADE_COUNT - 1) {
-                    culling_radius = radius;
-                }
+                // Round the radius up so it does not change with the camera's rotation, then snap the center
+                // to whole texels in light space. This keeps shadow edges from shimmering as the camera moves,
+                // and leaves the cascade's matrices bit-for-bit unchanged until it moves by a full texel,
+                // which is what allows an unchanged cascade to be reused.
+                radius = kceil(radius * 16.0f) / 16.0f;
+                f32 texel_size = (radius * 2.0f) / graph->shadowmap_resolution;
+                center = vec3_add(
+                    vec3_add(vec3_mul_scalar(shadow_right, kfloor(vec3_dot(center, shadow_right) / texel_size) * texel_size),
+                             vec3_mul_scalar(shadow_up, kfloor(vec3_dot(center, shadow_up) / texel_size) * texel_size)),
+                    vec3_mul_scalar(shadow_forward, kfloor(vec3_dot(center, shadow_forward) / texel_size) * texel_size));
+                cascade_centers[c] = center;
 
                 // Calculate the extents by using the radius from above.
                 extents_3d extents;
@@ -247,6 +285,13 @@ b8 forward_rendergraph_frame_prepare(forward_rendergraph* graph, struct frame_da
                 // Generate ortho projection based on extents.
                 shadow_camera_projections[c] = mat4_orthographic(extents.min.x, extents.max.x, extents.min.y, extents.max.y, extents.min.z, extents.max.z - extents.min.z);
 
+                // Casters are culled against the projection's box, which already reaches well toward the light
+                // from the pulled-in near plane, but only out to the far side of the cascade's sphere, since
+                // nothing past the receivers can cast onto them.
+                extents_3d caster_extents = extents;
+                caster_extents.max.z = -extents.min.z + radius;
+                cascade_frusta[c] = frustum_create_orthographic(&shadow_camera_positions[c], &shadow_forward, &shadow_right, &shadow_up, caster_extents);
+
                 // Save these off to the pass data.
                 cascade->view = shadow_camera_lookats[c];
                 cascade->projection = shadow_camera_projections[c];
@@ -257,37 +302,50 @@ b8 forward_rendergraph_frame_prepare(forward_rendergraph* graph, struct frame_da
                 last_split_dist = split_dist;
             }
 
-            // Gather the geometries to be rendered.
-            // Note that this only needs to happen once, since all geometries visible by the furthest-out cascase
-            // must also be drawn on the nearest cascade to ensure objects outside the view cast shadows into the
-            // view properly.
-            ext_data->geometries = darray_reserve_with_allocator(geometry_render_data, 512, &p_frame_data->allocator);
-            if (!simple_scene_mesh_render_data_query_from_line(
-                    scene,
-                    light_dir,
-                    culling_center,
-                    culling_radius,
-                    p_frame_data,
-                    &ext_data->geometry_count, &ext_data->geometries)) {
-                DERROR("Failed to query shadow map pass meshes.");
+            // Cull the camera and every cascade together.
+            for (u32 c = 0; c < MAX_CASCADE_COUNT; ++c) {
+                views[1 + c].f = cascade_frusta[c];
+                views[1 + c].lod_position = views[0].lod_position;
+                views[1 + c].lod_scale = views[0].lod_scale;
+                views[1 + c].lod_error_pixels = FORWARD_RENDERGRAPH_SHADOW_LOD_ERROR_PIXELS;
             }
-            // Track the number of meshes drawn in the shadow pass.
-            p_frame_data->drawn_shadow_mesh_count = ext_data->geometry_count;
+            if (!simple_scene_views_cull(scene, 1 + MAX_CASCADE_COUNT, views, p_frame_data)) {
+                DERROR("Failed to cull scene views.");
+            }
+            views_culled = true;
 
-            // Gather terrain geometries.
-            ext_data->terrain_geometries = darray_reserve_with_allocator(geometry_render_data, 16, &p_frame_data->allocator);
-            if (!simple_scene_terrain_render_data_query_from_line(
-                    scene,
-                    light_dir,
-                    culling_center,
-                    culling_radius,
-                    p_frame_data,
-                    &ext_data->terrain_geometry_count, &ext_data->terrain_geometries)) {
-                DERROR("Failed to query shadow map pass terrain geometries.");
+            // Gather the geometries and terrain chunks to be rendered into each cascade, from that cascade's own caster volume.
+            for (u32 c = 0; c < MAX_CASCADE_COUNT; ++c) {
+                shadow_map_cascade_data* cascade = &ext_data->cascades[c];
+                cascade->geometries = darray_reserve_with_allocator(geometry_render_data, 512, &p_frame_data->allocator);
+                if (!simple_scene_mesh_render_data_from_views(
+                        scene,
+                        1,
+                        &views[1 + c],
+                        cascade_centers[c],
+                        p_frame_data,
+                        &cascade->geometry_count, &cascade->geometries)) {
+                    DERROR("Failed to query shadow map pass meshes for cascade %u.", c);
+                }
+
+                cascade->terrain_geometries = darray_reserve_with_allocator(geometry_render_data, 16, &p_frame_data->allocator);
+                if (!simple_scene_terrain_render_data_query(
+                        scene,
+                        &cascade_frusta[c],
+                        cascade_centers[c],
+                        p_frame_data,
+                        &cascade->terrain_geometry_count, &cascade->terrain_geometries)) {
+                    DERROR("Failed to query shadow map pass terrain geometries for cascade %u.", c);
+                }
             }
 
-            // TODO: Counter for terrain geometries.
-            p_frame_data->drawn_shadow_mesh_count += ext_data->terrain_geometry_count;
+            // Track the number of meshes drawn into each cascade.
+            // The shadow pass zeroes the count of any cascade it reuses from a previous frame.
+            p_frame_data->drawn_shadow_mesh_count = 0;
+            for (u32 c = 0; c < MAX_CASCADE_COUNT; ++c) {
+                p_frame_data->drawn_shadow_cascade_mesh_counts[c] = ext_data->cascades[c].geometry_count + ext_data->cascades[c].terrain_geometry_count;
+                p_frame_data->drawn_shadow_mesh_count += p_frame_data->drawn_shadow_cascade_mesh_counts[c];
+            }
         }
 
         // Scene pass.
@@ -315,22 +373,21 @@ b8 forward_rendergraph_frame_prepare(forward_rendergraph* graph, struct frame_da
             // HACK: use the skybox cubemap as the irradiance texture for now.
             ext_data->irradiance_cube_texture = scene->sb->cubemap.texture;
 
-            // Camera frustum culling and count
-            viewport* v = current_viewport;
-            vec3 forward = camera_forward(current_camera);
-            vec3 right = camera_right(current_camera);
-            vec3 up = camera_up(current_camera);
-            frustum camera_frustum = frustum_create(&current_camera->position, &forward, &right,
-                                                    &up, v->rect.width / v->rect.height, v->fov, v->near_clip, v->far_clip);
+            // Camera frustum culling and count. Already done along with the cascades if there are any.
+            if (!views_culled && !simple_scene_views_cull(scene, 1, views, p_frame_data)) {
+                DERROR("Failed to cull scene camera view.");
+            }
+            frustum camera_frustum = views[0].f;
 
             p_frame_data->drawn_mesh_count = 0;
 
             ext_data->geometries = darray_reserve_with_allocator(geometry_render_data, 512, &p_frame_data->allocator);
 
-            // Query the scene for static meshes using the camera frustum.
-            if (!simple_scene_mesh_render_data_query(
+            // Obtain the static meshes visible to the camera.
+            if (!simple_scene_mesh_render_data_from_views(
                     scene,
-                    &camera_frustum,
+                    1,
+                    views,
                     current_camera->position,
                     p_frame_data,
                     &ext_data->geometry_count, &ext_data->geometries)) {
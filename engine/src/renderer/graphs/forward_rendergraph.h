@@ -19,6 +19,8 @@ typedef struct forward_rendergraph {
 
 typedef struct forward_rendergraph_config {
     u16 shadowmap_resolution;
+    // Reuse the contents of far shadow cascades whose light, volume and casters have not changed.
+    b8 cache_far_shadow_cascades;
 } forward_rendergraph_config;
 
 API b8 forward_rendergraph_create(const forward_rendergraph_config* config, forward_rendergraph* out_graph);
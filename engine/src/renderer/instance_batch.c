@@ -0,0 +1,87 @@
+#include "instance_batch.h"
+
+#include "core/logger.h"
+#include "renderer/renderer_types.h"
+#include "resources/resource_types.h"
+#include "utils/ksort.h"
+
+// The low bits of a sort key hold the geometry's vertex buffer offset, and the high bits its run.
+#define INSTANCE_BATCH_OFFSET_BITS 40
+
+// Transparent draws are drawn back to front, so they can't be moved. This matches how the scene decides.
+static b8 geometry_is_transparent(const geometry_render_data* g) {
+    const material* m = g->material;
+    return m && m->type == MATERIAL_TYPE_PBR && m->maps && m->maps[0].texture && (m->maps[0].texture->flags & TEXTURE_FLAG_HAS_TRANSPARENCY);
+}
+
+static b8 geometry_same_state(const geometry_render_data* a, const geometry_render_data* b) {
+    return a->material == b->material && a->winding_inverted == b->winding_inverted;
+}
+
+static b8 geometry_same_mesh(const geometry_render_data* a, const geometry_render_data* b) {
+    return a->vertex_buffer_offset == b->vertex_buffer_offset && a->vertex_count == b->vertex_count &&
+           a->index_buffer_offset == b->index_buffer_offset && a->index_count == b->index_count;
+}
+
+b8 instance_batch_list_build(const frame_allocator_int* allocator, u32 count, geometry_render_data* geometries, instance_batch_list* out_list) {
+    out_list->batch_count = 0;
+    out_list->instance_count = count;
+    if (count == 0) {
+        out_list->batches = 0;
+        out_list->models = 0;
+        return true;
+    }
+    if (count > INSTANCE_BATCH_MAX_DRAWS) {
+        DERROR("instance_batch_list_build: %u draws given, but no more than %u can be batched.", count, INSTANCE_BATCH_MAX_DRAWS);
+        return false;
+    }
+
+    // Key each draw by its run of equal state, then its geometry. Sorting by these keeps runs in
+    // order and brings together the draws of each geometry within a run. The sort is stable, so
+    // draws of the same geometry also keep their order. Every transparent draw starts a new run,
+    // unless it is identical to the one before it, so transparent draws never move.
+    u64* keys = allocator->allocate(sizeof(u64) * count);
+    u32* indices = allocator->allocate(sizeof(u32) * count);
+    u64 run = 0;
+    for (u32 i = 0; i < count; ++i) {
+        const geometry_render_data* g = &geometries[i];
+        if (i > 0) {
+            const geometry_render_data* previous = &geometries[i - 1];
+            if (!geometry_same_state(g, previous) || (geometry_is_transparent(g) && !geometry_same_mesh(g, previous))) {
+                run++;
+            }
+        }
+        keys[i] = (run << INSTANCE_BATCH_OFFSET_BITS) | (g->vertex_buffer_offset & ((1ull << INSTANCE_BATCH_OFFSET_BITS) - 1));
+        indices[i] = i;
+    }
+
+    if (count > 1) {
+        u64* scratch_keys = allocator->allocate(sizeof(u64) * count);
+        u32* scratch_indices = allocator->allocate(sizeof(u32) * count);
+        kradix_sort_u64(keys, indices, count, scratch_keys, scratch_indices);
+        allocator->free(scratch_keys, sizeof(u64) * count);
+        allocator->free(scratch_indices, sizeof(u32) * count);
+    }
+
+    // Walk the sorted draws, starting a new batch whenever the key or the geometry changes.
+    out_list->batches = allocator->allocate(sizeof(instance_batch) * count);
+    out_list->models = allocator->allocate(sizeof(matrix4) * count);
+    instance_batch* batch = 0;
+    for (u32 i = 0; i < count; ++i) {
+        geometry_render_data* g = &geometries[indices[i]];
+        out_list->models[i] = g->model;
+        if (batch && keys[i] == keys[i - 1] && geometry_same_mesh(g, batch->geometry)) {
+            batch->instance_count++;
+        } else {
+            batch = &out_list->batches[out_list->batch_count];
+            out_list->batch_count++;
+            batch->geometry = g;
+            batch->first_instance = i;
+            batch->instance_count = 1;
+        }
+    }
+
+    allocator->free(keys, sizeof(u64) * count);
+    allocator->free(indices, sizeof(u32) * count);
+    return true;
+}
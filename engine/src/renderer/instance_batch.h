@@ -0,0 +1,61 @@
+/**
+ * @file instance_batch.h
+ * @brief Groups draws of the same geometry and material into instanced draws.
+ *
+ * @details
+ * Draws are expected in the order a render queue sorts them, where draws
+ * sharing a material and winding are next to each other. Within each such
+ * run, all opaque draws of the same geometry are gathered into one batch.
+ * Transparent draws must keep their back-to-front order, so they are only
+ * batched with identical draws directly before them.
+ *
+ * The model matrices of each batch are laid out together, ready to be
+ * uploaded once as per-instance data for the whole list.
+ */
+
+#pragma once
+
+#include "core/frame_data.h"
+#include "defines.h"
+#include "math/math_types.h"
+
+struct geometry_render_data;
+
+/** @brief The maximum number of draws a batch list can be built from. */
+#define INSTANCE_BATCH_MAX_DRAWS (1u << 24)
+
+/** @brief A single instanced draw. */
+typedef struct instance_batch {
+    /** @brief The render data of the batch's first draw. Its model matrix is not used. */
+    struct geometry_render_data* geometry;
+    /** @brief The index of the batch's first model matrix in the list's models. */
+    u32 first_instance;
+    /** @brief The number of instances drawn. */
+    u32 instance_count;
+} instance_batch;
+
+/**
+ * @brief A list of batches and their model matrices.
+ * All storage comes from a frame allocator, so there is nothing to destroy.
+ */
+typedef struct instance_batch_list {
+    /** @brief The number of batches. */
+    u32 batch_count;
+    /** @brief The batches, in the order they should be drawn. */
+    instance_batch* batches;
+    /** @brief The number of model matrices, which is one per draw given. */
+    u32 instance_count;
+    /** @brief The model matrix of every draw, laid out batch by batch. */
+    matrix4* models;
+} instance_batch_list;
+
+/**
+ * @brief Builds the instanced batches of the given draws.
+ *
+ * @param allocator A constant pointer to the frame allocator to take storage from.
+ * @param count The number of draws. Must be no more than INSTANCE_BATCH_MAX_DRAWS.
+ * @param geometries An array of draws, in the order a render queue sorted them.
+ * @param out_list A pointer to hold the created list.
+ * @return True on success; otherwise false.
+ */
+API b8 instance_batch_list_build(const frame_allocator_int* allocator, u32 count, struct geometry_render_data* geometries, instance_batch_list* out_list);
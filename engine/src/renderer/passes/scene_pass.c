@@ -6,6 +6,7 @@
 #include "core/logger.h"
 #include "defines.h"
 #include "math/kmath.h"
+#include "renderer/instance_batch.h"
 #include "renderer/passes/shadow_map_pass.h"
 #include "renderer/renderer_frontend.h"
 #include "renderer/rendergraph.h"
@@ -281,13 +282,27 @@ b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_
             return false;
         }
 
+        // Group draws of the same geometry and material into instanced draws, and upload all of
+        // their model matrices at once.
+        instance_batch_list batches;
+        u64 instance_offset = 0;
+        if (!instance_batch_list_build(&p_frame_data->allocator, geometry_count, ext_data->geometries, &batches)) {
+            DERROR("Failed to prepare instance data for static geometries. Render frame failed.");
+            return false;
+        }
+        if (batches.instance_count > 0 && !renderer_instance_data_upload(sizeof(matrix4) * batches.instance_count, batches.models, &instance_offset)) {
+            // Out of instance space. The renderer grows it before the next frame, so only this frame goes without.
+            batches.batch_count = 0;
+        }
+
         u32 current_material_id = INVALID_ID - 1;
         // Draw geometries.
-        u32 count = ext_data->geometry_count;
-        for (u32 i = 0; i < count; ++i) {
+        for (u32 b = 0; b < batches.batch_count; ++b) {
+            instance_batch* batch = &batches.batches[b];
+            geometry_render_data* g = batch->geometry;
             material* m = 0;
-            if (ext_data->geometries[i].material) {
-                m = ext_data->geometries[i].material;
+            if (g->material) {
+                m = g->material;
             } else {
                 m = material_system_get_default();
             }
@@ -311,19 +326,16 @@ b8 scene_pass_execute(struct rendergraph_pass* self, struct frame_data* p_frame_
                 current_material_id = m->id;
             }
 
-            // Apply the locals
-            material_system_apply_local(m, &ext_data->geometries[i].model, p_frame_data);
-
             // Invert if needed
-            if (ext_data->geometries[i].winding_inverted) {
+            if (g->winding_inverted) {
                 renderer_winding_set(RENDERER_WINDING_CLOCKWISE);
             }
 
-            // Draw it.
-            renderer_geometry_draw(&ext_data->geometries[i]);
+            // Draw every instance. Model matrices come from the instance buffer, so there are no locals.
+            renderer_geometry_draw_instanced(g, instance_offset + sizeof(matrix4) * batch->first_instance, batch->instance_count);
 
             // Change back if needed
-            if (ext_data->geometries[i].winding_inverted) {
+            if (g->winding_inverted) {
                 renderer_winding_set(RENDERER_WINDING_COUNTER_CLOCKWISE);
             }
         }
@@ -6,6 +6,7 @@
 #include "core/logger.h"
 #include "defines.h"
 #include "math/math_types.h"
+#include "renderer/instance_batch.h"
 #include "renderer/renderer_frontend.h"
 #include "renderer/renderer_types.h"
 #include "renderer/rendergraph.h"
@@ -18,6 +19,7 @@
 typedef struct shadow_map_shader_locations {
     u16 projections_location;
     u16 views_location;
+    // Only used by the terrain shader. The standard one takes its model matrices per instance.
     u16 model_location;
     u32 cascade_index_location;
     u16 colour_map_location;
@@ -26,6 +28,8 @@ typedef struct shadow_map_shader_locations {
 typedef struct cascade_resources {
     // One target per frame.
     render_target* targets;
+    // The signature of what was last rendered into each target, or INVALID_ID_U64 if nothing yet.
+    u64* signatures;
 } cascade_resources;
 
 typedef struct shadow_shader_instance_data {
@@ -68,6 +72,54 @@ typedef struct shadow_map_pass_internal_data {
     u8 terrain_instance_draw_index;
 } shadow_map_pass_internal_data;
 
+static u64 signature_mix(u64 hash, u64 value) {
+    hash ^= value;
+    hash *= 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+}
+
+// Mixes in a block of 4-byte values, such as a matrix.
+static u64 signature_mix_block(u64 hash, const void* block, u64 size) {
+    const u32* values = block;
+    for (u64 i = 0; i < size / sizeof(u32); ++i) {
+        hash = signature_mix(hash, values[i]);
+    }
+    return hash;
+}
+
+static u64 signature_mix_geometries(u64 hash, u32 count, const geometry_render_data* geometries) {
+    hash = signature_mix(hash, count);
+    for (u32 i = 0; i < count; ++i) {
+        const geometry_render_data* g = &geometries[i];
+        hash = signature_mix_block(hash, &g->model, sizeof(matrix4));
+        hash = signature_mix(hash, (u64)g->material);
+        if (g->material && g->material->maps && g->material->maps[0].texture) {
+            // The colour map is sampled for transparency, so a reloaded texture changes the result.
+            hash = signature_mix(hash, g->material->maps[0].texture->generation);
+        }
+        hash = signature_mix(hash, g->unique_id);
+        hash = signature_mix(hash, g->winding_inverted);
+        hash = signature_mix(hash, g->vertex_buffer_offset);
+        hash = signature_mix(hash, g->index_buffer_offset);
+        hash = signature_mix(hash, ((u64)g->vertex_count << 32) | g->index_count);
+    }
+    return hash;
+}
+
+/**
+ * @brief Produces a signature of everything that affects what is rendered into a cascade: its
+ * matrices, which follow the light and the camera, and every caster drawn into it.
+ */
+static u64 cascade_signature(const shadow_map_pass_extended_data* ext_data, u32 cascade_index) {
+    const shadow_map_cascade_data* cascade = &ext_data->cascades[cascade_index];
+    u64 hash = signature_mix(0xCBF29CE484222325ull, cascade_index);
+    hash = signature_mix_block(hash, &cascade->projection, sizeof(matrix4));
+    hash = signature_mix_block(hash, &cascade->view, sizeof(matrix4));
+    hash = signature_mix_geometries(hash, cascade->geometry_count, cascade->geometries);
+    hash = signature_mix_geometries(hash, cascade->terrain_geometry_count, cascade->terrain_geometries);
+    return hash;
+}
+
 b8 shadow_map_pass_create(struct rendergraph_pass* self, void* config) {
     if (!self || !config) {
         DERROR("shadow_map_pass_create requires both a pointer to self and a valid config");
@@ -162,7 +214,7 @@ b8 shadow_map_pass_initialize(struct rendergraph_pass* self) {
     }
     internal_data->locations.projections_location = shader_system_uniform_location(internal_data->s, "projections");
     internal_data->locations.views_location = shader_system_uniform_location(internal_data->s, "views");
-    internal_data->locations.model_location = shader_system_uniform_location(internal_data->s, "model");
+    internal_data->locations.model_location = INVALID_ID_U16;
     internal_data->locations.cascade_index_location = shader_system_uniform_location(internal_data->s, "cascade_index");
     internal_data->locations.colour_map_location = shader_system_uniform_location(internal_data->s, "colour_map");
 
@@ -285,7 +337,9 @@ b8 shadow_map_pass_load_resources(struct rendergraph_pass* self) {
         cascade_resources* cascade = &internal_data->cascades[i];
         // Targets per frame
         cascade->targets = kallocate(sizeof(render_target) * frame_count, MEMORY_TAG_ARRAY);
+        cascade->signatures = kallocate(sizeof(u64) * frame_count, MEMORY_TAG_ARRAY);
         for (u32 f = 0; f < frame_count; ++f) {
+            cascade->signatures[f] = INVALID_ID_U64;
             // One render target per pass
             render_target* target = &cascade->targets[f];
             target->attachment_count = 1;
@@ -324,14 +378,26 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
     // Bind the internal viewport - do not use one provided in pass data.
     renderer_active_viewport_set(&internal_data->camera_viewport);
 
+    // Globals are applied by the first cascade actually rendered.
+    b8 globals_applied = false;
+
     for (u32 p = 0; p < MAX_CASCADE_COUNT; ++p) {
-        // shadow_map_cascade_data* cascade = &ext_data->cascades[p];
-        /* if (!renderer_renderpass_begin(&self->pass, &self->pass.targets[p_frame_data->render_target_index])) {
-            DERROR("Shadowmap pass failed to start.");
-            return false;
-        } */
+        shadow_map_cascade_data* cascade = &ext_data->cascades[p];
+        cascade_resources* resources = &internal_data->cascades[p];
+
+        // Far cascades can keep what was last rendered into this frame's target if nothing that
+        // affects them has changed since.
+        if (internal_data->config.cache_far_cascades && p > 0) {
+            u64 signature = cascade_signature(ext_data, p);
+            if (resources->signatures[p_frame_data->render_target_index] == signature) {
+                p_frame_data->drawn_shadow_mesh_count -= p_frame_data->drawn_shadow_cascade_mesh_counts[p];
+                p_frame_data->drawn_shadow_cascade_mesh_counts[p] = 0;
+                continue;
+            }
+            resources->signatures[p_frame_data->render_target_index] = signature;
+        }
 
-        if (!renderer_renderpass_begin(&self->pass, &internal_data->cascades[p].targets[p_frame_data->render_target_index])) {
+        if (!renderer_renderpass_begin(&self->pass, &resources->targets[p_frame_data->render_target_index])) {
             DERROR("Shadowmap pass failed to start.");
             return false;
         }
@@ -339,8 +405,8 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
         // Use the standard shadowmap shader.
         shader_system_use_by_id(internal_data->s->id);
 
-        // Apply globals, once per cascade.
-        b8 needs_update = p == 0;
+        // Apply globals, once per frame.
+        b8 needs_update = !globals_applied;
         if (needs_update) {
             renderer_shader_bind_globals(internal_data->s);
             for (u32 i = 0; i < MAX_CASCADE_COUNT; ++i) {
@@ -356,8 +422,8 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
         }
         shader_system_apply_global(needs_update, p_frame_data);
 
-        u32 geometry_count = ext_data->geometry_count;
-        u32 terrain_geometry_count = ext_data->terrain_geometry_count;
+        u32 geometry_count = cascade->geometry_count;
+        u32 terrain_geometry_count = cascade->terrain_geometry_count;
 
         // Verify enough instance resources for this frame.
         // This is done by taking the highest material instance id
@@ -367,7 +433,7 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
         // of instance updates per frame.
         u32 highest_id = 0;
         for (u32 i = 0; i < geometry_count; ++i) {
-            material* m = ext_data->geometries[i].material;
+            material* m = cascade->geometries[i].material;
             if (m->internal_id > highest_id) {
                 // NOTE: +1 to account for the first id being taken by the default instance.
                 highest_id = m->internal_id + 1;
@@ -410,9 +476,25 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
             internal_data->instance_count = highest_id;
         }
 
+        // Group casters of the same geometry and material into instanced draws, and upload all of
+        // their model matrices at once.
+        instance_batch_list batches;
+        u64 instance_offset = 0;
+        if (!instance_batch_list_build(&p_frame_data->allocator, geometry_count, cascade->geometries, &batches)) {
+            DERROR("Failed to prepare instance data for shadow casters.");
+            return false;
+        }
+        if (batches.instance_count > 0 && !renderer_instance_data_upload(sizeof(matrix4) * batches.instance_count, batches.models, &instance_offset)) {
+            // Out of instance space. The renderer grows it before the next frame, so only this frame goes
+            // without its casters. Forget the signature so the cascade isn't reused with them missing.
+            batches.batch_count = 0;
+            resources->signatures[p_frame_data->render_target_index] = INVALID_ID_U64;
+        }
+
         // Static geometries.
-        for (u32 i = 0; i < geometry_count; ++i) {
-            geometry_render_data* g = &ext_data->geometries[i];
+        for (u32 b = 0; b < batches.batch_count; ++b) {
+            instance_batch* batch = &batches.batches[b];
+            geometry_render_data* g = batch->geometry;
 
             u32 bind_id = INVALID_ID;
             texture_map* bind_map = 0;
@@ -462,22 +544,21 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
             *render_number = p_frame_data->renderer_frame_number;
             *draw_index = p_frame_data->draw_index;
 
-            // Apply the locals
+            // Apply the locals. Model matrices come from the instance buffer.
             shader_system_bind_local();
-            shader_system_uniform_set_by_location(internal_data->locations.model_location, &g->model);
             shader_system_uniform_set_by_location(internal_data->locations.cascade_index_location, &p);
             shader_system_apply_local(p_frame_data);
 
             // Invert if needed
-            if (ext_data->geometries[i].winding_inverted) {
+            if (g->winding_inverted) {
                 renderer_winding_set(RENDERER_WINDING_CLOCKWISE);
             }
 
-            // Draw it.
-            renderer_geometry_draw(g);
+            // Draw every instance.
+            renderer_geometry_draw_instanced(g, instance_offset + sizeof(matrix4) * batch->first_instance, batch->instance_count);
 
             // Change back if needed
-            if (ext_data->geometries[i].winding_inverted) {
+            if (g->winding_inverted) {
                 renderer_winding_set(RENDERER_WINDING_COUNTER_CLOCKWISE);
             }
         }
@@ -501,9 +582,10 @@ b8 shadow_map_pass_execute(struct rendergraph_pass* self, struct frame_data* p_f
             }
         }
         shader_system_apply_global(needs_update, p_frame_data);
+        globals_applied = true;
 
         for (u32 i = 0; i < terrain_geometry_count; ++i) {
-            geometry_render_data* terrain = &ext_data->terrain_geometries[i];
+            geometry_render_data* terrain = &cascade->terrain_geometries[i];
 
             // Just draw these using the default instance and texture map.
             texture_map* bind_map = &internal_data->default_terrain_colour_map;
@@ -563,6 +645,7 @@ void shadow_map_pass_destroy(struct rendergraph_pass* self) {
                     renderer_render_target_destroy(target, true);
                 }
                 kfree(cascade->targets, sizeof(render_target) * attachment_count, MEMORY_TAG_ARRAY);
+                kfree(cascade->signatures, sizeof(u64) * attachment_count, MEMORY_TAG_ARRAY);
             }
 
             for (u8 i = 0; i < attachment_count; ++i) {
@@ -1,37 +1,43 @@
 #ifndef _SHADOW_MAP_PASS_H_
 #define _SHADOW_MAP_PASS_H_
 
+#include "core/frame_data.h"
 #include "defines.h"
 #include "math/math_types.h"
 #include "renderer/renderer_types.h"
 
 struct rendergraph_pass;
 struct rendergraph_source;
-struct frame_data;
 struct texture;
 
-#define MAX_CASCADE_COUNT 4
+#define MAX_CASCADE_COUNT MAX_SHADOW_CASCADE_COUNT
 
 typedef struct shadow_map_cascade_data {
     matrix4 projection;
     matrix4 view;
     f32 split_depth;
     i32 cascade_index;
+
+    // The casters culled against this cascade's volume.
+    u32 geometry_count;
+    struct geometry_render_data* geometries;
+
+    // The terrain chunks culled against this cascade's volume.
+    u32 terrain_geometry_count;
+    struct geometry_render_data* terrain_geometries;
 } shadow_map_cascade_data;
 
 typedef struct shadow_map_pass_extended_data {
     struct directional_light* light;
     // Per-cascade data.
     shadow_map_cascade_data cascades[MAX_CASCADE_COUNT];
-
-    u32 terrain_geometry_count;
-    struct geometry_render_data* terrain_geometries;
-    u32 geometry_count;
-    struct geometry_render_data* geometries;
 } shadow_map_pass_extended_data;
 
 typedef struct shadow_map_pass_config {
     u16 resolution;
+    // If set, every cascade but the nearest keeps what was last rendered into it while its
+    // matrices and casters are unchanged, instead of being rendered again.
+    b8 cache_far_cascades;
 } shadow_map_pass_config;
 
 API b8 shadow_map_pass_create(struct rendergraph_pass* self, void* config);
@@ -0,0 +1,79 @@
+#include "render_queue.h"
+
+#include "core/kmemory.h"
+#include "utils/ksort.h"
+
+#define RENDER_KEY_LAYER_SHIFT 62
+#define RENDER_KEY_SHADER_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 20
+#define RENDER_KEY_OPAQUE_DEPTH_BITS 29
+#define RENDER_KEY_TRANSPARENT_DEPTH_BITS 30
+
+// The bits of a non-negative float order the same way as its value.
+static u32 depth_bits(f32 depth) {
+    union {
+        f32 f;
+        u32 u;
+    } bits;
+    bits.f = depth > 0.0f ? depth : 0.0f;
+    return bits.u;
+}
+
+u64 render_key_create(render_key_layer layer, u32 shader_id, u32 material_id, b8 winding_inverted, f32 depth) {
+    u64 shader = shader_id & ((1u << RENDER_KEY_SHADER_BITS) - 1);
+    u64 material = material_id & ((1u << RENDER_KEY_MATERIAL_BITS) - 1);
+    u64 key = (u64)layer << RENDER_KEY_LAYER_SHIFT;
+
+    if (layer == RENDER_KEY_LAYER_TRANSPARENT) {
+        // Back to front, so the depth is inverted and comes first.
+        u64 depth_key = (~depth_bits(depth) >> (32 - RENDER_KEY_TRANSPARENT_DEPTH_BITS)) & ((1u << RENDER_KEY_TRANSPARENT_DEPTH_BITS) - 1);
+        key |= depth_key << (RENDER_KEY_SHADER_BITS + RENDER_KEY_MATERIAL_BITS);
+        key |= shader << RENDER_KEY_MATERIAL_BITS;
+        key |= material;
+    } else {
+        // The sign bit is always clear, so the top 29 of the remaining 31 bits are kept.
+        u64 depth_key = depth_bits(depth) >> (31 - RENDER_KEY_OPAQUE_DEPTH_BITS);
+        key |= shader << (RENDER_KEY_MATERIAL_BITS + 1 + RENDER_KEY_OPAQUE_DEPTH_BITS);
+        key |= material << (1 + RENDER_KEY_OPAQUE_DEPTH_BITS);
+        key |= (u64)(winding_inverted ? 1 : 0) << RENDER_KEY_OPAQUE_DEPTH_BITS;
+        key |= depth_key;
+    }
+    return key;
+}
+
+void render_queue_create(const frame_allocator_int* allocator, u32 capacity, render_queue* out_queue) {
+    out_queue->allocator = allocator;
+    out_queue->count = 0;
+    out_queue->capacity = KMAX(capacity, 16);
+    out_queue->keys = allocator->allocate(sizeof(u64) * out_queue->capacity);
+    out_queue->indices = allocator->allocate(sizeof(u32) * out_queue->capacity);
+}
+
+void render_queue_push(render_queue* queue, u64 key, u32 index) {
+    if (queue->count == queue->capacity) {
+        u32 new_capacity = queue->capacity * 2;
+        u64* keys = queue->allocator->allocate(sizeof(u64) * new_capacity);
+        u32* indices = queue->allocator->allocate(sizeof(u32) * new_capacity);
+        kcopy_memory(keys, queue->keys, sizeof(u64) * queue->count);
+        kcopy_memory(indices, queue->indices, sizeof(u32) * queue->count);
+        queue->allocator->free(queue->keys, sizeof(u64) * queue->capacity);
+        queue->allocator->free(queue->indices, sizeof(u32) * queue->capacity);
+        queue->keys = keys;
+        queue->indices = indices;
+        queue->capacity = new_capacity;
+    }
+    queue->keys[queue->count] = key;
+    queue->indices[queue->count] = index;
+    queue->count++;
+}
+
+void render_queue_sort(render_queue* queue) {
+    if (queue->count < 2) {
+        return;
+    }
+    u64* scratch_keys = queue->allocator->allocate(sizeof(u64) * queue->count);
+    u32* scratch_indices = queue->allocator->allocate(sizeof(u32) * queue->count);
+    kradix_sort_u64(queue->keys, queue->indices, queue->count, scratch_keys, scratch_indices);
+    queue->allocator->free(scratch_keys, sizeof(u64) * queue->count);
+    queue->allocator->free(scratch_indices, sizeof(u32) * queue->count);
+}
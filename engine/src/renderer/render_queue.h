@@ -0,0 +1,84 @@
+/**
+ * @file render_queue.h
+ * @brief A per-frame queue of draws, ordered by packed 64-bit sort keys.
+ *
+ * @details
+ * Each draw is pushed as a key and the index of its render data, and the
+ * queue is sorted with a radix sort over those pairs. The render data itself
+ * never moves while sorting; it is copied once, in order, afterward.
+ *
+ * Keys are laid out so that the most important state change is in the
+ * highest bits:
+ *
+ * Opaque:      | layer:2 | shader:12 | material:20 | winding:1 | depth:29 |
+ * Transparent: | layer:2 | inverted depth:30 | shader:12 | material:20 |
+ *
+ * Opaque draws are grouped by shader and material, then drawn front to back.
+ * Transparent draws come after all opaque ones and are drawn back to front.
+ */
+
+#pragma once
+
+#include "core/frame_data.h"
+#include "defines.h"
+
+/** @brief The layer a draw belongs to, in the order layers are drawn. */
+typedef enum render_key_layer {
+    RENDER_KEY_LAYER_OPAQUE = 0,
+    RENDER_KEY_LAYER_TRANSPARENT = 1
+} render_key_layer;
+
+/**
+ * @brief A queue of sort keys and the indices of the draws they belong to.
+ * All storage comes from a frame allocator, so there is nothing to destroy.
+ */
+typedef struct render_queue {
+    /** @brief The number of draws in the queue. */
+    u32 count;
+    /** @brief The number of draws that can be held before growing. */
+    u32 capacity;
+    /** @brief The sort key of each draw. */
+    u64* keys;
+    /** @brief The index of each draw, as given when pushed. */
+    u32* indices;
+    /** @brief The frame allocator storage is taken from. */
+    const frame_allocator_int* allocator;
+} render_queue;
+
+/**
+ * @brief Packs the given draw state into a sort key.
+ *
+ * @param layer The layer the draw belongs to.
+ * @param shader_id The id of the shader used. Only the low 12 bits are used.
+ * @param material_id The id of the material used. Only the low 20 bits are used.
+ * @param winding_inverted Indicates if the draw uses inverted winding.
+ * @param depth The distance from the view. Negative values are treated as 0.
+ * @return The sort key.
+ */
+API u64 render_key_create(render_key_layer layer, u32 shader_id, u32 material_id, b8 winding_inverted, f32 depth);
+
+/**
+ * @brief Creates a render queue using the given frame allocator.
+ *
+ * @param allocator A constant pointer to the frame allocator to take storage from.
+ * @param capacity The number of draws to reserve room for. Grows as needed.
+ * @param out_queue A pointer to hold the created queue.
+ */
+API void render_queue_create(const frame_allocator_int* allocator, u32 capacity, render_queue* out_queue);
+
+/**
+ * @brief Adds a draw to the queue, growing it if needed.
+ *
+ * @param queue A pointer to the queue.
+ * @param key The sort key of the draw.
+ * @param index The index of the draw's render data.
+ */
+API void render_queue_push(render_queue* queue, u64 key, u32 index);
+
+/**
+ * @brief Sorts the queue by key, so that indices lists the draws in the order
+ * they should be drawn. Draws with equal keys keep the order they were pushed in.
+ *
+ * @param queue A pointer to the queue.
+ */
+API void render_queue_sort(render_queue* queue);
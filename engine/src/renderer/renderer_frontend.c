@@ -38,6 +38,18 @@ typedef struct renderer_system_state {
     renderbuffer geometry_vertex_buffer;
     /** @brief The object index buffer, used to hold geometry indices. */
     renderbuffer geometry_index_buffer;
+    /** @brief The per-instance data buffer, with one region per render target, rewritten every frame. */
+    renderbuffer instance_buffer;
+    /** @brief The size of each render target's region of the instance buffer. */
+    u64 instance_region_size;
+    /** @brief The end of the current frame's region of the instance buffer. */
+    u64 instance_region_end;
+    /** @brief The instance space the current frame asked for, including any uploads that did not fit. */
+    u64 instance_space_requested;
+    /** @brief Set once growing the instance buffer has failed, so it is not retried every frame. */
+    b8 instance_growth_failed;
+    /** @brief The number of geometry draw calls issued so far this frame. */
+    u32 draw_call_count;
 } renderer_system_state;
 
 b8 renderer_system_initialize(u64* memory_requirement, void* state, void* config) {
@@ -96,6 +108,21 @@ b8 renderer_system_initialize(u64* memory_requirement, void* state, void* config
     }
     renderer_renderbuffer_bind(&state_ptr->geometry_index_buffer, 0);
 
+    // Instance buffer, with one region per render target so a frame never overwrites data an earlier
+    // one is still reading. Each region starts with room for 256K model matrices, far more than a
+    // typical frame uploads. A frame that needs more grows every region before the next frame (see
+    // renderer_frame_prepare), so this is only a starting size, not a limit.
+    kzero_memory(bufname, 256);
+    string_format(bufname, "renderbuffer_instancebuffer_global");
+    state_ptr->instance_region_size = sizeof(matrix4) * 256 * 1024;
+    const u64 instance_buffer_size = state_ptr->instance_region_size * state_ptr->window_render_target_count;
+    if (!renderer_renderbuffer_create(bufname, RENDERBUFFER_TYPE_INSTANCE, instance_buffer_size, RENDERBUFFER_TRACK_TYPE_LINEAR, &state_ptr->instance_buffer)) {
+        DERROR("Error creating instance buffer.");
+        return false;
+    }
+    renderer_renderbuffer_bind(&state_ptr->instance_buffer, 0);
+    state_ptr->instance_region_end = state_ptr->instance_region_size;
+
     return true;
 }
 
@@ -108,6 +135,7 @@ void renderer_system_shutdown(void* state) {
         // Destroy buffers.
         renderer_renderbuffer_destroy(&typed_state->geometry_vertex_buffer);
         renderer_renderbuffer_destroy(&typed_state->geometry_index_buffer);
+        renderer_renderbuffer_destroy(&typed_state->instance_buffer);
 
         // Shutdown the plugin
         typed_state->plugin.shutdown(&typed_state->plugin);
@@ -153,6 +181,23 @@ b8 renderer_frame_prepare(struct frame_data* p_frame_data) {
     // Reset the draw index for this frame.
     state_ptr->plugin.draw_index = 0;
 
+    // If the last frame ran out of instance space, grow every region to fit it before anything is
+    // recorded against the buffer. The resize waits for the device, so no earlier frame is still reading it.
+    if (state_ptr->instance_space_requested > state_ptr->instance_region_size && !state_ptr->instance_growth_failed) {
+        u64 new_region_size = state_ptr->instance_region_size;
+        while (new_region_size < state_ptr->instance_space_requested) {
+            new_region_size *= 2;
+        }
+        DWARN("Instance buffer ran out of space (%llu bytes requested per frame). Growing each region from %llu to %llu bytes.", state_ptr->instance_space_requested, state_ptr->instance_region_size, new_region_size);
+        if (renderer_renderbuffer_resize(&state_ptr->instance_buffer, new_region_size * state_ptr->window_render_target_count)) {
+            state_ptr->instance_region_size = new_region_size;
+        } else {
+            DERROR("Failed to grow the instance buffer. Instanced draws that do not fit will be skipped.");
+            state_ptr->instance_growth_failed = true;
+        }
+    }
+    state_ptr->instance_space_requested = 0;
+
     b8 result = state_ptr->plugin.frame_prepare(&state_ptr->plugin, p_frame_data);
 
     // Update the frame data with renderer info.
@@ -160,6 +205,12 @@ b8 renderer_frame_prepare(struct frame_data* p_frame_data) {
     p_frame_data->renderer_frame_number = state_ptr->plugin.frame_number;
     p_frame_data->draw_index = state_ptr->plugin.draw_index;
     p_frame_data->render_target_index = attachment_index;
+    p_frame_data->draw_call_count = state_ptr->draw_call_count;
+    state_ptr->draw_call_count = 0;
+
+    // Instance data for this frame goes in its render target's region.
+    state_ptr->instance_buffer.offset = state_ptr->instance_region_size * attachment_index;
+    state_ptr->instance_region_end = state_ptr->instance_buffer.offset + state_ptr->instance_region_size;
 
     return result;
 }
@@ -290,6 +341,8 @@ renderbuffer* renderer_renderbuffer_get(renderbuffer_type type) {
             return &state_ptr->geometry_vertex_buffer;
         case RENDERBUFFER_TYPE_INDEX:
             return &state_ptr->geometry_index_buffer;
+        case RENDERBUFFER_TYPE_INSTANCE:
+            return &state_ptr->instance_buffer;
         default:
             DERROR("Unsupported buffer type %u", type);
             return 0;
@@ -426,6 +479,7 @@ void renderer_geometry_destroy(geometry* g) {
 void renderer_geometry_draw(geometry_render_data* data) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     b8 includes_index_data = data->index_count > 0;
+    state_ptr->draw_call_count++;
     if (!renderer_renderbuffer_draw(&state_ptr->geometry_vertex_buffer, data->vertex_buffer_offset, data->vertex_count, includes_index_data)) {
         DERROR("vulkan_renderer_draw_geometry failed to draw vertex buffer;");
         return;
@@ -439,6 +493,45 @@ void renderer_geometry_draw(geometry_render_data* data) {
     }
 }
 
+b8 renderer_instance_data_upload(u64 size, const void* data, u64* out_offset) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    if (!size || !data || !out_offset) {
+        DERROR("renderer_instance_data_upload requires a nonzero size, valid data and a valid pointer to hold the offset.");
+        return false;
+    }
+
+    // Track everything asked for, so the next frame can grow the buffer to fit it.
+    state_ptr->instance_space_requested += size;
+
+    renderbuffer* buffer = &state_ptr->instance_buffer;
+    if (buffer->offset + size > state_ptr->instance_region_end) {
+        return false;
+    }
+
+    renderer_renderbuffer_allocate(buffer, size, out_offset);
+    return renderer_renderbuffer_load_range(buffer, *out_offset, size, data, false);
+}
+
+void renderer_geometry_draw_instanced(geometry_render_data* data, u64 instance_offset, u32 instance_count) {
+    renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
+    renderer_plugin* plugin = &state_ptr->plugin;
+    state_ptr->draw_call_count++;
+    if (data->index_count > 0) {
+        // Bind the vertices, then draw by index.
+        if (!renderer_renderbuffer_draw(&state_ptr->geometry_vertex_buffer, data->vertex_buffer_offset, data->vertex_count, true)) {
+            DERROR("renderer_geometry_draw_instanced failed to bind vertex buffer.");
+            return;
+        }
+        if (!plugin->renderbuffer_draw_instanced(plugin, &state_ptr->geometry_index_buffer, data->index_buffer_offset, data->index_count, &state_ptr->instance_buffer, instance_offset, instance_count)) {
+            DERROR("renderer_geometry_draw_instanced failed to draw index buffer.");
+        }
+    } else {
+        if (!plugin->renderbuffer_draw_instanced(plugin, &state_ptr->geometry_vertex_buffer, data->vertex_buffer_offset, data->vertex_count, &state_ptr->instance_buffer, instance_offset, instance_count)) {
+            DERROR("renderer_geometry_draw_instanced failed to draw vertex buffer.");
+        }
+    }
+}
+
 b8 renderer_renderpass_begin(renderpass* pass, render_target* target) {
     renderer_system_state* state_ptr = (renderer_system_state*)systems_manager_get_state(K_SYSTEM_TYPE_RENDERER);
     return state_ptr->plugin.renderpass_begin(&state_ptr->plugin, pass, target);
@@ -827,9 +920,10 @@ b8 renderer_renderbuffer_create(const char* name, renderbuffer_type type, u64 to
 
     // Create the freelist, if needed.
     if (track_type == RENDERBUFFER_TRACK_TYPE_FREELIST) {
-        freelist_create(total_size, &out_buffer->freelist_memory_requirement, 0, 0);
+        // TLSF, so allocation cost doesn't grow as large scenes fragment the buffer.
+        freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &out_buffer->freelist_memory_requirement, 0, 0);
         out_buffer->freelist_block = kallocate(out_buffer->freelist_memory_requirement, MEMORY_TAG_RENDERER);
-        freelist_create(total_size, &out_buffer->freelist_memory_requirement, out_buffer->freelist_block, &out_buffer->buffer_freelist);
+        freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &out_buffer->freelist_memory_requirement, out_buffer->freelist_block, &out_buffer->buffer_freelist);
     } else if (track_type == RENDERBUFFER_TRACK_TYPE_LINEAR) {
         out_buffer->offset = 0;
     }
@@ -912,7 +1006,7 @@ b8 renderer_renderbuffer_resize(renderbuffer* buffer, u64 new_total_size) {
     if (buffer->track_type == RENDERBUFFER_TRACK_TYPE_FREELIST) {
         // Resize the freelist first, if used.
         u64 new_memory_requirement = 0;
-        freelist_resize(&buffer->buffer_freelist, &new_memory_requirement, 0, 0, 0);
+        freelist_resize(&buffer->buffer_freelist, &new_memory_requirement, 0, new_total_size, 0);
         void* new_block = kallocate(new_memory_requirement, MEMORY_TAG_RENDERER);
         void* old_block = 0;
         if (!freelist_resize(&buffer->buffer_freelist, &new_memory_requirement, new_block, new_total_size, &old_block)) {
@@ -284,6 +284,29 @@ API void renderer_geometry_destroy(geometry* geometry);
  */
 API void renderer_geometry_draw(geometry_render_data* data);
 
+/**
+ * @brief Uploads per-instance data for the current frame to the renderer's instance buffer.
+ * The data is only valid for the current frame. If the frame's instance space runs out, nothing
+ * is uploaded and the buffer is grown before the next frame, so callers should skip the draws
+ * that needed the data rather than fail the frame.
+ *
+ * @param size The size of the data in bytes.
+ * @param data A constant pointer to the data to upload.
+ * @param out_offset A pointer to hold the offset of the data in the instance buffer.
+ * @return True on success; otherwise false, such as when the frame's instance space has run out.
+ */
+API b8 renderer_instance_data_upload(u64 size, const void* data, u64* out_offset);
+
+/**
+ * @brief Draws the given geometry once per instance, using instanced shaders' per-instance
+ * model matrices from the instance buffer. Should only be called inside a renderpass, within a frame.
+ *
+ * @param data The render data of the geometry to be drawn. Its model matrix is not used.
+ * @param instance_offset The offset of the first instance's data, as obtained from renderer_instance_data_upload.
+ * @param instance_count The number of instances to draw.
+ */
+API void renderer_geometry_draw_instanced(geometry_render_data* data, u64 instance_offset, u32 instance_count);
+
 /**
  * @brief Begins the given renderpass.
  *
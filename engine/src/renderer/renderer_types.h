@@ -218,7 +218,9 @@ typedef enum renderbuffer_type {
     /** @brief Buffer is used for reading purposes (i.e copy to from device local, then read) */
     RENDERBUFFER_TYPE_READ,
     /** @brief Buffer is used for data storage. */
-    RENDERBUFFER_TYPE_STORAGE
+    RENDERBUFFER_TYPE_STORAGE,
+    /** @brief Buffer is used for per-instance vertex data, written by the host every frame. */
+    RENDERBUFFER_TYPE_INSTANCE
 } renderbuffer_type;
 
 typedef enum renderbuffer_track_type {
@@ -959,6 +961,23 @@ typedef struct renderer_plugin {
      */
     b8 (*renderbuffer_draw)(struct renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u32 element_count, b8 bind_only);
 
+    /**
+     * @brief Attempts to draw the contents of the provided buffer at the given offset
+     * and element count once per instance, reading per-instance data from the given
+     * instance buffer. When drawing an index buffer, the vertex buffer must have been
+     * bound first.
+     *
+     * @param plugin A pointer to the renderer plugin interface.
+     * @param buffer A pointer to the vertex or index buffer to be drawn.
+     * @param offset The offset in bytes from the beginning of the buffer.
+     * @param element_count The number of elements to be drawn.
+     * @param instance_buffer A pointer to the buffer holding per-instance data.
+     * @param instance_offset The offset in bytes of the first instance's data.
+     * @param instance_count The number of instances to be drawn.
+     * @return True on success; otherwise false.
+     */
+    b8 (*renderbuffer_draw_instanced)(struct renderer_plugin* plugin, renderbuffer* buffer, u64 offset, u32 element_count, renderbuffer* instance_buffer, u64 instance_offset, u32 instance_count);
+
     /**
      * Waits for the renderer backend to be completely idle of work before returning.
      * NOTE: This incurs a lot of overhead/waits, and should be used sparingly.
@@ -0,0 +1,552 @@
+#include "ksm_file.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "math/geometry_utils.h"
+#include "math/kmath.h"
+#include "systems/geometry_system.h"
+
+/** @brief The fixed header at the start of a version 3 or later file. */
+typedef struct ksm_header {
+    /** @brief The file version. First, as in every version, so all can be told apart by it. */
+    u16 version;
+    /** @brief The size of this header, so it can grow in later versions. */
+    u16 header_size;
+    /** @brief The number of geometries, and entries in the geometry table. */
+    u32 geometry_count;
+    /** @brief The size of the whole file in bytes, to catch truncated files. */
+    u64 file_size;
+    /** @brief The offset of the geometry table from the start of the file. */
+    u64 geometry_table_offset;
+    /** @brief The offset of the mesh name, which is null-terminated. */
+    u64 name_offset;
+    /** @brief The length of the mesh name, including the terminator. */
+    u32 name_length;
+    /** @brief The average cache miss ratio of the index data, over all geometries. Added in version 4. */
+    f32 acmr;
+    /** @brief The average transform to vertex ratio of the index data, over all geometries. Added in version 4. */
+    f32 atvr;
+    /** @brief The number of entries in the level of detail table. Added in version 5. */
+    u32 lod_count;
+    /** @brief The offset of the level of detail table, which holds the levels of each geometry in turn. Added in version 5. */
+    u64 lod_table_offset;
+} ksm_header;
+
+/** @brief The size of the header of a version 3 file, which ends before the statistics. */
+#define KSM_HEADER_SIZE_V3 40
+/** @brief The size of the header of a version 4 file, which ends before the level of detail table. */
+#define KSM_HEADER_SIZE_V4 48
+
+/** @brief An entry in the geometry table of a version 3 or later file. Offsets are from the start of the file. */
+typedef struct ksm_geometry_entry {
+    u64 vertex_offset;
+    u64 index_offset;
+    u64 name_offset;
+    u64 material_name_offset;
+    u32 vertex_size;
+    u32 vertex_count;
+    u32 index_size;
+    u32 index_count;
+    /** @brief The length of the geometry name, including the terminator. */
+    u32 name_length;
+    /** @brief The length of the material name, including the terminator. */
+    u32 material_name_length;
+    vec3 center;
+    vec3 min_extents;
+    vec3 max_extents;
+    /** @brief The number of the geometry's levels of detail in the level of detail table. Added in version 5; 0 if it has none. */
+    u32 lod_count;
+} ksm_geometry_entry;
+
+/** @brief An entry in the level of detail table of a version 5 or later file. */
+typedef struct ksm_lod_entry {
+    /** @brief The offset of the level's first index, in indices from the start of the geometry's index data. */
+    u32 index_offset;
+    u32 index_count;
+    f32 error;
+} ksm_lod_entry;
+
+STATIC_ASSERT(sizeof(ksm_header) == 56, "Expected ksm_header to be 56 bytes");
+STATIC_ASSERT(sizeof(ksm_geometry_entry) == 96, "Expected ksm_geometry_entry to be 96 bytes");
+STATIC_ASSERT(sizeof(ksm_lod_entry) == 12, "Expected ksm_lod_entry to be 12 bytes");
+
+// The size of the header written for the given version.
+static u32 ksm_header_size(u16 version) {
+    if (version == 0x0003U) {
+        return KSM_HEADER_SIZE_V3;
+    } else if (version == 0x0004U) {
+        return KSM_HEADER_SIZE_V4;
+    }
+    return sizeof(ksm_header);
+}
+
+// The number of indices written for the given geometry. Versions without levels of detail only get the full detail.
+static u32 ksm_index_count(const geometry_config *g, u16 version) {
+    return (version < 0x0005U && g->lod_count > 0) ? g->lods[0].index_count : g->index_count;
+}
+
+static u64 ksm_align(u64 offset) {
+    return (offset + KSM_BLOB_ALIGNMENT - 1) & ~((u64)KSM_BLOB_ALIGNMENT - 1);
+}
+
+// Checks that a range of the given size at the given offset lies within the file.
+static b8 ksm_range_valid(const file_mapping *mapping, u64 offset, u64 size) {
+    return offset <= mapping->size && size <= mapping->size - offset;
+}
+
+// Copies a null-terminated string out of the file, failing if it does not fit or is not terminated.
+static b8 ksm_string_copy(const file_mapping *mapping, u64 offset, u32 length, char *out_string, u32 capacity) {
+    if (length == 0 || length > capacity || !ksm_range_valid(mapping, offset, length)) {
+        return false;
+    }
+    const char *source = (const char *)mapping->data + offset;
+    if (source[length - 1] != 0) {
+        return false;
+    }
+    kcopy_memory(out_string, source, length);
+    return true;
+}
+
+static b8 load_v3(const char *path, ksm_file *file) {
+    const file_mapping *mapping = &file->mapping;
+    u32 expected_header_size = ksm_header_size(file->version);
+    if (mapping->size < expected_header_size) {
+        DERROR("KSM file '%s' is too small to hold a header.", path);
+        return false;
+    }
+    const ksm_header *header = mapping->data;
+    if (header->header_size < expected_header_size || header->file_size != mapping->size) {
+        DERROR("KSM file '%s' has an invalid header or is truncated (expected %llu bytes, found %llu).", path, header->file_size, mapping->size);
+        return false;
+    }
+    if ((header->geometry_table_offset % sizeof(u64)) != 0 ||
+        !ksm_range_valid(mapping, header->geometry_table_offset, (u64)header->geometry_count * sizeof(ksm_geometry_entry))) {
+        DERROR("KSM file '%s' has an invalid geometry table.", path);
+        return false;
+    }
+    if (file->version >= 0x0004U) {
+        file->acmr = header->acmr;
+        file->atvr = header->atvr;
+    }
+    u32 lod_table_count = file->version >= 0x0005U ? header->lod_count : 0;
+    if (lod_table_count && ((header->lod_table_offset % sizeof(u32)) != 0 ||
+                            !ksm_range_valid(mapping, header->lod_table_offset, (u64)lod_table_count * sizeof(ksm_lod_entry)))) {
+        DERROR("KSM file '%s' has an invalid level of detail table.", path);
+        return false;
+    }
+    const ksm_lod_entry *lod_entries = lod_table_count ? (const ksm_lod_entry *)((const u8 *)mapping->data + header->lod_table_offset) : 0;
+    u32 lod_table_position = 0;
+
+    file->geometries = darray_reserve(geometry_config, header->geometry_count);
+    const ksm_geometry_entry *entries = (const ksm_geometry_entry *)((const u8 *)mapping->data + header->geometry_table_offset);
+    for (u32 i = 0; i < header->geometry_count; ++i) {
+        const ksm_geometry_entry *e = &entries[i];
+        u64 vertices_size = (u64)e->vertex_size * e->vertex_count;
+        u64 indices_size = (u64)e->index_size * e->index_count;
+        if ((e->vertex_offset % KSM_BLOB_ALIGNMENT) != 0 || (e->index_offset % KSM_BLOB_ALIGNMENT) != 0 ||
+            !ksm_range_valid(mapping, e->vertex_offset, vertices_size) || !ksm_range_valid(mapping, e->index_offset, indices_size)) {
+            DERROR("KSM file '%s' has invalid data ranges for geometry %u.", path, i);
+            return false;
+        }
+
+        geometry_config g = {0};
+        if (!ksm_string_copy(mapping, e->name_offset, e->name_length, g.name, GEOMETRY_NAME_MAX_LENGTH) ||
+            !ksm_string_copy(mapping, e->material_name_offset, e->material_name_length, g.material_name, MATERIAL_NAME_MAX_LENGTH)) {
+            DERROR("KSM file '%s' has invalid names for geometry %u.", path, i);
+            return false;
+        }
+
+        // Point straight into the mapping.
+        g.vertex_size = e->vertex_size;
+        g.vertex_count = e->vertex_count;
+        g.vertices = vertices_size ? (void *)((const u8 *)mapping->data + e->vertex_offset) : 0;
+        g.index_size = e->index_size;
+        g.index_count = e->index_count;
+        g.indices = indices_size ? (void *)((const u8 *)mapping->data + e->index_offset) : 0;
+        g.center = e->center;
+        g.min_extents = e->min_extents;
+        g.max_extents = e->max_extents;
+
+        if (file->version >= 0x0005U && e->lod_count > 0) {
+            if (e->lod_count > GEOMETRY_MAX_LODS || e->lod_count > lod_table_count - lod_table_position) {
+                DERROR("KSM file '%s' has too many levels of detail for geometry %u.", path, i);
+                return false;
+            }
+            for (u32 l = 0; l < e->lod_count; ++l) {
+                const ksm_lod_entry *lod = &lod_entries[lod_table_position++];
+                if (lod->index_offset > e->index_count || lod->index_count > e->index_count - lod->index_offset) {
+                    DERROR("KSM file '%s' has an invalid level of detail for geometry %u.", path, i);
+                    return false;
+                }
+                g.lods[l].index_offset = lod->index_offset;
+                g.lods[l].index_count = lod->index_count;
+                g.lods[l].error = lod->error;
+            }
+            g.lod_count = e->lod_count;
+        }
+
+        darray_push(file->geometries, g);
+    }
+
+    return true;
+}
+
+// Reads a length-prefixed string of a version 1 or 2 file.
+static b8 read_legacy_string(file_handle *f, char *out_string, u32 capacity) {
+    u64 bytes_read = 0;
+    u32 length = 0;
+    if (!filesystem_read(f, sizeof(u32), &length, &bytes_read) || length > capacity) {
+        return false;
+    }
+    return filesystem_read(f, sizeof(char) * length, out_string, &bytes_read);
+}
+
+static b8 load_legacy(file_handle *f, u16 version, ksm_file *file) {
+    u64 bytes_read = 0;
+
+    // Name + terminator
+    char name[256];
+    if (!read_legacy_string(f, name, 256)) {
+        return false;
+    }
+
+    // Geometry count
+    u32 geometry_count = 0;
+    if (!filesystem_read(f, sizeof(u32), &geometry_count, &bytes_read)) {
+        return false;
+    }
+
+    // Handles backward compatability for
+    u64 extent_size = sizeof(vec3);
+    if (version == 0x0001U) {
+        extent_size = sizeof(vertex_3d);
+    }
+
+    // Each geometry
+    file->geometries = darray_create(geometry_config);
+    for (u32 i = 0; i < geometry_count; ++i) {
+        geometry_config g = {0};
+
+        // Vertices (size/count/array)
+        filesystem_read(f, sizeof(u32), &g.vertex_size, &bytes_read);
+        filesystem_read(f, sizeof(u32), &g.vertex_count, &bytes_read);
+        g.vertices = kallocate(g.vertex_size * g.vertex_count, MEMORY_TAG_ARRAY);
+        filesystem_read(f, g.vertex_size * g.vertex_count, g.vertices, &bytes_read);
+
+        // Indices (size/count/array)
+        filesystem_read(f, sizeof(u32), &g.index_size, &bytes_read);
+        filesystem_read(f, sizeof(u32), &g.index_count, &bytes_read);
+        g.indices = kallocate(g.index_size * g.index_count, MEMORY_TAG_ARRAY);
+        filesystem_read(f, g.index_size * g.index_count, g.indices, &bytes_read);
+
+        // Names
+        b8 names_read = read_legacy_string(f, g.name, GEOMETRY_NAME_MAX_LENGTH) &&
+                        read_legacy_string(f, g.material_name, MATERIAL_NAME_MAX_LENGTH);
+
+        // Center, then extents (min/max). Version 1 stored these as whole vertices.
+        vertex_3d extents[3];
+        b8 extents_read = filesystem_read(f, extent_size, &extents[0], &bytes_read) &&
+                          filesystem_read(f, extent_size, &extents[1], &bytes_read) &&
+                          filesystem_read(f, extent_size, &extents[2], &bytes_read);
+        g.center = extents[0].position;
+        g.min_extents = extents[1].position;
+        g.max_extents = extents[2].position;
+
+        // Add to the output array, so it is disposed of along with the others on failure.
+        darray_push(file->geometries, g);
+        if (!names_read || !extents_read) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+b8 ksm_file_load(const char *path, ksm_file *out_file) {
+    kzero_memory(out_file, sizeof(ksm_file));
+
+    // Map the file, then tell the versions apart by the version at the start of every file.
+    if (!filesystem_map(path, &out_file->mapping)) {
+        DERROR("Unable to open KSM file '%s'.", path);
+        return false;
+    }
+    if (out_file->mapping.size < sizeof(u16)) {
+        DERROR("KSM file '%s' is empty.", path);
+        ksm_file_unload(out_file);
+        return false;
+    }
+    out_file->version = *(const u16 *)out_file->mapping.data;
+
+    b8 result = false;
+    if (out_file->version >= 0x0003U && out_file->version <= KSM_VERSION_CURRENT) {
+        result = load_v3(path, out_file);
+    } else if (out_file->version == 0x0001U || out_file->version == 0x0002U) {
+        // Older versions are streamed and copied out, so the mapping is not needed.
+        filesystem_unmap(&out_file->mapping);
+        file_handle f;
+        if (filesystem_open(path, FILE_MODE_READ, true, &f)) {
+            u16 version = 0;
+            u64 bytes_read = 0;
+            result = filesystem_read(&f, sizeof(u16), &version, &bytes_read) && load_legacy(&f, version, out_file);
+            filesystem_close(&f);
+        }
+    } else {
+        DERROR("KSM file '%s' has an unsupported version %u.", path, out_file->version);
+    }
+
+    if (!result) {
+        DERROR("Failed to load KSM file '%s'.", path);
+        ksm_file_unload(out_file);
+        return false;
+    }
+    return true;
+}
+
+void ksm_file_unload(ksm_file *file) {
+    if (file->geometries) {
+        u32 count = darray_length(file->geometries);
+        for (u32 i = 0; i < count; ++i) {
+            geometry_config *g = &file->geometries[i];
+            if (file->mapping.data) {
+                // The data belongs to the mapping.
+                kzero_memory(g, sizeof(geometry_config));
+            } else {
+                geometry_system_config_dispose(g);
+            }
+        }
+        darray_destroy(file->geometries);
+        file->geometries = 0;
+    }
+    filesystem_unmap(&file->mapping);
+    file->version = 0;
+}
+
+static b8 write_legacy(file_handle *f, const char *name, u32 geometry_count, const geometry_config *geometries) {
+    const u16 version = 0x0002U;
+    u64 written = 0;
+    b8 result = true;
+
+    // Version
+    result &= filesystem_write(f, sizeof(u16), &version, &written);
+
+    // Name length
+    u32 name_length = string_length(name) + 1;
+    result &= filesystem_write(f, sizeof(u32), &name_length, &written);
+    // Name + terminator
+    result &= filesystem_write(f, sizeof(char) * name_length, name, &written);
+
+    // Geometry count
+    result &= filesystem_write(f, sizeof(u32), &geometry_count, &written);
+
+    // Each geometry
+    for (u32 i = 0; i < geometry_count; ++i) {
+        const geometry_config *g = &geometries[i];
+
+        // Vertices (size/count/array)
+        result &= filesystem_write(f, sizeof(u32), &g->vertex_size, &written);
+        result &= filesystem_write(f, sizeof(u32), &g->vertex_count, &written);
+        result &= filesystem_write(f, g->vertex_size * g->vertex_count, g->vertices, &written);
+
+        // Indices (size/count/array)
+        u32 index_count = ksm_index_count(g, version);
+        result &= filesystem_write(f, sizeof(u32), &g->index_size, &written);
+        result &= filesystem_write(f, sizeof(u32), &index_count, &written);
+        result &= filesystem_write(f, g->index_size * index_count, g->indices, &written);
+
+        // Name
+        u32 g_name_length = string_length(g->name) + 1;
+        result &= filesystem_write(f, sizeof(u32), &g_name_length, &written);
+        result &= filesystem_write(f, sizeof(char) * g_name_length, g->name, &written);
+
+        // Material Name
+        u32 m_name_length = string_length(g->material_name) + 1;
+        result &= filesystem_write(f, sizeof(u32), &m_name_length, &written);
+        result &= filesystem_write(f, sizeof(char) * m_name_length, g->material_name, &written);
+
+        // Center
+        result &= filesystem_write(f, sizeof(vec3), &g->center, &written);
+
+        // Extents (min/max)
+        result &= filesystem_write(f, sizeof(vec3), &g->min_extents, &written);
+        result &= filesystem_write(f, sizeof(vec3), &g->max_extents, &written);
+    }
+
+    return result;
+}
+
+// Measures the vertex cache use of the geometries as if drawn one after another, each starting with a cold cache.
+static void ksm_analyze_vertex_cache(u32 geometry_count, const geometry_config *geometries, f32 *out_acmr, f32 *out_atvr) {
+    f64 misses = 0;
+    f64 triangles = 0;
+    f64 vertices = 0;
+    for (u32 i = 0; i < geometry_count; ++i) {
+        const geometry_config *g = &geometries[i];
+        // Only the full detail is measured.
+        u32 index_count = g->lod_count > 0 ? g->lods[0].index_count : g->index_count;
+        if (g->index_size != sizeof(u32) || index_count < 3) {
+            continue;
+        }
+        f32 acmr = 0;
+        f32 atvr = 0;
+        geometry_analyze_vertex_cache(g->vertex_count, index_count, (const u32 *)g->indices + (g->lod_count > 0 ? g->lods[0].index_offset : 0), GEOMETRY_VERTEX_CACHE_SIZE, &acmr, &atvr);
+        f64 geometry_misses = (f64)acmr * (index_count / 3);
+        misses += geometry_misses;
+        triangles += index_count / 3;
+        vertices += atvr > 0 ? geometry_misses / atvr : 0;
+    }
+    *out_acmr = triangles > 0 ? (f32)(misses / triangles) : 0.0f;
+    *out_atvr = vertices > 0 ? (f32)(misses / vertices) : 0.0f;
+}
+
+static b8 write_v3(file_handle *f, const char *name, u32 geometry_count, const geometry_config *geometries, u16 version) {
+    // Lay out the header, table and names, which are small and written in one go.
+    u32 header_size = ksm_header_size(version);
+    u64 table_offset = ksm_align(header_size);
+    u32 lod_count = 0;
+    if (version >= 0x0005U) {
+        for (u32 i = 0; i < geometry_count; ++i) {
+            lod_count += geometries[i].lod_count;
+        }
+    }
+    u64 lod_table_offset = table_offset + sizeof(ksm_geometry_entry) * geometry_count;
+    u64 names_offset = lod_table_offset + sizeof(ksm_lod_entry) * lod_count;
+    u64 offset = names_offset;
+    ksm_header header = {0};
+    header.version = version;
+    header.header_size = header_size;
+    if (version >= 0x0004U) {
+        ksm_analyze_vertex_cache(geometry_count, geometries, &header.acmr, &header.atvr);
+    }
+    if (version >= 0x0005U) {
+        header.lod_count = lod_count;
+        header.lod_table_offset = lod_table_offset;
+    }
+    header.geometry_count = geometry_count;
+    header.geometry_table_offset = table_offset;
+    header.name_offset = offset;
+    header.name_length = string_length(name) + 1;
+    offset += header.name_length;
+
+    ksm_geometry_entry *entries = kallocate(sizeof(ksm_geometry_entry) * (geometry_count ? geometry_count : 1), MEMORY_TAG_ARRAY);
+    ksm_lod_entry *lods = kallocate(sizeof(ksm_lod_entry) * (lod_count ? lod_count : 1), MEMORY_TAG_ARRAY);
+    u32 lod_position = 0;
+    for (u32 i = 0; i < geometry_count; ++i) {
+        const geometry_config *g = &geometries[i];
+        ksm_geometry_entry *e = &entries[i];
+        if (version >= 0x0005U) {
+            e->lod_count = g->lod_count;
+            for (u32 l = 0; l < g->lod_count; ++l) {
+                lods[lod_position].index_offset = g->lods[l].index_offset;
+                lods[lod_position].index_count = g->lods[l].index_count;
+                lods[lod_position].error = g->lods[l].error;
+                lod_position++;
+            }
+        }
+        e->name_offset = offset;
+        e->name_length = string_length(g->name) + 1;
+        offset += e->name_length;
+        e->material_name_offset = offset;
+        e->material_name_length = string_length(g->material_name) + 1;
+        offset += e->material_name_length;
+    }
+
+    // Then the vertex and index data of each geometry, each aligned.
+    for (u32 i = 0; i < geometry_count; ++i) {
+        const geometry_config *g = &geometries[i];
+        ksm_geometry_entry *e = &entries[i];
+        e->vertex_size = g->vertex_size;
+        e->vertex_count = g->vertex_count;
+        e->vertex_offset = ksm_align(offset);
+        offset = e->vertex_offset + (u64)g->vertex_size * g->vertex_count;
+        e->index_size = g->index_size;
+        e->index_count = ksm_index_count(g, version);
+        e->index_offset = ksm_align(offset);
+        offset = e->index_offset + (u64)g->index_size * e->index_count;
+        e->center = g->center;
+        e->min_extents = g->min_extents;
+        e->max_extents = g->max_extents;
+    }
+    header.file_size = offset;
+
+    static const u8 zeros[KSM_BLOB_ALIGNMENT] = {0};
+    u64 written = 0;
+    u64 position = 0;
+    b8 result = filesystem_write(f, header_size, &header, &written);
+    result &= filesystem_write(f, table_offset - header_size, zeros, &written);
+    result &= filesystem_write(f, sizeof(ksm_geometry_entry) * geometry_count, entries, &written);
+    result &= filesystem_write(f, sizeof(ksm_lod_entry) * lod_count, lods, &written);
+    result &= filesystem_write(f, header.name_length, name, &written);
+    for (u32 i = 0; i < geometry_count; ++i) {
+        result &= filesystem_write(f, entries[i].name_length, geometries[i].name, &written);
+        result &= filesystem_write(f, entries[i].material_name_length, geometries[i].material_name, &written);
+    }
+    position = names_offset + header.name_length;
+    for (u32 i = 0; i < geometry_count; ++i) {
+        position += entries[i].name_length + entries[i].material_name_length;
+    }
+    for (u32 i = 0; i < geometry_count; ++i) {
+        const geometry_config *g = &geometries[i];
+        const ksm_geometry_entry *e = &entries[i];
+        u64 vertices_size = (u64)g->vertex_size * g->vertex_count;
+        u64 indices_size = (u64)g->index_size * e->index_count;
+        result &= filesystem_write(f, e->vertex_offset - position, zeros, &written);
+        result &= filesystem_write(f, vertices_size, g->vertices, &written);
+        position = e->vertex_offset + vertices_size;
+        result &= filesystem_write(f, e->index_offset - position, zeros, &written);
+        result &= filesystem_write(f, indices_size, g->indices, &written);
+        position = e->index_offset + indices_size;
+    }
+
+    kfree(lods, sizeof(ksm_lod_entry) * (lod_count ? lod_count : 1), MEMORY_TAG_ARRAY);
+    kfree(entries, sizeof(ksm_geometry_entry) * (geometry_count ? geometry_count : 1), MEMORY_TAG_ARRAY);
+    return result;
+}
+
+b8 ksm_file_write(const char *path, const char *name, u32 geometry_count, const geometry_config *geometries, u16 version) {
+    if (version < 0x0002U || version > KSM_VERSION_CURRENT) {
+        DERROR("ksm_file_write - Version %u cannot be written. Only versions 2 to %u are supported.", version, KSM_VERSION_CURRENT);
+        return false;
+    }
+    if (filesystem_exists(path)) {
+        DINFO("File '%s' already exists and will be overwritten.", path);
+    }
+
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
+        DERROR("Unable to open file '%s' for writing. KSM write failed.", path);
+        return false;
+    }
+
+    b8 result = version >= 0x0003U ? write_v3(&f, name, geometry_count, geometries, version) : write_legacy(&f, name, geometry_count, geometries);
+    filesystem_close(&f);
+
+    if (!result) {
+        DERROR("Failed to write KSM file '%s'.", path);
+    }
+    return result;
+}
+
+b8 ksm_file_upgrade(const char *path, const char *name, ksm_file *file) {
+    if (file->version >= KSM_VERSION_CURRENT) {
+        return true;
+    }
+
+    // Write next to the original, which may still be mapped and backing the geometries.
+    char temp_path[512];
+    string_format(temp_path, "%s.tmp", path);
+    b8 written = ksm_file_write(temp_path, name, darray_length(file->geometries), file->geometries, KSM_VERSION_CURRENT);
+    if (!written) {
+        DWARN("Failed to upgrade KSM file '%s'. It will be loaded as is.", path);
+        filesystem_delete(temp_path);
+        return true;
+    }
+
+    ksm_file_unload(file);
+    if (!filesystem_rename(temp_path, path)) {
+        DWARN("Failed to replace KSM file '%s' with its upgrade. It will be loaded as is.", path);
+        filesystem_delete(temp_path);
+    }
+    return ksm_file_load(path, file);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file ksm_file.h
+ * @author DOD
+ * @brief Reading and writing of KSM (binary static mesh) files.
+ *
+ * @details
+ * Versions 1 and 2 are a stream of variable-length fields, which must be read
+ * one at a time and copied out into allocated arrays.
+ *
+ * Version 3 is laid out to be used in place. A fixed header is followed by a
+ * table with one fixed-size entry per geometry, then the names, then the
+ * vertex and index data of every geometry, each aligned to
+ * KSM_BLOB_ALIGNMENT. The file is memory-mapped and the geometry configs
+ * point straight into the mapping, so nothing is copied until the data is
+ * handed to the renderer.
+ *
+ * Version 4 adds the vertex cache statistics of the index data to the header,
+ * as measured by geometry_analyze_vertex_cache, so that the effect of the
+ * import-time optimizations can be checked without re-importing. The layout is
+ * otherwise that of version 3.
+ *
+ * Version 5 adds a table of the levels of detail of each geometry, which are
+ * ranges of its index data. Older versions only hold the full detail.
+ *
+ * All values are stored in the byte order of the machine which wrote them.
+ *
+ * @version 1.0
+ *
+ * @copyright DOD Game Engine is Copyright (c) DOD 2024
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "platform/filesystem.h"
+
+struct geometry_config;
+
+/** @brief The version of KSM files written by the importer. */
+#define KSM_VERSION_CURRENT 0x0005U
+
+/** @brief The alignment of each vertex and index array in a version 3 or later file. */
+#define KSM_BLOB_ALIGNMENT 16
+
+/** @brief A loaded KSM file. */
+typedef struct ksm_file {
+    /** @brief The version the file was written with. */
+    u16 version;
+    /** @brief A darray of the file's geometry configs. */
+    struct geometry_config *geometries;
+    /**
+     * @brief The average cache miss ratio of the index data over all geometries: vertices
+     * transformed per triangle, with a cache of GEOMETRY_VERTEX_CACHE_SIZE. 0 if not recorded,
+     * as in files older than version 4.
+     */
+    f32 acmr;
+    /** @brief The average transform to vertex ratio of the index data over all geometries. 0 if not recorded. */
+    f32 atvr;
+    /**
+     * @brief The mapping of a version 3 or later file. The vertex and index data of its geometries point
+     * into this, so it must be kept until they are no longer needed. Unused for older versions,
+     * whose geometries own their data.
+     */
+    file_mapping mapping;
+} ksm_file;
+
+/**
+ * @brief Loads the KSM file at the given path. Version 3 and later files are mapped, older versions
+ * are read. The vertex and index data of a mapped file is read-only, as it points into the mapping.
+ *
+ * @param path The path of the file.
+ * @param out_file A pointer to hold the loaded file. Must be unloaded with ksm_file_unload.
+ * @return True on success; otherwise false.
+ */
+API b8 ksm_file_load(const char *path, ksm_file *out_file);
+
+/**
+ * @brief Unloads the given file, releasing its geometry configs and mapping.
+ *
+ * @param file A pointer to the file to unload.
+ */
+API void ksm_file_unload(ksm_file *file);
+
+/**
+ * @brief Writes the given geometries to a KSM file.
+ *
+ * @param path The path of the file to write. Overwritten if it exists.
+ * @param name The name of the mesh.
+ * @param geometry_count The number of geometries.
+ * @param geometries An array of the geometries to write.
+ * @param version The version to write, from 2 to KSM_VERSION_CURRENT; typically the latter.
+ * @return True on success; otherwise false.
+ */
+API b8 ksm_file_write(const char *path, const char *name, u32 geometry_count, const struct geometry_config *geometries, u16 version);
+
+/**
+ * @brief Rewrites a loaded file older than KSM_VERSION_CURRENT at the current version, in place,
+ * then loads it again. The geometries of a mapped file point into the file being replaced, so the
+ * new one is written alongside it and only moved over it once the old one has been unloaded. If
+ * the upgrade fails, the file is loaded again as it was.
+ *
+ * @param path The path the file was loaded from.
+ * @param name The name of the mesh.
+ * @param file A pointer to the loaded file. Updated to the upgraded file.
+ * @return True if the file is loaded afterwards, whether or not it was upgraded; false if it could
+ * not be loaded again, in which case it is left unloaded.
+ */
+API b8 ksm_file_upgrade(const char *path, const char *name, ksm_file *file);
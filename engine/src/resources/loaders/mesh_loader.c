@@ -6,7 +6,9 @@
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
+#include "ksm_file.h"
 #include "loader_utils.h"
+#include "obj_file.h"
 #include "math/geometry_utils.h"
 #include "math/kmath.h"
 #include "platform/filesystem.h"
@@ -26,31 +28,10 @@ typedef struct supported_mesh_filetype {
     b8 is_binary;
 } supported_mesh_filetype;
 
-typedef struct mesh_vertex_index_data {
-    u32 position_index;
-    u32 normal_index;
-    u32 texcoord_index;
-} mesh_vertex_index_data;
-
-typedef struct mesh_face_data {
-    mesh_vertex_index_data vertices[3];
-} mesh_face_data;
-
-typedef struct mesh_group_data {
-    // darray
-    mesh_face_data *faces;
-} mesh_group_data;
-
-static b8 import_obj_file(file_handle *obj_file, const char *out_ksm_filename,
+static b8 import_obj_file(const char *obj_filename, const char *out_ksm_filename,
                           geometry_config **out_geometries_darray);
-static void process_subobject(vec3 *positions, vec3 *normals, vec2 *tex_coords,
-                              mesh_face_data *faces, geometry_config *out_data);
 static b8 import_obj_material_library_file(const char *mtl_file_path);
 
-static b8 load_ksm_file(file_handle *ksm_file,
-                        geometry_config **out_geometries_darray);
-static b8 write_ksm_file(const char *path, const char *name, u32 geometry_count,
-                         geometry_config *geometries);
 static b8 write_kmt_file(const char *directory, material_config *config);
 
 static b8 mesh_loader_load(struct resource_loader *self, const char *name,
@@ -60,7 +41,6 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
     }
 
     char *format_str = "%s/%s/%s%s";
-    file_handle f;
     // Supported extensions. Note that these are in order of priority when looked
     // up. This is to prioritize the loading of a binary version of the mesh,
     // followed by importing various types of meshes to binary types, which would
@@ -80,13 +60,10 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
     for (u32 i = 0; i < SUPPORTED_FILETYPE_COUNT; ++i) {
         string_format(full_file_path, format_str, resource_system_base_path(),
                       self->type_path, name, supported_filetypes[i].extension);
-        // If the file exists, open it and stop looking.
+        // If the file exists, stop looking. Both KSM and OBJ files are mapped rather than opened.
         if (filesystem_exists(full_file_path)) {
-            if (filesystem_open(full_file_path, FILE_MODE_READ,
-                                supported_filetypes[i].is_binary, &f)) {
-                type = supported_filetypes[i].type;
-                break;
-            }
+            type = supported_filetypes[i].type;
+            break;
         }
     }
 
@@ -98,7 +75,7 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
     out_resource->full_path = string_duplicate(full_file_path);
 
     // The resource data is just an array of configs.
-    geometry_config *resource_data = darray_create(geometry_config);
+    geometry_config *resource_data = 0;
 
     b8 result = false;
     switch (type) {
@@ -107,12 +84,33 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
             char ksm_file_name[512];
             string_format(ksm_file_name, "%s/%s/%s%s", resource_system_base_path(),
                           self->type_path, name, ".ksm");
-            result = import_obj_file(&f, ksm_file_name, &resource_data);
+            result = import_obj_file(full_file_path, ksm_file_name, &resource_data);
             break;
         }
-        case MESH_FILE_TYPE_KSM:
-            result = load_ksm_file(&f, &resource_data);
+        case MESH_FILE_TYPE_KSM: {
+            // The configs point into the file's mapping, so it is kept with the resource until unloaded.
+            ksm_file *file = kallocate(sizeof(ksm_file), MEMORY_TAG_RESOURCE);
+            result = ksm_file_load(full_file_path, file);
+            if (!result) {
+                kfree(file, sizeof(ksm_file), MEMORY_TAG_RESOURCE);
+                break;
+            }
+            // Upgrade older files, so they can be mapped from the next run on.
+            if (file->version < KSM_VERSION_CURRENT) {
+                DINFO("Upgrading KSM file '%s' from version %u to %u.", full_file_path, file->version, KSM_VERSION_CURRENT);
+                result = ksm_file_upgrade(full_file_path, name, file);
+                if (!result) {
+                    kfree(file, sizeof(ksm_file), MEMORY_TAG_RESOURCE);
+                    break;
+                }
+            }
+            if (file->acmr > 0) {
+                DDEBUG("Mesh '%s' has a vertex cache miss ratio of %.3f (%.3f per vertex).", name, file->acmr, file->atvr);
+            }
+            resource_data = file->geometries;
+            out_resource->loader_data = file;
             break;
+        }
         default:
         case MESH_FILE_TYPE_NOT_FOUND:
             DERROR("Unable to find mesh of supported type called '%s'.", name);
@@ -120,11 +118,8 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
             break;
     }
 
-    filesystem_close(&f);
-
     if (!result) {
         DERROR("Failed to process mesh file '%s'.", full_file_path);
-        darray_destroy(resource_data);
         out_resource->data = 0;
         out_resource->data_size = 0;
         return false;
@@ -139,6 +134,16 @@ static b8 mesh_loader_load(struct resource_loader *self, const char *name,
 
 static void mesh_loader_unload(struct resource_loader *self,
                                resource *resource) {
+    if (resource->loader_data) {
+        // Loaded from a KSM file, which owns the configs.
+        ksm_file_unload(resource->loader_data);
+        kfree(resource->loader_data, sizeof(ksm_file), MEMORY_TAG_RESOURCE);
+        resource->loader_data = 0;
+        resource->data = 0;
+        resource->data_size = 0;
+        return;
+    }
+
     u32 count = darray_length(resource->data);
     for (u32 i = 0; i < count; ++i) {
         geometry_config *config = &((geometry_config *)resource->data)[i];
@@ -149,357 +154,35 @@ static void mesh_loader_unload(struct resource_loader *self,
     resource->data_size = 0;
 }
 
-static b8 load_ksm_file(file_handle *ksm_file,
-                        geometry_config **out_geometries_darray) {
-    // Version
-    u64 bytes_read = 0;
-    u16 version = 0;
-    filesystem_read(ksm_file, sizeof(u16), &version, &bytes_read);
-
-    // Name length
-    u32 name_length = 0;
-    filesystem_read(ksm_file, sizeof(u32), &name_length, &bytes_read);
-    // Name + terminator
-    char name[256];
-    filesystem_read(ksm_file, sizeof(char) * name_length, name, &bytes_read);
-
-    // Geometry count
-    u32 geometry_count = 0;
-    filesystem_read(ksm_file, sizeof(u32), &geometry_count, &bytes_read);
-
-    // Each geometry
-    for (u32 i = 0; i < geometry_count; ++i) {
-        geometry_config g = {};
-
-        // Vertices (size/count/array)
-        filesystem_read(ksm_file, sizeof(u32), &g.vertex_size, &bytes_read);
-        filesystem_read(ksm_file, sizeof(u32), &g.vertex_count, &bytes_read);
-        g.vertices = kallocate(g.vertex_size * g.vertex_count, MEMORY_TAG_ARRAY);
-        filesystem_read(ksm_file, g.vertex_size * g.vertex_count, g.vertices,
-                        &bytes_read);
-
-        // Indices (size/count/array)
-        filesystem_read(ksm_file, sizeof(u32), &g.index_size, &bytes_read);
-        filesystem_read(ksm_file, sizeof(u32), &g.index_count, &bytes_read);
-        g.indices = kallocate(g.index_size * g.index_count, MEMORY_TAG_ARRAY);
-        filesystem_read(ksm_file, g.index_size * g.index_count, g.indices,
-                        &bytes_read);
-
-        // Name
-        u32 g_name_length = 0;
-        filesystem_read(ksm_file, sizeof(u32), &g_name_length, &bytes_read);
-        filesystem_read(ksm_file, sizeof(char) * g_name_length, g.name,
-                        &bytes_read);
-
-        // Material Name
-        u32 m_name_length = 0;
-        filesystem_read(ksm_file, sizeof(u32), &m_name_length, &bytes_read);
-        filesystem_read(ksm_file, sizeof(char) * m_name_length, g.material_name,
-                        &bytes_read);
-
-        // Handles backward compatability for
-        u64 extent_size = sizeof(vec3);
-        if (version == 0x0001U) {
-            extent_size = sizeof(vertex_3d);
-        }
-
-        // Center
-        filesystem_read(ksm_file, extent_size, &g.center, &bytes_read);
-
-        // Extents (min/max)
-        filesystem_read(ksm_file, extent_size, &g.min_extents, &bytes_read);
-        filesystem_read(ksm_file, extent_size, &g.max_extents, &bytes_read);
-
-        // Add to the output array.
-        darray_push(*out_geometries_darray, g);
-    }
-
-    filesystem_close(ksm_file);
-
-    return true;
-}
-
-static b8 write_ksm_file(const char *path, const char *name, u32 geometry_count,
-                         geometry_config *geometries) {
-    if (filesystem_exists(path)) {
-        DINFO("File '%s' already exists and will be overwritten.", path);
-    }
-
-    file_handle f;
-    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
-        DERROR("Unable to open file '%s' for writing. KSM write failed.", path);
-        return false;
-    }
-
-    // Version
-    u64 written = 0;
-    u16 version = 0x0002U;
-    filesystem_write(&f, sizeof(u16), &version, &written);
-
-    // Name length
-    u32 name_length = string_length(name) + 1;
-    filesystem_write(&f, sizeof(u32), &name_length, &written);
-    // Name + terminator
-    filesystem_write(&f, sizeof(char) * name_length, name, &written);
-
-    // Geometry count
-    filesystem_write(&f, sizeof(u32), &geometry_count, &written);
-
-    // Each geometry
-    for (u32 i = 0; i < geometry_count; ++i) {
-        geometry_config *g = &geometries[i];
-
-        // Vertices (size/count/array)
-        filesystem_write(&f, sizeof(u32), &g->vertex_size, &written);
-        filesystem_write(&f, sizeof(u32), &g->vertex_count, &written);
-        filesystem_write(&f, g->vertex_size * g->vertex_count, g->vertices,
-                         &written);
-
-        // Indices (size/count/array)
-        filesystem_write(&f, sizeof(u32), &g->index_size, &written);
-        filesystem_write(&f, sizeof(u32), &g->index_count, &written);
-        filesystem_write(&f, g->index_size * g->index_count, g->indices, &written);
-
-        // Name
-        u32 g_name_length = string_length(g->name) + 1;
-        filesystem_write(&f, sizeof(u32), &g_name_length, &written);
-        filesystem_write(&f, sizeof(char) * g_name_length, g->name, &written);
-
-        // Material Name
-        u32 m_name_length = string_length(g->material_name) + 1;
-        filesystem_write(&f, sizeof(u32), &m_name_length, &written);
-        filesystem_write(&f, sizeof(char) * m_name_length, g->material_name,
-                         &written);
-
-        // Center
-        filesystem_write(&f, sizeof(vec3), &g->center, &written);
-
-        // Extents (min/max)
-        filesystem_write(&f, sizeof(vec3), &g->min_extents, &written);
-        filesystem_write(&f, sizeof(vec3), &g->max_extents, &written);
-    }
-
-    filesystem_close(&f);
-
-    return true;
-}
-
 /**
  * @brief Imports an obj file. This reads the obj, creates geometry configs,
  * then calls logic to write those geometries out to a binary ksm file. That
  * file can be used on the next load.
  *
- * @param obj_file A pointer to the obj file handle to be read.
+ * @param obj_filename The path to the obj file to be read.
  * @param out_ksm_filename The path to the ksm file to be written to.
- * @param out_geometries_darray A darray of geometries parsed from the file.
+ * @param out_geometries_darray A pointer to hold a darray of geometries parsed from the file.
  * @return True on success; otherwise false.
  */
-static b8 import_obj_file(file_handle *obj_file, const char *out_ksm_filename,
+static b8 import_obj_file(const char *obj_filename, const char *out_ksm_filename,
                           geometry_config **out_geometries_darray) {
-    // Positions
-    vec3 *positions = darray_reserve(vec3, 16384);
-
-    // Normals
-    vec3 *normals = darray_reserve(vec3, 16384);
-
-    // Normals
-    vec2 *tex_coords = darray_reserve(vec2, 16384);
-
-    // Groups
-    mesh_group_data *groups = darray_reserve(mesh_group_data, 4);
-
-    char material_file_name[512] = "";
-
-    char name[512];
-    kzero_memory(name, sizeof(char) * 512);
-    u8 current_mat_name_count = 0;
-    char material_names[32][64];
-
-    char line_buf[512] = "";
-    char *p = &line_buf[0];
-    u64 line_length = 0;
-
-    // index 0 is previous, 1 is previous before that.
-    char prev_first_chars[2] = {0, 0};
-    while (true) {
-        if (!filesystem_read_line(obj_file, 511, &p, &line_length)) {
-            break;
-        }
-
-        // Skip blank lines.
-        if (line_length < 1) {
-            continue;
-        }
-
-        char first_char = line_buf[0];
-
-        switch (first_char) {
-            case '#':
-                // Skip comments
-                continue;
-            case 'v': {
-                char second_char = line_buf[1];
-                switch (second_char) {
-                    case ' ': {
-                        // Vertex position
-                        vec3 pos;
-                        char t[2];
-                        sscanf(line_buf, "%s %f %f %f", t, &pos.x, &pos.y, &pos.z);
-
-                        darray_push(positions, pos);
-                    } break;
-                    case 'n': {
-                        // Vertex normal
-                        vec3 norm;
-                        char t[2];
-                        sscanf(line_buf, "%s %f %f %f", t, &norm.x, &norm.y, &norm.z);
-
-                        darray_push(normals, norm);
-                    } break;
-                    case 't': {
-                        // Vertex texture coords.
-                        vec2 tex_coord;
-                        char t[2];
-
-                        // NOTE: Ignoring Z if present.
-                        sscanf(line_buf, "%s %f %f", t, &tex_coord.x, &tex_coord.y);
-
-                        darray_push(tex_coords, tex_coord);
-                    } break;
-                }
-            } break;
-            case 's': {
-            } break;
-            case 'f': {
-                // face
-                // f 1/1/1 2/2/2 3/3/3  = pos/tex/norm pos/tex/norm pos/tex/norm
-                mesh_face_data face;
-                char t[2];
-
-                u64 normal_count = darray_length(normals);
-                u64 tex_coord_count = darray_length(tex_coords);
-
-                if (normal_count == 0 || tex_coord_count == 0) {
-                    sscanf(line_buf, "%s %d %d %d", t, &face.vertices[0].position_index,
-                           &face.vertices[1].position_index,
-                           &face.vertices[2].position_index);
-                } else {
-                    sscanf(line_buf, "%s %d/%d/%d %d/%d/%d %d/%d/%d", t,
-                           &face.vertices[0].position_index,
-                           &face.vertices[0].texcoord_index, &face.vertices[0].normal_index,
-
-                           &face.vertices[1].position_index,
-                           &face.vertices[1].texcoord_index, &face.vertices[1].normal_index,
-
-                           &face.vertices[2].position_index,
-                           &face.vertices[2].texcoord_index,
-                           &face.vertices[2].normal_index);
-                }
-                u64 group_index = darray_length(groups) - 1;
-                darray_push(groups[group_index].faces, face);
-            } break;
-            case 'm': {
-                // Material library file.
-                char substr[7];
-
-                sscanf(line_buf, "%s %s", substr, material_file_name);
-
-                // If found, save off the material file name.
-                if (strings_nequali(substr, "mtllib", 6)) {
-                    // TODO: verification
-                }
-            } break;
-            case 'u': {
-                // Any time there is a usemtl, assume a new group.
-                // New named group or smoothing group, all faces coming after should be
-                // added to it.
-                mesh_group_data new_group;
-                new_group.faces = darray_reserve(mesh_face_data, 16384);
-                darray_push(groups, new_group);
-
-                // usemtl
-                // Read the material name.
-                char t[8];
-                sscanf(line_buf, "%s %s", t, material_names[current_mat_name_count]);
-                current_mat_name_count++;
-            } break;
-            case 'g': {
-                u64 group_count = darray_length(groups);
-                // Process each group as a subobject.
-                for (u64 i = 0; i < group_count; ++i) {
-                    geometry_config new_data = {};
-                    string_ncopy(new_data.name, name, 255);
-                    if (i > 0) {
-                        string_append_int(new_data.name, new_data.name, i);
-                    }
-                    string_ncopy(new_data.material_name, material_names[i], 255);
-
-                    process_subobject(positions, normals, tex_coords, groups[i].faces,
-                                      &new_data);
-                    new_data.vertex_count = darray_length(new_data.vertices);
-                    new_data.vertex_size = sizeof(vertex_3d);
-                    new_data.index_count = darray_length(new_data.indices);
-                    new_data.index_size = sizeof(u32);
-
-                    darray_push(*out_geometries_darray, new_data);
-
-                    // Increment the number of objects.
-                    darray_destroy(groups[i].faces);
-                    kzero_memory(material_names[i], 64);
-                }
-
-                current_mat_name_count = 0;
-                darray_clear(groups);
-                kzero_memory(name, 512);
-
-                // Read the name
-                char t[2];
-                sscanf(line_buf, "%s %s", t, name);
-
-            } break;
-        }
-
-        prev_first_chars[1] = prev_first_chars[0];
-        prev_first_chars[0] = first_char;
-    }  // each line
-
-    // Process the remaining group since the last one will not have been trigged
-    // by the finding of a new name.
-    // Process each group as a subobject.
-    u64 group_count = darray_length(groups);
-    for (u64 i = 0; i < group_count; ++i) {
-        geometry_config new_data = {};
-        string_ncopy(new_data.name, name, 255);
-        if (i > 0) {
-            string_append_int(new_data.name, new_data.name, i);
-        }
-        string_ncopy(new_data.material_name, material_names[i], 255);
-
-        process_subobject(positions, normals, tex_coords, groups[i].faces,
-                          &new_data);
-        new_data.vertex_count = darray_length(new_data.vertices);
-        new_data.vertex_size = sizeof(vertex_3d);
-        new_data.index_count = darray_length(new_data.indices);
-        new_data.index_size = sizeof(u32);
-
-        darray_push(*out_geometries_darray, new_data);
-
-        // Increment the number of objects.
-        darray_destroy(groups[i].faces);
+    obj_import_options options = {0};
+    options.optimize = true;
+    options.overdraw_threshold = 1.05f;
+    options.lod_count = GEOMETRY_MAX_LODS;
+    options.lod_max_error = 0.05f;
+    obj_file file;
+    if (!obj_file_import(obj_filename, &options, &file)) {
+        return false;
     }
 
-    darray_destroy(groups);
-    darray_destroy(positions);
-    darray_destroy(normals);
-    darray_destroy(tex_coords);
-
-    if (string_length(material_file_name) > 0) {
+    if (string_length(file.material_file_name) > 0) {
         // Load up the material file
         char full_mtl_path[512];
         kzero_memory(full_mtl_path, sizeof(char) * 512);
         string_directory_from_path(full_mtl_path, out_ksm_filename);
         string_trim(full_mtl_path);
-        string_append_string(full_mtl_path, full_mtl_path, material_file_name);
+        string_append_string(full_mtl_path, full_mtl_path, file.material_file_name);
 
         // Process material library file.
         if (!import_obj_material_library_file(full_mtl_path)) {
@@ -507,130 +190,15 @@ static b8 import_obj_file(file_handle *obj_file, const char *out_ksm_filename,
         }
     }
 
-    // De-duplicate geometry
-    u32 count = darray_length(*out_geometries_darray);
-    for (u64 i = 0; i < count; ++i) {
-        geometry_config *g = &((*out_geometries_darray)[i]);
-        DDEBUG(
-            "Geometry de-duplication process starting on geometry object named "
-            "'%s'...",
-            g->name);
-
-        u32 new_vert_count = 0;
-        vertex_3d *unique_verts = 0;
-        geometry_deduplicate_vertices(g->vertex_count, g->vertices, g->index_count,
-                                      g->indices, &new_vert_count, &unique_verts);
-
-        // Destroy the old, large array...
-        darray_destroy(g->vertices);
-
-        // And replace with the de-duplicated one.
-        g->vertices = unique_verts;
-        g->vertex_count = new_vert_count;
-
-        // Take a copy of the indices as a normal, non-darray
-        u32 *indices = kallocate(sizeof(u32) * g->index_count, MEMORY_TAG_ARRAY);
-        kcopy_memory(indices, g->indices, sizeof(u32) * g->index_count);
-        // Destroy the darray
-        darray_destroy(g->indices);
-        // Replace with the non-darray version.
-        g->indices = indices;
-
-        // Also generate tangents here, this way tangents are also stored in the
-        // output file.
-        geometry_generate_tangents(g->vertex_count, g->vertices, g->index_count,
-                                   g->indices);
-    }
-
     // Output a ksm file, which will be loaded in the future.
-    return write_ksm_file(out_ksm_filename, name, count, *out_geometries_darray);
-}
-
-static void process_subobject(vec3 *positions, vec3 *normals, vec2 *tex_coords,
-                              mesh_face_data *faces,
-                              geometry_config *out_data) {
-    out_data->indices = darray_create(u32);
-    out_data->vertices = darray_create(vertex_3d);
-    b8 extent_set = false;
-    kzero_memory(&out_data->min_extents, sizeof(vec3));
-    kzero_memory(&out_data->max_extents, sizeof(vec3));
-
-    u64 face_count = darray_length(faces);
-    u64 normal_count = darray_length(normals);
-    u64 tex_coord_count = darray_length(tex_coords);
-
-    b8 skip_normals = false;
-    b8 skip_tex_coords = false;
-    if (normal_count == 0) {
-        DWARN("No normals are present in this model.");
-        skip_normals = true;
-    }
-    if (tex_coord_count == 0) {
-        DWARN("No texture coordinates are present in this model.");
-        skip_tex_coords = true;
-    }
-    for (u64 f = 0; f < face_count; ++f) {
-        mesh_face_data face = faces[f];
-
-        // Each vertex
-        for (u64 i = 0; i < 3; ++i) {
-            mesh_vertex_index_data index_data = face.vertices[i];
-            darray_push(out_data->indices, (u32)(i + (f * 3)));
-
-            vertex_3d vert;
-
-            vec3 pos = positions[index_data.position_index - 1];
-            vert.position = pos;
-
-            // Check extents - min
-            if (pos.x < out_data->min_extents.x || !extent_set) {
-                out_data->min_extents.x = pos.x;
-            }
-            if (pos.y < out_data->min_extents.y || !extent_set) {
-                out_data->min_extents.y = pos.y;
-            }
-            if (pos.z < out_data->min_extents.z || !extent_set) {
-                out_data->min_extents.z = pos.z;
-            }
-
-            // Check extents - max
-            if (pos.x > out_data->max_extents.x || !extent_set) {
-                out_data->max_extents.x = pos.x;
-            }
-            if (pos.y > out_data->max_extents.y || !extent_set) {
-                out_data->max_extents.y = pos.y;
-            }
-            if (pos.z > out_data->max_extents.z || !extent_set) {
-                out_data->max_extents.z = pos.z;
-            }
-
-            extent_set = true;
-
-            if (skip_normals) {
-                vert.normal = vec3_create(0, 0, 1);
-            } else {
-                vert.normal = normals[index_data.normal_index - 1];
-            }
-
-            if (skip_tex_coords) {
-                vert.texcoord = vec2_zero();
-            } else {
-                vert.texcoord = tex_coords[index_data.texcoord_index - 1];
-            }
-
-            // TODO: Color. Hardcode to white for now.
-            vert.colour = vec4_one();
-
-            darray_push(out_data->vertices, vert);
-        }
+    if (!ksm_file_write(out_ksm_filename, file.name, darray_length(file.geometries), file.geometries, KSM_VERSION_CURRENT)) {
+        obj_file_destroy(&file);
+        return false;
     }
 
-    // Calculate the center based on the extents.
-    for (u8 i = 0; i < 3; ++i) {
-        out_data->center.elements[i] = (out_data->min_extents.elements[i] +
-                                        out_data->max_extents.elements[i]) /
-                                       2.0f;
-    }
+    // The configs are handed over to the resource.
+    *out_geometries_darray = file.geometries;
+    return true;
 }
 
 // TODO: Load the material library file, and create material definitions from
@@ -0,0 +1,681 @@
+#include "obj_file.h"
+
+#include <stdlib.h>  // strtof
+#include <string.h>  // memchr
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "math/geometry_utils.h"
+#include "math/kmath.h"
+#include "platform/filesystem.h"
+#include "systems/geometry_system.h"
+#include "systems/job_system.h"
+
+// The size of the chunks the file is split into. Each chunk is parsed by one job.
+#define OBJ_CHUNK_SIZE (256 * 1024)
+
+/** @brief The 1-based indices of one corner of a face. 0 where an index is absent. */
+typedef struct obj_corner {
+    u32 position_index;
+    u32 texcoord_index;
+    u32 normal_index;
+} obj_corner;
+
+typedef struct obj_face {
+    obj_corner corners[3];
+} obj_face;
+
+typedef enum obj_line_type {
+    OBJ_LINE_TYPE_OTHER,
+    OBJ_LINE_TYPE_POSITION,
+    OBJ_LINE_TYPE_NORMAL,
+    OBJ_LINE_TYPE_TEXCOORD,
+    OBJ_LINE_TYPE_FACE,
+    OBJ_LINE_TYPE_USEMTL,
+    OBJ_LINE_TYPE_GROUP,
+    OBJ_LINE_TYPE_MTLLIB
+} obj_line_type;
+
+/** @brief A usemtl, g or mtllib statement, which are applied in order once all chunks are parsed. */
+typedef struct obj_statement {
+    obj_line_type type;
+    /** @brief The number of faces before this statement in its chunk. */
+    u32 face_index;
+    /** @brief The first word of the statement's arguments, pointing into the file. Not terminated. */
+    const char *text;
+    u32 length;
+} obj_statement;
+
+typedef struct obj_chunk {
+    const char *start;
+    const char *end;
+    u32 position_count;
+    u32 normal_count;
+    u32 texcoord_count;
+    u32 face_count;
+    u32 statement_count;
+    vec3 *positions;
+    vec3 *normals;
+    vec2 *texcoords;
+    obj_face *faces;
+    obj_statement *statements;
+} obj_chunk;
+
+/** @brief A group of faces started by a usemtl statement. It runs on to the next group. */
+typedef struct obj_group {
+    u32 first_face;
+    char material_name[MATERIAL_NAME_MAX_LENGTH];
+} obj_group;
+
+/** @brief A geometry to be resolved from a range of the file's faces. */
+typedef struct obj_geometry_range {
+    u32 first_face;
+    u32 face_count;
+} obj_geometry_range;
+
+typedef struct obj_import_context {
+    const char *path;
+    obj_import_options options;
+    u32 chunk_count;
+    // The number of chunks allocated, which can be more than were needed.
+    u32 chunk_capacity;
+    obj_chunk *chunks;
+
+    u32 position_count;
+    u32 normal_count;
+    u32 texcoord_count;
+    u32 face_count;
+    vec3 *positions;
+    vec3 *normals;
+    vec2 *texcoords;
+    obj_face *faces;
+
+    // Parallel to the file's geometries.
+    obj_geometry_range *ranges;
+    b8 *results;
+    geometry_config *geometries;
+} obj_import_context;
+
+static b8 obj_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static const char *obj_skip_space(const char *p, const char *end) {
+    while (p < end && obj_is_space(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+static const char *obj_skip_word(const char *p, const char *end) {
+    while (p < end && !obj_is_space(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// Checks if the line starts with the given keyword, followed by whitespace or the end of the line.
+static b8 obj_is_keyword(const char *line, const char *end, const char *keyword, u32 length) {
+    if ((u64)(end - line) < length || !strings_nequal(line, keyword, length)) {
+        return false;
+    }
+    return line + length == end || obj_is_space(line[length]);
+}
+
+static obj_line_type obj_line_classify(const char *line, const char *end) {
+    if (line == end) {
+        return OBJ_LINE_TYPE_OTHER;
+    }
+    switch (line[0]) {
+        case 'v':
+            if (obj_is_keyword(line, end, "v", 1)) {
+                return OBJ_LINE_TYPE_POSITION;
+            }
+            if (obj_is_keyword(line, end, "vn", 2)) {
+                return OBJ_LINE_TYPE_NORMAL;
+            }
+            if (obj_is_keyword(line, end, "vt", 2)) {
+                return OBJ_LINE_TYPE_TEXCOORD;
+            }
+            return OBJ_LINE_TYPE_OTHER;
+        case 'f':
+            return obj_is_keyword(line, end, "f", 1) ? OBJ_LINE_TYPE_FACE : OBJ_LINE_TYPE_OTHER;
+        case 'u':
+            return obj_is_keyword(line, end, "usemtl", 6) ? OBJ_LINE_TYPE_USEMTL : OBJ_LINE_TYPE_OTHER;
+        case 'g':
+            return obj_is_keyword(line, end, "g", 1) ? OBJ_LINE_TYPE_GROUP : OBJ_LINE_TYPE_OTHER;
+        case 'm':
+            return obj_is_keyword(line, end, "mtllib", 6) ? OBJ_LINE_TYPE_MTLLIB : OBJ_LINE_TYPE_OTHER;
+        default:
+            return OBJ_LINE_TYPE_OTHER;
+    }
+}
+
+// Parses a float. Leaves out_value untouched if there is none. A word never starts with
+// whitespace, so strtof cannot run on past the end of the line.
+static const char *obj_parse_f32(const char *p, const char *end, f32 *out_value) {
+    p = obj_skip_space(p, end);
+    if (p == end) {
+        return p;
+    }
+    char *after = 0;
+    f32 value = strtof(p, &after);
+    if (after == p) {
+        return obj_skip_word(p, end);
+    }
+    *out_value = value;
+    return after;
+}
+
+static const char *obj_parse_index(const char *p, const char *end, u32 *out_index) {
+    u32 index = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        index = index * 10 + (u32)(*p - '0');
+        ++p;
+    }
+    *out_index = index;
+    return p;
+}
+
+// Parses a face corner, one of "p", "p/t", "p//n" or "p/t/n".
+static const char *obj_parse_corner(const char *p, const char *end, obj_corner *out_corner) {
+    p = obj_skip_space(p, end);
+    p = obj_parse_index(p, end, &out_corner->position_index);
+    if (p < end && *p == '/') {
+        p = obj_parse_index(p + 1, end, &out_corner->texcoord_index);
+        if (p < end && *p == '/') {
+            p = obj_parse_index(p + 1, end, &out_corner->normal_index);
+        }
+    }
+    return obj_skip_word(p, end);
+}
+
+// Finds the end of the line, excluding its newline.
+static const char *obj_line_end(const char *line, const char *end) {
+    const char *newline = memchr(line, '\n', (u64)(end - line));
+    return newline ? newline : end;
+}
+
+static void obj_chunk_parse(obj_chunk *chunk) {
+    // Count the records first, so each array is allocated once.
+    for (const char *line = chunk->start; line < chunk->end;) {
+        const char *line_end = obj_line_end(line, chunk->end);
+        switch (obj_line_classify(obj_skip_space(line, line_end), line_end)) {
+            case OBJ_LINE_TYPE_POSITION:
+                chunk->position_count++;
+                break;
+            case OBJ_LINE_TYPE_NORMAL:
+                chunk->normal_count++;
+                break;
+            case OBJ_LINE_TYPE_TEXCOORD:
+                chunk->texcoord_count++;
+                break;
+            case OBJ_LINE_TYPE_FACE:
+                chunk->face_count++;
+                break;
+            case OBJ_LINE_TYPE_USEMTL:
+            case OBJ_LINE_TYPE_GROUP:
+            case OBJ_LINE_TYPE_MTLLIB:
+                chunk->statement_count++;
+                break;
+            default:
+                break;
+        }
+        line = line_end + 1;
+    }
+
+    if (chunk->position_count) {
+        chunk->positions = kallocate(sizeof(vec3) * chunk->position_count, MEMORY_TAG_ARRAY);
+    }
+    if (chunk->normal_count) {
+        chunk->normals = kallocate(sizeof(vec3) * chunk->normal_count, MEMORY_TAG_ARRAY);
+    }
+    if (chunk->texcoord_count) {
+        chunk->texcoords = kallocate(sizeof(vec2) * chunk->texcoord_count, MEMORY_TAG_ARRAY);
+    }
+    if (chunk->face_count) {
+        chunk->faces = kallocate(sizeof(obj_face) * chunk->face_count, MEMORY_TAG_ARRAY);
+    }
+    if (chunk->statement_count) {
+        chunk->statements = kallocate(sizeof(obj_statement) * chunk->statement_count, MEMORY_TAG_ARRAY);
+    }
+
+    u32 positions = 0, normals = 0, texcoords = 0, faces = 0, statements = 0;
+    for (const char *line = chunk->start; line < chunk->end;) {
+        const char *line_end = obj_line_end(line, chunk->end);
+        const char *keyword = obj_skip_space(line, line_end);
+        obj_line_type type = obj_line_classify(keyword, line_end);
+        const char *p = obj_skip_word(keyword, line_end);
+        switch (type) {
+            case OBJ_LINE_TYPE_POSITION: {
+                vec3 *position = &chunk->positions[positions++];
+                p = obj_parse_f32(p, line_end, &position->x);
+                p = obj_parse_f32(p, line_end, &position->y);
+                obj_parse_f32(p, line_end, &position->z);
+            } break;
+            case OBJ_LINE_TYPE_NORMAL: {
+                vec3 *normal = &chunk->normals[normals++];
+                p = obj_parse_f32(p, line_end, &normal->x);
+                p = obj_parse_f32(p, line_end, &normal->y);
+                obj_parse_f32(p, line_end, &normal->z);
+            } break;
+            case OBJ_LINE_TYPE_TEXCOORD: {
+                // NOTE: Ignoring Z if present.
+                vec2 *texcoord = &chunk->texcoords[texcoords++];
+                p = obj_parse_f32(p, line_end, &texcoord->x);
+                obj_parse_f32(p, line_end, &texcoord->y);
+            } break;
+            case OBJ_LINE_TYPE_FACE: {
+                obj_face *face = &chunk->faces[faces++];
+                for (u32 i = 0; i < 3; ++i) {
+                    p = obj_parse_corner(p, line_end, &face->corners[i]);
+                }
+            } break;
+            case OBJ_LINE_TYPE_USEMTL:
+            case OBJ_LINE_TYPE_GROUP:
+            case OBJ_LINE_TYPE_MTLLIB: {
+                obj_statement *statement = &chunk->statements[statements++];
+                statement->type = type;
+                statement->face_index = faces;
+                statement->text = obj_skip_space(p, line_end);
+                statement->length = (u32)(obj_skip_word(statement->text, line_end) - statement->text);
+            } break;
+            default:
+                break;
+        }
+        line = line_end + 1;
+    }
+}
+
+static void obj_chunks_parse(u32 start, u32 end, void *userdata) {
+    obj_import_context *context = userdata;
+    for (u32 i = start; i < end; ++i) {
+        obj_chunk_parse(&context->chunks[i]);
+    }
+}
+
+static void obj_chunks_destroy(obj_import_context *context) {
+    for (u32 i = 0; i < context->chunk_count; ++i) {
+        obj_chunk *chunk = &context->chunks[i];
+        if (chunk->positions) {
+            kfree(chunk->positions, sizeof(vec3) * chunk->position_count, MEMORY_TAG_ARRAY);
+        }
+        if (chunk->normals) {
+            kfree(chunk->normals, sizeof(vec3) * chunk->normal_count, MEMORY_TAG_ARRAY);
+        }
+        if (chunk->texcoords) {
+            kfree(chunk->texcoords, sizeof(vec2) * chunk->texcoord_count, MEMORY_TAG_ARRAY);
+        }
+        if (chunk->faces) {
+            kfree(chunk->faces, sizeof(obj_face) * chunk->face_count, MEMORY_TAG_ARRAY);
+        }
+        if (chunk->statements) {
+            kfree(chunk->statements, sizeof(obj_statement) * chunk->statement_count, MEMORY_TAG_ARRAY);
+        }
+    }
+    kfree(context->chunks, sizeof(obj_chunk) * context->chunk_capacity, MEMORY_TAG_ARRAY);
+    context->chunks = 0;
+}
+
+// Copies a word from the file into a null-terminated string, truncating it to fit.
+static void obj_word_copy(char *dest, u32 capacity, const char *text, u32 length) {
+    if (length > capacity - 1) {
+        length = capacity - 1;
+    }
+    kcopy_memory(dest, text, length);
+    dest[length] = 0;
+}
+
+// Faces read before the first usemtl since the last g statement get a group without a material.
+static void obj_groups_open_default(obj_group **groups, u32 block_start, u32 face_index) {
+    if (darray_length(*groups) == 0 && face_index > block_start) {
+        obj_group group = {0};
+        group.first_face = block_start;
+        darray_push(*groups, group);
+    }
+}
+
+// Turns the groups read since the last g statement into geometries.
+static void obj_groups_flush(obj_geometry_range **ranges, geometry_config **geometries, const char *name, obj_group *groups, u32 end_face) {
+    u32 group_count = darray_length(groups);
+    for (u32 i = 0; i < group_count; ++i) {
+        u32 first_face = groups[i].first_face;
+        u32 face_end = i + 1 < group_count ? groups[i + 1].first_face : end_face;
+        if (face_end == first_face) {
+            // Nothing to draw.
+            continue;
+        }
+        obj_geometry_range range = {first_face, face_end - first_face};
+        darray_push(*ranges, range);
+
+        geometry_config config = {0};
+        if (i > 0) {
+            // Leave room for the number.
+            obj_word_copy(config.name, GEOMETRY_NAME_MAX_LENGTH - 12, name, string_length(name));
+            string_append_int(config.name, config.name, i);
+        } else {
+            string_ncopy(config.name, name, GEOMETRY_NAME_MAX_LENGTH - 1);
+        }
+        string_ncopy(config.material_name, groups[i].material_name, MATERIAL_NAME_MAX_LENGTH - 1);
+        darray_push(*geometries, config);
+    }
+}
+
+static b8 obj_corner_resolve(const obj_import_context *context, obj_corner corner, vertex_3d *out_vertex) {
+    if (corner.position_index == 0 || corner.position_index > context->position_count) {
+        DERROR("OBJ file '%s' has a face using position %u, but only %u were read.", context->path, corner.position_index, context->position_count);
+        return false;
+    }
+    out_vertex->position = context->positions[corner.position_index - 1];
+
+    if (corner.normal_index == 0 || context->normal_count == 0) {
+        out_vertex->normal = vec3_create(0, 0, 1);
+    } else if (corner.normal_index <= context->normal_count) {
+        out_vertex->normal = context->normals[corner.normal_index - 1];
+    } else {
+        DERROR("OBJ file '%s' has a face using normal %u, but only %u were read.", context->path, corner.normal_index, context->normal_count);
+        return false;
+    }
+
+    if (corner.texcoord_index == 0 || context->texcoord_count == 0) {
+        out_vertex->texcoord = vec2_zero();
+    } else if (corner.texcoord_index <= context->texcoord_count) {
+        out_vertex->texcoord = context->texcoords[corner.texcoord_index - 1];
+    } else {
+        DERROR("OBJ file '%s' has a face using texture coordinate %u, but only %u were read.", context->path, corner.texcoord_index, context->texcoord_count);
+        return false;
+    }
+
+    // TODO: Color. Hardcode to white for now.
+    out_vertex->colour = vec4_one();
+    out_vertex->tangent = vec3_zero();
+    return true;
+}
+
+static b8 obj_geometry_resolve(const obj_import_context *context, obj_geometry_range range, geometry_config *config) {
+    // Every corner of every face is a vertex until de-duplicated, so the sizes are known up front.
+    u32 vertex_count = range.face_count * 3;
+    vertex_3d *vertices = kallocate_no_zero(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    u32 *indices = kallocate_no_zero(sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+
+    vec3 min_extents = vec3_zero();
+    vec3 max_extents = vec3_zero();
+    for (u32 f = 0; f < range.face_count; ++f) {
+        const obj_face *face = &context->faces[range.first_face + f];
+        for (u32 i = 0; i < 3; ++i) {
+            u32 v = f * 3 + i;
+            if (!obj_corner_resolve(context, face->corners[i], &vertices[v])) {
+                kfree(vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+                kfree(indices, sizeof(u32) * vertex_count, MEMORY_TAG_ARRAY);
+                return false;
+            }
+            indices[v] = v;
+
+            vec3 pos = vertices[v].position;
+            for (u8 e = 0; e < 3; ++e) {
+                if (pos.elements[e] < min_extents.elements[e] || v == 0) {
+                    min_extents.elements[e] = pos.elements[e];
+                }
+                if (pos.elements[e] > max_extents.elements[e] || v == 0) {
+                    max_extents.elements[e] = pos.elements[e];
+                }
+            }
+        }
+    }
+
+    u32 unique_count = 0;
+    vertex_3d *unique_vertices = 0;
+    geometry_deduplicate_vertices(vertex_count, vertices, vertex_count, indices, &unique_count, &unique_vertices);
+    kfree(vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+
+    // Also generate tangents here, this way tangents are also stored in the output file.
+    geometry_generate_tangents(unique_count, unique_vertices, vertex_count, indices);
+
+    // The optimizations only reorder triangles and vertices, so they come after anything which reads them in order.
+    if (context->options.optimize) {
+        geometry_optimize_vertex_cache(unique_count, vertex_count, indices);
+        if (context->options.overdraw_threshold > 0) {
+            geometry_optimize_overdraw(unique_count, unique_vertices, vertex_count, indices, context->options.overdraw_threshold);
+        }
+    }
+
+    config->vertex_size = sizeof(vertex_3d);
+    config->vertex_count = unique_count;
+    config->vertices = unique_vertices;
+    config->index_size = sizeof(u32);
+    config->index_count = vertex_count;
+    config->indices = indices;
+    config->min_extents = min_extents;
+    config->max_extents = max_extents;
+    for (u8 i = 0; i < 3; ++i) {
+        config->center.elements[i] = (min_extents.elements[i] + max_extents.elements[i]) / 2.0f;
+    }
+
+    // Levels of detail are simplified from the full detail as it will be drawn, and share its vertices.
+    if (context->options.lod_count > 1) {
+        geometry_generate_lods(config, context->options.lod_count, context->options.lod_max_error);
+    }
+    // Vertices are ordered last, by their first use in any level.
+    if (context->options.optimize) {
+        geometry_optimize_vertex_fetch(config->vertex_count, config->vertices, config->index_count, config->indices);
+    }
+    return true;
+}
+
+static void obj_geometries_resolve(u32 start, u32 end, void *userdata) {
+    obj_import_context *context = userdata;
+    for (u32 i = start; i < end; ++i) {
+        context->results[i] = obj_geometry_resolve(context, context->ranges[i], &context->geometries[i]);
+    }
+}
+
+// Joins the records of all chunks into single arrays, in file order.
+static void obj_records_join(obj_import_context *context) {
+    for (u32 i = 0; i < context->chunk_count; ++i) {
+        context->position_count += context->chunks[i].position_count;
+        context->normal_count += context->chunks[i].normal_count;
+        context->texcoord_count += context->chunks[i].texcoord_count;
+        context->face_count += context->chunks[i].face_count;
+    }
+    if (context->position_count) {
+        context->positions = kallocate_no_zero(sizeof(vec3) * context->position_count, MEMORY_TAG_ARRAY);
+    }
+    if (context->normal_count) {
+        context->normals = kallocate_no_zero(sizeof(vec3) * context->normal_count, MEMORY_TAG_ARRAY);
+    }
+    if (context->texcoord_count) {
+        context->texcoords = kallocate_no_zero(sizeof(vec2) * context->texcoord_count, MEMORY_TAG_ARRAY);
+    }
+    if (context->face_count) {
+        context->faces = kallocate_no_zero(sizeof(obj_face) * context->face_count, MEMORY_TAG_ARRAY);
+    }
+
+    u32 positions = 0, normals = 0, texcoords = 0, faces = 0;
+    for (u32 i = 0; i < context->chunk_count; ++i) {
+        const obj_chunk *chunk = &context->chunks[i];
+        if (chunk->position_count) {
+            kcopy_memory(context->positions + positions, chunk->positions, sizeof(vec3) * chunk->position_count);
+            positions += chunk->position_count;
+        }
+        if (chunk->normal_count) {
+            kcopy_memory(context->normals + normals, chunk->normals, sizeof(vec3) * chunk->normal_count);
+            normals += chunk->normal_count;
+        }
+        if (chunk->texcoord_count) {
+            kcopy_memory(context->texcoords + texcoords, chunk->texcoords, sizeof(vec2) * chunk->texcoord_count);
+            texcoords += chunk->texcoord_count;
+        }
+        if (chunk->face_count) {
+            kcopy_memory(context->faces + faces, chunk->faces, sizeof(obj_face) * chunk->face_count);
+            faces += chunk->face_count;
+        }
+    }
+}
+
+static void obj_records_destroy(obj_import_context *context) {
+    if (context->positions) {
+        kfree(context->positions, sizeof(vec3) * context->position_count, MEMORY_TAG_ARRAY);
+    }
+    if (context->normals) {
+        kfree(context->normals, sizeof(vec3) * context->normal_count, MEMORY_TAG_ARRAY);
+    }
+    if (context->texcoords) {
+        kfree(context->texcoords, sizeof(vec2) * context->texcoord_count, MEMORY_TAG_ARRAY);
+    }
+    if (context->faces) {
+        kfree(context->faces, sizeof(obj_face) * context->face_count, MEMORY_TAG_ARRAY);
+    }
+}
+
+b8 obj_file_import(const char *path, const obj_import_options *options, obj_file *out_file) {
+    if (!path || !out_file) {
+        return false;
+    }
+    kzero_memory(out_file, sizeof(obj_file));
+
+    file_mapping mapping;
+    if (!filesystem_map(path, &mapping)) {
+        DERROR("Unable to map OBJ file '%s'.", path);
+        return false;
+    }
+    const char *data = mapping.data;
+    const char *data_end = data + mapping.size;
+
+    // A last line without a newline is parsed from a terminated copy, so that strtof cannot
+    // read past the end of the mapping.
+    const char *terminated_end = data_end;
+    while (terminated_end > data && terminated_end[-1] != '\n') {
+        --terminated_end;
+    }
+    u64 tail_length = (u64)(data_end - terminated_end);
+    char *tail = 0;
+    if (tail_length) {
+        tail = kallocate(tail_length + 1, MEMORY_TAG_STRING);
+        kcopy_memory(tail, terminated_end, tail_length);
+    }
+
+    // Split the file into chunks which each start at the beginning of a line.
+    obj_import_context context = {0};
+    context.path = path;
+    if (options) {
+        context.options = *options;
+    }
+    u64 terminated_size = (u64)(terminated_end - data);
+    // Chunks run on to the end of a line, so there may be fewer than this.
+    context.chunk_capacity = (u32)((terminated_size + OBJ_CHUNK_SIZE - 1) / OBJ_CHUNK_SIZE) + 1;
+    context.chunks = kallocate(sizeof(obj_chunk) * context.chunk_capacity, MEMORY_TAG_ARRAY);
+    u32 chunk_count = 0;
+    const char *start = data;
+    while (start < terminated_end) {
+        const char *end = start + OBJ_CHUNK_SIZE < terminated_end ? start + OBJ_CHUNK_SIZE : terminated_end;
+        // Run on to the end of the line.
+        if (end < terminated_end) {
+            end = (const char *)memchr(end - 1, '\n', terminated_end - (end - 1)) + 1;
+        }
+        context.chunks[chunk_count].start = start;
+        context.chunks[chunk_count].end = end;
+        chunk_count++;
+        start = end;
+    }
+    if (tail) {
+        context.chunks[chunk_count].start = tail;
+        context.chunks[chunk_count].end = tail + tail_length;
+        chunk_count++;
+    }
+    context.chunk_count = chunk_count;
+
+    job_parallel_for(chunk_count, 1, obj_chunks_parse, &context);
+    obj_records_join(&context);
+
+    if (context.normal_count == 0) {
+        DWARN("No normals are present in OBJ file '%s'.", path);
+    }
+    if (context.texcoord_count == 0) {
+        DWARN("No texture coordinates are present in OBJ file '%s'.", path);
+    }
+
+    // Apply the statements in file order to lay out the geometries. A new group starts at each
+    // usemtl, and each g turns the groups before it into geometries.
+    context.ranges = darray_create(obj_geometry_range);
+    out_file->geometries = darray_create(geometry_config);
+    obj_group *groups = darray_create(obj_group);
+    u32 face_base = 0;
+    u32 block_start = 0;
+    for (u32 c = 0; c < chunk_count; ++c) {
+        const obj_chunk *chunk = &context.chunks[c];
+        for (u32 s = 0; s < chunk->statement_count; ++s) {
+            const obj_statement *statement = &chunk->statements[s];
+            u32 face_index = face_base + statement->face_index;
+            switch (statement->type) {
+                case OBJ_LINE_TYPE_USEMTL: {
+                    obj_groups_open_default(&groups, block_start, face_index);
+                    obj_group group;
+                    group.first_face = face_index;
+                    obj_word_copy(group.material_name, MATERIAL_NAME_MAX_LENGTH, statement->text, statement->length);
+                    darray_push(groups, group);
+                } break;
+                case OBJ_LINE_TYPE_GROUP: {
+                    obj_groups_open_default(&groups, block_start, face_index);
+                    obj_groups_flush(&context.ranges, &out_file->geometries, out_file->name, groups, face_index);
+                    darray_clear(groups);
+                    block_start = face_index;
+                    obj_word_copy(out_file->name, GEOMETRY_NAME_MAX_LENGTH, statement->text, statement->length);
+                } break;
+                case OBJ_LINE_TYPE_MTLLIB:
+                    obj_word_copy(out_file->material_file_name, sizeof(out_file->material_file_name), statement->text, statement->length);
+                    break;
+                default:
+                    break;
+            }
+        }
+        face_base += chunk->face_count;
+    }
+    // The groups after the last g.
+    obj_groups_open_default(&groups, block_start, context.face_count);
+    obj_groups_flush(&context.ranges, &out_file->geometries, out_file->name, groups, context.face_count);
+    darray_destroy(groups);
+
+    // The statements point into the file, so it is only released once they have been applied.
+    obj_chunks_destroy(&context);
+    if (tail) {
+        kfree(tail, tail_length + 1, MEMORY_TAG_STRING);
+    }
+    filesystem_unmap(&mapping);
+
+    // Resolve the faces of each geometry.
+    u32 geometry_count = darray_length(out_file->geometries);
+    context.geometries = out_file->geometries;
+    b8 result = true;
+    if (geometry_count) {
+        context.results = kallocate(sizeof(b8) * geometry_count, MEMORY_TAG_ARRAY);
+        job_parallel_for(geometry_count, 1, obj_geometries_resolve, &context);
+        for (u32 i = 0; i < geometry_count; ++i) {
+            result = result && context.results[i];
+        }
+        kfree(context.results, sizeof(b8) * geometry_count, MEMORY_TAG_ARRAY);
+    }
+
+    darray_destroy(context.ranges);
+    obj_records_destroy(&context);
+
+    if (!result) {
+        DERROR("Failed to import OBJ file '%s'.", path);
+        obj_file_destroy(out_file);
+        return false;
+    }
+    return true;
+}
+
+void obj_file_destroy(obj_file *file) {
+    if (!file || !file->geometries) {
+        return;
+    }
+    u32 count = darray_length(file->geometries);
+    for (u32 i = 0; i < count; ++i) {
+        geometry_system_config_dispose(&file->geometries[i]);
+    }
+    darray_destroy(file->geometries);
+    file->geometries = 0;
+}
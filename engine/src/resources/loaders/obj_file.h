@@ -0,0 +1,78 @@
+/**
+ * @file obj_file.h
+ * @author DOD
+ * @brief Importing of Wavefront OBJ files.
+ *
+ * @details
+ * The file is memory-mapped and split into chunks at line boundaries. The
+ * chunks are parsed in parallel on the job system, each counting its records
+ * first so that its arrays are allocated once at their final size. The groups
+ * are then laid out in file order, and the faces of each geometry are resolved
+ * into vertex and index arrays, de-duplicated and given tangents, again in
+ * parallel.
+ *
+ * Records are interpreted as the engine always has: a new group starts at
+ * each usemtl, and every g statement turns the groups read so far into
+ * geometries named after the previous g. Only the first three corners of a
+ * face are used, and relative (negative) indices are not supported.
+ *
+ * Optionally, each geometry is then optimized for drawing: its triangles are
+ * reordered for the post-transform vertex cache and then, in clusters, to
+ * reduce overdraw, and its vertices into the order they are fetched. Levels of
+ * detail can also be generated, each a simplified range of the same index data.
+ *
+ * @version 1.0
+ *
+ * @copyright DOD Game Engine is Copyright (c) DOD 2024
+ *
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "resources/resource_types.h"
+
+struct geometry_config;
+
+/** @brief Options for importing an OBJ file. */
+typedef struct obj_import_options {
+    /** @brief Indicates if the triangles and vertices of each geometry should be reordered for drawing. */
+    b8 optimize;
+    /**
+     * @brief When optimizing, the factor the vertex cache miss ratio may grow by to reorder
+     * triangles for less overdraw, such as 1.05. 0 leaves overdraw alone.
+     */
+    f32 overdraw_threshold;
+    /** @brief The greatest number of levels of detail to generate for each geometry, including the full detail. 0 or 1 generates none. */
+    u8 lod_count;
+    /** @brief The furthest any level of detail may stray from the full detail, as a fraction of the size of the geometry. */
+    f32 lod_max_error;
+} obj_import_options;
+
+/** @brief An imported OBJ file. */
+typedef struct obj_file {
+    /** @brief A darray of the file's geometry configs, which own their vertex and index data. */
+    struct geometry_config *geometries;
+    /** @brief The name of the last group in the file, used as the name of the mesh. */
+    char name[GEOMETRY_NAME_MAX_LENGTH];
+    /** @brief The material library named by the file, relative to it. Empty if there is none. */
+    char material_file_name[512];
+} obj_file;
+
+/**
+ * @brief Imports the OBJ file at the given path. Its material library is not read.
+ *
+ * @param path The path of the file.
+ * @param options A pointer to the options to import with. Optional; if 0, the geometries are not optimized.
+ * @param out_file A pointer to hold the imported file. On success, its geometries must either
+ * be taken over or released with obj_file_destroy.
+ * @return True on success; otherwise false.
+ */
+API b8 obj_file_import(const char *path, const obj_import_options *options, obj_file *out_file);
+
+/**
+ * @brief Releases the geometry configs of the given file.
+ *
+ * @param file A pointer to the file to destroy.
+ */
+API void obj_file_destroy(obj_file *file);
@@ -146,6 +146,7 @@ b8 mesh_create(mesh_config config, mesh* out_mesh) {
     out_mesh->generation = INVALID_ID_U8;
     if (config.name) {
         out_mesh->name = string_duplicate(config.name);
+        out_mesh->name_id = kname_create(config.name);
     }
 
     return true;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core/identifier.h"
+#include "core/kname.h"
 #include "math/math_types.h"
 
 #define TERRAIN_MAX_MATERIAL_COUNT 4
@@ -65,6 +66,8 @@ typedef struct resource {
     u64 data_size;
     /** @brief The resource data. */
     void *data;
+    /** @brief Loader-specific data kept until the resource is unloaded, such as a file mapping the data points into. */
+    void *loader_data;
 } resource;
 
 /**
@@ -295,11 +298,30 @@ typedef struct system_font_resource_data {
 /** @brief The maximum length of a material name. */
 #define MATERIAL_NAME_MAX_LENGTH 256
 
+/** @brief The maximum number of render targets a material tracks its applied state for. Others always rewrite it. */
+#define MATERIAL_MAX_RENDER_TARGETS 4
+
 struct material;
 
 /** @brief The maximum length of a geometry name. */
 #define GEOMETRY_NAME_MAX_LENGTH 256
 
+/** @brief The maximum number of levels of detail of a geometry, including the full detail. */
+#define GEOMETRY_MAX_LODS 4
+
+/**
+ * @brief A level of detail of a geometry: a range of its index data, drawing a simplified
+ * version of it from the same vertices. Level 0 is the full detail.
+ */
+typedef struct geometry_lod {
+    /** @brief The offset of the first index of the level, in indices from the start of the geometry's index data. */
+    u32 index_offset;
+    /** @brief The number of indices of the level. */
+    u32 index_count;
+    /** @brief The furthest the level strays from the full detail surface, in local units. 0 for the full detail. */
+    f32 error;
+} geometry_lod;
+
 /**
  * @brief Represents actual geometry in the world.
  * Typically (but not always, depending on use) paired with a material.
@@ -333,6 +355,11 @@ typedef struct geometry {
     /** @brief The offset from the beginning of the index buffer. */
     u64 index_buffer_offset;
 
+    /** @brief The number of levels of detail. At least 1 once created. */
+    u8 lod_count;
+    /** @brief The levels of detail, each a range of the index data, from the full detail down. */
+    geometry_lod lods[GEOMETRY_MAX_LODS];
+
     /** @brief The geometry name. */
     char name[GEOMETRY_NAME_MAX_LENGTH];
     /** @brief A pointer to the material associated with this geometry.. */
@@ -350,6 +377,8 @@ typedef struct mesh_config {
 
 typedef struct mesh {
     char *name;
+    /** @brief The interned id of name, used for lookups. */
+    kname name_id;
     mesh_config config;
     identifier id;
     u8 generation;
@@ -612,6 +641,13 @@ typedef struct material {
      * been applied that frame. */
     u64 render_frame_number;
     u8 render_draw_index;
+
+    /**
+     * @brief The state the material's instance data was last written with, per render target.
+     * Used to only bind the material when nothing has changed. 0 if never written, or if the
+     * shared instance uniforms have since been rewritten with a different state.
+     */
+    u64 applied_states[MATERIAL_MAX_RENDER_TARGETS];
 } material;
 
 typedef struct skybox_simple_scene_config {
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "defines.h"
+#include "math/bvh.h"
+#include "math/culling.h"
 #include "math/math_types.h"
+#include "math/transform_hierarchy.h"
 #include "resources/debug/debug_grid.h"
 
 struct frame_data;
@@ -44,6 +47,64 @@ typedef struct pending_mesh {
     struct geometry_config** g_configs;
 } pending_mesh;
 
+/** @brief Identifies the geometry an entry in a scene's geometry bounds belongs to. */
+typedef struct simple_scene_geometry_ref {
+    /** @brief The index of the mesh within the scene. */
+    u32 mesh_index;
+    /** @brief The index of the geometry within the mesh. */
+    u32 geometry_index;
+} simple_scene_geometry_ref;
+
+/** @brief Flags describing a cached draw in a scene. */
+typedef enum simple_scene_draw_flag_bits {
+    /** @brief The geometry is drawn back to front after all opaque geometry. */
+    SIMPLE_SCENE_DRAW_FLAG_TRANSPARENT = 0x1,
+    /** @brief The diffuse texture is still loading, so transparency is checked again on update. */
+    SIMPLE_SCENE_DRAW_FLAG_TEXTURE_PENDING = 0x2
+} simple_scene_draw_flag_bits;
+
+/** @brief A combination of simple_scene_draw_flag_bits. */
+typedef u8 simple_scene_draw_flags;
+
+/**
+ * @brief What the cached draws of a mesh were last written from, so they are only written again on change.
+ * The layout of a mesh's draws is keyed on its generation, the unique id it was given when loaded and its
+ * geometry count. The generation alone is not enough, as it restarts when a mesh is reloaded. The draws
+ * themselves are written again when the world transform changes, or when the material of any geometry
+ * is swapped or reloaded, which is checked per draw against the material pointer and generation.
+ */
+typedef struct simple_scene_mesh_cache {
+    /** @brief The mesh generation. INVALID_ID_U8 if the mesh was not loaded, in which case it has no draws. */
+    u8 generation;
+    /** @brief The unique id of the mesh, which is drawn anew each time it is loaded. */
+    u64 load_id;
+    /** @brief The world version of the mesh transform. */
+    u32 world_version;
+    /** @brief The index of the mesh's first draw. Its draws are contiguous. */
+    u32 first_draw;
+    /** @brief The number of draws, one per geometry. */
+    u32 geometry_count;
+} simple_scene_mesh_cache;
+
+/** @brief A view of a scene to be culled, such as a camera or a shadow cascade. */
+typedef struct simple_scene_view {
+    /** @brief The frustum of the view. */
+    frustum f;
+    /** @brief The position levels of detail are chosen from, typically that of the camera the result is seen through. */
+    vec3 lod_position;
+    /**
+     * @brief The size in pixels of a world unit at a distance of one unit from lod_position, such as the
+     * viewport height over 2 tan(fov / 2). 0 always draws the full detail.
+     */
+    f32 lod_scale;
+    /** @brief The largest error, in pixels, allowed for a level of detail. Shadow views can allow more than the camera. */
+    f32 lod_error_pixels;
+    /** @brief Indices into the scene's draws visible to the view, in ascending order. Frame allocated when culled. */
+    u32* visible;
+    /** @brief The number of entries in visible. */
+    u32 visible_count;
+} simple_scene_view;
+
 typedef struct simple_scene {
     u32 id;
     simple_scene_state state;
@@ -63,6 +124,40 @@ typedef struct simple_scene {
     // darray of meshes.
     struct mesh* meshes;
 
+    // The transforms of all meshes, sorted by depth so their world matrices can be updated in one pass per frame.
+    transform_hierarchy mesh_transforms;
+
+    // Indicates that meshes have been added, removed or reparented since mesh_transforms was built.
+    b8 mesh_transforms_dirty;
+
+    // Bounding volume hierarchy over the world-space extents of loaded meshes. Leaf user data is the mesh index.
+    bvh mesh_bvh;
+
+    // darray of bvh leaf ids, parallel to meshes. INVALID_ID until the mesh is loaded.
+    u32* mesh_bvh_ids;
+
+    // World-space bounds of every geometry of every loaded mesh, for batched frustum culling. Kept up to date on
+    // update along with draws, only writing meshes that have changed.
+    bounds_soa geometry_bounds;
+
+    // darray of the geometry each entry in geometry_bounds belongs to.
+    simple_scene_geometry_ref* geometry_refs;
+
+    // darray of the render data of each entry in geometry_bounds. Views cull into lists of indices into this.
+    struct geometry_render_data* draws;
+
+    // darray of the flags of each entry in draws.
+    simple_scene_draw_flags* draw_flags;
+
+    // darray of the generation of each entry's material when the draw was written. INVALID_ID without one.
+    u32* draw_material_generations;
+
+    // darray parallel to meshes, recording what the draws of each mesh were last written from.
+    simple_scene_mesh_cache* mesh_caches;
+
+    // darray of indices into draws whose transparency is waiting on a texture to load.
+    u32* pending_draws;
+
     // darray of terrains.
     struct terrain* terrains;
 
@@ -175,7 +270,36 @@ API struct transform* simple_scene_transform_get_by_id(simple_scene* scene, u64
 
 API b8 simple_scene_debug_render_data_query(simple_scene* scene, u32* data_count, struct geometry_render_data** debug_geometries);
 
+/**
+ * @brief Culls the scene's draws against every given view in a single stage. The draws are split into
+ * chunks which are culled in parallel on the job system, each chunk testing every view at once.
+ * Writes each view's visible list into frame-allocated memory.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param view_count The number of views.
+ * @param views An array of views, whose frustums are set. Their visible lists are set on return.
+ * @param p_frame_data A pointer to the current frame's data, whose allocator is used for the visible lists.
+ * @return True on success; otherwise false.
+ */
+API b8 simple_scene_views_cull(const simple_scene* scene, u32 view_count, simple_scene_view* views, struct frame_data* p_frame_data);
+
+/**
+ * @brief Produces render data for the draws visible to any of the given culled views, each draw once,
+ * sorted opaque-by-shader-and-material followed by transparent-back-to-front from center.
+ *
+ * @param scene A constant pointer to the scene.
+ * @param view_count The number of views.
+ * @param views An array of views already culled with simple_scene_views_cull.
+ * @param center The position to sort by distance from.
+ * @param p_frame_data A pointer to the current frame's data.
+ * @param out_count A pointer to hold the number of entries in out_geometries.
+ * @param out_geometries A pointer to a darray of render data, which draws are appended to.
+ * @return True on success; otherwise false.
+ */
+API b8 simple_scene_mesh_render_data_from_views(const simple_scene* scene, u32 view_count, const simple_scene_view* views, vec3 center, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data** out_geometries);
+
 API b8 simple_scene_mesh_render_data_query(const simple_scene* scene, const frustum* f, vec3 center, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data** out_geometries);
+API b8 simple_scene_mesh_render_data_query_frusta(const simple_scene* scene, const frustum* frusta, u32 frustum_count, vec3 center, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data** out_geometries);
 API b8 simple_scene_mesh_render_data_query_from_line(const simple_scene* scene, vec3 direction, vec3 center, f32 radius, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data** out_geometries);
 
 API b8 simple_scene_terrain_render_data_query(const simple_scene* scene, const frustum* f, vec3 center, struct frame_data* p_frame_data, u32* out_count, struct geometry_render_data** out_terrain_geometries);
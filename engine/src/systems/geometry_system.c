@@ -186,6 +186,17 @@ static b8 geometry_create(geometry_system_state* state, geometry_config config,
     g->extents.max = config.max_extents;
     g->generation++;
 
+    // Without levels of detail, the whole of the index data is the only level.
+    if (config.lod_count > 0) {
+        g->lod_count = config.lod_count;
+        kcopy_memory(g->lods, config.lods, sizeof(geometry_lod) * config.lod_count);
+    } else {
+        g->lod_count = 1;
+        g->lods[0].index_offset = 0;
+        g->lods[0].index_count = config.index_count;
+        g->lods[0].error = 0;
+    }
+
     // Acquire the material
     if (string_length(config.material_name) > 0) {
         g->material = material_system_acquire(config.material_name);
@@ -201,6 +212,7 @@ static void geometry_destroy(geometry_system_state* state, geometry* g) {
     renderer_geometry_destroy(g);
     g->generation = INVALID_ID_U16;
     g->id = INVALID_ID;
+    g->lod_count = 0;
 
     string_empty(g->name);
 
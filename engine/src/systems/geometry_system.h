@@ -22,6 +22,10 @@ typedef struct geometry_config {
     vec3 max_extents;
     char name[GEOMETRY_NAME_MAX_LENGTH];
     char material_name[MATERIAL_NAME_MAX_LENGTH];
+    /** @brief The number of levels of detail in lods. 0 if the whole of the index data is the only level. */
+    u8 lod_count;
+    /** @brief The levels of detail, each a range of the index data, from the full detail down. */
+    geometry_lod lods[GEOMETRY_MAX_LODS];
 } geometry_config;
 
 #define DEFAULT_GEOMETRY_NAME "default"
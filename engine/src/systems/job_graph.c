@@ -0,0 +1,121 @@
+#include "job_graph.h"
+
+#include "containers/darray.h"
+#include "core/katomic.h"
+#include "core/logger.h"
+
+typedef struct job_graph_task_params {
+    job_graph* graph;
+    u32 task;
+} job_graph_task_params;
+
+static void job_graph_task_submit(job_graph* graph, u32 task);
+
+static b8 job_graph_task_run(void* params, void* result_data) {
+    job_graph_task_params* typed_params = params;
+    job_graph* graph = typed_params->graph;
+    job_graph_task* task = &graph->tasks[typed_params->task];
+
+    task->fn(task->userdata);
+
+    // Release dependents. The last dependency to finish is the one that submits the task, and
+    // does so before this job's own count is released, so the graph can't read as done early.
+    u32 dependent_count = darray_length(task->dependents);
+    for (u32 i = 0; i < dependent_count; ++i) {
+        u32 dependent = task->dependents[i];
+        if (katomic_fetch_sub_u32(&graph->tasks[dependent].pending_dependencies, 1) == 1) {
+            job_graph_task_submit(graph, dependent);
+        }
+    }
+    return true;
+}
+
+static void job_graph_task_submit(job_graph* graph, u32 task) {
+    job_graph_task_params params;
+    params.graph = graph;
+    params.task = task;
+    job_info job = job_create_priority(job_graph_task_run, 0, 0, &params, sizeof(job_graph_task_params), 0, JOB_TYPE_GENERAL, JOB_PRIORITY_HIGH);
+    job_system_submit_with_counter(job, &graph->counter);
+}
+
+b8 job_graph_create(job_graph* out_graph) {
+    if (!out_graph) {
+        DERROR("job_graph_create requires a valid pointer to hold the graph.");
+        return false;
+    }
+    out_graph->tasks = darray_create(job_graph_task);
+    out_graph->counter.count = 0;
+    return true;
+}
+
+void job_graph_destroy(job_graph* graph) {
+    if (!graph || !graph->tasks) {
+        return;
+    }
+    u32 task_count = darray_length(graph->tasks);
+    for (u32 i = 0; i < task_count; ++i) {
+        darray_destroy(graph->tasks[i].dependents);
+    }
+    darray_destroy(graph->tasks);
+    graph->tasks = 0;
+}
+
+u32 job_graph_task_add(job_graph* graph, pfn_job_graph_task fn, void* userdata) {
+    if (!graph || !graph->tasks || !fn) {
+        DERROR("job_graph_task_add requires a valid graph and task function.");
+        return INVALID_ID;
+    }
+    job_graph_task task = {0};
+    task.fn = fn;
+    task.userdata = userdata;
+    task.dependents = darray_create(u32);
+    darray_push(graph->tasks, task);
+    return (u32)darray_length(graph->tasks) - 1;
+}
+
+b8 job_graph_dependency_add(job_graph* graph, u32 task, u32 depends_on) {
+    if (!graph || !graph->tasks) {
+        DERROR("job_graph_dependency_add requires a valid graph.");
+        return false;
+    }
+    u32 task_count = darray_length(graph->tasks);
+    if (task >= task_count || depends_on >= task) {
+        DERROR("job_graph_dependency_add: task %u may not depend on task %u. Tasks may only depend on tasks added before them.", task, depends_on);
+        return false;
+    }
+    darray_push(graph->tasks[depends_on].dependents, task);
+    graph->tasks[task].dependency_count++;
+    return true;
+}
+
+void job_graph_execute(job_graph* graph) {
+    if (!graph || !graph->tasks) {
+        return;
+    }
+    u32 task_count = darray_length(graph->tasks);
+    if (!task_count) {
+        return;
+    }
+
+    if (!job_system_is_running()) {
+        // Tasks only ever depend on earlier ones, so insertion order is a valid order.
+        for (u32 i = 0; i < task_count; ++i) {
+            graph->tasks[i].fn(graph->tasks[i].userdata);
+        }
+        return;
+    }
+
+    for (u32 i = 0; i < task_count; ++i) {
+        katomic_store_relaxed_u32(&graph->tasks[i].pending_dependencies, graph->tasks[i].dependency_count);
+    }
+    // Make the counts visible before any task can start decrementing them.
+    katomic_thread_fence();
+
+    for (u32 i = 0; i < task_count; ++i) {
+        if (!graph->tasks[i].dependency_count) {
+            job_graph_task_submit(graph, i);
+        }
+    }
+
+    job_system_wait_for_counter(&graph->counter);
+}
@@ -0,0 +1,77 @@
+/**
+ * @file job_graph.h
+ * @brief A static graph of tasks with dependencies between them, run on the job system's
+ * worker pool. Intended to be built once (for example, the stages of a frame) and then
+ * executed as often as needed.
+ */
+
+#pragma once
+
+#include "defines.h"
+#include "systems/job_system.h"
+
+/** @brief A function pointer definition for a task in a job graph. */
+typedef void (*pfn_job_graph_task)(void* userdata);
+
+/** @brief A single task in a job graph. */
+typedef struct job_graph_task {
+    /** @brief The function run by this task. */
+    pfn_job_graph_task fn;
+    /** @brief Passed through to fn. */
+    void* userdata;
+    /** @brief The number of tasks which must complete before this one may start. */
+    u32 dependency_count;
+    /** @brief The number of dependencies yet to complete during the current execution. */
+    volatile u32 pending_dependencies;
+    /** @brief A darray of the indices of tasks which depend on this one. */
+    u32* dependents;
+} job_graph_task;
+
+/** @brief A static graph of tasks. */
+typedef struct job_graph {
+    /** @brief A darray of the tasks in the graph, in the order they were added. */
+    job_graph_task* tasks;
+    /** @brief Tracks the tasks in flight during execution. */
+    job_counter counter;
+} job_graph;
+
+/**
+ * @brief Creates a new, empty job graph.
+ * @param out_graph A pointer to hold the created graph.
+ * @return True on success; otherwise false.
+ */
+API b8 job_graph_create(job_graph* out_graph);
+
+/**
+ * @brief Destroys the given job graph. Must not be called while the graph is executing.
+ * @param graph A pointer to the graph to be destroyed.
+ */
+API void job_graph_destroy(job_graph* graph);
+
+/**
+ * @brief Adds a task to the graph. Must not be called while the graph is executing.
+ * @param graph A pointer to the graph.
+ * @param fn The function to be run by the task.
+ * @param userdata Passed through to fn. Optional.
+ * @return The index of the new task, used to declare dependencies. INVALID_ID on failure.
+ */
+API u32 job_graph_task_add(job_graph* graph, pfn_job_graph_task fn, void* userdata);
+
+/**
+ * @brief Declares that the given task may not start until another has completed. A task may
+ * only depend on tasks added before it, which keeps the graph free of cycles.
+ * @param graph A pointer to the graph.
+ * @param task The index of the dependent task.
+ * @param depends_on The index of the task it depends on. Must be less than task.
+ * @return True on success; otherwise false.
+ */
+API b8 job_graph_dependency_add(job_graph* graph, u32 task, u32 depends_on);
+
+/**
+ * @brief Runs every task in the graph, each one starting as soon as its dependencies have
+ * completed, and returns once all of them have. The calling thread helps run the tasks.
+ * Falls back to running the tasks in order on the calling thread if the job system is not
+ * running.
+ * @param graph A pointer to the graph to execute.
+ */
+API void job_graph_execute(job_graph* graph);
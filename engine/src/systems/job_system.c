@@ -1,190 +1,449 @@
 #include "job_system.h"
 
+#include "containers/mpsc_queue.h"
+#include "containers/queue.h"
 #include "containers/ring_queue.h"
+#include "containers/work_deque.h"
 #include "core/asserts.h"
 #include "core/frame_data.h"
+#include "core/katomic.h"
 #include "core/kmemory.h"
 #include "core/mutex.h"
 #include "core/ksemaphore.h"
 #include "core/thread.h"
 #include "core/logger.h"
 #include "defines.h"
+#include "platform/platform.h"
+
+// The max number of jobs which may be in flight (created, queued or running) at once.
+// Must be a power of 2, as the low bits of a job handle hold the slot index.
+#define MAX_JOB_COUNT 4096
+#define JOB_HANDLE_INDEX_BITS 12
+#define JOB_HANDLE_INDEX_MASK (MAX_JOB_COUNT - 1)
+// Generations use the remaining bits. On wrapping they skip both the value that would make the handle
+// INVALID_ID and 0, the generation of a slot's first use, so the handles handed out first are never reissued.
+#define JOB_HANDLE_GENERATION_MASK (0xFFFFFFFFU >> JOB_HANDLE_INDEX_BITS)
+// The number of entries in each per-thread work-stealing deque. Must be a power of 2.
+#define JOB_DEQUE_CAPACITY 1024
+// The number of distinct job types (see job_type).
+#define JOB_TYPE_COUNT 3
+// The number of job priority levels (see job_priority).
+#define JOB_PRIORITY_COUNT 3
+// The max number of job threads.
+#define MAX_JOB_THREAD_COUNT 32
+// Bytes of storage reserved per job slot for its params, result and dependency ids. Anything
+// that does not fit spills to the heap.
+#define JOB_INLINE_DATA_SIZE 128
+// Bytes of result data a completed job's result entry can carry without a heap allocation.
+#define JOB_INLINE_RESULT_SIZE 64
 
 typedef struct job_thread {
     u8 index;
     kthread thread;
-    job_info info;
-    // A mutex to guard access to this thread's info.
-    kmutex info_mutex;
 
     // Used to cause a thread to block until work is available.
     ksemaphore semaphore;
+    // Set while the thread is (about to be) blocked on its semaphore.
+    volatile u32 sleeping;
 
     // The types of jobs this thread can handle.
     u32 type_mask;
+
+    // General jobs submitted from this thread, one deque per priority. Other threads steal from these.
+    work_deque queues[JOB_PRIORITY_COUNT];
 } job_thread;
 
 typedef struct job_result_entry {
-    u16 id;
     pfn_job_on_complete callback;
     u32 param_size;
+    // Only used when param_size exceeds JOB_INLINE_RESULT_SIZE, otherwise the data is held inline.
     void* params;
+    u8 inline_params[JOB_INLINE_RESULT_SIZE];
 } job_result_entry;
 
-// The max number of job results that can be stored at once.
-#define MAX_JOB_RESULTS 512
+// The max number of job results the result channel can hold at once. Must be a power of 2.
+#define MAX_JOB_RESULTS 4096
 
 typedef struct job_system_state {
-    b8 running;
+    volatile u32 running;
     u8 thread_count;
-    job_thread job_threads[32];
+    job_thread job_threads[MAX_JOB_THREAD_COUNT];
+
+    // General jobs submitted from the main thread, one deque per priority. Job threads steal from these.
+    work_deque main_thread_queues[JOB_PRIORITY_COUNT];
+
+    // Storage for all in-flight jobs. Queues only ever hold indices into this array.
+    job_info* jobs;
+    // JOB_INLINE_DATA_SIZE bytes per job slot, owned by whichever job holds the slot.
+    u8* job_data;
+    // The current generation of each job slot, bumped whenever a job in that slot completes.
+    // A handle whose generation no longer matches its slot refers to a completed job.
+    volatile u32* job_generations;
+    // Free job slots, in a lock-free bounded FIFO queue of MAX_JOB_COUNT cells. Slots are reused in
+    // the order they were released, so every slot is cycled through before any one is reused again,
+    // and a slot's generation only wraps after about 2^32 jobs rather than 2^20 on a hot slot.
+    volatile u32* job_free_slots;
+    // The sequence number of each cell. A cell is ready to dequeue when its sequence is one past the
+    // dequeue position, and ready to enqueue when it equals the enqueue position.
+    volatile u32* job_free_sequences;
+    volatile u32 job_free_enqueue_pos;
+    volatile u32 job_free_dequeue_pos;
+
+    // Jobs submitted from threads that do not own a deque, or which the submitting thread cannot
+    // run itself. Indexed by [type][priority], each type guarded by a single mutex.
+    ring_queue injected_queues[JOB_TYPE_COUNT][JOB_PRIORITY_COUNT];
+    volatile u32 injected_counts[JOB_TYPE_COUNT][JOB_PRIORITY_COUNT];
+    kmutex injected_mutexes[JOB_TYPE_COUNT];
+
+    // Jobs waiting on dependencies. These are checked and dispatched in job_system_update.
+    ring_queue deferred_queue;
+    kmutex deferred_mutex;
+    volatile u32 deferred_count;
+
+    // Rotates the starting point when looking for a thread to wake.
+    volatile u32 wake_index;
+
+    // Completed job results, produced by any thread and consumed by the main thread in job_system_update.
+    mpsc_queue results;
+    // Results which did not fit in the result channel. Kept in order to be run after it, never dropped.
+    queue result_overflow;
+    kmutex result_overflow_mutex;
+    volatile u32 result_overflow_count;
+    // The number of results that have hit backpressure since the last update, for reporting.
+    volatile u32 result_backpressure_count;
+} job_system_state;
 
-    u16 current_job_id;
-    // TODO: This is a massive waste of memory - combine 8 at a time into each bool.
-    b8* job_statuses;
-    kmutex job_status_mutex;
+static job_system_state* state_ptr;
 
-    ring_queue low_priority_queue;
-    ring_queue normal_priority_queue;
-    ring_queue high_priority_queue;
+// The deques owned by the current thread, if any (job threads and the main thread).
+static THREAD_LOCAL work_deque* local_queues = 0;
+// The index of the current job thread. The main thread uses MAX_JOB_THREAD_COUNT, others INVALID_ID.
+static THREAD_LOCAL u32 local_thread_index = INVALID_ID;
+// The types of jobs the current thread may run. The main thread only ever helps with general jobs.
+static THREAD_LOCAL u32 local_type_mask = 0;
+
+static u32 job_type_index(job_type type) {
+    switch (type) {
+        case JOB_TYPE_RESOURCE_LOAD:
+            return 1;
+        case JOB_TYPE_GPU_RESOURCE:
+            return 2;
+        case JOB_TYPE_GENERAL:
+        default:
+            return 0;
+    }
+}
 
-    // Mutexes for each queue, since a job could be kicked off from another job (thread).
-    kmutex low_pri_queue_mutex;
-    kmutex normal_pri_queue_mutex;
-    kmutex high_pri_queue_mutex;
+STATIC_ASSERT((1U << JOB_HANDLE_INDEX_BITS) == MAX_JOB_COUNT, "Job handle index bits must cover MAX_JOB_COUNT.");
 
-    job_result_entry pending_results[MAX_JOB_RESULTS];
-    kmutex result_mutex;
-    // A mutex for the result array
-} job_system_state;
+static u32 job_slot_acquire(void) {
+    u32 pos = katomic_load_relaxed_u32(&state_ptr->job_free_dequeue_pos);
+    while (true) {
+        u32 cell = pos & JOB_HANDLE_INDEX_MASK;
+        i32 diff = (i32)(katomic_load_u32(&state_ptr->job_free_sequences[cell]) - (pos + 1));
+        if (diff == 0) {
+            if (katomic_compare_exchange_u32(&state_ptr->job_free_dequeue_pos, &pos, pos + 1)) {
+                u32 index = katomic_load_relaxed_u32(&state_ptr->job_free_slots[cell]);
+                // Hand the cell back to enqueuers, one lap on.
+                katomic_store_u32(&state_ptr->job_free_sequences[cell], pos + MAX_JOB_COUNT);
+                return index;
+            }
+        } else if (diff < 0) {
+            // Every slot is in flight.
+            return INVALID_ID;
+        } else {
+            // Another thread dequeued this cell first.
+            pos = katomic_load_relaxed_u32(&state_ptr->job_free_dequeue_pos);
+        }
+    }
+}
 
-static job_system_state* state_ptr;
+static void job_slot_release(u32 index) {
+    // Retire the handle first, so the job reads as complete before its slot can be reused.
+    u32 generation = (katomic_load_relaxed_u32(&state_ptr->job_generations[index]) + 1) & JOB_HANDLE_GENERATION_MASK;
+    if (generation == JOB_HANDLE_GENERATION_MASK) {
+        generation = 1;
+    }
+    katomic_store_u32(&state_ptr->job_generations[index], generation);
+
+    // There are only MAX_JOB_COUNT slots, so the queue always has a cell for this one.
+    u32 pos = katomic_load_relaxed_u32(&state_ptr->job_free_enqueue_pos);
+    while (true) {
+        u32 cell = pos & JOB_HANDLE_INDEX_MASK;
+        i32 diff = (i32)(katomic_load_u32(&state_ptr->job_free_sequences[cell]) - pos);
+        if (diff == 0) {
+            if (katomic_compare_exchange_u32(&state_ptr->job_free_enqueue_pos, &pos, pos + 1)) {
+                katomic_store_relaxed_u32(&state_ptr->job_free_slots[cell], index);
+                // Publish the slot to dequeuers.
+                katomic_store_u32(&state_ptr->job_free_sequences[cell], pos + 1);
+                return;
+            }
+        } else {
+            // Another thread enqueued into this cell first, or the dequeuer of its last lap has not
+            // handed it back yet.
+            pos = katomic_load_relaxed_u32(&state_ptr->job_free_enqueue_pos);
+        }
+    }
+}
+
+/**
+ * Hands out the next part of a job slot's inline storage, or a heap allocation if the
+ * request does not fit in what remains.
+ */
+static void* job_data_reserve(u8* slot_data, u32* offset, u32 size, memory_tag tag) {
+    if (!size) {
+        return 0;
+    }
+    u32 aligned_offset = (u32)get_aligned(*offset, 16);
+    if (aligned_offset + size <= JOB_INLINE_DATA_SIZE) {
+        *offset = aligned_offset + size;
+        return slot_data + aligned_offset;
+    }
+    return kallocate(size, tag);
+}
+
+/**
+ * Frees data obtained from job_data_reserve. Inline data needs nothing, as it goes back
+ * along with the slot.
+ */
+static void job_data_release(u32 index, void* block, u32 size, memory_tag tag) {
+    u8* slot_data = state_ptr->job_data + ((u64)index * JOB_INLINE_DATA_SIZE);
+    if (block && ((u8*)block < slot_data || (u8*)block >= slot_data + JOB_INLINE_DATA_SIZE)) {
+        kfree(block, size, tag);
+    }
+}
 
 static void store_result(pfn_job_on_complete callback, u32 param_size, void* params) {
-    // Create the new entry.
+    // Create the new entry. Take a copy, as the job is destroyed after this.
     job_result_entry entry;
-    entry.id = INVALID_ID_U16;
     entry.param_size = param_size;
     entry.callback = callback;
-    if (entry.param_size > 0) {
-        // Take a copy, as the job is destroyed after this.
-        entry.params = kallocate(param_size, MEMORY_TAG_JOB);
+    entry.params = 0;
+    if (param_size > JOB_INLINE_RESULT_SIZE) {
+        entry.params = kallocate_no_zero(param_size, MEMORY_TAG_JOB);
         kcopy_memory(entry.params, params, param_size);
-    } else {
-        entry.params = 0;
+    } else if (param_size > 0) {
+        kcopy_memory(entry.inline_params, params, param_size);
     }
 
-    // Lock, find a free space, store, unlock.
-    if (!kmutex_lock(&state_ptr->result_mutex)) {
-        DERROR("Failed to obtain mutex lock for storing a result! Result storage may be corrupted.");
+    // Once anything has overflowed, keep using the overflow queue until it drains so callbacks stay in order.
+    if (!katomic_load_u32(&state_ptr->result_overflow_count) && mpsc_queue_enqueue(&state_ptr->results, &entry)) {
+        return;
     }
-    for (u16 i = 0; i < MAX_JOB_RESULTS; ++i) {
-        if (state_ptr->pending_results[i].id == INVALID_ID_U16) {
-            state_ptr->pending_results[i] = entry;
-            state_ptr->pending_results[i].id = i;
-            break;
-        }
+
+    // The channel is full. Rather than dropping the callback or blocking a job thread on the
+    // main thread (which may itself be the one storing this), park it and report it.
+    if (!kmutex_lock(&state_ptr->result_overflow_mutex)) {
+        DERROR("Failed to obtain lock on result overflow mutex!");
     }
-    if (!kmutex_unlock(&state_ptr->result_mutex)) {
-        DERROR("Failed to release mutex lock for result storage, storage may be corrupted.");
+    queue_push(&state_ptr->result_overflow, &entry);
+    katomic_fetch_add_u32(&state_ptr->result_overflow_count, 1);
+    if (!kmutex_unlock(&state_ptr->result_overflow_mutex)) {
+        DERROR("Failed to release lock on result overflow mutex!");
     }
+    katomic_fetch_add_u32(&state_ptr->result_backpressure_count, 1);
 }
 
-static u32 job_thread_run(void* params) {
-    u32 index = *(u32*)params;
-    job_thread* thread = &state_ptr->job_threads[index];
-    DTRACE("Starting job thread #%i (id=%#x, type=%#x).", thread->index, thread->thread.thread_id, thread->type_mask);
-
-    // A mutex to lock info for this thread.
-    if (!kmutex_create(&thread->info_mutex)) {
-        DERROR("Failed to create job thread mutex! Aborting thread.");
-        return 0;
+static void run_result(job_result_entry* entry) {
+    // Execute the callback.
+    if (entry->params) {
+        entry->callback(entry->params);
+    } else {
+        entry->callback(entry->param_size ? entry->inline_params : 0);
     }
 
-    // Create a semaphore for the thread which will block until there is work to do.
-    if (!ksemaphore_create(&thread->semaphore, 1, 1)) {
-        DERROR("Failed to create job thread semaphore! Aborting thread.");
-        return 0;
+    if (entry->params) {
+        kfree(entry->params, entry->param_size, MEMORY_TAG_JOB);
     }
+}
 
-    // Run forever, waiting for jobs.
-    while (true) {
-        if (!state_ptr || !state_ptr->running || !thread) {
-            break;
+/**
+ * Wakes one sleeping job thread capable of running the given job type, if any.
+ * Threads which are awake will find the job on their own.
+ */
+static void wake_thread_for(job_type type) {
+    // Order the publish of the job before the checks of the sleeping flags.
+    katomic_thread_fence();
+
+    u32 thread_count = state_ptr->thread_count;
+    u32 start = katomic_fetch_add_u32(&state_ptr->wake_index, 1);
+    for (u32 i = 0; i < thread_count; ++i) {
+        job_thread* thread = &state_ptr->job_threads[(start + i) % thread_count];
+        if ((thread->type_mask & type) == 0 || thread->index == local_thread_index) {
+            continue;
+        }
+        if (katomic_exchange_u32(&thread->sleeping, 0)) {
+            ksemaphore_signal(&thread->semaphore);
+            return;
         }
+    }
+}
 
-        // Wait for the semaphore to be signaled.
-        ksemaphore_wait(&thread->semaphore, 0xFFFFFFFF);
+/**
+ * Hands the job in the given slot to the scheduler. General jobs go onto the submitting
+ * thread's own deque when it has one, everything else goes onto the shared queue for
+ * its type.
+ */
+static void dispatch_job(u32 index) {
+    job_info* info = &state_ptr->jobs[index];
+    job_priority priority = info->priority;
+    job_type type = info->type;
+
+    b8 queued = false;
+    if (local_queues && type == JOB_TYPE_GENERAL && (local_type_mask & JOB_TYPE_GENERAL)) {
+        queued = work_deque_push(&local_queues[priority], index);
+    }
 
-        // Lock and grab a copy of the info
-        if (!kmutex_lock(&thread->info_mutex)) {
-            DERROR("Failed to obtain lock on job thread mutex!");
+    if (!queued) {
+        u32 type_index = job_type_index(type);
+        kmutex* mutex = &state_ptr->injected_mutexes[type_index];
+        if (!kmutex_lock(mutex)) {
+            DERROR("Failed to obtain lock on queue mutex!");
         }
-        job_info info = thread->info;
-        if (!kmutex_unlock(&thread->info_mutex)) {
-            DERROR("Failed to release lock on job thread mutex!");
+        ring_queue_enqueue(&state_ptr->injected_queues[type_index][priority], &index);
+        katomic_fetch_add_u32(&state_ptr->injected_counts[type_index][priority], 1);
+        if (!kmutex_unlock(mutex)) {
+            DERROR("Failed to release lock on queue mutex!");
         }
+    }
 
-        if (info.entry_point) {
-            b8 result = info.entry_point(info.param_data, info.result_data);
+    wake_thread_for(type);
+}
 
-            // Store the result to be executed on the main thread later.
-            // Note that store_result takes a copy of the result_data
-            // so it does not have to be held onto by this thread any longer.
-            if (result && info.on_success) {
-                store_result(info.on_success, info.result_data_size, info.result_data);
-            } else if (!result && info.on_fail) {
-                store_result(info.on_fail, info.result_data_size, info.result_data);
-            }
+static b8 take_injected_job(u32 type_index, job_priority priority, u32* out_index) {
+    if (katomic_load_u32(&state_ptr->injected_counts[type_index][priority]) == 0) {
+        return false;
+    }
 
-            // Clear the param data and result data.
-            if (info.param_data) {
-                kfree(info.param_data, info.param_data_size, MEMORY_TAG_JOB);
-            }
-            if (info.result_data) {
-                kfree(info.result_data, info.result_data_size, MEMORY_TAG_JOB);
-            }
+    b8 found = false;
+    kmutex* mutex = &state_ptr->injected_mutexes[type_index];
+    if (!kmutex_lock(mutex)) {
+        DERROR("Failed to obtain lock on queue mutex!");
+    }
+    ring_queue* queue = &state_ptr->injected_queues[type_index][priority];
+    if (queue->length > 0) {
+        found = ring_queue_dequeue(queue, out_index);
+        katomic_fetch_sub_u32(&state_ptr->injected_counts[type_index][priority], 1);
+    }
+    if (!kmutex_unlock(mutex)) {
+        DERROR("Failed to release lock on queue mutex!");
+    }
+    return found;
+}
 
-            // Update the job status for this job.
-            if (!kmutex_lock(&state_ptr->job_status_mutex)) {
-                DERROR("Failed to lock job status mutex!");
-            }
-            state_ptr->job_statuses[thread->info.id] = true;
-            if (!kmutex_unlock(&state_ptr->job_status_mutex)) {
-                DERROR("Failed to unlock job status mutex!");
-            }
+static b8 steal_job(job_priority priority, u32 self_index, u32* out_index) {
+    u32 thread_count = state_ptr->thread_count;
+    // Start at a different victim per thread to spread contention.
+    for (u32 i = 0; i <= thread_count; ++i) {
+        u32 victim = (self_index + 1 + i) % (thread_count + 1);
+        if (victim == self_index) {
+            continue;
+        }
+        work_deque* queue = victim == thread_count ? &state_ptr->main_thread_queues[priority] : &state_ptr->job_threads[victim].queues[priority];
+        if (work_deque_steal(queue, out_index)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-            // Lock and reset the thread's info object
-            if (!kmutex_lock(&thread->info_mutex)) {
-                DERROR("Failed to obtain lock on job thread mutex!");
-            }
-            if (thread->info.dependency_ids) {
-                kfree(thread->info.dependency_ids, sizeof(u16) * thread->info.dependency_count, MEMORY_TAG_ARRAY);
+/**
+ * Finds the next job runnable by the calling thread, highest priority first. For each priority,
+ * the thread's own deque is checked first, then the shared queues for its types, then the
+ * deques of other threads.
+ */
+static b8 find_job(u32 type_mask, u32* out_index) {
+    u32 self_index = local_thread_index == MAX_JOB_THREAD_COUNT ? state_ptr->thread_count : local_thread_index;
+    for (i32 p = JOB_PRIORITY_HIGH; p >= JOB_PRIORITY_LOW; --p) {
+        if (local_queues && work_deque_pop(&local_queues[p], out_index)) {
+            return true;
+        }
+        for (u32 t = 0; t < JOB_TYPE_COUNT; ++t) {
+            if ((type_mask & (JOB_TYPE_GENERAL << t)) && take_injected_job(t, p, out_index)) {
+                return true;
             }
-            kzero_memory(&thread->info, sizeof(job_info));
-            if (!kmutex_unlock(&thread->info_mutex)) {
-                DERROR("Failed to release lock on job thread mutex!");
+        }
+        if ((type_mask & JOB_TYPE_GENERAL) && steal_job(p, self_index, out_index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void execute_job(u32 index) {
+    // Take a copy so the slot can be released before callbacks run.
+    job_info info = state_ptr->jobs[index];
+
+    b8 result = info.entry_point(info.param_data, info.result_data);
+
+    // Store the result to be executed on the main thread later.
+    // Note that store_result takes a copy of the result_data
+    // so it does not have to be held onto by this thread any longer.
+    if (result && info.on_success) {
+        store_result(info.on_success, info.result_data_size, info.result_data);
+    } else if (!result && info.on_fail) {
+        store_result(info.on_fail, info.result_data_size, info.result_data);
+    }
+
+    // Clear the param data and result data.
+    job_data_release(index, info.param_data, info.param_data_size, MEMORY_TAG_JOB);
+    job_data_release(index, info.result_data, info.result_data_size, MEMORY_TAG_JOB);
+    job_data_release(index, info.dependency_ids, sizeof(u32) * info.dependency_count, MEMORY_TAG_ARRAY);
+
+    // Marks the job as complete.
+    job_slot_release(index);
+
+    // Signal any waiter last, so everything the job did is visible once the count drops.
+    if (info.counter) {
+        katomic_fetch_sub_u32(&info.counter->count, 1);
+    }
+}
+
+static u32 job_thread_run(void* params) {
+    u32 index = *(u8*)params;
+    job_thread* thread = &state_ptr->job_threads[index];
+    local_thread_index = index;
+    local_queues = thread->queues;
+    local_type_mask = thread->type_mask;
+    DTRACE("Starting job thread #%i (id=%#x, type=%#x).", thread->index, platform_current_thread_id(), thread->type_mask);
+
+    // Run until the system shuts down, pulling work as soon as the previous job is done.
+    while (katomic_load_u32(&state_ptr->running)) {
+        u32 job_index;
+        if (find_job(thread->type_mask, &job_index)) {
+            execute_job(job_index);
+            continue;
+        }
+
+        // Announce that this thread is going to sleep, then check once more. Submitters
+        // publish their job before checking this flag, so one side always sees the other.
+        katomic_exchange_u32(&thread->sleeping, 1);
+        katomic_thread_fence();
+        if (find_job(thread->type_mask, &job_index)) {
+            if (!katomic_exchange_u32(&thread->sleeping, 0)) {
+                // A submitter already claimed the wakeup, so consume its signal.
+                ksemaphore_wait(&thread->semaphore, 0xFFFFFFFF);
             }
+            execute_job(job_index);
+            continue;
         }
 
-        // If no longer running, shut down the thread.
-        if (!state_ptr->running) {
+        if (!katomic_load_u32(&state_ptr->running)) {
             break;
         }
-    }
-
-    // Destroy the mutex for this thread.
-    kmutex_destroy(&thread->info_mutex);
 
-    // Destroy the semaphore.
-    ksemaphore_destroy(&thread->semaphore);
+        // Wait for the semaphore to be signaled.
+        ksemaphore_wait(&thread->semaphore, 0xFFFFFFFF);
+    }
 
+    // Hand back any small blocks this thread has cached.
+    kmemory_thread_cache_flush();
     return 1;
 }
 
 b8 job_system_initialize(u64* job_system_memory_requirement, void* state, void* config) {
     job_system_config* typed_config = (job_system_config*)config;
-    *job_system_memory_requirement = sizeof(job_system_state) + (sizeof(u8) * (INVALID_ID_U16 - 1));
+    *job_system_memory_requirement = sizeof(job_system_state);
     if (state == 0) {
         return true;
     }
@@ -193,52 +452,79 @@ b8 job_system_initialize(u64* job_system_memory_requirement, void* state, void*
 
     state_ptr = state;
     state_ptr->running = true;
-    state_ptr->job_statuses = (void*)((u64)state_ptr + sizeof(job_system_state));
+    state_ptr->thread_count = KMIN(typed_config->max_job_thread_count, MAX_JOB_THREAD_COUNT);
+
+    // Job storage, with every slot in the free queue.
+    state_ptr->jobs = kallocate(sizeof(job_info) * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+    state_ptr->job_data = kallocate(JOB_INLINE_DATA_SIZE * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+    state_ptr->job_free_slots = kallocate(sizeof(u32) * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+    state_ptr->job_free_sequences = kallocate(sizeof(u32) * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+    state_ptr->job_generations = kallocate(sizeof(u32) * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+    for (u32 i = 0; i < MAX_JOB_COUNT; ++i) {
+        // As if each slot had been enqueued in order.
+        state_ptr->job_free_slots[i] = i;
+        state_ptr->job_free_sequences[i] = i + 1;
+    }
+    state_ptr->job_free_enqueue_pos = MAX_JOB_COUNT;
+    state_ptr->job_free_dequeue_pos = 0;
+
+    for (u32 t = 0; t < JOB_TYPE_COUNT; ++t) {
+        for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+            ring_queue_create(sizeof(u32), MAX_JOB_COUNT, 0, &state_ptr->injected_queues[t][p]);
+        }
+        if (!kmutex_create(&state_ptr->injected_mutexes[t])) {
+            DERROR("Failed to create job queue mutex!");
+            return false;
+        }
+    }
+    ring_queue_create(sizeof(u32), MAX_JOB_COUNT, 0, &state_ptr->deferred_queue);
+    for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+        work_deque_create(JOB_DEQUE_CAPACITY, 0, &state_ptr->main_thread_queues[p]);
+    }
 
-    ring_queue_create(sizeof(job_info), 1024, 0, &state_ptr->low_priority_queue);
-    ring_queue_create(sizeof(job_info), 1024, 0, &state_ptr->normal_priority_queue);
-    ring_queue_create(sizeof(job_info), 1024, 0, &state_ptr->high_priority_queue);
-    state_ptr->thread_count = typed_config->max_job_thread_count;
+    u64 results_requirement = 0;
+    mpsc_queue_create(sizeof(job_result_entry), MAX_JOB_RESULTS, &results_requirement, 0, &state_ptr->results);
+    queue_create(&state_ptr->result_overflow, sizeof(job_result_entry));
 
-    // Invalidate all result slots
-    for (u16 i = 0; i < MAX_JOB_RESULTS; ++i) {
-        state_ptr->pending_results[i].id = INVALID_ID_U16;
+    // Create needed mutexes
+    if (!kmutex_create(&state_ptr->result_overflow_mutex)) {
+        DERROR("Failed to create result overflow mutex!");
+        return false;
     }
+    if (!kmutex_create(&state_ptr->deferred_mutex)) {
+        DERROR("Failed to create deferred job queue mutex!");
+        return false;
+    }
+
+    // The initializing thread is considered the main thread, and owns its own set of deques.
+    local_thread_index = MAX_JOB_THREAD_COUNT;
+    local_queues = state_ptr->main_thread_queues;
+    local_type_mask = JOB_TYPE_GENERAL;
 
     DDEBUG("Main thread id is: %#x", platform_current_thread_id());
 
     DDEBUG("Spawning %i job threads.", state_ptr->thread_count);
 
+    // Everything a thread touches must exist before any thread starts, since threads steal from each other.
     for (u8 i = 0; i < state_ptr->thread_count; ++i) {
-        state_ptr->job_threads[i].index = i;
-        state_ptr->job_threads[i].type_mask = typed_config->type_masks[i];
-        if (!kthread_create(job_thread_run, &state_ptr->job_threads[i].index, false, &state_ptr->job_threads[i].thread)) {
-            DFATAL("OS Error in creating job thread. Application cannot continue.");
+        job_thread* thread = &state_ptr->job_threads[i];
+        thread->index = i;
+        thread->type_mask = typed_config->type_masks[i];
+        for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+            work_deque_create(JOB_DEQUE_CAPACITY, 0, &thread->queues[p]);
+        }
+        // Create a semaphore for the thread which will block until there is work to do.
+        if (!ksemaphore_create(&thread->semaphore, 1, 0)) {
+            DERROR("Failed to create job thread semaphore!");
             return false;
         }
-        kzero_memory(&state_ptr->job_threads[i].info, sizeof(job_info));
     }
 
-    // Create needed mutexes
-    if (!kmutex_create(&state_ptr->result_mutex)) {
-        DERROR("Failed to create result mutex!");
-        return false;
-    }
-    if (!kmutex_create(&state_ptr->low_pri_queue_mutex)) {
-        DERROR("Failed to create low priority queue mutex!");
-        return false;
-    }
-    if (!kmutex_create(&state_ptr->normal_pri_queue_mutex)) {
-        DERROR("Failed to create normal priority queue mutex!");
-        return false;
-    }
-    if (!kmutex_create(&state_ptr->high_pri_queue_mutex)) {
-        DERROR("Failed to create high priority queue mutex!");
-        return false;
-    }
-    if (!kmutex_create(&state_ptr->job_status_mutex)) {
-        DERROR("Failed to create job status mutex!");
-        return false;
+    for (u8 i = 0; i < state_ptr->thread_count; ++i) {
+        if (!kthread_create(job_thread_run, &state_ptr->job_threads[i].index, false, &state_ptr->job_threads[i].thread)) {
+            DFATAL("OS Error in creating job thread. Application cannot continue.");
+            return false;
+        }
     }
 
     return true;
@@ -246,96 +532,98 @@ b8 job_system_initialize(u64* job_system_memory_requirement, void* state, void*
 
 void job_system_shutdown(void* state) {
     if (state_ptr) {
-        state_ptr->running = false;
+        katomic_exchange_u32(&state_ptr->running, false);
 
         u64 thread_count = state_ptr->thread_count;
 
-        // Check for a free thread first.
+        // Wake every sleeping thread so it can observe the shutdown, then wait for it to exit.
         for (u8 i = 0; i < thread_count; ++i) {
-            kthread_destroy(&state_ptr->job_threads[i].thread);
+            if (katomic_exchange_u32(&state_ptr->job_threads[i].sleeping, 0)) {
+                ksemaphore_signal(&state_ptr->job_threads[i].semaphore);
+            }
+        }
+        for (u8 i = 0; i < thread_count; ++i) {
+            kthread_wait(&state_ptr->job_threads[i].thread);
         }
-        ring_queue_destroy(&state_ptr->low_priority_queue);
-        ring_queue_destroy(&state_ptr->normal_priority_queue);
-        ring_queue_destroy(&state_ptr->high_priority_queue);
 
-        // Destroy mutexes
-        kmutex_destroy(&state_ptr->result_mutex);
-        kmutex_destroy(&state_ptr->low_pri_queue_mutex);
-        kmutex_destroy(&state_ptr->normal_pri_queue_mutex);
-        kmutex_destroy(&state_ptr->high_pri_queue_mutex);
-        kmutex_destroy(&state_ptr->job_status_mutex);
+        // Only tear down once no thread can still be stealing.
+        for (u8 i = 0; i < thread_count; ++i) {
+            job_thread* thread = &state_ptr->job_threads[i];
+            kthread_destroy(&thread->thread);
+            ksemaphore_destroy(&thread->semaphore);
+            for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+                work_deque_destroy(&thread->queues[p]);
+            }
+        }
+
+        for (u32 t = 0; t < JOB_TYPE_COUNT; ++t) {
+            for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+                ring_queue_destroy(&state_ptr->injected_queues[t][p]);
+            }
+            kmutex_destroy(&state_ptr->injected_mutexes[t]);
+        }
+        for (u32 p = 0; p < JOB_PRIORITY_COUNT; ++p) {
+            work_deque_destroy(&state_ptr->main_thread_queues[p]);
+        }
+        ring_queue_destroy(&state_ptr->deferred_queue);
+
+        kfree(state_ptr->jobs, sizeof(job_info) * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+        kfree(state_ptr->job_data, JOB_INLINE_DATA_SIZE * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+        kfree((void*)state_ptr->job_free_slots, sizeof(u32) * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+        kfree((void*)state_ptr->job_free_sequences, sizeof(u32) * MAX_JOB_COUNT, MEMORY_TAG_JOB);
+        kfree((void*)state_ptr->job_generations, sizeof(u32) * MAX_JOB_COUNT, MEMORY_TAG_JOB);
 
+        // Destroy mutexes
+        mpsc_queue_destroy(&state_ptr->results);
+        queue_destroy(&state_ptr->result_overflow);
+        kmutex_destroy(&state_ptr->result_overflow_mutex);
+        kmutex_destroy(&state_ptr->deferred_mutex);
+
+        local_queues = 0;
+        local_thread_index = INVALID_ID;
+        local_type_mask = 0;
         state_ptr = 0;
     }
 }
 
-static void process_queue(ring_queue* queue, kmutex* queue_mutex) {
-    u64 thread_count = state_ptr->thread_count;
+/**
+ * Dispatches deferred jobs whose dependencies have all completed. Jobs still waiting are
+ * put back in the same order.
+ */
+static void process_deferred_jobs(void) {
+    if (!kmutex_lock(&state_ptr->deferred_mutex)) {
+        DERROR("Failed to obtain lock on deferred queue mutex!");
+    }
 
-    // Check for a free thread first.
-    while (queue->length > 0) {
-        job_info info;
-        if (!ring_queue_peek(queue, &info)) {
+    ring_queue* queue = &state_ptr->deferred_queue;
+    u32 count = queue->length;
+    for (u32 i = 0; i < count; ++i) {
+        u32 index;
+        if (!ring_queue_dequeue(queue, &index)) {
             break;
         }
 
         // Verify dependencies are complete.
+        job_info* info = &state_ptr->jobs[index];
         b8 awaiting_dependency = false;
-        if (info.dependency_count) {
-            for (u32 i = 0; i < info.dependency_count; ++i) {
-                if (!job_system_query_job_complete(info.dependency_ids[i])) {
-                    DTRACE("Note: Not starting job id %u because it's dependency (job id=%u) is still running.", info.id, info.dependency_ids[i]);
-                    awaiting_dependency = true;
-                    break;
-                }
+        for (u32 d = 0; d < info->dependency_count; ++d) {
+            if (!job_system_query_job_complete(info->dependency_ids[d])) {
+                DTRACE("Note: Not starting job id %u because it's dependency (job id=%u) is still running.", info->id, info->dependency_ids[d]);
+                awaiting_dependency = true;
+                break;
             }
         }
 
         if (awaiting_dependency) {
-            continue;
-        }
-
-        b8 thread_found = false;
-        for (u8 i = 0; i < thread_count; ++i) {
-            job_thread* thread = &state_ptr->job_threads[i];
-            if ((thread->type_mask & info.type) == 0) {
-                continue;
-            }
-
-            // Check that the job thread can handle the job type.
-            if (!kmutex_lock(&thread->info_mutex)) {
-                DERROR("Failed to obtain lock on job thread mutex!");
-            }
-            if (!thread->info.entry_point) {
-                // Make sure to remove the entry from the queue.
-                if (!kmutex_lock(queue_mutex)) {
-                    DERROR("Failed to obtain lock on queue mutex!");
-                }
-                ring_queue_dequeue(queue, &info);
-                if (!kmutex_unlock(queue_mutex)) {
-                    DERROR("Failed to release lock on queue mutex!");
-                }
-                thread->info = info;
-                DTRACE("Assigning job to thread: %u", thread->index);
-                thread_found = true;
-                // Signal the thread's semaphore since there is work to be done.
-                ksemaphore_signal(&thread->semaphore);
-            }
-            if (!kmutex_unlock(&thread->info_mutex)) {
-                DERROR("Failed to release lock on job thread mutex!");
-            }
-
-            // Break after unlocking if an available thread was found.
-            if (thread_found) {
-                break;
-            }
+            ring_queue_enqueue(queue, &index);
+        } else {
+            katomic_fetch_sub_u32(&state_ptr->deferred_count, 1);
+            dispatch_job(index);
         }
+    }
 
-        // This means all of the threads are currently handling a job,
-        // So wait until the next update and try again.
-        if (!thread_found) {
-            break;
-        }
+    if (!kmutex_unlock(&state_ptr->deferred_mutex)) {
+        DERROR("Failed to release lock on deferred queue mutex!");
     }
 }
 
@@ -344,93 +632,68 @@ b8 job_system_update(void* state, struct frame_data* p_frame_data) {
         return false;
     }
 
-    process_queue(&state_ptr->high_priority_queue, &state_ptr->high_pri_queue_mutex);
-    process_queue(&state_ptr->normal_priority_queue, &state_ptr->normal_pri_queue_mutex);
-    process_queue(&state_ptr->low_priority_queue, &state_ptr->low_pri_queue_mutex);
-
-    // Process pending results.
-    for (u16 i = 0; i < MAX_JOB_RESULTS; ++i) {
-        // Lock and take a copy, unlock.
-        if (!kmutex_lock(&state_ptr->result_mutex)) {
-            DERROR("Failed to obtain lock on result mutex!");
-        }
-        job_result_entry entry = state_ptr->pending_results[i];
-        if (!kmutex_unlock(&state_ptr->result_mutex)) {
-            DERROR("Failed to release lock on result mutex!");
-        }
+    // Most frames defer nothing, so the lock is only taken when there is something to release.
+    if (katomic_load_u32(&state_ptr->deferred_count)) {
+        process_deferred_jobs();
+    }
 
-        if (entry.id != INVALID_ID_U16) {
-            // Execute the callback.
-            entry.callback(entry.params);
+    // Process pending results. Only completed results are touched, so an idle frame costs a single load.
+    job_result_entry entry;
+    while (mpsc_queue_dequeue(&state_ptr->results, &entry)) {
+        run_result(&entry);
+    }
 
-            if (entry.params) {
-                kfree(entry.params, entry.param_size, MEMORY_TAG_JOB);
+    // Then anything that overflowed, which is always newer than what was in the channel.
+    if (katomic_load_u32(&state_ptr->result_overflow_count)) {
+        if (!kmutex_lock(&state_ptr->result_overflow_mutex)) {
+            DERROR("Failed to obtain lock on result overflow mutex!");
+        }
+        while (queue_pop(&state_ptr->result_overflow, &entry)) {
+            // Callbacks may submit new jobs, so don't hold the lock while running them.
+            if (!kmutex_unlock(&state_ptr->result_overflow_mutex)) {
+                DERROR("Failed to release lock on result overflow mutex!");
             }
-
-            // Lock actual entry, invalidate and clear it
-            if (!kmutex_lock(&state_ptr->result_mutex)) {
-                DERROR("Failed to obtain lock on result mutex!");
+            run_result(&entry);
+            if (!kmutex_lock(&state_ptr->result_overflow_mutex)) {
+                DERROR("Failed to obtain lock on result overflow mutex!");
             }
-            kzero_memory(&state_ptr->pending_results[i], sizeof(job_result_entry));
-            state_ptr->pending_results[i].id = INVALID_ID_U16;
-            if (!kmutex_unlock(&state_ptr->result_mutex)) {
-                DERROR("Failed to release lock on result mutex!");
+            if (katomic_fetch_sub_u32(&state_ptr->result_overflow_count, 1) == 1) {
+                break;
             }
         }
+        if (!kmutex_unlock(&state_ptr->result_overflow_mutex)) {
+            DERROR("Failed to release lock on result overflow mutex!");
+        }
+    }
+
+    u32 backpressure_count = katomic_exchange_u32(&state_ptr->result_backpressure_count, 0);
+    if (backpressure_count) {
+        DWARN("Job result channel was full; %u result(s) were held in overflow. Consider raising MAX_JOB_RESULTS.", backpressure_count);
     }
 
     return true;
 }
 
 void job_system_submit(job_info info) {
-    u64 thread_count = state_ptr->thread_count;
-    ring_queue* queue = &state_ptr->normal_priority_queue;
-    kmutex* queue_mutex = &state_ptr->normal_pri_queue_mutex;
-
-    // If the job is high priority, try to kick it off immediately.
-    if (info.priority == JOB_PRIORITY_HIGH) {
-        queue = &state_ptr->high_priority_queue;
-        queue_mutex = &state_ptr->high_pri_queue_mutex;
-
-        // Check for a free thread that supports the job type first.
-        for (u8 i = 0; i < thread_count; ++i) {
-            job_thread* thread = &state_ptr->job_threads[i];
-            if (state_ptr->job_threads[i].type_mask & info.type) {
-                b8 found = false;
-                if (!kmutex_lock(&thread->info_mutex)) {
-                    DERROR("Failed to obtain lock on job thread mutex!");
-                }
-                if (!state_ptr->job_threads[i].info.entry_point) {
-                    DTRACE("Job immediately submitted on thread %i", state_ptr->job_threads[i].index);
-                    state_ptr->job_threads[i].info = info;
-                    found = true;
-                }
-                if (!kmutex_unlock(&thread->info_mutex)) {
-                    DERROR("Failed to release lock on job thread mutex!");
-                }
-                if (found) {
-                    return;
-                }
-            }
+    // The slot was reserved when the job was created.
+    u32 index = info.id & JOB_HANDLE_INDEX_MASK;
+    state_ptr->jobs[index] = info;
+
+    if (info.dependency_count) {
+        // Dependencies are checked once per update cycle.
+        if (!kmutex_lock(&state_ptr->deferred_mutex)) {
+            DERROR("Failed to obtain lock on deferred queue mutex!");
         }
+        ring_queue_enqueue(&state_ptr->deferred_queue, &index);
+        katomic_fetch_add_u32(&state_ptr->deferred_count, 1);
+        if (!kmutex_unlock(&state_ptr->deferred_mutex)) {
+            DERROR("Failed to release lock on deferred queue mutex!");
+        }
+        DTRACE("Job deferred until dependencies complete.");
+        return;
     }
 
-    // If this point is reached, all threads are busy (if high) or it can wait a frame.
-    // Add to the queue and try again next cycle.
-    if (info.priority == JOB_PRIORITY_LOW) {
-        queue = &state_ptr->low_priority_queue;
-        queue_mutex = &state_ptr->low_pri_queue_mutex;
-    }
-
-    // NOTE: Locking here in case the job is submitted from another job/thread.
-    if (!kmutex_lock(queue_mutex)) {
-        DERROR("Failed to obtain lock on queue mutex!");
-    }
-    ring_queue_enqueue(queue, &info);
-    if (!kmutex_unlock(queue_mutex)) {
-        DERROR("Failed to release lock on queue mutex!");
-    }
-    DTRACE("Job queued.");
+    dispatch_job(index);
 }
 
 job_info job_create(pfn_job_start entry_point, pfn_job_on_complete on_success, pfn_job_on_complete on_fail, void* param_data, u32 param_data_size, u32 result_data_size) {
@@ -455,67 +718,169 @@ job_info job_create_with_dependencies(
     job_type type,
     job_priority priority,
     u8 dependency_count,
-    u16* dependencies) {
+    u32* dependencies) {
     job_info job;
     job.entry_point = entry_point;
     job.on_success = on_success;
     job.on_fail = on_fail;
     job.type = type;
     job.priority = priority;
-
-    // Technically jobs can be created in the middle of other jobs (i.e. on a different thread)
-    // so make sure to lock around these updates.
-    if (!kmutex_lock(&state_ptr->job_status_mutex)) {
-        DERROR("Failed to lock job status mutex!");
+    job.counter = 0;
+
+    // Reserve a slot, which also determines the job's handle. Jobs can be created from any
+    // thread, so this is lock-free.
+    u32 index = job_slot_acquire();
+    while (index == INVALID_ID) {
+        // Every slot is in flight. Help drain work if this thread can, otherwise yield.
+        u32 job_index;
+        if (local_queues && find_job(local_type_mask, &job_index)) {
+            execute_job(job_index);
+        } else {
+            platform_sleep(0);
+        }
+        index = job_slot_acquire();
     }
+    job.id = (katomic_load_relaxed_u32(&state_ptr->job_generations[index]) << JOB_HANDLE_INDEX_BITS) | index;
 
-    // TODO: Pack booleans.
-    KASSERT_MSG(state_ptr->current_job_id < INVALID_ID_U16, "Job system identifier overflow - need to pack booleans.");
-    job.id = state_ptr->current_job_id;
-    state_ptr->current_job_id++;
-    state_ptr->job_statuses[job.id] = false;
-    if (!kmutex_unlock(&state_ptr->job_status_mutex)) {
-        DERROR("Failed to unlock job status mutex!");
-    }
+    // Small payloads live in the slot's own storage, so the common case never touches the
+    // allocator (and its global lock). Larger ones spill to the heap.
+    u8* slot_data = state_ptr->job_data + ((u64)index * JOB_INLINE_DATA_SIZE);
+    u32 offset = 0;
 
     job.param_data_size = param_data_size;
-    if (param_data_size) {
-        job.param_data = kallocate(param_data_size, MEMORY_TAG_JOB);
+    job.param_data = job_data_reserve(slot_data, &offset, param_data_size, MEMORY_TAG_JOB);
+    if (job.param_data) {
         kcopy_memory(job.param_data, param_data, param_data_size);
-    } else {
-        job.param_data = 0;
     }
 
     job.result_data_size = result_data_size;
-    if (result_data_size) {
-        job.result_data = kallocate(result_data_size, MEMORY_TAG_JOB);
-    } else {
-        job.result_data = 0;
-    }
+    job.result_data = job_data_reserve(slot_data, &offset, result_data_size, MEMORY_TAG_JOB);
 
     job.dependency_count = dependency_count;
-    if (dependency_count) {
-        job.dependency_ids = kallocate(sizeof(u16) * dependency_count, MEMORY_TAG_ARRAY);
-        kcopy_memory(job.dependency_ids, dependencies, sizeof(u16) * dependency_count);
-    } else {
-        job.dependency_ids = 0;
+    job.dependency_ids = job_data_reserve(slot_data, &offset, sizeof(u32) * dependency_count, MEMORY_TAG_ARRAY);
+    if (job.dependency_ids) {
+        kcopy_memory(job.dependency_ids, dependencies, sizeof(u32) * dependency_count);
     }
 
     return job;
 }
 
-b8 job_system_query_job_complete(u16 job_id) {
-    b8 status = INVALID_ID;
-    if (!kmutex_lock(&state_ptr->job_status_mutex)) {
-        DERROR("Failed to lock job status mutex!");
+void job_system_submit_with_counter(job_info info, job_counter* counter) {
+    info.counter = counter;
+    if (counter) {
+        katomic_fetch_add_u32(&counter->count, 1);
+    }
+    job_system_submit(info);
+}
+
+/**
+ * Runs one pending job on the calling thread if there is one it may run. Returns false if
+ * there was nothing to do, after backing off according to the number of idle attempts so far.
+ */
+static b8 help_with_pending_jobs(u32* idle_count) {
+    // Threads outside the job system may still help with general work.
+    u32 type_mask = local_type_mask ? local_type_mask : JOB_TYPE_GENERAL;
+    u32 job_index;
+    if (find_job(type_mask, &job_index)) {
+        execute_job(job_index);
+        *idle_count = 0;
+        return true;
+    }
+
+    // Deferred jobs would otherwise only be released by the next update, which could be the very
+    // thing that is waiting.
+    if (katomic_load_u32(&state_ptr->deferred_count)) {
+        process_deferred_jobs();
+    }
+
+    (*idle_count)++;
+    if (*idle_count < 64) {
+        katomic_pause();
+    } else {
+        platform_sleep(0);
+    }
+    return false;
+}
+
+void job_system_wait_for_counter(job_counter* counter) {
+    if (!counter) {
+        return;
+    }
+
+    u32 idle_count = 0;
+    while (katomic_load_u32(&counter->count) > 0) {
+        help_with_pending_jobs(&idle_count);
+    }
+}
+
+b8 job_system_wait_for_jobs(u8 job_count, u32* job_ids) {
+    if (!job_ids) {
+        return false;
     }
-    status = state_ptr->job_statuses[job_id];
-    if (!kmutex_unlock(&state_ptr->job_status_mutex)) {
-        DERROR("Failed to unlock job status mutex!");
+
+    u32 idle_count = 0;
+    for (u8 i = 0; i < job_count; ++i) {
+        while (!job_system_query_job_complete(job_ids[i])) {
+            help_with_pending_jobs(&idle_count);
+        }
     }
-    return status;
+    return true;
 }
 
-b8 job_system_wait_for_jobs(u8 job_count, u16 job_ids) {
+b8 job_system_is_running(void) {
+    return state_ptr && katomic_load_u32(&state_ptr->running);
+}
+
+typedef struct parallel_for_chunk {
+    pfn_job_parallel_for fn;
+    void* userdata;
+    u32 start;
+    u32 end;
+} parallel_for_chunk;
+
+static b8 parallel_for_chunk_run(void* params, void* result_data) {
+    parallel_for_chunk* chunk = params;
+    chunk->fn(chunk->start, chunk->end, chunk->userdata);
     return true;
-}
\ No newline at end of file
+}
+
+void job_parallel_for(u32 count, u32 grain, pfn_job_parallel_for fn, void* userdata) {
+    if (!count || !fn) {
+        return;
+    }
+    if (!grain) {
+        grain = 1;
+    }
+
+    // Nothing to split, or nobody to split it with.
+    if (count <= grain || !job_system_is_running()) {
+        fn(0, count, userdata);
+        return;
+    }
+
+    // Hand out everything but the first chunk, which this thread runs itself. The caller is
+    // blocked until all of it is done, so it goes in at high priority.
+    job_counter counter = {0};
+    for (u32 start = grain; start < count; start += grain) {
+        parallel_for_chunk chunk;
+        chunk.fn = fn;
+        chunk.userdata = userdata;
+        chunk.start = start;
+        chunk.end = count - start > grain ? start + grain : count;
+        job_info job = job_create_priority(parallel_for_chunk_run, 0, 0, &chunk, sizeof(parallel_for_chunk), 0, JOB_TYPE_GENERAL, JOB_PRIORITY_HIGH);
+        job_system_submit_with_counter(job, &counter);
+    }
+
+    fn(0, grain, userdata);
+
+    job_system_wait_for_counter(&counter);
+}
+
+b8 job_system_query_job_complete(u32 job_id) {
+    if (job_id == INVALID_ID) {
+        return true;
+    }
+    // Once a job completes its slot moves on to a new generation, so a stale handle always reads as complete.
+    u32 index = job_id & JOB_HANDLE_INDEX_MASK;
+    return katomic_load_u32(&state_ptr->job_generations[index]) != (job_id >> JOB_HANDLE_INDEX_BITS);
+}
@@ -8,6 +8,9 @@ typedef b8 (*pfn_job_start)(void*, void*);
 /** @brief A function pointer definition for completion of a job. */
 typedef void (*pfn_job_on_complete)(void*);
 
+/** @brief A function pointer definition for one chunk of a parallel for, covering the items [start, end). */
+typedef void (*pfn_job_parallel_for)(u32 start, u32 end, void* userdata);
+
 struct frame_data;
 
 /** @brief Describes a type of job */
@@ -46,6 +49,16 @@ typedef enum job_priority {
     JOB_PRIORITY_HIGH
 } job_priority;
 
+/**
+ * @brief A counter used to wait on a group of jobs (fork-join). Zero-initialize before use.
+ * Each job submitted with job_system_submit_with_counter increments it, and decrements it
+ * once the job has finished running. The counter reaches zero when all of them are done.
+ */
+typedef struct job_counter {
+    /** @brief The number of outstanding jobs. Modified atomically. */
+    volatile u32 count;
+} job_counter;
+
 /**
  * @brief Describes a job to be run.
  */
@@ -53,8 +66,11 @@ typedef struct job_info {
     /** @brief The type of job. Used to determine which thread the job executes on. */
     job_type type;
 
-    /** @brief The uniquie identifier of this job. */
-    u16 id;
+    /**
+     * @brief The handle of this job. Generational, so it stays unique among in-flight jobs and
+     * reads as complete forever once the job is done, even after its slot is reused.
+     */
+    u32 id;
 
     /** @brief The priority of this job. Higher priority jobs obviously run sooner. */
     job_priority priority;
@@ -68,7 +84,7 @@ typedef struct job_info {
     /** @brief A function pointer to be invoked when the job successfully fails. Optional. */
     pfn_job_on_complete on_fail;
 
-    /** @brief Data to be passed to the entry point upon execution. */
+    /** @brief Data to be passed to the entry point upon execution. Small payloads are held in the job's slot, so this pointer is only valid until the job completes. */
     void* param_data;
 
     /** @brief The size of the data passed to the job. */
@@ -84,7 +100,10 @@ typedef struct job_info {
     u8 dependency_count;
 
     /** @brief An array of job identifiers that must be complete before this job starts. */
-    u16* dependency_ids;
+    u32* dependency_ids;
+
+    /** @brief An optional counter decremented once this job has finished. Set by job_system_submit_with_counter. */
+    job_counter* counter;
 } job_info;
 
 typedef struct job_system_config {
@@ -105,17 +124,17 @@ typedef struct job_system_config {
  * @param config A pointer to the configuration (job_system_config) of this system.
  * @returns True if the job system started up successfully; otherwise false.
  */
-b8 job_system_initialize(u64* job_system_memory_requirement, void* state, void* config);
+API b8 job_system_initialize(u64* job_system_memory_requirement, void* state, void* config);
 
 /**
  * @brief Shuts the job system down.
  */
-void job_system_shutdown(void* state);
+API void job_system_shutdown(void* state);
 
 /**
  * @brief Updates the job system. Should happen once an update cycle.
  */
-b8 job_system_update(void* state, struct frame_data* p_frame_data);
+API b8 job_system_update(void* state, struct frame_data* p_frame_data);
 
 /**
  * @brief Submits the provided job to be queued for execution.
@@ -123,6 +142,33 @@ b8 job_system_update(void* state, struct frame_data* p_frame_data);
  */
 API void job_system_submit(job_info info);
 
+/**
+ * @brief Submits the provided job to be queued for execution, incrementing the given counter.
+ * The counter is decremented once the job finishes running, after which any data the job
+ * wrote through its params is visible to a thread returning from job_system_wait_for_counter.
+ * NOTE: Success/fail callbacks are still invoked from job_system_update as usual.
+ * @param info The description of the job to be executed.
+ * @param counter A pointer to the counter to track the job with. Must outlive the job.
+ */
+API void job_system_submit_with_counter(job_info info, job_counter* counter);
+
+/**
+ * @brief Blocks until the given counter reaches zero. Rather than sleeping, the calling
+ * thread executes pending jobs it is allowed to run while it waits, so this is safe to
+ * call from within a job.
+ * @param counter A pointer to the counter to wait on.
+ */
+API void job_system_wait_for_counter(job_counter* counter);
+
+/**
+ * @brief Blocks until all of the jobs with the given identifiers have completed, executing
+ * pending jobs on the calling thread while it waits.
+ * @param job_count The number of job identifiers.
+ * @param job_ids An array of job identifiers to wait on.
+ * @returns True once all jobs have completed.
+ */
+API b8 job_system_wait_for_jobs(u8 job_count, u32* job_ids);
+
 /**
  * @brief Creates a new job with default type (Generic) and priority (Normal).
  * @param entry_point A pointer to a function to be invoked when the job starts. Required.
@@ -175,6 +221,8 @@ API job_info job_create_priority(pfn_job_start entry_point, pfn_job_on_complete
  * @param dependency_count The number of job identifiers which must be complete before this job runs.
  * @param dependencies An array of job identifiers which must be complete before this job runs.
  * @returns The newly created job information to be submitted for execution.
+ * NOTE: Creating a job reserves one of the job system's in-flight slots, which is only
+ * released once the job has run. Every created job must therefore be submitted.
  */
 API job_info job_create_with_dependencies(
     pfn_job_start entry_point,
@@ -186,9 +234,29 @@ API job_info job_create_with_dependencies(
     job_type type,
     job_priority priority,
     u8 dependency_count,
-    u16* dependencies);
+    u32* dependencies);
+
+/**
+ * @brief Indicates if the job system is initialized and running.
+ * @return True if running; otherwise false.
+ */
+API b8 job_system_is_running(void);
+
+/**
+ * @brief Runs fn over the range [0, count) in chunks of up to grain items, spread across
+ * the general job threads. The calling thread runs the first chunk itself and then helps
+ * with the rest, returning once every chunk has completed. Safe to call from within a job.
+ * Runs everything on the calling thread if the job system is not running.
+ * @param count The number of items in the range.
+ * @param grain The max number of items per chunk. Each chunk is a job, so this should be
+ * large enough that a chunk's work outweighs the cost of a job. 0 is treated as 1.
+ * @param fn The function to run on each chunk.
+ * @param userdata Passed through to fn. Optional.
+ */
+API void job_parallel_for(u32 count, u32 grain, pfn_job_parallel_for fn, void* userdata);
 
 /**
- * @brief Returns whether or not the job with the given identifier has completed.
+ * @brief Returns whether or not the job with the given identifier has completed. Lock-free.
+ * @param job_id The job identifier, as held in job_info.id. INVALID_ID always reads as complete.
  */
-API b8 job_system_query_job_complete(u16 job_id);
\ No newline at end of file
+API b8 job_system_query_job_complete(u32 job_id);
\ No newline at end of file
@@ -3,8 +3,6 @@
 #include "core/logger.h"
 #include "core/systems_manager.h"
 
-#define MAX_POINT_LIGHTS 10
-
 typedef struct light_system_state {
     directional_light* dir_light;
     point_light* p_lights[MAX_POINT_LIGHTS];
@@ -4,6 +4,9 @@
 
 #include "math/math_types.h"
 
+/** @brief The maximum number of point lights. Must match the size of the point light arrays in shaders. */
+#define MAX_POINT_LIGHTS 10
+
 typedef struct directional_light_data {
     /** @brief The light colour. */
     vec4 colour;
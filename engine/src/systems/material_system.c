@@ -1,7 +1,8 @@
 #include "material_system.h"
 
 #include "containers/darray.h"
-#include "containers/hashtable.h"
+#include "containers/hashmap.h"
+#include "core/kname.h"
 #include "core/event.h"
 #include "core/frame_data.h"
 #include "core/kmemory.h"
@@ -22,8 +23,6 @@
 #define PBR_MAP_COUNT 5
 #endif
 
-#define MAX_SHADOW_CASCADE_COUNT 4
-
 // Samplers
 const u32 SAMP_ALBEDO = 0;
 const u32 SAMP_NORMAL = 1;
@@ -56,7 +55,6 @@ typedef struct pbr_shader_uniform_locations {
     u16 light_space_1;
     u16 light_space_2;
     u16 light_space_3;
-    u16 model;
     u16 render_mode;
     u16 use_pcf;
     u16 bias;
@@ -106,8 +104,8 @@ typedef struct material_system_state {
     // Array of registered materials.
     material* registered_materials;
 
-    // Hashtable for material lookups.
-    hashtable registered_material_table;
+    // Map of material name (as a kname) to material_reference.
+    hashmap registered_material_table;
 
     // Known locations for terrain shader.
     terrain_shader_locations terrain_locations;
@@ -128,6 +126,22 @@ typedef struct material_system_state {
     matrix4 directional_light_space[MAX_SHADOW_CASCADE_COUNT];
 
     i32 use_pcf;
+
+    // The point lights as shaders take them, gathered once per frame and shared by all materials.
+    point_light_data p_light_datas[MAX_POINT_LIGHTS];
+    u32 p_light_count;
+
+    // The renderer frame number the point lights and upload counters below are for.
+    u64 frame_number;
+    // Bytes of uniform data uploaded so far this frame, by scope.
+    u32 global_bytes_uploaded;
+    u32 instance_bytes_uploaded;
+    // The number of materials whose instance data was rewritten so far this frame.
+    u32 instance_update_count;
+
+    // Signatures of the globals last applied to the PBR and terrain shaders. 0 if none.
+    u64 pbr_global_state;
+    u64 terrain_global_state;
 } material_system_state;
 
 typedef struct material_reference {
@@ -163,11 +177,10 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
         return false;
     }
 
-    // Block of memory will contain state structure, then block for array, then block for hashtable.
+    // Block of memory will contain state structure, then block for array. The lookup map allocates its own storage.
     u64 struct_requirement = sizeof(material_system_state);
     u64 array_requirement = sizeof(material) * typed_config->max_material_count;
-    u64 hashtable_requirement = sizeof(material_reference) * typed_config->max_material_count;
-    *memory_requirement = struct_requirement + array_requirement + hashtable_requirement;
+    *memory_requirement = struct_requirement + array_requirement;
 
     if (!state) {
         return true;
@@ -184,7 +197,6 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     state_ptr->pbr_locations.material_texures = INVALID_ID_U16;
     state_ptr->pbr_locations.shadow_textures = INVALID_ID_U16;
     state_ptr->pbr_locations.cascade_splits = INVALID_ID_U16;
-    state_ptr->pbr_locations.model = INVALID_ID_U16;
     state_ptr->pbr_locations.render_mode = INVALID_ID_U16;
     state_ptr->pbr_locations.properties = INVALID_ID_U16;
     state_ptr->pbr_locations.light_space_0 = INVALID_ID_U16;
@@ -214,22 +226,23 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     state_ptr->terrain_locations.use_pcf = INVALID_ID_U16;
     state_ptr->terrain_locations.bias = INVALID_ID_U16;
 
+    state_ptr->frame_number = INVALID_ID_U64;
+    state_ptr->p_light_count = 0;
+    state_ptr->global_bytes_uploaded = 0;
+    state_ptr->instance_bytes_uploaded = 0;
+    state_ptr->instance_update_count = 0;
+    state_ptr->pbr_global_state = 0;
+    state_ptr->terrain_global_state = 0;
+
     // The array block is after the state. Already allocated, so just set the pointer.
     void* array_block = state + struct_requirement;
     state_ptr->registered_materials = array_block;
 
-    // Hashtable block is after array.
-    void* hashtable_block = array_block + array_requirement;
-
-    // Create a hashtable for material lookups.
-    hashtable_create(sizeof(material_reference), typed_config->max_material_count, hashtable_block, false, &state_ptr->registered_material_table);
-
-    // Fill the hashtable with invalid references to use as a default.
-    material_reference invalid_ref;
-    invalid_ref.auto_release = false;
-    invalid_ref.handle = INVALID_ID;  // Primary reason for needing default values.
-    invalid_ref.reference_count = 0;
-    hashtable_fill(&state_ptr->registered_material_table, &invalid_ref);
+    // Create a map for material lookups. Names that are not present are treated as invalid references.
+    if (!hashmap_create(sizeof(material_reference), typed_config->max_material_count, HASHMAP_KEY_TYPE_U64, true, &state_ptr->registered_material_table)) {
+        DFATAL("material_system_initialize - Failed to create the material lookup map.");
+        return false;
+    }
 
     // Invalidate all materials in the array.
     u32 count = state_ptr->config.max_material_count;
@@ -256,7 +269,6 @@ b8 material_system_initialize(u64* memory_requirement, void* state, void* config
     state_ptr->pbr_locations.material_texures = shader_system_uniform_location(state_ptr->pbr_shader, "material_textures");
     state_ptr->pbr_locations.shadow_textures = shader_system_uniform_location(state_ptr->pbr_shader, "shadow_textures");
     state_ptr->pbr_locations.ibl_cube_texture = shader_system_uniform_location(state_ptr->pbr_shader, "ibl_cube_texture");
-    state_ptr->pbr_locations.model = shader_system_uniform_location(state_ptr->pbr_shader, "model");
     state_ptr->pbr_locations.render_mode = shader_system_uniform_location(state_ptr->pbr_shader, "mode");
     state_ptr->pbr_locations.dir_light = shader_system_uniform_location(state_ptr->pbr_shader, "dir_light");
     state_ptr->pbr_locations.p_lights = shader_system_uniform_location(state_ptr->pbr_shader, "p_lights");
@@ -331,6 +343,8 @@ void material_system_shutdown(void* state) {
         // Destroy the default material.
         destroy_material(&s->default_pbr_material);
         destroy_material(&s->default_terrain_material);
+
+        hashmap_destroy(&s->registered_material_table);
     }
 
     state_ptr = 0;
@@ -361,8 +375,16 @@ material* material_system_acquire(const char* name) {
 }
 
 static material* material_system_acquire_reference(const char* name, b8 auto_release, b8* needs_creation) {
-    material_reference ref;
-    if (state_ptr && hashtable_get(&state_ptr->registered_material_table, name, &ref)) {
+    if (state_ptr) {
+        kname name_id = kname_create(name);
+        material_reference ref;
+        if (!hashmap_get_u64(&state_ptr->registered_material_table, name_id, &ref)) {
+            // Not registered yet.
+            ref.auto_release = false;
+            ref.handle = INVALID_ID;
+            ref.reference_count = 0;
+        }
+
         // This can only be changed the first time a material is loaded.
         if (ref.reference_count == 0) {
             ref.auto_release = auto_release;
@@ -398,12 +420,14 @@ static material* material_system_acquire_reference(const char* name, b8 auto_rel
         }
 
         // Update the entry.
-        hashtable_set(&state_ptr->registered_material_table, name, &ref);
+        if (!hashmap_set_u64(&state_ptr->registered_material_table, name_id, &ref)) {
+            DERROR("material_system_acquire_from_config failed to register material '%s'. Null pointer will be returned.", name);
+            return 0;
+        }
         return &state_ptr->registered_materials[ref.handle];
     }
 
-    // NOTE: This would only happen in the event something went wrong with the state.
-    DERROR("material_system_acquire_from_config failed to acquire material '%s'. Null pointer will be returned.", name);
+    DERROR("material_system_acquire_from_config called before the material system is initialized. Null pointer will be returned.");
     return 0;
 }
 
@@ -619,18 +643,15 @@ void material_system_release(const char* name) {
     if (strings_equali(name, DEFAULT_PBR_MATERIAL_NAME) || strings_equali(name, DEFAULT_TERRAIN_MATERIAL_NAME)) {
         return;
     }
-    material_reference ref;
-    if (state_ptr && hashtable_get(&state_ptr->registered_material_table, name, &ref)) {
-        if (ref.reference_count == 0) {
+    if (state_ptr) {
+        // Resolved before the material that owns name can be destroyed.
+        kname name_id = kname_hash(name);
+        material_reference ref;
+        if (!hashmap_get_u64(&state_ptr->registered_material_table, name_id, &ref) || ref.reference_count == 0) {
             DWARN("Tried to release non-existent material: '%s'", name);
             return;
         }
 
-        // Take a copy of the name since it would be wiped out if destroyed,
-        // (as passed in name is generally a pointer to the actual material's name).
-        char name_copy[MATERIAL_NAME_MAX_LENGTH];
-        string_ncopy(name_copy, name, MATERIAL_NAME_MAX_LENGTH);
-
         ref.reference_count--;
         if (ref.reference_count == 0 && ref.auto_release) {
             material* m = &state_ptr->registered_materials[ref.handle];
@@ -641,13 +662,17 @@ void material_system_release(const char* name) {
             // Reset the reference.
             ref.handle = INVALID_ID;
             ref.auto_release = false;
-            // DTRACE("Released material '%s'., Material unloaded because reference count=0 and auto_release=true.", name_copy);
+            // DTRACE("Released material '%s'., Material unloaded because reference count=0 and auto_release=true.", kname_string_get(name_id));
         } else {
-            // DTRACE("Released material '%s', now has a reference count of '%i' (auto_release=%s).", name_copy, ref.reference_count, ref.auto_release ? "true" : "false");
+            // DTRACE("Released material '%s', now has a reference count of '%i' (auto_release=%s).", kname_string_get(name_id), ref.reference_count, ref.auto_release ? "true" : "false");
         }
 
-        // Update the entry.
-        hashtable_set(&state_ptr->registered_material_table, name_copy, &ref);
+        // Update the entry. Entries for destroyed materials are dropped rather than kept invalid.
+        if (ref.handle == INVALID_ID) {
+            hashmap_remove_u64(&state_ptr->registered_material_table, name_id);
+        } else {
+            hashmap_set_u64(&state_ptr->registered_material_table, name_id, &ref);
+        }
     } else {
         DERROR("material_system_release failed to release material '%s'.", name);
     }
@@ -681,151 +706,250 @@ material* material_system_get_default_terrain(void) {
         return false;                                 \
     }
 
+// Mixes a value into a material state signature.
+static u64 state_mix(u64 hash, u64 value) {
+    hash ^= value;
+    hash *= 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+}
+
+/**
+ * @brief Produces a signature of everything written into a material's instance data: its
+ * properties, and the texture and sampler of each of its maps. Never 0.
+ */
+static u64 material_instance_state(const material* m, u32 map_count) {
+    u64 hash = state_mix(0xCBF29CE484222325ull, m->internal_id);
+    hash = state_mix(hash, m->generation);
+    const u32* properties = m->properties;
+    for (u32 i = 0; properties && i < m->property_struct_size / sizeof(u32); ++i) {
+        hash = state_mix(hash, properties[i]);
+    }
+    for (u32 i = 0; i < map_count; ++i) {
+        const texture_map* map = &m->maps[i];
+        hash = state_mix(hash, (u64)map->texture);
+        hash = state_mix(hash, map->texture ? map->texture->generation : INVALID_ID);
+        hash = state_mix(hash, map->internal_id);
+    }
+    return hash ? hash : 1;
+}
+
+// Mixes a block of data into a state signature, a u32 at a time.
+static u64 state_mix_data(u64 hash, const void* data, u32 size) {
+    const u32* words = data;
+    for (u32 i = 0; i < size / sizeof(u32); ++i) {
+        hash = state_mix(hash, words[i]);
+    }
+    return hash;
+}
+
+/**
+ * @brief Produces a signature of everything written into a shader's globals by
+ * material_system_apply_global, other than the lights, which only change between frames. Never 0.
+ */
+static u64 material_global_state(const matrix4* projection, const matrix4* view, const vec4* ambient_colour, const vec3* view_position, u32 render_mode) {
+    u64 hash = state_mix_data(0xCBF29CE484222325ull, projection, sizeof(matrix4));
+    hash = state_mix_data(hash, view, sizeof(matrix4));
+    hash = state_mix_data(hash, ambient_colour, sizeof(vec4));
+    hash = state_mix_data(hash, view_position, sizeof(vec3));
+    hash = state_mix(hash, render_mode);
+    hash = state_mix_data(hash, state_ptr->directional_light_space, sizeof(state_ptr->directional_light_space));
+    hash = state_mix(hash, (u32)state_ptr->use_pcf);
+    return hash ? hash : 1;
+}
+
+/**
+ * @brief Starts a new frame on the first apply within it. Publishes the last frame's upload
+ * counters to the frame data, and gathers the point lights all materials share.
+ */
+static void material_system_frame_sync(frame_data* p_frame_data) {
+    if (state_ptr->frame_number == p_frame_data->renderer_frame_number) {
+        return;
+    }
+    state_ptr->frame_number = p_frame_data->renderer_frame_number;
+
+    p_frame_data->material_global_bytes_uploaded = state_ptr->global_bytes_uploaded;
+    p_frame_data->material_instance_bytes_uploaded = state_ptr->instance_bytes_uploaded;
+    p_frame_data->material_instance_update_count = state_ptr->instance_update_count;
+    state_ptr->global_bytes_uploaded = 0;
+    state_ptr->instance_bytes_uploaded = 0;
+    state_ptr->instance_update_count = 0;
+
+    point_light p_lights[MAX_POINT_LIGHTS];
+    state_ptr->p_light_count = KMIN(light_system_point_light_count(), MAX_POINT_LIGHTS);
+    light_system_point_lights_get(p_lights);
+    for (u32 i = 0; i < state_ptr->p_light_count; ++i) {
+        state_ptr->p_light_datas[i] = p_lights[i].data;
+    }
+    // The whole array is uploaded, so keep the unused part from holding stale lights.
+    kzero_memory(&state_ptr->p_light_datas[state_ptr->p_light_count], sizeof(point_light_data) * (MAX_POINT_LIGHTS - state_ptr->p_light_count));
+}
+
+// Sets a uniform on the current shader, counting its size towards this frame's uploads.
+static b8 material_uniform_set(shader* s, u16 location, const void* value) {
+    if (!shader_system_uniform_set_by_location(location, value)) {
+        return false;
+    }
+    const shader_uniform* uniform = &s->uniforms[location];
+    if (uniform->scope == SHADER_SCOPE_GLOBAL) {
+        state_ptr->global_bytes_uploaded += uniform->size;
+    } else if (uniform->scope == SHADER_SCOPE_INSTANCE) {
+        state_ptr->instance_bytes_uploaded += uniform->size;
+    }
+    return true;
+}
+
 b8 material_system_apply_global(u32 shader_id, struct frame_data* p_frame_data, const matrix4* projection, const matrix4* view, const vec4* ambient_colour, const vec3* view_position, u32 render_mode) {
     shader* s = shader_system_get_by_id(shader_id);
     if (!s) {
         return false;
     }
-    if (s->render_frame_number == p_frame_data->renderer_frame_number && s->draw_index == p_frame_data->draw_index) {
+    u64* applied_state = 0;
+    if (shader_id == state_ptr->terrain_shader_id) {
+        applied_state = &state_ptr->terrain_global_state;
+    } else if (shader_id == state_ptr->pbr_shader_id) {
+        applied_state = &state_ptr->pbr_global_state;
+    }
+    // Globals are only written once per frame and draw, unless a pass applies a different view in the same draw.
+    u64 global_state = material_global_state(projection, view, ambient_colour, view_position, render_mode);
+    if (s->render_frame_number == p_frame_data->renderer_frame_number && s->draw_index == p_frame_data->draw_index && applied_state && *applied_state == global_state) {
         return true;
     }
+    material_system_frame_sync(p_frame_data);
+
+    // Directional light - global for both shaders.
+    directional_light* dir_light = light_system_directional_light_get();
+    directional_light_data dir_light_data = {0};
+    if (dir_light) {
+        dir_light_data = dir_light->data;
+    }
 
     if (shader_id == state_ptr->terrain_shader_id) {
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.projection, projection));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.view, view));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.projection, projection));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.view, view));
         // TODO: set cascade splits like dir lights and shadow map, etc.
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.cascade_splits, ambient_colour));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.view_position, view_position));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.render_mode, &render_mode));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.cascade_splits, ambient_colour));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.view_position, view_position));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.render_mode, &render_mode));
         // Light space for shadow mapping. Per cascade
         for (u32 i = 0; i < MAX_SHADOW_CASCADE_COUNT; ++i) {
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.light_space_0 + i, &state_ptr->directional_light_space[i]));
-        }
-        // Directional light - global for this shader..
-        directional_light* dir_light = light_system_directional_light_get();
-        if (dir_light) {
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.dir_light, &dir_light->data));
-        } else {
-            directional_light_data data = {0};
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.dir_light, &data));
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.light_space_0 + i, &state_ptr->directional_light_space[i]));
         }
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.dir_light, &dir_light_data));
+        // Point lights.
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.p_lights, state_ptr->p_light_datas));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.num_p_lights, &state_ptr->p_light_count));
         // Global shader options.
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.use_pcf, &state_ptr->use_pcf));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.use_pcf, &state_ptr->use_pcf));
 
         // HACK: Read this in from somewhere (or have global setter?);
         f32 bias = 0.00005f;
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.bias, &bias));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.bias, &bias));
     } else if (shader_id == state_ptr->pbr_shader_id) {
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.projection, projection));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.view, view));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.projection, projection));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.view, view));
         // TODO: set cascade splits like dir lights and shadow map, etc.
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.cascade_splits, ambient_colour));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.view_position, view_position));
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.render_mode, &render_mode));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.cascade_splits, ambient_colour));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.view_position, view_position));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.render_mode, &render_mode));
         // Light space for shadow mapping. Per cascade
         for (u32 i = 0; i < MAX_SHADOW_CASCADE_COUNT; ++i) {
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.light_space_0 + i, &state_ptr->directional_light_space[i]));
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.light_space_0 + i, &state_ptr->directional_light_space[i]));
         }
         // Global shader options.
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.use_pcf, &state_ptr->use_pcf));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.use_pcf, &state_ptr->use_pcf));
 
         // HACK: Read this in from somewhere (or have global setter?);
         f32 bias = 0.00005f;
-        MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.bias, &bias));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.bias, &bias));
+
+        // Lights are the same for every material, so are uploaded here once rather than per material.
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.dir_light, &dir_light_data));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.p_lights, state_ptr->p_light_datas));
+        MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.num_p_lights, &state_ptr->p_light_count));
     } else {
         DERROR("material_system_apply_global(): Unrecognized shader id '%d' ", shader_id);
         return false;
     }
     MATERIAL_APPLY_OR_FAIL(shader_system_apply_global(true, p_frame_data));
 
-    // Sync the frame number.
+    // Sync the frame number, draw index and the globals applied in them.
     s->render_frame_number = p_frame_data->renderer_frame_number;
+    s->draw_index = p_frame_data->draw_index;
+    *applied_state = global_state;
     return true;
 }
 
 b8 material_system_apply_instance(material* m, struct frame_data* p_frame_data, b8 needs_update) {
+    material_system_frame_sync(p_frame_data);
+
     // Apply instance-level uniforms.
     MATERIAL_APPLY_OR_FAIL(shader_system_bind_instance(m->internal_id));
     if (needs_update) {
+        shader* s = 0;
+        u32 map_count = 0;
         if (m->shader_id == state_ptr->pbr_shader_id) {
+            s = state_ptr->pbr_shader;
+            map_count = PBR_MAP_COUNT;
+            m->maps[SAMP_SHADOW_MAP].texture = state_ptr->shadow_texture ? state_ptr->shadow_texture : texture_system_get_default_diffuse_texture();
+            m->maps[SAMP_IRRADIANCE_MAP].texture = m->irradiance_texture ? m->irradiance_texture : state_ptr->irradiance_cube_texture;
+        } else if (m->shader_id == state_ptr->terrain_shader_id) {
+            s = state_ptr->terrain_shader;
+            map_count = TERRAIN_SAMP_COUNT;
+            m->maps[SAMP_TERRAIN_SHADOW_MAP].texture = state_ptr->shadow_texture ? state_ptr->shadow_texture : texture_system_get_default_diffuse_texture();
+            m->maps[SAMP_TERRAIN_IRRADIANCE_MAP].texture = m->irradiance_texture ? m->irradiance_texture : state_ptr->irradiance_cube_texture;
+        } else {
+            DERROR("material_system_apply_instance(): Unrecognized shader id '%d' on shader '%s'.", m->shader_id, m->name);
+            return false;
+        }
+
+        // Each render target has its own descriptors, so track what each was last written with.
+        // When nothing has changed since, the material only needs to be bound. The instance uniforms
+        // themselves are in a single region shared by every target, which is why a write below also
+        // forgets any other target that was last written with a different state.
+        u64 applied_state = material_instance_state(m, map_count);
+        u64 target_index = p_frame_data->render_target_index;
+        if (target_index < MATERIAL_MAX_RENDER_TARGETS && m->applied_states[target_index] == applied_state) {
+            needs_update = false;
+        } else if (m->shader_id == state_ptr->pbr_shader_id) {
             // PBR shader
             // Properties
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.properties, m->properties));
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.properties, m->properties));
             // Maps
             MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location_arrayed(state_ptr->pbr_locations.material_texures, SAMP_ALBEDO, &m->maps[SAMP_ALBEDO]));
             MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location_arrayed(state_ptr->pbr_locations.material_texures, SAMP_NORMAL, &m->maps[SAMP_NORMAL]));
             MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location_arrayed(state_ptr->pbr_locations.material_texures, SAMP_COMBINED, &m->maps[SAMP_COMBINED]));
 
             // Shadow Maps
-            m->maps[SAMP_SHADOW_MAP].texture = state_ptr->shadow_texture ? state_ptr->shadow_texture : texture_system_get_default_diffuse_texture();
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.shadow_textures, &m->maps[SAMP_SHADOW_MAP]));
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.shadow_textures, &m->maps[SAMP_SHADOW_MAP]));
 
             // Irradience map
-            m->maps[SAMP_IRRADIANCE_MAP].texture = m->irradiance_texture ? m->irradiance_texture : state_ptr->irradiance_cube_texture;
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.ibl_cube_texture, &m->maps[SAMP_IRRADIANCE_MAP]));
-
-            // Directional light.
-            directional_light* dir_light = light_system_directional_light_get();
-            if (dir_light) {
-                MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.dir_light, &dir_light->data));
-            } else {
-                directional_light_data data = {0};
-                MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.dir_light, &data));
-            }
-            // Point lights.
-            u32 p_light_count = light_system_point_light_count();
-            if (p_light_count) {
-                point_light* p_lights = p_frame_data->allocator.allocate(sizeof(point_light) * p_light_count);
-                light_system_point_lights_get(p_lights);
-
-                point_light_data* p_light_datas = p_frame_data->allocator.allocate(sizeof(point_light_data) * p_light_count);
-                for (u32 i = 0; i < p_light_count; ++i) {
-                    p_light_datas[i] = p_lights[i].data;
-                }
-
-                MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.p_lights, p_light_datas));
-            }
-
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->pbr_locations.num_p_lights, &p_light_count));
-
-        } else if (m->shader_id == state_ptr->terrain_shader_id) {
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->pbr_locations.ibl_cube_texture, &m->maps[SAMP_IRRADIANCE_MAP]));
+        } else {
             // Apply material maps, all as one layered texture.
-            // m->maps[SAMP_TERRAIN_MATERIAL_ARRAY_MAP].texture = state_ptr->shadow_texture ? state_ptr->shadow_texture : texture_system_get_default_terrain_texture();
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.material_texures, &m->maps[SAMP_TERRAIN_MATERIAL_ARRAY_MAP]));
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.material_texures, &m->maps[SAMP_TERRAIN_MATERIAL_ARRAY_MAP]));
 
             // NOTE: apply other maps separately.
 
             // Shadow Maps
-            m->maps[SAMP_TERRAIN_SHADOW_MAP].texture = state_ptr->shadow_texture ? state_ptr->shadow_texture : texture_system_get_default_diffuse_texture();
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.shadow_textures, &m->maps[SAMP_TERRAIN_SHADOW_MAP]));
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.shadow_textures, &m->maps[SAMP_TERRAIN_SHADOW_MAP]));
 
             // Irradience map
-            m->maps[SAMP_TERRAIN_IRRADIANCE_MAP].texture = m->irradiance_texture ? m->irradiance_texture : state_ptr->irradiance_cube_texture;
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.ibl_cube_texture, &m->maps[SAMP_TERRAIN_IRRADIANCE_MAP]));
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.ibl_cube_texture, &m->maps[SAMP_TERRAIN_IRRADIANCE_MAP]));
 
             // Apply properties.
-            shader_system_uniform_set_by_location(state_ptr->terrain_locations.properties, m->properties);
-
-            // TODO: Duplicating above... move this to its own function, perhaps.
-
-            // Point lights.
-            u32 p_light_count = light_system_point_light_count();
-            if (p_light_count) {
-                point_light* p_lights = p_frame_data->allocator.allocate(sizeof(point_light) * p_light_count);
-                light_system_point_lights_get(p_lights);
+            MATERIAL_APPLY_OR_FAIL(material_uniform_set(s, state_ptr->terrain_locations.properties, m->properties));
+        }
 
-                point_light_data* p_light_datas = p_frame_data->allocator.allocate(sizeof(point_light_data) * p_light_count);
-                for (u32 i = 0; i < p_light_count; ++i) {
-                    p_light_datas[i] = p_lights[i].data;
+        if (needs_update) {
+            for (u32 i = 0; i < MATERIAL_MAX_RENDER_TARGETS; ++i) {
+                if (m->applied_states[i] != applied_state) {
+                    m->applied_states[i] = 0;
                 }
-
-                MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.p_lights, p_light_datas));
             }
-
-            MATERIAL_APPLY_OR_FAIL(shader_system_uniform_set_by_location(state_ptr->terrain_locations.num_p_lights, &p_light_count));
-        } else {
-            DERROR("material_system_apply_instance(): Unrecognized shader id '%d' on shader '%s'.", m->shader_id, m->name);
-            return false;
+            if (target_index < MATERIAL_MAX_RENDER_TARGETS) {
+                m->applied_states[target_index] = applied_state;
+            }
+            state_ptr->instance_update_count++;
         }
     }
     MATERIAL_APPLY_OR_FAIL(shader_system_apply_instance(needs_update, p_frame_data));
@@ -836,9 +960,8 @@ b8 material_system_apply_instance(material* m, struct frame_data* p_frame_data,
 b8 material_system_apply_local(material* m, const matrix4* model, frame_data* p_frame_data) {
     shader_system_bind_local();
     b8 result = false;
-    if (m->shader_id == state_ptr->pbr_shader_id) {
-        result = shader_system_uniform_set_by_location(state_ptr->pbr_locations.model, model);
-    } else if (m->shader_id == state_ptr->terrain_shader_id) {
+    // NOTE: The PBR shader is instanced, and takes its model matrices from the instance buffer instead.
+    if (m->shader_id == state_ptr->terrain_shader_id) {
         result = shader_system_uniform_set_by_location(state_ptr->terrain_locations.model, model);
     }
     shader_system_apply_local(p_frame_data);
@@ -877,14 +1000,12 @@ void material_system_directional_light_space_set(matrix4 directional_light_space
 }
 
 void material_system_dump(void) {
-    material_reference* refs = (material_reference*)state_ptr->registered_material_table.memory;
-    for (u32 i = 0; i < state_ptr->registered_material_table.element_count; ++i) {
-        material_reference* r = &refs[i];
-        if (r->reference_count > 0 || r->handle != INVALID_ID) {
-            DDEBUG("Found material ref (handle/refCount): (%u/%u)", r->handle, r->reference_count);
-            if (r->handle != INVALID_ID) {
-                DTRACE("Material name: %s", state_ptr->registered_materials[r->handle].name);
-            }
+    for (u32 i = 0; i < state_ptr->config.max_material_count; ++i) {
+        material* m = &state_ptr->registered_materials[i];
+        material_reference r;
+        if (m->id != INVALID_ID && hashmap_get_u64(&state_ptr->registered_material_table, kname_hash(m->name), &r)) {
+            DDEBUG("Found material ref (handle/refCount): (%u/%u)", r.handle, r.reference_count);
+            DTRACE("Material name: %s", m->name);
         }
     }
 }
@@ -1393,4 +1514,4 @@ static b8 create_default_terrain_material(material_system_state* state) {
     state->default_terrain_material.shader_id = s->id;
 
     return true;
-}
\ No newline at end of file
+}
\ No newline at end of file
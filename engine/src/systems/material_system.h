@@ -94,7 +94,8 @@ API material* material_system_get_default_pbr(void);
 API material* material_system_get_default_terrain(void);
 
 /**
- * @brief Applies global-level data for the material shader id.
+ * @brief Applies global-level data for the material shader id. This includes the lights,
+ * which are shared by all materials and so only uploaded here, once per frame.
  *
  * @param shader_id The identifier of the shader to apply globals for.
  * @param p_frame_data A constant pointer to the current frame's data.
@@ -112,13 +113,16 @@ API b8 material_system_apply_global(u32 shader_id, struct frame_data* p_frame_da
  *
  * @param m A pointer to the material to be applied.
  * @param p_frame_data A pointer to the current frame's data.
- * @param needs_update Indicates if material internals require updating, or if they should just be bound.
+ * @param needs_update Indicates if material internals may require updating, or if they should just be bound.
+ * Even when true, they are only rewritten if they changed since last written for the current render target.
  * @return True on success; otherwise false.
  */
 API b8 material_system_apply_instance(material* m, struct frame_data* p_frame_data, b8 needs_update);
 
 /**
  * @brief Applies local-level material data (typically just model matrix).
+ * Not used for materials with instanced shaders, such as PBR materials, which
+ * take their model matrices per instance.
  *
  * @param m A pointer to the material to be applied.
  * @param model A constant pointer to the model matrix to be applied.
@@ -207,5 +207,6 @@ static b8 load(const char *name, resource_loader *loader, void *params,
     }
 
     out_resource->loader_id = loader->id;
+    out_resource->loader_data = 0;
     return loader->load(loader, name, params, out_resource);
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "shader_system.h"
 
 #include "containers/darray.h"
+#include "containers/hashmap.h"
 #include "core/event.h"
 #include "core/frame_data.h"
+#include "core/kname.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
@@ -16,10 +18,8 @@
 typedef struct shader_system_state {
     // This system's configuration.
     shader_system_config config;
-    // A lookup table for shader name->id
-    hashtable lookup;
-    // The memory used for the lookup table.
-    void* lookup_memory;
+    // A lookup table for shader name (as a kname)->id
+    hashmap lookup;
     // The identifier for the currently bound shader.
     u32 current_shader_id;
     // A collection of created shaders.
@@ -67,35 +67,30 @@ static b8 file_watch_event(u16 code, void* sender, void* listener_inst, event_co
 b8 shader_system_initialize(u64* memory_requirement, void* memory, void* config) {
     shader_system_config* typed_config = (shader_system_config*)config;
     // Verify configuration.
-    if (typed_config->max_shader_count < 512) {
-        if (typed_config->max_shader_count == 0) {
-            DERROR("shader_system_initialize - config.max_shader_count must be greater than 0");
-            return false;
-        } else {
-            // This is to help avoid hashtable collisions.
-            DWARN("shader_system_initialize - config.max_shader_count is recommended to be at least 512.");
-        }
+    if (typed_config->max_shader_count == 0) {
+        DERROR("shader_system_initialize - config.max_shader_count must be greater than 0");
+        return false;
     }
 
-    // Figure out how large of a hashtable is needed.
-    // Block of memory will contain state structure then the block for the hashtable.
+    // Block of memory will contain state structure then the shader array. The lookup map allocates its own storage.
     u64 struct_requirement = sizeof(shader_system_state);
-    u64 hashtable_requirement = sizeof(u32) * typed_config->max_shader_count;
     u64 shader_array_requirement = sizeof(shader) * typed_config->max_shader_count;
-    *memory_requirement = struct_requirement + hashtable_requirement + shader_array_requirement;
+    *memory_requirement = struct_requirement + shader_array_requirement;
 
     if (!memory) {
         return true;
     }
 
-    // Setup the state pointer, memory block, shader array, then create the hashtable.
+    // Setup the state pointer, memory block, shader array, then create the lookup map.
     state_ptr = memory;
     u64 addr = (u64)memory;
-    state_ptr->lookup_memory = (void*)(addr + struct_requirement);
-    state_ptr->shaders = (void*)((u64)state_ptr->lookup_memory + hashtable_requirement);
+    state_ptr->shaders = (void*)(addr + struct_requirement);
     state_ptr->config = *typed_config;
     state_ptr->current_shader_id = INVALID_ID;
-    hashtable_create(sizeof(u32), typed_config->max_shader_count, state_ptr->lookup_memory, false, &state_ptr->lookup);
+    if (!hashmap_create(sizeof(u32), typed_config->max_shader_count, HASHMAP_KEY_TYPE_U64, false, &state_ptr->lookup)) {
+        DERROR("shader_system_initialize - Failed to create the shader lookup map.");
+        return false;
+    }
 
     // Invalidate all shader ids.
     for (u32 i = 0; i < typed_config->max_shader_count; ++i) {
@@ -103,13 +98,6 @@ b8 shader_system_initialize(u64* memory_requirement, void* memory, void* config)
         state_ptr->shaders[i].render_frame_number = INVALID_ID_U64;
     }
 
-    // Fill the table with invalid ids.
-    u32 invalid_fill_id = INVALID_ID;
-    if (!hashtable_fill(&state_ptr->lookup, &invalid_fill_id)) {
-        DERROR("hashtable_fill failed.");
-        return false;
-    }
-
     for (u32 i = 0; i < state_ptr->config.max_shader_count; ++i) {
         state_ptr->shaders[i].id = INVALID_ID;
     }
@@ -132,7 +120,7 @@ void shader_system_shutdown(void* state) {
                 internal_shader_destroy(s);
             }
         }
-        hashtable_destroy(&st->lookup);
+        hashmap_destroy(&st->lookup);
         kzero_memory(st, sizeof(shader_system_state));
     }
 
@@ -226,9 +214,9 @@ b8 shader_system_create(renderpass* pass, const shader_config* config) {
         return false;
     }
 
-    // At this point, creation is successful, so store the shader id in the hashtable
+    // At this point, creation is successful, so store the shader id in the lookup map
     // so this can be looked up by name later.
-    if (!hashtable_set(&state_ptr->lookup, config->name, &out_shader->id)) {
+    if (!hashmap_set_u64(&state_ptr->lookup, kname_create(config->name), &out_shader->id)) {
         // Dangit, we got so far... welp, nuke the shader and boot.
         renderer_shader_destroy(out_shader);
         return false;
@@ -247,7 +235,7 @@ b8 shader_system_reload(shader* s) {
 
 u32 shader_system_get_id(const char* shader_name) {
     u32 shader_id = INVALID_ID;
-    if (!hashtable_get(&state_ptr->lookup, shader_name, &shader_id)) {
+    if (!hashmap_get_u64(&state_ptr->lookup, kname_hash(shader_name), &shader_id)) {
         DERROR("There is no shader registered named '%s'.", shader_name);
         return INVALID_ID;
     }
@@ -308,6 +296,7 @@ void shader_system_destroy(const char* shader_name) {
     shader* s = &state_ptr->shaders[shader_id];
 
     internal_shader_destroy(s);
+    hashmap_remove_u64(&state_ptr->lookup, kname_hash(shader_name));
 }
 
 b8 shader_system_use(const char* shader_name) {
@@ -74,7 +74,9 @@ typedef enum shader_flags {
     SHADER_FLAG_DEPTH_WRITE = 0x02,
     SHADER_FLAG_WIREFRAME = 0x04,
     SHADER_FLAG_STENCIL_TEST = 0x08,
-    SHADER_FLAG_STENCIL_WRITE = 0x10
+    SHADER_FLAG_STENCIL_WRITE = 0x10,
+    // Takes its model matrix per instance, from the renderer's instance buffer, instead of as a local.
+    SHADER_FLAG_INSTANCED = 0x20
 } shader_flags;
 
 typedef u32 shader_flag_bits;
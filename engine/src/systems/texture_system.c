@@ -1,6 +1,7 @@
 #include "texture_system.h"
 
-#include "containers/hashtable.h"
+#include "containers/hashmap.h"
+#include "core/kname.h"
 #include "core/kmemory.h"
 #include "core/kstring.h"
 #include "core/logger.h"
@@ -25,8 +26,8 @@ typedef struct texture_system_state {
     // Array of registered textures.
     texture* registered_textures;
 
-    // Hashtable for texture lookups.
-    hashtable registered_texture_table;
+    // Map of texture name (as a kname) to texture_reference.
+    hashmap registered_texture_table;
 } texture_system_state;
 
 typedef struct texture_reference {
@@ -86,11 +87,10 @@ b8 texture_system_initialize(u64* memory_requirement, void* state, void* config)
         return false;
     }
 
-    // Block of memory will contain state structure, then block for array, then block for hashtable.
+    // Block of memory will contain state structure, then block for array. The lookup map allocates its own storage.
     u64 struct_requirement = sizeof(texture_system_state);
     u64 array_requirement = sizeof(texture) * typed_config->max_texture_count;
-    u64 hashtable_requirement = sizeof(texture_reference) * typed_config->max_texture_count;
-    *memory_requirement = struct_requirement + array_requirement + hashtable_requirement;
+    *memory_requirement = struct_requirement + array_requirement;
 
     if (!state) {
         return true;
@@ -103,18 +103,12 @@ b8 texture_system_initialize(u64* memory_requirement, void* state, void* config)
     void* array_block = state + struct_requirement;
     state_ptr->registered_textures = array_block;
 
-    // Hashtable block is after array.
-    void* hashtable_block = array_block + array_requirement;
-
-    // Create a hashtable for texture lookups.
-    hashtable_create(sizeof(texture_reference), typed_config->max_texture_count, hashtable_block, false, &state_ptr->registered_texture_table);
-
-    // Fill the hashtable with invalid references to use as a default.
-    texture_reference invalid_ref;
-    invalid_ref.auto_release = false;
-    invalid_ref.handle = INVALID_ID;  // Primary reason for needing default values.
-    invalid_ref.reference_count = 0;
-    hashtable_fill(&state_ptr->registered_texture_table, &invalid_ref);
+    // Create a map for texture lookups. Names that are not present are treated as invalid references.
+    // Can hold one entry per texture slot, plus non-auto-release names that have dropped to 0 references.
+    if (!hashmap_create(sizeof(texture_reference), typed_config->max_texture_count, HASHMAP_KEY_TYPE_U64, true, &state_ptr->registered_texture_table)) {
+        DFATAL("texture_system_initialize - Failed to create the texture lookup map.");
+        return false;
+    }
 
     // Invalidate all textures in the array.
     u32 count = state_ptr->config.max_texture_count;
@@ -141,6 +135,8 @@ void texture_system_shutdown(void* state) {
 
         destroy_default_textures(state_ptr);
 
+        hashmap_destroy(&state_ptr->registered_texture_table);
+
         state_ptr = 0;
     }
 }
@@ -1086,98 +1082,102 @@ static b8 process_texture_reference(const char* name, i8 reference_diff, b8 auto
     *out_texture_id = INVALID_ID;
     *needs_creation = false;
     if (state_ptr) {
+        // Resolved before anything below can destroy the texture that owns name. Only acquiring
+        // interns the name; a release of a name never acquired must not add it to the table.
+        kname name_id = reference_diff > 0 ? kname_create(name) : kname_hash(name);
         texture_reference ref;
-        if (hashtable_get(&state_ptr->registered_texture_table, name, &ref)) {
-            // If the reference count starts off at zero, one of two things can be
-            // true. If incrementing references, this means the entry is new. If
-            // decrementing, then the texture doesn't exist _if_ not auto-releasing.
-            if (ref.reference_count == 0 && reference_diff > 0) {
-                if (reference_diff > 0) {
-                    // This can only be changed the first time a texture is loaded.
-                    ref.auto_release = auto_release;
+        if (!hashmap_get_u64(&state_ptr->registered_texture_table, name_id, &ref)) {
+            // Not registered yet.
+            ref.auto_release = false;
+            ref.handle = INVALID_ID;
+            ref.reference_count = 0;
+        }
+
+        // If the reference count starts off at zero, one of two things can be
+        // true. If incrementing references, this means the entry is new. If
+        // decrementing, then the texture doesn't exist _if_ not auto-releasing.
+        if (ref.reference_count == 0 && reference_diff > 0) {
+            if (reference_diff > 0) {
+                // This can only be changed the first time a texture is loaded.
+                ref.auto_release = auto_release;
+            } else {
+                if (ref.auto_release) {
+                    DWARN("Tried to release non-existent texture: '%s'", name);
+                    return false;
                 } else {
-                    if (ref.auto_release) {
-                        DWARN("Tried to release non-existent texture: '%s'", name);
-                        return false;
-                    } else {
-                        DWARN("Tried to release a texture where autorelease=false, but references was already 0.");
-                        // Still count this as a success, but warn about it.
-                        return true;
-                    }
+                    DWARN("Tried to release a texture where autorelease=false, but references was already 0.");
+                    // Still count this as a success, but warn about it.
+                    return true;
                 }
             }
+        }
 
-            ref.reference_count += reference_diff;
+        ref.reference_count += reference_diff;
 
-            // Take a copy of the name since it would be wiped out if destroyed,
-            // (as passed in name is generally a pointer to the actual texture's name).
-            char name_copy[TEXTURE_NAME_MAX_LENGTH];
-            string_ncopy(name_copy, name, TEXTURE_NAME_MAX_LENGTH);
+        // If decrementing, this means a release.
+        if (reference_diff < 0) {
+            // Check if the reference count has reached 0. If it has, and the reference
+            // is set to auto-release, destroy the texture.
+            if (ref.reference_count == 0 && ref.auto_release) {
+                texture* t = &state_ptr->registered_textures[ref.handle];
 
-            // If decrementing, this means a release.
-            if (reference_diff < 0) {
-                // Check if the reference count has reached 0. If it has, and the reference
-                // is set to auto-release, destroy the texture.
-                if (ref.reference_count == 0 && ref.auto_release) {
-                    texture* t = &state_ptr->registered_textures[ref.handle];
-
-                    // Destroy/reset texture.
-                    destroy_texture(t);
-
-                    // Reset the reference.
-                    ref.handle = INVALID_ID;
-                    ref.auto_release = false;
-                    // DTRACE("Released texture '%s'., Texture unloaded because reference count=0 and auto_release=true.", name_copy);
-                } else {
-                    // DTRACE("Released texture '%s', now has a reference count of '%i' (auto_release=%s).", name_copy, ref.reference_count, ref.auto_release ? "true" : "false");
-                }
+                // Destroy/reset texture.
+                destroy_texture(t);
 
+                // Reset the reference.
+                ref.handle = INVALID_ID;
+                ref.auto_release = false;
+                // DTRACE("Released texture '%s'., Texture unloaded because reference count=0 and auto_release=true.", kname_string_get(name_id));
             } else {
-                // Incrementing. Check if the handle is new or not.
-                if (ref.handle == INVALID_ID) {
-                    // This means no texture exists here. Find a free index first.
-                    u32 count = state_ptr->config.max_texture_count;
-
-                    for (u32 i = 0; i < count; ++i) {
-                        if (state_ptr->registered_textures[i].id == INVALID_ID) {
-                            // A free slot has been found. Use its index as the handle.
-                            ref.handle = i;
-                            *out_texture_id = i;
-                            break;
-                        }
-                    }
+                // DTRACE("Released texture '%s', now has a reference count of '%i' (auto_release=%s).", kname_string_get(name_id), ref.reference_count, ref.auto_release ? "true" : "false");
+            }
 
-                    // An empty slot was not found, bleat about it and boot out.
-                    if (*out_texture_id == INVALID_ID) {
-                        DFATAL("process_texture_reference - Texture system cannot hold anymore textures. Adjust configuration to allow more.");
-                        return false;
-                    } else {
-                        // Setup some basic properties on the texture.
-                        texture* t = &state_ptr->registered_textures[ref.handle];
-                        t->id = ref.handle;
-                        t->generation = INVALID_ID;
-                        t->internal_data = 0;
-                        // Make sure to hold onto the texture name.
-                        string_ncopy(t->name, name, TEXTURE_NAME_MAX_LENGTH);
-                        // DTRACE("Texture '%s' does not yet exist. Created, and ref_count is now %i.", name, ref.reference_count);
-                        *needs_creation = true;
+        } else {
+            // Incrementing. Check if the handle is new or not.
+            if (ref.handle == INVALID_ID) {
+                // This means no texture exists here. Find a free index first.
+                u32 count = state_ptr->config.max_texture_count;
+
+                for (u32 i = 0; i < count; ++i) {
+                    if (state_ptr->registered_textures[i].id == INVALID_ID) {
+                        // A free slot has been found. Use its index as the handle.
+                        ref.handle = i;
+                        *out_texture_id = i;
+                        break;
                     }
+                }
+
+                // An empty slot was not found, bleat about it and boot out.
+                if (*out_texture_id == INVALID_ID) {
+                    DFATAL("process_texture_reference - Texture system cannot hold anymore textures. Adjust configuration to allow more.");
+                    return false;
                 } else {
-                    *out_texture_id = ref.handle;
-                    // DTRACE("Texture '%s' already exists, ref_count increased to %i.", name, ref.reference_count);
+                    // Setup some basic properties on the texture.
+                    texture* t = &state_ptr->registered_textures[ref.handle];
+                    t->id = ref.handle;
+                    t->generation = INVALID_ID;
+                    t->internal_data = 0;
+                    // Make sure to hold onto the texture name.
+                    string_ncopy(t->name, name, TEXTURE_NAME_MAX_LENGTH);
+                    // DTRACE("Texture '%s' does not yet exist. Created, and ref_count is now %i.", name, ref.reference_count);
+                    *needs_creation = true;
                 }
+            } else {
+                *out_texture_id = ref.handle;
+                // DTRACE("Texture '%s' already exists, ref_count increased to %i.", name, ref.reference_count);
             }
-
-            // Either way, update the entry.
-            hashtable_set(&state_ptr->registered_texture_table, name_copy, &ref);
-            return true;
         }
 
-        // NOTE: This would only happen in the event something went wrong with the state.
-        DERROR("process_texture_reference failed to acquire id for name '%s'. INVALID_ID returned.", name);
-        return false;
+        // Either way, update the entry. Entries for destroyed textures are dropped rather than kept invalid.
+        if (ref.handle == INVALID_ID && ref.reference_count == 0) {
+            hashmap_remove_u64(&state_ptr->registered_texture_table, name_id);
+        } else if (!hashmap_set_u64(&state_ptr->registered_texture_table, name_id, &ref)) {
+            DERROR("process_texture_reference failed to register texture '%s'.", kname_string_get(name_id));
+            return false;
+        }
+        return true;
     }
 
     DERROR("process_texture_reference called before texture system is initialized.");
     return false;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -47,4 +47,61 @@ void kquick_sort(u64 type_size, void* data, i32 low_index, i32 high_index, PFN_k
         kquick_sort_internal(scratch_mem, type_size, data, partition_index + 1, high_index, compare_pfn);
         kfree(scratch_mem, type_size, MEMORY_TAG_ARRAY);
     }
-}
\ No newline at end of file
+}
+
+void kradix_sort_u64(u64* keys, u32* values, u32 count, u64* scratch_keys, u32* scratch_values) {
+    if (count < 2) {
+        return;
+    }
+
+    // Count every byte of every key in one read.
+    u32 histograms[8][256];
+    kzero_memory(histograms, sizeof(histograms));
+    for (u32 i = 0; i < count; ++i) {
+        u64 key = keys[i];
+        for (u32 b = 0; b < 8; ++b) {
+            histograms[b][(key >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    u64* src_keys = keys;
+    u32* src_values = values;
+    u64* dst_keys = scratch_keys;
+    u32* dst_values = scratch_values;
+    for (u32 b = 0; b < 8; ++b) {
+        u32* histogram = histograms[b];
+        u32 shift = b * 8;
+        // A byte that all keys share would leave the order as it is.
+        if (histogram[(src_keys[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        // Turn the counts into starting offsets.
+        u32 offset = 0;
+        for (u32 d = 0; d < 256; ++d) {
+            u32 c = histogram[d];
+            histogram[d] = offset;
+            offset += c;
+        }
+
+        for (u32 i = 0; i < count; ++i) {
+            u32 d = (src_keys[i] >> shift) & 0xFF;
+            u32 target = histogram[d]++;
+            dst_keys[target] = src_keys[i];
+            dst_values[target] = src_values[i];
+        }
+
+        u64* temp_keys = src_keys;
+        src_keys = dst_keys;
+        dst_keys = temp_keys;
+        u32* temp_values = src_values;
+        src_values = dst_values;
+        dst_values = temp_values;
+    }
+
+    // An odd number of passes leaves the result in the scratch memory.
+    if (src_keys != keys) {
+        kcopy_memory(keys, src_keys, sizeof(u64) * count);
+        kcopy_memory(values, src_values, sizeof(u32) * count);
+    }
+}
@@ -6,4 +6,18 @@ typedef i32 (*PFN_kquicksort_compare)(void* a, void* b);
 
 API void ptr_swap(void* scratch_mem, u64 size, void* a, void* b);
 
-API void kquick_sort(u64 type_size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn);
\ No newline at end of file
+API void kquick_sort(u64 type_size, void* data, i32 low_index, i32 high_index, PFN_kquicksort_compare compare_pfn);
+
+/**
+ * @brief Sorts the given keys in ascending order, moving each key's value along with it. A stable
+ * least-significant-digit radix sort, one byte at a time, which skips any byte that is the same
+ * across all keys. Only the keys and values move, so this is typically used to sort indices into
+ * larger structures by a packed key.
+ *
+ * @param keys The keys to be sorted. Holds the sorted keys afterward.
+ * @param values The value of each key. Holds the values in sorted order afterward.
+ * @param count The number of keys and values.
+ * @param scratch_keys Scratch memory with room for count keys.
+ * @param scratch_values Scratch memory with room for count values.
+ */
+API void kradix_sort_u64(u64* keys, u32* values, u32 count, u64* scratch_keys, u32* scratch_values);
\ No newline at end of file
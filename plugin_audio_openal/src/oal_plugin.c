@@ -196,6 +196,7 @@ static u32 source_work_thread(void* params) {
     while (!do_break) {
         if (!source->data_mutex.internal_data) {
             // This can happen during unexpected shutdown, and if so kill the thread.
+            kmemory_thread_cache_flush();
             return 0;
         }
         kmutex_lock(&source->data_mutex);
@@ -217,6 +218,8 @@ static u32 source_work_thread(void* params) {
     }
 
     DDEBUG("Audio source thread shutting down.");
+    // Hand back any small blocks this thread has cached.
+    kmemory_thread_cache_flush();
     return 0;
 }
 
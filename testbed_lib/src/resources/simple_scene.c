@@ -8,11 +8,14 @@
 #include "core/kstring.h"
 #include "core/logger.h"
 #include "defines.h"
+#include "math/bvh.h"
 #include "math/geometry_3d.h"
+#include "math/geometry_utils.h"
 #include "math/kmath.h"
 #include "math/math_types.h"
 #include "math/transform.h"
 #include "renderer/camera.h"
+#include "renderer/render_queue.h"
 #include "renderer/renderer_types.h"
 #include "renderer/viewport.h"
 #include "resources/debug/debug_box3d.h"
@@ -21,8 +24,10 @@
 #include "resources/resource_types.h"
 #include "resources/skybox.h"
 #include "resources/terrain.h"
+#include "systems/job_system.h"
 #include "systems/light_system.h"
 #include "systems/resource_system.h"
+#include "systems/texture_system.h"
 #include "utils/ksort.h"
 
 static void
@@ -35,26 +40,26 @@ typedef struct simple_scene_debug_data {
     debug_line3d line;
 } simple_scene_debug_data;
 
-/** @brief A private structure used to sort geometry by distance from the camera. */
-typedef struct geometry_distance {
-    /** @brief The geometry render data. */
-    geometry_render_data g;
-    /** @brief The distance from the camera. */
-    f32 distance;
-} geometry_distance;
-
-static i32 geometry_render_data_compare(void *a, void *b) {
-    geometry_render_data *a_typed = a;
-    geometry_render_data *b_typed = b;
-    if (!a_typed->material || !b_typed->material) {
-        return 0;  // Don't sort invalid entries.
-    }
-    return a_typed->material->id - b_typed->material->id;
+// Obtains the sort key for geometry drawn with the given material. Opaque geometry is grouped by
+// shader and material, then drawn front to back. Transparent geometry is drawn back to front after it.
+static u64 geometry_sort_key(const material *m, b8 winding_inverted, b8 has_transparency, f32 distance) {
+    u32 shader_id = m ? m->shader_id : 0;
+    u32 material_id = m ? m->id : 0;
+    render_key_layer layer = has_transparency ? RENDER_KEY_LAYER_TRANSPARENT : RENDER_KEY_LAYER_OPAQUE;
+    return render_key_create(layer, shader_id, material_id, winding_inverted, distance);
 }
 
-static i32 geometry_distance_compare(void *a, void *b) {
-    geometry_distance *a_typed = a;
-    geometry_distance *b_typed = b;
+// Sorts the queued geometries and appends them to out_geometries in that order.
+static void geometry_render_queue_flush(render_queue *queue, const geometry_render_data *queued, geometry_render_data **out_geometries) {
+    render_queue_sort(queue);
+    for (u32 i = 0; i < queue->count; ++i) {
+        darray_push(*out_geometries, queued[queue->indices[i]]);
+    }
+}
+
+static i32 raycast_hit_compare(void *a, void *b) {
+    raycast_hit *a_typed = a;
+    raycast_hit *b_typed = b;
     if (a_typed->distance > b_typed->distance) {
         return 1;
     } else if (a_typed->distance < b_typed->distance) {
@@ -63,6 +68,207 @@ static i32 geometry_distance_compare(void *a, void *b) {
     return 0;
 }
 
+// The amount mesh boxes are grown by in the bvh, so small movements don't restructure the tree.
+#define SIMPLE_SCENE_BVH_MARGIN 0.25f
+
+// Obtains the world-space axis-aligned bounds of local extents under the given model matrix.
+static void world_bounds_get(extents_3d local, matrix4 model, vec3 *out_center, vec3 *out_half) {
+    vec3 center = vec3_mul_scalar(vec3_add(local.min, local.max), 0.5f);
+    vec3 half = vec3_mul_scalar(vec3_sub(local.max, local.min), 0.5f);
+
+    // Transform the center, then project the local half extents onto each world axis.
+    *out_center = vec3_mul_mat4(center, model);
+    *out_half = (vec3){
+        kabs(model.data[0]) * half.x + kabs(model.data[4]) * half.y + kabs(model.data[8]) * half.z,
+        kabs(model.data[1]) * half.x + kabs(model.data[5]) * half.y + kabs(model.data[9]) * half.z,
+        kabs(model.data[2]) * half.x + kabs(model.data[6]) * half.y + kabs(model.data[10]) * half.z};
+}
+
+// Obtains the draw flags of the given geometry from its material.
+static simple_scene_draw_flags geometry_draw_flags_get(const geometry *g) {
+    simple_scene_draw_flags flags = 0;
+    if (g->material && g->material->type == MATERIAL_TYPE_PBR) {
+        // Check diffuse map (slot 0).
+        texture *diffuse = g->material->maps[0].texture;
+        if (diffuse) {
+            if (diffuse->flags & TEXTURE_FLAG_HAS_TRANSPARENCY) {
+                flags |= SIMPLE_SCENE_DRAW_FLAG_TRANSPARENT;
+            }
+            // Transparency isn't known until the texture has loaded.
+            if (diffuse->generation == INVALID_ID && !texture_system_is_default_texture(diffuse)) {
+                flags |= SIMPLE_SCENE_DRAW_FLAG_TEXTURE_PENDING;
+            }
+        }
+    }
+    return flags;
+}
+
+// Writes the world-space bounds and cached draws of every geometry of the given mesh, at the place laid
+// out for them, and refits the mesh's bvh leaf. Leaves only move within the tree when a mesh leaves its
+// fattened box.
+static void mesh_draws_write(simple_scene *scene, u32 mesh_index) {
+    mesh *m = &scene->meshes[mesh_index];
+    simple_scene_mesh_cache *cache = &scene->mesh_caches[mesh_index];
+    matrix4 model = transform_world_get(&m->transform);
+    b8 winding_inverted = m->transform.determinant < 0;
+
+    vec3 center, half;
+    world_bounds_get(m->extents, model, &center, &half);
+    extents_3d world_extents = {vec3_sub(center, half), vec3_add(center, half)};
+    if (scene->mesh_bvh_ids[mesh_index] == INVALID_ID) {
+        scene->mesh_bvh_ids[mesh_index] = bvh_insert(&scene->mesh_bvh, world_extents, mesh_index);
+    } else {
+        bvh_update(&scene->mesh_bvh, scene->mesh_bvh_ids[mesh_index], world_extents);
+    }
+
+    for (u32 j = 0; j < cache->geometry_count; ++j) {
+        u32 index = cache->first_draw + j;
+        geometry *g = m->geometries[j];
+        world_bounds_get(g->extents, model, &center, &half);
+        bounds_soa_set(&scene->geometry_bounds, index, center, half);
+
+        geometry_render_data *data = &scene->draws[index];
+        data->model = model;
+        data->material = g->material;
+        data->vertex_count = g->vertex_count;
+        data->vertex_buffer_offset = g->vertex_buffer_offset;
+        // The full detail. A level of detail is chosen for each view when queried.
+        data->index_count = g->lod_count ? g->lods[0].index_count : g->index_count;
+        data->index_buffer_offset = g->index_buffer_offset + (g->lod_count ? (u64)g->lods[0].index_offset * g->index_element_size : 0);
+        data->unique_id = m->id.uniqueid;
+        data->winding_inverted = winding_inverted;
+
+        simple_scene_draw_flags flags = geometry_draw_flags_get(g);
+        if ((flags & SIMPLE_SCENE_DRAW_FLAG_TEXTURE_PENDING) && !(scene->draw_flags[index] & SIMPLE_SCENE_DRAW_FLAG_TEXTURE_PENDING)) {
+            darray_push(scene->pending_draws, index);
+        }
+        scene->draw_flags[index] = flags;
+        scene->draw_material_generations[index] = g->material ? g->material->generation : INVALID_ID;
+    }
+
+    cache->world_version = m->transform.world_version;
+}
+
+// Lays out the cached draws of every loaded mesh again, one contiguous run per mesh, and writes them.
+static void simple_scene_draws_layout(simple_scene *scene) {
+    bounds_soa_clear(&scene->geometry_bounds);
+    darray_clear(scene->geometry_refs);
+    darray_clear(scene->draws);
+    darray_clear(scene->draw_flags);
+    darray_clear(scene->draw_material_generations);
+    darray_clear(scene->pending_draws);
+    darray_clear(scene->mesh_caches);
+
+    u32 mesh_count = darray_length(scene->meshes);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        mesh *m = &scene->meshes[i];
+        b8 loaded = m->generation != INVALID_ID_U8;
+        simple_scene_mesh_cache cache = {0};
+        cache.generation = m->generation;
+        cache.load_id = m->id.uniqueid;
+        cache.geometry_count = loaded ? m->geometry_count : 0;
+        cache.first_draw = scene->geometry_bounds.count;
+        darray_push(scene->mesh_caches, cache);
+        if (!loaded) {
+            continue;
+        }
+
+        for (u32 j = 0; j < m->geometry_count; ++j) {
+            bounds_soa_push(&scene->geometry_bounds, vec3_zero(), vec3_zero());
+            simple_scene_geometry_ref ref = {i, j};
+            darray_push(scene->geometry_refs, ref);
+            geometry_render_data data = {0};
+            darray_push(scene->draws, data);
+            simple_scene_draw_flags flags = 0;
+            darray_push(scene->draw_flags, flags);
+            u32 material_generation = INVALID_ID;
+            darray_push(scene->draw_material_generations, material_generation);
+        }
+        mesh_draws_write(scene, i);
+    }
+}
+
+// Checks whether any geometry of a mesh has had its material swapped or reloaded since its draws were written.
+static b8 mesh_materials_changed(const simple_scene *scene, u32 mesh_index) {
+    const mesh *m = &scene->meshes[mesh_index];
+    const simple_scene_mesh_cache *cache = &scene->mesh_caches[mesh_index];
+    for (u32 j = 0; j < cache->geometry_count; ++j) {
+        u32 index = cache->first_draw + j;
+        const material *mat = m->geometries[j]->material;
+        if (scene->draws[index].material != mat || scene->draw_material_generations[index] != (mat ? mat->generation : INVALID_ID)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Brings the spatial data and cached draws up to date with the current mesh list, transforms and
+// materials. Only meshes that moved or had a material changed are written again, unless the mesh list
+// itself has changed.
+static void simple_scene_bounds_refresh(simple_scene *scene) {
+    u32 mesh_count = darray_length(scene->meshes);
+
+    // Bring every mesh world matrix up to date at once, so that the transform_world_get calls here and
+    // in the queries that follow only read cached results.
+    if (scene->mesh_transforms_dirty) {
+        transform **transforms = kallocate(sizeof(transform *) * KMAX(mesh_count, 1), MEMORY_TAG_ARRAY);
+        for (u32 i = 0; i < mesh_count; ++i) {
+            transforms[i] = &scene->meshes[i].transform;
+        }
+        transform_hierarchy_build(&scene->mesh_transforms, transforms, mesh_count);
+        kfree(transforms, sizeof(transform *) * KMAX(mesh_count, 1), MEMORY_TAG_ARRAY);
+        scene->mesh_transforms_dirty = false;
+    }
+    transform_hierarchy_update(&scene->mesh_transforms);
+
+    while (darray_length(scene->mesh_bvh_ids) < mesh_count) {
+        u32 invalid = INVALID_ID;
+        darray_push(scene->mesh_bvh_ids, invalid);
+    }
+
+    // A mesh being added, removed, loaded or unloaded moves the draws of every mesh after it.
+    b8 layout_changed = darray_length(scene->mesh_caches) != mesh_count;
+    for (u32 i = 0; i < mesh_count && !layout_changed; ++i) {
+        mesh *m = &scene->meshes[i];
+        simple_scene_mesh_cache *cache = &scene->mesh_caches[i];
+        // The generation restarts when a mesh is reloaded, so the unique id drawn on each load is checked too.
+        if (m->generation != cache->generation || (m->generation != INVALID_ID_U8 && (m->id.uniqueid != cache->load_id || m->geometry_count != cache->geometry_count))) {
+            layout_changed = true;
+        }
+    }
+    if (layout_changed) {
+        simple_scene_draws_layout(scene);
+        return;
+    }
+
+    for (u32 i = 0; i < mesh_count; ++i) {
+        simple_scene_mesh_cache *cache = &scene->mesh_caches[i];
+        if (cache->generation != INVALID_ID_U8 && (scene->meshes[i].transform.world_version != cache->world_version || mesh_materials_changed(scene, i))) {
+            mesh_draws_write(scene, i);
+        }
+    }
+
+    // Check again on draws whose transparency was waiting on a texture to load.
+    u32 pending_count = darray_length(scene->pending_draws);
+    u32 still_pending = 0;
+    for (u32 i = 0; i < pending_count; ++i) {
+        u32 index = scene->pending_draws[i];
+        simple_scene_geometry_ref ref = scene->geometry_refs[index];
+        scene->draw_flags[index] = geometry_draw_flags_get(scene->meshes[ref.mesh_index].geometries[ref.geometry_index]);
+        if (scene->draw_flags[index] & SIMPLE_SCENE_DRAW_FLAG_TEXTURE_PENDING) {
+            scene->pending_draws[still_pending++] = index;
+        }
+    }
+    darray_length_set(scene->pending_draws, still_pending);
+}
+
+static b8 mesh_index_collect(u64 user_data, void *context) {
+    u32 **indices = context;
+    u32 index = (u32)user_data;
+    darray_push(*indices, index);
+    return true;
+}
+
 b8 simple_scene_create(void *config, simple_scene *out_scene) {
     if (!out_scene) {
         DERROR("simple_scene_create(): A valid pointer to out_scene is required.");
@@ -81,6 +287,25 @@ b8 simple_scene_create(void *config, simple_scene *out_scene) {
     out_scene->dir_light = 0;
     out_scene->point_lights = darray_create(point_light);
     out_scene->meshes = darray_create(mesh);
+    if (!transform_hierarchy_create(64, &out_scene->mesh_transforms)) {
+        DERROR("simple_scene_create(): Failed to create mesh transform hierarchy.");
+        return false;
+    }
+    out_scene->mesh_bvh_ids = darray_create(u32);
+    if (!bvh_create(64, SIMPLE_SCENE_BVH_MARGIN, &out_scene->mesh_bvh)) {
+        DERROR("simple_scene_create(): Failed to create mesh bvh.");
+        return false;
+    }
+    out_scene->geometry_refs = darray_create(simple_scene_geometry_ref);
+    out_scene->draws = darray_create(geometry_render_data);
+    out_scene->draw_flags = darray_create(simple_scene_draw_flags);
+    out_scene->draw_material_generations = darray_create(u32);
+    out_scene->mesh_caches = darray_create(simple_scene_mesh_cache);
+    out_scene->pending_draws = darray_create(u32);
+    if (!bounds_soa_create(256, &out_scene->geometry_bounds)) {
+        DERROR("simple_scene_create(): Failed to create geometry bounds.");
+        return false;
+    }
     out_scene->terrains = darray_create(terrain);
     out_scene->sb = 0;
 
@@ -304,6 +529,7 @@ b8 simple_scene_initialize(simple_scene *scene) {
             transform_parent_set(&scene->meshes[i].transform, &parent->transform);
         }
     }
+    scene->mesh_transforms_dirty = true;
 
     if (scene->sb) {
         if (!skybox_initialize(scene->sb)) {
@@ -503,6 +729,8 @@ b8 simple_scene_update(simple_scene *scene, const struct frame_data *p_frame_dat
                 }
             }
         }
+
+        simple_scene_bounds_refresh(scene);
     }
 
     return true;
@@ -604,12 +832,13 @@ b8 simple_scene_raycast(simple_scene *scene, const struct ray *r, struct raycast
     // Only create if needed.
     out_result->hits = 0;
 
-    // Iterate meshes in the scene.
-    // TODO: This needs to be optimized. We need some sort of spatial partitioning to speed this up.
-    // Otherwise a scene with thousands of objects will be super slow!
-    u32 mesh_count = darray_length(scene->meshes);
-    for (u32 i = 0; i < mesh_count; ++i) {
-        mesh *m = &scene->meshes[i];
+    // Only test meshes whose world-space box the ray passes through.
+    u32 *candidates = darray_create(u32);
+    bvh_query_ray(&scene->mesh_bvh, r, mesh_index_collect, &candidates);
+
+    u32 candidate_count = darray_length(candidates);
+    for (u32 i = 0; i < candidate_count; ++i) {
+        mesh *m = &scene->meshes[candidates[i]];
         matrix4 model = transform_world_get(&m->transform);
         f32 dist;
         if (raycast_oriented_extents(m->extents, model, r, &dist)) {
@@ -628,24 +857,11 @@ b8 simple_scene_raycast(simple_scene *scene, const struct ray *r, struct raycast
         }
     }
 
+    darray_destroy(candidates);
+
     // Sort the results based on distance.
     if (out_result->hits) {
-        b8 swapped;
-        u32 length = darray_length(out_result->hits);
-        for (u32 i = 0; i < length - 1; ++i) {
-            swapped = false;
-            for (u32 j = 0; j < length - 1; ++j) {
-                if (out_result->hits[j].distance > out_result->hits[j + 1].distance) {
-                    KSWAP(raycast_hit, out_result->hits[j], out_result->hits[j + 1]);
-                    swapped = true;
-                }
-            }
-
-            // If no 2 elements were swapped, then sort is complete.
-            if (!swapped) {
-                break;
-            }
-        }
+        kquick_sort(sizeof(raycast_hit), out_result->hits, 0, darray_length(out_result->hits) - 1, raycast_hit_compare);
     }
     return out_result->hits != 0;
 }
@@ -776,6 +992,7 @@ b8 simple_scene_mesh_add(simple_scene *scene, const char *name,
     }
 
     darray_push(scene->meshes, m);
+    scene->mesh_transforms_dirty = true;
 
     return true;
 }
@@ -905,9 +1122,10 @@ b8 simple_scene_mesh_remove(simple_scene *scene, const char *name) {
         return false;
     }
 
+    kname name_id = kname_hash(name);
     u32 mesh_count = darray_length(scene->meshes);
     for (u32 i = 0; i < mesh_count; ++i) {
-        if (strings_equal(scene->meshes[i].name, name)) {
+        if (scene->meshes[i].name_id == name_id) {
             // Unload any debug data.
             if (scene->meshes[i].debug_data) {
                 simple_scene_debug_data *debug = scene->meshes[i].debug_data;
@@ -926,6 +1144,13 @@ b8 simple_scene_mesh_remove(simple_scene *scene, const char *name) {
 
             mesh rubbish = {0};
             darray_pop_at(scene->meshes, i, &rubbish);
+            scene->mesh_transforms_dirty = true;
+
+            // Later meshes have shifted down, so their leaf user data is stale. Rebuild the tree.
+            bvh_clear(&scene->mesh_bvh);
+            darray_clear(scene->mesh_bvh_ids);
+            darray_clear(scene->mesh_caches);
+            simple_scene_bounds_refresh(scene);
 
             return true;
         }
@@ -1002,13 +1227,15 @@ struct point_light *simple_scene_point_light_get(simple_scene *scene,
 }
 
 struct mesh *simple_scene_mesh_get(simple_scene *scene, const char *name) {
-    if (!scene) {
+    if (!scene || !name) {
         return 0;
     }
 
+    // Compare ids rather than strings.
+    kname name_id = kname_hash(name);
     u32 length = darray_length(scene->meshes);
     for (u32 i = 0; i < length; ++i) {
-        if (strings_nequal(name, scene->meshes[i].name, 256)) {
+        if (scene->meshes[i].name_id == name_id) {
             return &scene->meshes[i];
         }
     }
@@ -1151,82 +1378,40 @@ b8 simple_scene_mesh_render_data_query_from_line(const simple_scene *scene, vec3
         return false;
     }
 
-    geometry_distance *transparent_geometries = darray_create_with_allocator(geometry_distance, &p_frame_data->allocator);
-
-    u32 mesh_count = darray_length(scene->meshes);
-    for (u32 i = 0; i < mesh_count; ++i) {
-        mesh *m = &scene->meshes[i];
-        if (m->generation != INVALID_ID_U8) {
-            matrix4 model = transform_world_get(&m->transform);
-            b8 winding_inverted = m->transform.determinant < 0;
-
-            for (u32 j = 0; j < m->geometry_count; ++j) {
-                geometry *g = m->geometries[j];
-
-                // TODO: cache this somewhere...
-                //
-                // Translate/scale the extents.
-                vec3 extents_min = vec3_mul_mat4(g->extents.min, model);
-                vec3 extents_max = vec3_mul_mat4(g->extents.max, model);
-                // Translate/scale the center.
-                vec3 transformed_center = vec3_mul_mat4(g->center, model);
-                // Find the one furthest from the center.
-                f32 mesh_radius = KMAX(vec3_distance(extents_min, transformed_center), vec3_distance(extents_max, transformed_center));
-
-                f32 dist_to_line = vec3_distance_to_line(transformed_center, center, direction);
-
-                // Is within distance, so include it
-                if ((dist_to_line - mesh_radius) <= radius) {
-                    // Add it to the list to be rendered.
-                    geometry_render_data data = {0};
-                    data.model = model;
-                    data.material = g->material;
-                    data.vertex_count = g->vertex_count;
-                    data.vertex_buffer_offset = g->vertex_buffer_offset;
-                    data.index_count = g->index_count;
-                    data.index_buffer_offset = g->index_buffer_offset;
-                    data.unique_id = m->id.uniqueid;
-                    data.winding_inverted = winding_inverted;
-
-                    // Check if transparent. If so, put into a separate, temp array to be
-                    // sorted by distance from the camera. Otherwise, put into the
-                    // ext_data->geometries array directly.
-                    b8 has_transparency = false;
-                    if (g->material->type == MATERIAL_TYPE_PBR) {
-                        // Check diffuse map (slot 0).
-                        has_transparency = ((g->material->maps[0].texture->flags & TEXTURE_FLAG_HAS_TRANSPARENCY) != 0);
-                    }
-
-                    if (has_transparency) {
-                        // For meshes _with_ transparency, add them to a separate list to be sorted by distance later.
-                        // Get the center, extract the global position from the model matrix and add it to the center,
-                        // then calculate the distance between it and the camera, and finally save it to a list to be sorted.
-                        // NOTE: This isn't perfect for translucent meshes that intersect, but is enough for our purposes now.
-                        vec3 geometry_center = vec3_transform(g->center, 1.0f, model);
-                        f32 distance = vec3_distance(geometry_center, center);
-
-                        geometry_distance gdist;
-                        gdist.distance = kabs(distance);
-                        gdist.g = data;
-                        darray_push(transparent_geometries, gdist);
-                    } else {
-                        darray_push(*out_geometries, data);
-                    }
-                    p_frame_data->drawn_mesh_count++;
-                }
+    // Draws are queued by their index in the scene's cached draws, and only indices move while sorting.
+    render_queue queue;
+    render_queue_create(&p_frame_data->allocator, 64, &queue);
+
+    // Only consider meshes whose world-space box is near the line.
+    u32 *candidates = darray_create_with_allocator(u32, &p_frame_data->allocator);
+    bvh_query_line(&scene->mesh_bvh, center, direction, radius, mesh_index_collect, &candidates);
+
+    const bounds_soa *bounds = &scene->geometry_bounds;
+    u32 candidate_count = darray_length(candidates);
+    for (u32 i = 0; i < candidate_count; ++i) {
+        const simple_scene_mesh_cache *cache = &scene->mesh_caches[candidates[i]];
+        for (u32 j = 0; j < cache->geometry_count; ++j) {
+            u32 index = cache->first_draw + j;
+
+            // The world-space bounds are kept up to date with the mesh.
+            vec3 g_center = {bounds->center_x[index], bounds->center_y[index], bounds->center_z[index]};
+            vec3 g_half = {bounds->half_x[index], bounds->half_y[index], bounds->half_z[index]};
+            f32 g_radius = vec3_length(g_half);
+            f32 dist_to_line = vec3_distance_to_line(g_center, center, direction);
+
+            // Is within distance, so include it
+            if ((dist_to_line - g_radius) <= radius) {
+                // NOTE: Sorting by center isn't perfect for translucent meshes that intersect, but is enough for our purposes now.
+                const geometry_render_data *data = &scene->draws[index];
+                b8 has_transparency = (scene->draw_flags[index] & SIMPLE_SCENE_DRAW_FLAG_TRANSPARENT) != 0;
+                f32 distance = vec3_distance(g_center, center);
+                render_queue_push(&queue, geometry_sort_key(data->material, data->winding_inverted, has_transparency, distance), index);
+                p_frame_data->drawn_mesh_count++;
             }
         }
     }
 
-    // Sort opaque geometries by material.
-    kquick_sort(sizeof(geometry_render_data), *out_geometries, 0, darray_length(*out_geometries) - 1, geometry_render_data_compare);
-
-    // Sort transparent geometries, then add them to the ext_data->geometries array.
-    u32 transparent_geometry_count = darray_length(transparent_geometries);
-    kquick_sort(sizeof(geometry_distance), transparent_geometries, 0, transparent_geometry_count - 1, geometry_distance_compare);
-    for (u32 i = 0; i < transparent_geometry_count; ++i) {
-        darray_push(*out_geometries, transparent_geometries[i].g);
-    }
+    geometry_render_queue_flush(&queue, scene->draws, out_geometries);
 
     *out_count = darray_length(*out_geometries);
 
@@ -1288,122 +1473,234 @@ b8 simple_scene_terrain_render_data_query_from_line(const simple_scene *scene, v
     return true;
 }
 
-b8 simple_scene_mesh_render_data_query(const simple_scene *scene, const frustum *f, vec3 center, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data **out_geometries) {
-    if (!scene) {
-        return false;
+// Chooses the level of detail to draw the given entry of the scene's cached draws at: the finest any of the views asks for.
+static u8 mesh_lod_select(const simple_scene *scene, u32 index, u32 view_count, const simple_scene_view *views) {
+    simple_scene_geometry_ref ref = scene->geometry_refs[index];
+    const geometry *g = scene->meshes[ref.mesh_index].geometries[ref.geometry_index];
+    // Without a view to judge the error from, such as for a query with no frustum, use the full detail.
+    if (g->lod_count <= 1 || view_count == 0) {
+        return 0;
     }
 
-    geometry_distance *transparent_geometries = darray_create_with_allocator(geometry_distance, &p_frame_data->allocator);
+    // The error is in local units, so is scaled by the largest scale of the model.
+    const matrix4 *model = &scene->draws[index].model;
+    f32 scale = 0;
+    for (u32 c = 0; c < 3; ++c) {
+        vec3 axis = {model->data[c * 4 + 0], model->data[c * 4 + 1], model->data[c * 4 + 2]};
+        scale = KMAX(scale, vec3_length(axis));
+    }
 
-    u32 mesh_count = darray_length(scene->meshes);
-    for (u32 i = 0; i < mesh_count; ++i) {
-        mesh *m = &scene->meshes[i];
-        if (m->generation != INVALID_ID_U8) {
-            matrix4 model = transform_world_get(&m->transform);
-            b8 winding_inverted = m->transform.determinant < 0;
+    const bounds_soa *bounds = &scene->geometry_bounds;
+    u8 lod = g->lod_count - 1;
+    for (u32 v = 0; v < view_count && lod > 0; ++v) {
+        if (views[v].lod_scale <= 0) {
+            return 0;
+        }
+        // The distance to the nearest point of the world-space bounds.
+        vec3 p = views[v].lod_position;
+        f32 dx = KMAX(kabs(p.x - bounds->center_x[index]) - bounds->half_x[index], 0.0f);
+        f32 dy = KMAX(kabs(p.y - bounds->center_y[index]) - bounds->half_y[index], 0.0f);
+        f32 dz = KMAX(kabs(p.z - bounds->center_z[index]) - bounds->half_z[index], 0.0f);
+        f32 distance = ksqrt(dx * dx + dy * dy + dz * dz);
+        if (distance <= K_FLOAT_EPSILON) {
+            return 0;
+        }
+        u8 view_lod = geometry_lod_select(g->lod_count, g->lods, views[v].lod_scale * scale / distance, views[v].lod_error_pixels);
+        lod = KMIN(lod, view_lod);
+    }
+    return lod;
+}
 
-            for (u32 j = 0; j < m->geometry_count; ++j) {
-                geometry *g = m->geometries[j];
+// Produces render data for the given visible entries of the scene's cached draws, sorted
+// opaque-by-shader-and-material followed by transparent-back-to-front from center. Each draw uses
+// the level of detail chosen for it from the given views.
+static b8 mesh_render_data_from_visible(const simple_scene *scene, const u32 *visible, u32 visible_count, u32 view_count, const simple_scene_view *views, vec3 center, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data **out_geometries) {
+    // Draws are queued by their index in the scene's cached draws, and only indices move while sorting.
+    render_queue queue;
+    render_queue_create(&p_frame_data->allocator, visible_count, &queue);
+
+    const bounds_soa *bounds = &scene->geometry_bounds;
+    for (u32 i = 0; i < visible_count; ++i) {
+        u32 index = visible[i];
+        const geometry_render_data *data = &scene->draws[index];
+        b8 has_transparency = (scene->draw_flags[index] & SIMPLE_SCENE_DRAW_FLAG_TRANSPARENT) != 0;
+
+        // The world-space center was already calculated along with the bounds.
+        // NOTE: Sorting by center isn't perfect for translucent meshes that intersect, but is enough for our purposes now.
+        vec3 g_center = {bounds->center_x[index], bounds->center_y[index], bounds->center_z[index]};
+        f32 distance = vec3_distance(g_center, center);
+        render_queue_push(&queue, geometry_sort_key(data->material, data->winding_inverted, has_transparency, distance), index);
+        p_frame_data->drawn_mesh_count++;
+    }
+
+    u32 first = darray_length(*out_geometries);
+    geometry_render_queue_flush(&queue, scene->draws, out_geometries);
+
+    // Switch the draws that are far enough away to a level of detail.
+    for (u32 i = 0; i < queue.count; ++i) {
+        u32 index = queue.indices[i];
+        u8 lod = mesh_lod_select(scene, index, view_count, views);
+        if (lod > 0) {
+            simple_scene_geometry_ref ref = scene->geometry_refs[index];
+            const geometry *g = scene->meshes[ref.mesh_index].geometries[ref.geometry_index];
+            geometry_render_data *data = &(*out_geometries)[first + i];
+            data->index_count = g->lods[lod].index_count;
+            data->index_buffer_offset = g->index_buffer_offset + (u64)g->lods[lod].index_offset * g->index_element_size;
+        }
+    }
 
-                // TODO: Distance-from-line detection per object (e.g. light direction and center pos, then distance check from that line.)
-                //
-                // // Bounding sphere calculation.
-                // {
-                //     // Translate/scale the extents.
-                //     vec3 extents_min = vec3_mul_mat4(g->extents.min, model);
-                //     vec3 extents_max = vec3_mul_mat4(g->extents.max, model);
-
-                //     f32 min = KMIN(KMIN(extents_min.x, extents_min.y),
-                //     extents_min.z); f32 max = KMAX(KMAX(extents_max.x,
-                //     extents_max.y), extents_max.z); f32 diff = kabs(max - min);
-                //     f32 radius = diff * 0.5f;
-
-                //     // Translate/scale the center.
-                //     vec3 center = vec3_mul_mat4(g->center, model);
-
-                //     if (frustum_intersects_sphere(&state->camera_frustum,
-                //     &center, radius)) {
-                //         // Add it to the list to be rendered.
-                //         geometry_render_data data = {0};
-                //         data.model = model;
-                //         data.geometry = g;
-                //         data.unique_id = m->unique_id;
-                //         darray_push(game_inst->frame_data.world_geometries,
-                //         data);
-
-                //         draw_count++;
-                //     }
-                // }
+    *out_count = darray_length(*out_geometries);
 
-                // AABB calculation
-                {
-                    // Translate/scale the extents.
-                    // vec3 extents_min = vec3_mul_mat4(g->extents.min, model);
-                    vec3 extents_max = vec3_mul_mat4(g->extents.max, model);
+    return true;
+}
 
-                    // Translate/scale the center.
-                    vec3 g_center = vec3_mul_mat4(g->center, model);
-                    vec3 half_extents = {
-                        kabs(extents_max.x - g_center.x),
-                        kabs(extents_max.y - g_center.y),
-                        kabs(extents_max.z - g_center.z),
-                    };
+// The number of bounds culled per job. A multiple of 8, as frustum_cull_bounds_range requires.
+#define SIMPLE_SCENE_CULL_GRAIN 4096
+
+typedef struct views_cull_context {
+    const bounds_soa *bounds;
+    const frustum *frusta;
+    u32 view_count;
+    // For each chunk, one output array per view, pointing at the chunk's place in that view's list.
+    u32 **chunk_visible;
+    // For each chunk, the number of visible entries per view.
+    u32 *chunk_counts;
+} views_cull_context;
+
+static void views_cull_chunk(u32 start, u32 end, void *userdata) {
+    views_cull_context *context = userdata;
+    u32 chunk = start / SIMPLE_SCENE_CULL_GRAIN;
+    frustum_cull_bounds_range(
+        context->frusta, context->view_count, context->bounds, start, end,
+        context->chunk_visible + chunk * context->view_count,
+        context->chunk_counts + chunk * context->view_count);
+}
 
-                    if (!f || frustum_intersects_aabb(f, &g_center, &half_extents)) {
-                        // Add it to the list to be rendered.
-                        geometry_render_data data = {0};
-                        data.model = model;
-                        data.material = g->material;
-                        data.vertex_count = g->vertex_count;
-                        data.vertex_buffer_offset = g->vertex_buffer_offset;
-                        data.index_count = g->index_count;
-                        data.index_buffer_offset = g->index_buffer_offset;
-                        data.unique_id = m->id.uniqueid;
-                        data.winding_inverted = winding_inverted;
-
-                        // Check if transparent. If so, put into a separate, temp array to be
-                        // sorted by distance from the camera. Otherwise, put into the
-                        // ext_data->geometries array directly.
-                        b8 has_transparency = false;
-                        if (g->material->type == MATERIAL_TYPE_PBR) {
-                            // Check diffuse map (slot 0).
-                            has_transparency = ((g->material->maps[0].texture->flags & TEXTURE_FLAG_HAS_TRANSPARENCY) != 0);
-                        }
-
-                        if (has_transparency) {
-                            // For meshes _with_ transparency, add them to a separate list to be sorted by distance later.
-                            // Get the center, extract the global position from the model matrix and add it to the center,
-                            // then calculate the distance between it and the camera, and finally save it to a list to be sorted.
-                            // NOTE: This isn't perfect for translucent meshes that intersect, but is enough for our purposes now.
-                            f32 distance = vec3_distance(g_center, center);
-
-                            geometry_distance gdist;
-                            gdist.distance = kabs(distance);
-                            gdist.g = data;
-                            darray_push(transparent_geometries, gdist);
-                        } else {
-                            darray_push(*out_geometries, data);
-                        }
-                        p_frame_data->drawn_mesh_count++;
-                    }
+b8 simple_scene_views_cull(const simple_scene *scene, u32 view_count, simple_scene_view *views, frame_data *p_frame_data) {
+    if (!scene || !views || !p_frame_data) {
+        return false;
+    }
+
+    u32 bounds_count = scene->geometry_bounds.count;
+    for (u32 v = 0; v < view_count; ++v) {
+        views[v].visible = p_frame_data->allocator.allocate(sizeof(u32) * KMAX(bounds_count, 1));
+        views[v].visible_count = 0;
+    }
+    if (!bounds_count || !view_count) {
+        return true;
+    }
+
+    // Everything is allocated up front, as the frame allocator is not used from the job threads.
+    u32 chunk_count = (bounds_count + SIMPLE_SCENE_CULL_GRAIN - 1) / SIMPLE_SCENE_CULL_GRAIN;
+    views_cull_context context;
+    context.bounds = &scene->geometry_bounds;
+    context.view_count = view_count;
+    frustum *frusta = p_frame_data->allocator.allocate(sizeof(frustum) * view_count);
+    for (u32 v = 0; v < view_count; ++v) {
+        frusta[v] = views[v].f;
+    }
+    context.frusta = frusta;
+    context.chunk_visible = p_frame_data->allocator.allocate(sizeof(u32 *) * chunk_count * view_count);
+    context.chunk_counts = p_frame_data->allocator.allocate(sizeof(u32) * chunk_count * view_count);
+    for (u32 c = 0; c < chunk_count; ++c) {
+        for (u32 v = 0; v < view_count; ++v) {
+            context.chunk_visible[c * view_count + v] = views[v].visible + c * SIMPLE_SCENE_CULL_GRAIN;
+        }
+    }
+
+    // Each chunk tests its bounds against every view at once, spread across the job threads.
+    job_parallel_for(bounds_count, SIMPLE_SCENE_CULL_GRAIN, views_cull_chunk, &context);
+
+    // Close the gaps between chunks. Entries only move toward the front, so this is safe in place.
+    for (u32 v = 0; v < view_count; ++v) {
+        u32 *visible = views[v].visible;
+        u32 visible_count = 0;
+        for (u32 c = 0; c < chunk_count; ++c) {
+            const u32 *chunk_visible = context.chunk_visible[c * view_count + v];
+            u32 count = context.chunk_counts[c * view_count + v];
+            if (chunk_visible != visible + visible_count) {
+                for (u32 i = 0; i < count; ++i) {
+                    visible[visible_count + i] = chunk_visible[i];
                 }
             }
+            visible_count += count;
         }
+        views[v].visible_count = visible_count;
     }
 
-    // Sort opaque geometries by material.
-    kquick_sort(sizeof(geometry_render_data), *out_geometries, 0, darray_length(*out_geometries) - 1, geometry_render_data_compare);
+    return true;
+}
 
-    // Sort transparent geometries, then add them to the ext_data->geometries array.
-    u32 transparent_geometry_count = darray_length(transparent_geometries);
-    kquick_sort(sizeof(geometry_distance), transparent_geometries, 0, transparent_geometry_count - 1, geometry_distance_compare);
-    for (u32 i = 0; i < transparent_geometry_count; ++i) {
-        darray_push(*out_geometries, transparent_geometries[i].g);
+b8 simple_scene_mesh_render_data_from_views(const simple_scene *scene, u32 view_count, const simple_scene_view *views, vec3 center, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data **out_geometries) {
+    if (!scene || !views) {
+        return false;
     }
 
-    *out_count = darray_length(*out_geometries);
+    if (!view_count) {
+        *out_count = darray_length(*out_geometries);
+        return true;
+    }
+    if (view_count == 1) {
+        return mesh_render_data_from_visible(scene, views[0].visible, views[0].visible_count, 1, views, center, p_frame_data, out_count, out_geometries);
+    }
 
-    return true;
+    // Take the union, so geometry seen by several views is only drawn once.
+    u32 bounds_count = scene->geometry_bounds.count;
+    u32 *visible = p_frame_data->allocator.allocate(sizeof(u32) * KMAX(bounds_count, 1));
+    u8 *marks = p_frame_data->allocator.allocate(KMAX(bounds_count, 1));
+    kzero_memory(marks, bounds_count);
+    for (u32 v = 0; v < view_count; ++v) {
+        for (u32 i = 0; i < views[v].visible_count; ++i) {
+            marks[views[v].visible[i]] = 1;
+        }
+    }
+
+    u32 visible_count = 0;
+    for (u32 i = 0; i < bounds_count; ++i) {
+        visible[visible_count] = i;
+        visible_count += marks[i];
+    }
+
+    return mesh_render_data_from_visible(scene, visible, visible_count, view_count, views, center, p_frame_data, out_count, out_geometries);
+}
+
+b8 simple_scene_mesh_render_data_query(const simple_scene *scene, const frustum *f, vec3 center, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data **out_geometries) {
+    if (!scene) {
+        return false;
+    }
+
+    // Without a frustum, everything is visible.
+    if (!f) {
+        u32 bounds_count = scene->geometry_bounds.count;
+        u32 *visible = p_frame_data->allocator.allocate(sizeof(u32) * KMAX(bounds_count, 1));
+        for (u32 i = 0; i < bounds_count; ++i) {
+            visible[i] = i;
+        }
+        return mesh_render_data_from_visible(scene, visible, bounds_count, 0, 0, center, p_frame_data, out_count, out_geometries);
+    }
+
+    simple_scene_view view = {0};
+    view.f = *f;
+    if (!simple_scene_views_cull(scene, 1, &view, p_frame_data)) {
+        return false;
+    }
+    return simple_scene_mesh_render_data_from_views(scene, 1, &view, center, p_frame_data, out_count, out_geometries);
+}
+
+b8 simple_scene_mesh_render_data_query_frusta(const simple_scene *scene, const frustum *frusta, u32 frustum_count, vec3 center, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data **out_geometries) {
+    if (!scene || !frusta) {
+        return false;
+    }
+
+    simple_scene_view *views = p_frame_data->allocator.allocate(sizeof(simple_scene_view) * KMAX(frustum_count, 1));
+    kzero_memory(views, sizeof(simple_scene_view) * KMAX(frustum_count, 1));
+    for (u32 i = 0; i < frustum_count; ++i) {
+        views[i].f = frusta[i];
+    }
+    if (!simple_scene_views_cull(scene, frustum_count, views, p_frame_data)) {
+        return false;
+    }
+    return simple_scene_mesh_render_data_from_views(scene, frustum_count, views, center, p_frame_data, out_count, out_geometries);
 }
 
 b8 simple_scene_terrain_render_data_query(const simple_scene *scene, const frustum *f, vec3 center, frame_data *p_frame_data, u32 *out_count, struct geometry_render_data **out_terrain_geometries) {
@@ -1557,6 +1854,33 @@ static void simple_scene_actual_unload(simple_scene *scene) {
         darray_destroy(scene->meshes);
     }
 
+    transform_hierarchy_destroy(&scene->mesh_transforms);
+
+    if (scene->mesh_bvh_ids) {
+        darray_destroy(scene->mesh_bvh_ids);
+    }
+    bvh_destroy(&scene->mesh_bvh);
+
+    if (scene->geometry_refs) {
+        darray_destroy(scene->geometry_refs);
+    }
+    if (scene->draws) {
+        darray_destroy(scene->draws);
+    }
+    if (scene->draw_flags) {
+        darray_destroy(scene->draw_flags);
+    }
+    if (scene->draw_material_generations) {
+        darray_destroy(scene->draw_material_generations);
+    }
+    if (scene->mesh_caches) {
+        darray_destroy(scene->mesh_caches);
+    }
+    if (scene->pending_draws) {
+        darray_destroy(scene->pending_draws);
+    }
+    bounds_soa_destroy(&scene->geometry_bounds);
+
     if (scene->terrains) {
         darray_destroy(scene->terrains);
     }
@@ -827,7 +827,8 @@ b8 application_update(struct application* game_inst, struct frame_data* p_frame_
 FPS: %5.1f(%4.1fms)        Pos=[%7.3f %7.3f %7.3f] Rot=[%7.3f, %7.3f, %7.3f]\n\
 Upd: %8.3fus, Prep: %8.3fus, Rend: %8.3fus, Tot: %8.3fus \n\
 Mouse: X=%-5d Y=%-5d   L=%s R=%s   NDC: X=%.6f, Y=%.6f\n\
-VSync: %s Drawn: %-5u (%-5u shadow pass) Hovered: %s%u",
+VSync: %s Drawn: %-5u (%-5u shadow pass: %u/%u/%u/%u) Hovered: %s%u\n\
+Draw calls: %-5u Material uploads: %uB global, %uB instance (%u rewritten)",
         fps,
         frame_time,
         pos.x, pos.y, pos.z,
@@ -844,8 +845,16 @@ VSync: %s Drawn: %-5u (%-5u shadow pass) Hovered: %s%u",
         vsync_text,
         p_frame_data->drawn_mesh_count,
         p_frame_data->drawn_shadow_mesh_count,
+        p_frame_data->drawn_shadow_cascade_mesh_counts[0],
+        p_frame_data->drawn_shadow_cascade_mesh_counts[1],
+        p_frame_data->drawn_shadow_cascade_mesh_counts[2],
+        p_frame_data->drawn_shadow_cascade_mesh_counts[3],
         state->hovered_object_id == INVALID_ID ? "none" : "",
-        state->hovered_object_id == INVALID_ID ? 0 : state->hovered_object_id);
+        state->hovered_object_id == INVALID_ID ? 0 : state->hovered_object_id,
+        p_frame_data->draw_call_count,
+        p_frame_data->material_global_bytes_uploaded,
+        p_frame_data->material_instance_bytes_uploaded,
+        p_frame_data->material_instance_update_count);
     if (state->running) {
         sui_label_text_set(&state->test_text, text_buffer);
     }
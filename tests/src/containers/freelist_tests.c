@@ -5,6 +5,7 @@
 #include <defines.h>
 #include <containers/freelist.h>
 #include <core/kmemory.h>
+#include <platform/platform.h>
 
 u8 freelist_should_create_and_destroy(void) {
     // NOTE: creating a small size list, which will trigger a warning.
@@ -285,10 +286,224 @@ u8 freelist_should_allocate_to_full_and_fail_to_allocate_more(void) {
     return true;
 }
 
+u8 freelist_tlsf_should_allocate_and_coalesce(void) {
+    freelist list;
+
+    u64 memory_requirement = 0;
+    u64 total_size = 4096;
+    freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &memory_requirement, 0, 0);
+    void* block = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &memory_requirement, block, &list);
+    expect_should_be(total_size, freelist_free_space(&list));
+
+    // Allocations are carved from the front of the range in order.
+    u64 offset_a = INVALID_ID, offset_b = INVALID_ID, offset_c = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, 100, &offset_a));
+    expect_to_be_true(freelist_allocate_block(&list, 200, &offset_b));
+    expect_to_be_true(freelist_allocate_block(&list, 300, &offset_c));
+    expect_should_be(0, offset_a);
+    expect_should_be(100, offset_b);
+    expect_should_be(300, offset_c);
+    expect_should_be(total_size - 600, freelist_free_space(&list));
+
+    // Fill the tail, then free a and b. They must coalesce for 300 bytes to fit back at the front.
+    u64 offset_tail = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, total_size - 600, &offset_tail));
+    expect_to_be_true(freelist_free_block(&list, 200, offset_b));
+    expect_to_be_true(freelist_free_block(&list, 100, offset_a));
+    u64 offset_d = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, 300, &offset_d));
+    expect_should_be(0, offset_d);
+
+    // Freeing everything must coalesce back into a single range.
+    expect_to_be_true(freelist_free_block(&list, 300, offset_d));
+    expect_to_be_true(freelist_free_block(&list, 300, offset_c));
+    expect_to_be_true(freelist_free_block(&list, total_size - 600, offset_tail));
+    expect_should_be(total_size, freelist_free_space(&list));
+    u64 offset_all = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, total_size, &offset_all));
+    expect_should_be(0, offset_all);
+    expect_should_be(0, freelist_free_space(&list));
+
+    // Full, so nothing more fits.
+    u64 offset_more = INVALID_ID;
+    DDEBUG("The following warning message is intentional.");
+    expect_to_be_false(freelist_allocate_block(&list, 1, &offset_more));
+    expect_to_be_true(freelist_free_block(&list, total_size, offset_all));
+
+    // Ranges that are not on a bin boundary must still be found when they are the only fit.
+    u64 offsets[3];
+    expect_to_be_true(freelist_allocate_block(&list, 1000, &offsets[0]));
+    expect_to_be_true(freelist_allocate_block(&list, 1001, &offsets[1]));
+    expect_to_be_true(freelist_allocate_block(&list, total_size - 2001, &offsets[2]));
+    expect_to_be_true(freelist_free_block(&list, 1001, offsets[1]));
+    u64 offset_exact = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, 1001, &offset_exact));
+    expect_should_be(offsets[1], offset_exact);
+
+    freelist_destroy(&list);
+    expect_should_be(0, list.memory);
+    kfree(block, memory_requirement, MEMORY_TAG_ENGINE);
+    return true;
+}
+
+u8 freelist_tlsf_should_reject_invalid_frees(void) {
+    freelist list;
+
+    u64 memory_requirement = 0;
+    u64 total_size = 1024;
+    freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &memory_requirement, 0, 0);
+    void* block = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &memory_requirement, block, &list);
+
+    u64 offset = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, 64, &offset));
+
+    DDEBUG("The following warning messages are intentional.");
+    // Wrong size.
+    expect_to_be_false(freelist_free_block(&list, 32, offset));
+    // Not an allocated offset.
+    expect_to_be_false(freelist_free_block(&list, 64, offset + 8));
+    expect_to_be_true(freelist_free_block(&list, 64, offset));
+    // Double free.
+    expect_to_be_false(freelist_free_block(&list, 64, offset));
+    expect_should_be(total_size, freelist_free_space(&list));
+
+    freelist_destroy(&list);
+    kfree(block, memory_requirement, MEMORY_TAG_ENGINE);
+    return true;
+}
+
+u8 freelist_tlsf_should_resize_and_clear(void) {
+    freelist list;
+
+    u64 memory_requirement = 0;
+    u64 total_size = 1024;
+    freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &memory_requirement, 0, 0);
+    void* block = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    freelist_create_with_type(total_size, FREELIST_TYPE_TLSF, &memory_requirement, block, &list);
+
+    u64 offset_a = INVALID_ID, offset_b = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, 512, &offset_a));
+    expect_to_be_true(freelist_allocate_block(&list, 512, &offset_b));
+
+    // Grow the list while full. Existing allocations must survive the move.
+    u64 new_size = 64 * 1024;
+    u64 new_requirement = 0;
+    expect_to_be_true(freelist_resize(&list, &new_requirement, 0, new_size, 0));
+    void* new_block = kallocate(new_requirement, MEMORY_TAG_ENGINE);
+    void* old_block = 0;
+    expect_to_be_true(freelist_resize(&list, &new_requirement, new_block, new_size, &old_block));
+    expect_should_be(block, old_block);
+    kfree(old_block, memory_requirement, MEMORY_TAG_ENGINE);
+    expect_should_be(new_size - total_size, freelist_free_space(&list));
+
+    u64 offset_c = INVALID_ID;
+    expect_to_be_true(freelist_allocate_block(&list, 4096, &offset_c));
+    expect_should_be(total_size, offset_c);
+    expect_to_be_true(freelist_free_block(&list, 512, offset_a));
+    expect_to_be_true(freelist_free_block(&list, 512, offset_b));
+    expect_to_be_true(freelist_free_block(&list, 4096, offset_c));
+    expect_should_be(new_size, freelist_free_space(&list));
+
+    // Clearing frees everything at once.
+    expect_to_be_true(freelist_allocate_block(&list, 100, &offset_a));
+    freelist_clear(&list);
+    expect_should_be(new_size, freelist_free_space(&list));
+    expect_to_be_true(freelist_allocate_block(&list, new_size, &offset_a));
+    expect_should_be(0, offset_a);
+
+    freelist_destroy(&list);
+    kfree(new_block, new_requirement, MEMORY_TAG_ENGINE);
+    return true;
+}
+
+static u32 fragmentation_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static b8 run_fragmentation_benchmark(freelist_type type, const char* name) {
+    // A heap churned by mixed-size allocations, so it ends up with thousands of holes.
+    const u64 total_size = MEBIBYTES(64);
+    const u32 live_count = 5000;
+    const u32 churn_count = 50000;
+
+    freelist list;
+    u64 memory_requirement = 0;
+    freelist_create_with_type(total_size, type, &memory_requirement, 0, 0);
+    void* block = kallocate(memory_requirement, MEMORY_TAG_ENGINE);
+    freelist_create_with_type(total_size, type, &memory_requirement, block, &list);
+
+    u64* offsets = kallocate(sizeof(u64) * live_count, MEMORY_TAG_ARRAY);
+    u64* sizes = kallocate(sizeof(u64) * live_count, MEMORY_TAG_ARRAY);
+    u32 seed = 0x12345678;
+    for (u32 i = 0; i < live_count; ++i) {
+        sizes[i] = 16 + fragmentation_random(&seed) % 8192;
+        if (!freelist_allocate_block(&list, sizes[i], &offsets[i])) {
+            return false;
+        }
+    }
+    // Free every other one to leave holes throughout.
+    for (u32 i = 0; i < live_count; i += 2) {
+        freelist_free_block(&list, sizes[i], offsets[i]);
+        sizes[i] = 0;
+    }
+
+    u32 failures = 0;
+    f64 start = platform_get_absolute_time();
+    for (u32 op = 0; op < churn_count; ++op) {
+        u32 i = fragmentation_random(&seed) % live_count;
+        if (sizes[i]) {
+            if (!freelist_free_block(&list, sizes[i], offsets[i])) {
+                return false;
+            }
+            sizes[i] = 0;
+        } else {
+            sizes[i] = 16 + fragmentation_random(&seed) % 8192;
+            if (!freelist_allocate_block(&list, sizes[i], &offsets[i])) {
+                failures++;
+                sizes[i] = 0;
+            }
+        }
+    }
+    f64 elapsed = platform_get_absolute_time() - start;
+
+    DINFO("Freelist fragmentation benchmark (%s): %u ops over ~%u live blocks, %.1f ns per op, %u failed allocations.",
+          name, churn_count, live_count / 2, (elapsed / churn_count) * 1000000000.0, failures);
+
+    for (u32 i = 0; i < live_count; ++i) {
+        if (sizes[i]) {
+            freelist_free_block(&list, sizes[i], offsets[i]);
+        }
+    }
+    b8 all_free = freelist_free_space(&list) == total_size;
+
+    kfree(offsets, sizeof(u64) * live_count, MEMORY_TAG_ARRAY);
+    kfree(sizes, sizeof(u64) * live_count, MEMORY_TAG_ARRAY);
+    freelist_destroy(&list);
+    kfree(block, memory_requirement, MEMORY_TAG_ENGINE);
+    return all_free && failures == 0;
+}
+
+u8 freelist_benchmark_fragmentation(void) {
+    expect_to_be_true(run_fragmentation_benchmark(FREELIST_TYPE_FIRST_FIT, "first-fit"));
+    expect_to_be_true(run_fragmentation_benchmark(FREELIST_TYPE_TLSF, "TLSF"));
+    return true;
+}
+
 void freelist_register_tests(void) {
     test_manager_register_test(freelist_should_create_and_destroy, "Freelist should create and destroy");
     test_manager_register_test(freelist_should_allocate_one_and_free_one, "Freelist allocate and free one entry.");
     test_manager_register_test(freelist_should_allocate_one_and_free_multi, "Freelist allocate and free multiple entries.");
     test_manager_register_test(freelist_should_allocate_one_and_free_multi_varying_sizes, "Freelist allocate and free multiple entries of varying sizes.");
     test_manager_register_test(freelist_should_allocate_to_full_and_fail_to_allocate_more, "Freelist allocate to full and fail when trying to allocate more.");
+    test_manager_register_test(freelist_tlsf_should_allocate_and_coalesce, "TLSF freelist allocates in order and coalesces on free.");
+    test_manager_register_test(freelist_tlsf_should_reject_invalid_frees, "TLSF freelist rejects double frees and mismatched sizes.");
+    test_manager_register_test(freelist_tlsf_should_resize_and_clear, "TLSF freelist resizes with live allocations and clears.");
+    test_manager_register_test(freelist_benchmark_fragmentation, "Freelist benchmark: first-fit vs TLSF on a fragmented heap.");
 }
\ No newline at end of file
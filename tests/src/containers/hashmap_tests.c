@@ -0,0 +1,244 @@
+#include "hashmap_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <containers/hashmap.h>
+#include <containers/hashtable.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <platform/platform.h>
+
+u8 hashmap_should_create_and_destroy(void) {
+    hashmap map;
+    expect_to_be_true(hashmap_create(sizeof(u64), 3, HASHMAP_KEY_TYPE_STRING, false, &map));
+
+    expect_should_not_be(0, map.slots);
+    expect_should_be(sizeof(u64), map.element_size);
+    expect_should_be(0, map.count);
+    // Capacity is always a power of two with room for the requested entries.
+    expect_should_be(0, (map.capacity & (map.capacity - 1)));
+    expect_to_be_true((map.max_count >= 3));
+
+    hashmap_destroy(&map);
+
+    expect_should_be(0, map.slots);
+    expect_should_be(0, map.capacity);
+    return true;
+}
+
+u8 hashmap_should_set_get_and_remove(void) {
+    hashmap map;
+    hashmap_create(sizeof(u64), 16, HASHMAP_KEY_TYPE_STRING, false, &map);
+
+    u64 value = 23;
+    expect_to_be_true(hashmap_set(&map, "test1", &value));
+    value = 42;
+    expect_to_be_true(hashmap_set(&map, "test2", &value));
+    expect_should_be(2, map.count);
+
+    u64 result = 0;
+    expect_to_be_true(hashmap_get(&map, "test1", &result));
+    expect_should_be(23, result);
+    expect_to_be_true(hashmap_get(&map, "test2", &result));
+    expect_should_be(42, result);
+    expect_to_be_false(hashmap_get(&map, "test3", &result));
+
+    // Overwrite replaces rather than adding.
+    value = 99;
+    expect_to_be_true(hashmap_set(&map, "test1", &value));
+    expect_should_be(2, map.count);
+    expect_to_be_true(hashmap_get(&map, "test1", &result));
+    expect_should_be(99, result);
+
+    expect_to_be_true(hashmap_remove(&map, "test1"));
+    expect_to_be_false(hashmap_remove(&map, "test1"));
+    expect_to_be_false(hashmap_get(&map, "test1", 0));
+    expect_to_be_true(hashmap_get(&map, "test2", &result));
+    expect_should_be(42, result);
+    expect_should_be(1, map.count);
+
+    hashmap_clear(&map);
+    expect_should_be(0, map.count);
+    expect_to_be_false(hashmap_get(&map, "test2", 0));
+
+    hashmap_destroy(&map);
+    return true;
+}
+
+u8 hashmap_should_keep_colliding_keys_distinct(void) {
+    // Every key lands in an 8-16 slot table, so most collide on their home slot.
+    // Unlike hashtable, each must still be found with its own value.
+    hashmap map;
+    hashmap_create(sizeof(u32), 12, HASHMAP_KEY_TYPE_STRING, false, &map);
+
+    char name[32];
+    for (u32 i = 0; i < 12; ++i) {
+        string_format(name, "texture_%u", i);
+        expect_to_be_true(hashmap_set(&map, name, &i));
+    }
+    expect_should_be(12, map.count);
+
+    // A fixed-size map refuses entries past its limit.
+    u32 extra = 0;
+    DDEBUG("The following error message is intentional.");
+    while (map.count < map.max_count) {
+        string_format(name, "filler_%u", extra++);
+        hashmap_set(&map, name, &extra);
+    }
+    expect_to_be_false(hashmap_set(&map, "one_too_many", &extra));
+
+    for (u32 i = 0; i < 12; ++i) {
+        string_format(name, "texture_%u", i);
+        u32 result = INVALID_ID;
+        expect_to_be_true(hashmap_get(&map, name, &result));
+        expect_should_be(i, result);
+    }
+
+    // Removing from the middle of probe chains must leave the rest reachable.
+    for (u32 i = 0; i < 12; i += 2) {
+        string_format(name, "texture_%u", i);
+        expect_to_be_true(hashmap_remove(&map, name));
+    }
+    for (u32 i = 0; i < 12; ++i) {
+        string_format(name, "texture_%u", i);
+        u32 result = INVALID_ID;
+        b8 found = hashmap_get(&map, name, &result);
+        expect_should_be(((i & 1) != 0), found);
+        if (found) {
+            expect_should_be(i, result);
+        }
+    }
+
+    hashmap_destroy(&map);
+    return true;
+}
+
+u8 hashmap_should_grow_with_integer_keys(void) {
+    hashmap map;
+    hashmap_create(sizeof(u64), 4, HASHMAP_KEY_TYPE_U64, true, &map);
+    u32 initial_capacity = map.capacity;
+
+    // Sequential ids are the common case for integer keys.
+    const u32 count = 10000;
+    for (u64 i = 0; i < count; ++i) {
+        u64 value = i * 3;
+        expect_to_be_true(hashmap_set_u64(&map, i, &value));
+    }
+    expect_should_be(count, map.count);
+    expect_to_be_true((map.capacity > initial_capacity));
+
+    for (u64 i = 0; i < count; ++i) {
+        u64 value = 0;
+        expect_to_be_true(hashmap_get_u64(&map, i, &value));
+        expect_should_be(i * 3, value);
+    }
+    expect_to_be_false(hashmap_get_u64(&map, count, 0));
+
+    for (u64 i = 0; i < count; i += 3) {
+        expect_to_be_true(hashmap_remove_u64(&map, i));
+    }
+    for (u64 i = 0; i < count; ++i) {
+        expect_should_be(((i % 3) != 0), hashmap_get_u64(&map, i, 0));
+    }
+
+    // String functions are rejected on integer maps.
+    DDEBUG("The following error message is intentional.");
+    expect_to_be_false(hashmap_get(&map, "1", 0));
+
+    hashmap_destroy(&map);
+    return true;
+}
+
+static b8 run_lookup_benchmark(u32 entry_count) {
+    // Names generated up front so only the table work is timed.
+    const u32 name_length = 24;
+    char* names = kallocate(name_length * entry_count, MEMORY_TAG_STRING);
+    for (u32 i = 0; i < entry_count; ++i) {
+        string_format(names + (name_length * i), "Texture.Asset_%u", i);
+    }
+    // Lookups happen in a shuffled order, as they would from a scene rather than a loop over the registry.
+    u32* order = kallocate(sizeof(u32) * entry_count, MEMORY_TAG_ARRAY);
+    u32 seed = 0x2545f491;
+    for (u32 i = 0; i < entry_count; ++i) {
+        order[i] = i;
+    }
+    for (u32 i = entry_count - 1; i > 0; --i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        u32 j = seed % (i + 1);
+        u32 t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+
+    // The existing fixed-size table, sized one slot per entry as the systems do.
+    hashtable table;
+    void* table_block = kallocate(sizeof(u32) * entry_count, MEMORY_TAG_HASHTABLE);
+    hashtable_create(sizeof(u32), entry_count, table_block, false, &table);
+
+    f64 start = platform_get_absolute_time();
+    for (u32 i = 0; i < entry_count; ++i) {
+        hashtable_set(&table, names + (name_length * i), &i);
+    }
+    f64 table_insert = platform_get_absolute_time() - start;
+
+    u32 table_wrong = 0;
+    start = platform_get_absolute_time();
+    for (u32 n = 0; n < entry_count; ++n) {
+        u32 i = order[n];
+        u32 value;
+        hashtable_get(&table, names + (name_length * i), &value);
+        table_wrong += value != i;
+    }
+    f64 table_lookup = platform_get_absolute_time() - start;
+
+    hashmap map;
+    hashmap_create(sizeof(u32), entry_count, HASHMAP_KEY_TYPE_STRING, false, &map);
+
+    start = platform_get_absolute_time();
+    for (u32 i = 0; i < entry_count; ++i) {
+        hashmap_set(&map, names + (name_length * i), &i);
+    }
+    f64 map_insert = platform_get_absolute_time() - start;
+
+    u32 map_wrong = 0;
+    start = platform_get_absolute_time();
+    for (u32 n = 0; n < entry_count; ++n) {
+        u32 i = order[n];
+        u32 value = INVALID_ID;
+        hashmap_get(&map, names + (name_length * i), &value);
+        map_wrong += value != i;
+    }
+    f64 map_lookup = platform_get_absolute_time() - start;
+
+    f64 to_ns = 1000000000.0 / entry_count;
+    DINFO("Hashtable benchmark (%u entries): insert %.1f ns, shuffled lookup %.1f ns, %u lookups returned another key's value.",
+          entry_count, table_insert * to_ns, table_lookup * to_ns, table_wrong);
+    DINFO("Hashmap benchmark   (%u entries): insert %.1f ns, shuffled lookup %.1f ns, %u lookups returned another key's value.",
+          entry_count, map_insert * to_ns, map_lookup * to_ns, map_wrong);
+
+    hashmap_destroy(&map);
+    hashtable_destroy(&table);
+    kfree(table_block, sizeof(u32) * entry_count, MEMORY_TAG_HASHTABLE);
+    kfree(order, sizeof(u32) * entry_count, MEMORY_TAG_ARRAY);
+    kfree(names, name_length * entry_count, MEMORY_TAG_STRING);
+    return map_wrong == 0;
+}
+
+u8 hashmap_benchmark_against_hashtable(void) {
+    expect_to_be_true(run_lookup_benchmark(1024));
+    expect_to_be_true(run_lookup_benchmark(64 * 1024));
+    expect_to_be_true(run_lookup_benchmark(1024 * 1024));
+    return true;
+}
+
+void hashmap_register_tests(void) {
+    test_manager_register_test(hashmap_should_create_and_destroy, "Hashmap should create and destroy");
+    test_manager_register_test(hashmap_should_set_get_and_remove, "Hashmap should set, get, overwrite and remove");
+    test_manager_register_test(hashmap_should_keep_colliding_keys_distinct, "Hashmap should keep colliding keys distinct and reject entries when full.");
+    test_manager_register_test(hashmap_should_grow_with_integer_keys, "Hashmap should grow with integer keys.");
+    test_manager_register_test(hashmap_benchmark_against_hashtable, "Hashmap benchmark against hashtable at 1K/64K/1M entries.");
+}
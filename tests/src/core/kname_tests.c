@@ -0,0 +1,147 @@
+#include "kname_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <core/katomic.h>
+#include <core/kname.h>
+#include <core/kstring.h>
+#include <core/thread.h>
+#include <platform/platform.h>
+
+#define KNAME_TEST_THREADS 4
+#define KNAME_TEST_NAMES 1000
+
+u8 kname_should_intern_and_resolve(void) {
+    kname a = kname_create("Texture.Brick");
+    kname b = kname_create("Texture.Brick");
+    kname c = kname_create("texture.brick");
+
+    expect_should_not_be(INVALID_KNAME, a);
+    expect_should_be(a, b);
+    // Case sensitive.
+    expect_should_not_be(a, c);
+
+    // Resolves back to a single copy of the text.
+    const char* str = kname_string_get(a);
+    expect_to_be_true(strings_equal("Texture.Brick", str));
+    expect_should_be(str, kname_string_get(b));
+    expect_to_be_true(strings_equal("texture.brick", kname_string_get(c)));
+
+    expect_should_be(INVALID_KNAME, kname_create(0));
+    expect_should_be(INVALID_KNAME, kname_create(""));
+    expect_should_be(0, kname_string_get(INVALID_KNAME));
+    // An id nobody created.
+    expect_should_be(0, kname_string_get(0x1234567890abcdefULL));
+    return true;
+}
+
+u8 kname_hash_should_not_intern(void) {
+    // The same id as kname_create, but the name is not kept, so looking up names that were never
+    // created cannot fill the table.
+    kname id = kname_hash("Shader.Never_Created");
+    expect_should_not_be(INVALID_KNAME, id);
+    expect_should_be(0, kname_string_get(id));
+    expect_should_be(id, kname_hash("Shader.Never_Created"));
+
+    expect_should_be(id, kname_create("Shader.Never_Created"));
+    expect_to_be_true(strings_equal("Shader.Never_Created", kname_string_get(id)));
+    expect_should_be(id, kname_hash("Shader.Never_Created"));
+
+    expect_should_be(INVALID_KNAME, kname_hash(0));
+    expect_should_be(INVALID_KNAME, kname_hash(""));
+    return true;
+}
+
+typedef struct kname_test_thread {
+    kthread thread;
+    u32 index;
+    volatile u32* start_flag;
+    kname ids[KNAME_TEST_NAMES];
+} kname_test_thread;
+
+static u32 kname_test_thread_run(void* params) {
+    kname_test_thread* t = params;
+    while (!katomic_load_u32(t->start_flag)) {
+        katomic_pause();
+    }
+    // Every thread interns the same names, in a different order, to race on the same entries.
+    char name[32];
+    for (u32 n = 0; n < KNAME_TEST_NAMES; ++n) {
+        u32 i = (n * 7 + t->index * 331) % KNAME_TEST_NAMES;
+        string_format(name, "Material.Concurrent_%u", i);
+        t->ids[i] = kname_create(name);
+    }
+    return 0;
+}
+
+u8 kname_should_intern_concurrently(void) {
+    kname_test_thread threads[KNAME_TEST_THREADS] = {0};
+    volatile u32 start_flag = 0;
+    for (u32 i = 0; i < KNAME_TEST_THREADS; ++i) {
+        threads[i].index = i;
+        threads[i].start_flag = &start_flag;
+        expect_to_be_true(kthread_create(kname_test_thread_run, &threads[i], false, &threads[i].thread));
+    }
+    katomic_store_u32(&start_flag, 1);
+    for (u32 i = 0; i < KNAME_TEST_THREADS; ++i) {
+        kthread_wait(&threads[i].thread);
+    }
+
+    char name[32];
+    for (u32 i = 0; i < KNAME_TEST_NAMES; ++i) {
+        string_format(name, "Material.Concurrent_%u", i);
+        kname id = threads[0].ids[i];
+        for (u32 t = 1; t < KNAME_TEST_THREADS; ++t) {
+            expect_should_be(id, threads[t].ids[i]);
+        }
+        expect_to_be_true(strings_equal(name, kname_string_get(id)));
+    }
+
+    for (u32 i = 0; i < KNAME_TEST_THREADS; ++i) {
+        kthread_destroy(&threads[i].thread);
+    }
+    return true;
+}
+
+u8 kname_should_stop_filling_and_release_on_shutdown(void) {
+    // Start from an empty table.
+    kname_system_shutdown();
+
+    // More names than the table holds. Once it stops taking them, names are still given ids, quickly,
+    // but cannot be resolved.
+    const u32 count = 65536;
+    char name[32];
+    kname first = kname_create("Fill_0");
+    u32 resolvable = 1;
+    f64 start = platform_get_absolute_time();
+    for (u32 i = 1; i < count; ++i) {
+        string_format(name, "Fill_%u", i);
+        kname id = kname_create(name);
+        expect_should_not_be(INVALID_KNAME, id);
+        if (kname_string_get(id)) {
+            resolvable++;
+        }
+    }
+    f64 elapsed = platform_get_absolute_time() - start;
+    expect_to_be_true((resolvable < count));
+    expect_to_be_true(strings_equal("Fill_0", kname_string_get(first)));
+    string_format(name, "Fill_%u", count - 1);
+    expect_should_be(0, kname_string_get(kname_create(name)));
+    DINFO("kname fill: %u of %u names resolvable, %.1f ns per create.", resolvable, count, elapsed * 1e9 / count);
+
+    // Shutdown releases every string. Ids are unchanged, and resolve again once created again.
+    kname_system_shutdown();
+    expect_should_be(0, kname_string_get(first));
+    expect_should_be(first, kname_create("Fill_0"));
+    expect_to_be_true(strings_equal("Fill_0", kname_string_get(first)));
+    kname_system_shutdown();
+    return true;
+}
+
+void kname_register_tests(void) {
+    test_manager_register_test(kname_should_intern_and_resolve, "kname should intern strings and resolve ids back to them.");
+    test_manager_register_test(kname_hash_should_not_intern, "kname_hash should give the created id without interning the string.");
+    test_manager_register_test(kname_should_intern_concurrently, "kname should give every thread the same id for the same string.");
+    test_manager_register_test(kname_should_stop_filling_and_release_on_shutdown, "kname should stop short of a full table and release strings on shutdown.");
+}
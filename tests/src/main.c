@@ -2,8 +2,23 @@
 
 #include "memory/linear_allocator_tests.h"
 #include "containers/hashtable_tests.h"
+#include "containers/hashmap_tests.h"
 #include "containers/freelist_tests.h"
+#include "core/kname_tests.h"
+#include "math/bvh_tests.h"
+#include "math/culling_tests.h"
+#include "math/geometry_utils_tests.h"
+#include "math/kmath_tests.h"
+#include "math/transform_hierarchy_tests.h"
 #include "memory/dynamic_allocator_tests.h"
+#include "memory/kmemory_tests.h"
+#include "renderer/instance_batch_tests.h"
+#include "renderer/render_queue_tests.h"
+#include "resources/ksm_file_tests.h"
+#include "resources/obj_file_tests.h"
+#include "resources/simple_scene_tests.h"
+#include "systems/job_system_tests.h"
+#include "systems/job_graph_tests.h"
 
 #include <core/logger.h>
 
@@ -12,8 +27,23 @@ int main(void) {
 
     linear_allocator_register_tests();
     hashtable_register_tests();
+    hashmap_register_tests();
     freelist_register_tests();
+    kname_register_tests();
+    bvh_register_tests();
+    culling_register_tests();
+    geometry_utils_register_tests();
+    kmath_register_tests();
+    transform_hierarchy_register_tests();
     dynamic_allocator_register_tests();
+    kmemory_register_tests();
+    render_queue_register_tests();
+    instance_batch_register_tests();
+    ksm_file_register_tests();
+    obj_file_register_tests();
+    simple_scene_register_tests();
+    job_system_register_tests();
+    job_graph_register_tests();
 
     DDEBUG("Starting tests");
 
@@ -0,0 +1,325 @@
+#include "bvh_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <defines.h>
+#include <core/kmemory.h>
+#include <core/logger.h>
+#include <math/bvh.h>
+#include <math/geometry_3d.h>
+#include <math/kmath.h>
+#include <platform/platform.h>
+
+typedef struct bvh_test_results {
+    u32 count;
+    u8* seen;
+} bvh_test_results;
+
+static b8 record_hit(u64 user_data, void* context) {
+    bvh_test_results* results = context;
+    results->seen[user_data] = 1;
+    results->count++;
+    return true;
+}
+
+static b8 count_hit(u64 user_data, void* context) {
+    (*(u32*)context)++;
+    return true;
+}
+
+static b8 stop_after_first(u64 user_data, void* context) {
+    (*(u32*)context)++;
+    return false;
+}
+
+static extents_3d box_at(vec3 center, f32 half) {
+    extents_3d e = {vec3_sub(center, (vec3){half, half, half}), vec3_add(center, (vec3){half, half, half})};
+    return e;
+}
+
+static frustum test_frustum(void) {
+    // Looking down -z from the origin, as the default camera does.
+    vec3 position = vec3_zero();
+    vec3 forward = vec3_forward();
+    vec3 right = vec3_right();
+    vec3 up = vec3_up();
+    return frustum_create(&position, &forward, &right, &up, 16.0f / 9.0f, deg_to_rad(45.0f), 0.1f, 1000.0f);
+}
+
+static b8 box_contains(extents_3d outer, extents_3d inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+           outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+// Height of the subtree at index, verifying parent links and that every parent box contains its children.
+static i32 validate_subtree(const bvh* tree, u32 index, u32* leaf_count) {
+    const bvh_node* n = &tree->nodes[index];
+    if (n->left == INVALID_ID) {
+        (*leaf_count)++;
+        return 0;
+    }
+    const bvh_node* l = &tree->nodes[n->left];
+    const bvh_node* r = &tree->nodes[n->right];
+    if (l->parent != index || r->parent != index) {
+        return -1;
+    }
+    if (!box_contains(n->aabb, l->aabb) || !box_contains(n->aabb, r->aabb)) {
+        return -1;
+    }
+    i32 lh = validate_subtree(tree, n->left, leaf_count);
+    i32 rh = validate_subtree(tree, n->right, leaf_count);
+    if (lh < 0 || rh < 0 || lh - rh > 1 || rh - lh > 1) {
+        return -1;
+    }
+    return 1 + KMAX(lh, rh);
+}
+
+u8 bvh_should_insert_query_and_remove(void) {
+    bvh tree;
+    expect_to_be_true(bvh_create(4, 0.0f, &tree));
+    expect_should_be(INVALID_ID, tree.root);
+
+    // Two boxes in front of the camera, one behind it.
+    u32 a = bvh_insert(&tree, box_at((vec3){0.0f, 0.0f, -10.0f}, 1.0f), 0);
+    u32 b = bvh_insert(&tree, box_at((vec3){2.0f, 0.0f, -20.0f}, 1.0f), 1);
+    u32 c = bvh_insert(&tree, box_at((vec3){0.0f, 0.0f, 10.0f}, 1.0f), 2);
+    expect_should_be(3, tree.leaf_count);
+
+    u8 seen[3] = {0};
+    bvh_test_results results = {0, seen};
+    frustum f = test_frustum();
+    bvh_query_frustum(&tree, &f, record_hit, &results);
+    expect_should_be(2, results.count);
+    expect_should_be(1, seen[0]);
+    expect_should_be(1, seen[1]);
+    expect_should_be(0, seen[2]);
+
+    // A ray down -z only hits the first box; one along +z only the one behind.
+    ray r = ray_create(vec3_zero(), vec3_forward());
+    kzero_memory(seen, sizeof(seen));
+    results.count = 0;
+    bvh_query_ray(&tree, &r, record_hit, &results);
+    expect_should_be(1, results.count);
+    expect_should_be(1, seen[0]);
+
+    r.direction = vec3_back();
+    kzero_memory(seen, sizeof(seen));
+    results.count = 0;
+    bvh_query_ray(&tree, &r, record_hit, &results);
+    expect_should_be(1, results.count);
+    expect_should_be(1, seen[2]);
+
+    // A line along z with a small radius reaches the two on-axis boxes, but not the offset one.
+    kzero_memory(seen, sizeof(seen));
+    results.count = 0;
+    bvh_query_line(&tree, vec3_zero(), vec3_forward(), 0.5f, record_hit, &results);
+    expect_should_be(2, results.count);
+    expect_should_be(0, seen[1]);
+
+    // Returning false stops the query.
+    u32 visited = 0;
+    bvh_query_frustum(&tree, &f, stop_after_first, &visited);
+    expect_should_be(1, visited);
+
+    bvh_remove(&tree, a);
+    bvh_remove(&tree, c);
+    expect_should_be(1, tree.leaf_count);
+    expect_should_be(b, tree.root);
+
+    visited = 0;
+    bvh_query_frustum(&tree, &f, count_hit, &visited);
+    expect_should_be(1, visited);
+
+    bvh_clear(&tree);
+    expect_should_be(0, tree.leaf_count);
+    expect_should_be(INVALID_ID, tree.root);
+
+    bvh_destroy(&tree);
+    expect_should_be(0, tree.nodes);
+    return true;
+}
+
+u8 bvh_should_only_restructure_when_leaving_fat_box(void) {
+    bvh tree;
+    bvh_create(4, 0.5f, &tree);
+
+    u32 id = bvh_insert(&tree, box_at((vec3){0.0f, 0.0f, -10.0f}, 1.0f), 7);
+    bvh_insert(&tree, box_at((vec3){5.0f, 0.0f, -10.0f}, 1.0f), 8);
+
+    // Within the margin, nothing changes.
+    expect_to_be_false(bvh_update(&tree, id, box_at((vec3){0.4f, 0.0f, -10.0f}, 1.0f)));
+    // Beyond it, the leaf is reinserted with a new fat box around its new position.
+    expect_to_be_true(bvh_update(&tree, id, box_at((vec3){0.0f, 0.0f, 10.0f}, 1.0f)));
+    expect_float_to_be(8.5f, tree.nodes[id].aabb.min.z);
+    expect_should_be(2, tree.leaf_count);
+
+    // The moved leaf is now behind the camera.
+    u8 seen[9] = {0};
+    bvh_test_results results = {0, seen};
+    frustum f = test_frustum();
+    bvh_query_frustum(&tree, &f, record_hit, &results);
+    expect_should_be(1, results.count);
+    expect_should_be(1, seen[8]);
+
+    bvh_destroy(&tree);
+    return true;
+}
+
+u8 bvh_should_stay_balanced_and_match_linear_scan(void) {
+    const u32 count = 4096;
+    u32 seed = 0x1234567;
+    bvh tree;
+    bvh_create(16, 0.1f, &tree);
+
+    extents_3d* boxes = kallocate(sizeof(extents_3d) * count, MEMORY_TAG_ARRAY);
+    u32* ids = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    u8* seen = kallocate(count, MEMORY_TAG_ARRAY);
+
+    // Inserted in a sorted sweep along x, the worst case for an unbalanced tree.
+    for (u32 i = 0; i < count; ++i) {
+        vec3 center = {(f32)i * 0.5f - 1000.0f, random_range(&seed, -50.0f, 50.0f), random_range(&seed, -500.0f, 0.0f)};
+        boxes[i] = box_at(center, random_range(&seed, 0.1f, 2.0f));
+        ids[i] = bvh_insert(&tree, boxes[i], i);
+    }
+
+    // Move a third of them, some a long way.
+    for (u32 i = 0; i < count; i += 3) {
+        vec3 offset = {random_range(&seed, -20.0f, 20.0f), 0.0f, random_range(&seed, -20.0f, 20.0f)};
+        boxes[i].min = vec3_add(boxes[i].min, offset);
+        boxes[i].max = vec3_add(boxes[i].max, offset);
+        bvh_update(&tree, ids[i], boxes[i]);
+    }
+
+    u32 leaves = 0;
+    i32 height = validate_subtree(&tree, tree.root, &leaves);
+    expect_to_be_true((height > 0));
+    expect_should_be(count, leaves);
+    // A balanced tree of 4096 leaves is 12 deep; AVL balance allows about 1.44x that.
+    expect_to_be_true((height <= 18));
+
+    // Every box the linear scan finds must be reported. Fat boxes may add a few more.
+    frustum f = test_frustum();
+    bvh_test_results results = {0, seen};
+    kzero_memory(seen, count);
+    bvh_query_frustum(&tree, &f, record_hit, &results);
+    u32 linear_count = 0;
+    u32 missed = 0;
+    for (u32 i = 0; i < count; ++i) {
+        vec3 center = vec3_mul_scalar(vec3_add(boxes[i].min, boxes[i].max), 0.5f);
+        vec3 half = vec3_mul_scalar(vec3_sub(boxes[i].max, boxes[i].min), 0.5f);
+        if (frustum_intersects_aabb(&f, &center, &half)) {
+            linear_count++;
+            missed += !seen[i];
+        }
+    }
+    expect_should_be(0, missed);
+    expect_to_be_true((linear_count > 0));
+    expect_to_be_true((results.count >= linear_count));
+
+    ray r = ray_create((vec3){-1000.0f, 0.0f, -250.0f}, vec3_normalized((vec3){1.0f, 0.0f, 0.1f}));
+    results.count = 0;
+    kzero_memory(seen, count);
+    bvh_query_ray(&tree, &r, record_hit, &results);
+    missed = 0;
+    for (u32 i = 0; i < count; ++i) {
+        vec3 point;
+        if (raycast_aabb(boxes[i], &r, &point)) {
+            missed += !seen[i];
+        }
+    }
+    expect_should_be(0, missed);
+
+    // Removing every other leaf keeps the tree valid.
+    for (u32 i = 0; i < count; i += 2) {
+        bvh_remove(&tree, ids[i]);
+    }
+    leaves = 0;
+    expect_to_be_true((validate_subtree(&tree, tree.root, &leaves) > 0));
+    expect_should_be(count / 2, leaves);
+
+    kfree(seen, count, MEMORY_TAG_ARRAY);
+    kfree(ids, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    kfree(boxes, sizeof(extents_3d) * count, MEMORY_TAG_ARRAY);
+    bvh_destroy(&tree);
+    return true;
+}
+
+static void run_scene_benchmark(u32 mesh_count) {
+    const u32 frame_count = 60;
+    u32 seed = 0xBADC0DE;
+
+    // Meshes scattered over a 2km square around the camera, as in a large open scene.
+    extents_3d* boxes = kallocate(sizeof(extents_3d) * mesh_count, MEMORY_TAG_ARRAY);
+    u32* ids = kallocate(sizeof(u32) * mesh_count, MEMORY_TAG_ARRAY);
+    bvh tree;
+    bvh_create(mesh_count, 0.25f, &tree);
+    for (u32 i = 0; i < mesh_count; ++i) {
+        vec3 center = {random_range(&seed, -1000.0f, 1000.0f), random_range(&seed, 0.0f, 20.0f), random_range(&seed, -1000.0f, 1000.0f)};
+        boxes[i] = box_at(center, random_range(&seed, 0.5f, 3.0f));
+        ids[i] = bvh_insert(&tree, boxes[i], i);
+    }
+
+    frustum f = test_frustum();
+    vec3 light_direction = vec3_normalized((vec3){-0.5f, -1.0f, -0.3f});
+
+    f64 refit_time = 0, bvh_time = 0, linear_time = 0;
+    u32 bvh_visible = 0, linear_visible = 0;
+    for (u32 frame = 0; frame < frame_count; ++frame) {
+        // A tenth of the meshes move a little each frame.
+        f64 start = platform_get_absolute_time();
+        for (u32 i = frame % 10; i < mesh_count; i += 10) {
+            vec3 offset = {random_range(&seed, -0.1f, 0.1f), 0.0f, random_range(&seed, -0.1f, 0.1f)};
+            boxes[i].min = vec3_add(boxes[i].min, offset);
+            boxes[i].max = vec3_add(boxes[i].max, offset);
+            bvh_update(&tree, ids[i], boxes[i]);
+        }
+        refit_time += platform_get_absolute_time() - start;
+
+        ray r = ray_create(vec3_zero(), vec3_normalized((vec3){random_range(&seed, -0.5f, 0.5f), -0.05f, -1.0f}));
+
+        // Camera frustum, a light line through the view and a mouse-pick ray.
+        start = platform_get_absolute_time();
+        u32 visible = 0, lit = 0, picked = 0;
+        bvh_query_frustum(&tree, &f, count_hit, &visible);
+        bvh_query_line(&tree, (vec3){0.0f, 0.0f, -50.0f}, light_direction, 60.0f, count_hit, &lit);
+        bvh_query_ray(&tree, &r, count_hit, &picked);
+        bvh_time += platform_get_absolute_time() - start;
+        bvh_visible += visible;
+
+        // The same queries as the scene performed them before: every mesh, every time.
+        start = platform_get_absolute_time();
+        visible = lit = picked = 0;
+        for (u32 i = 0; i < mesh_count; ++i) {
+            vec3 center = vec3_mul_scalar(vec3_add(boxes[i].min, boxes[i].max), 0.5f);
+            vec3 half = vec3_mul_scalar(vec3_sub(boxes[i].max, boxes[i].min), 0.5f);
+            visible += frustum_intersects_aabb(&f, &center, &half);
+            lit += (vec3_distance_to_line(center, (vec3){0.0f, 0.0f, -50.0f}, light_direction) - vec3_length(half)) <= 60.0f;
+            vec3 point;
+            picked += raycast_aabb(boxes[i], &r, &point);
+        }
+        linear_time += platform_get_absolute_time() - start;
+        linear_visible += visible;
+    }
+
+    f64 to_ms = 1000.0 / frame_count;
+    DINFO("BVH scene benchmark (%u meshes): refit %.3f ms, queries %.3f ms, linear scan %.3f ms per frame. %u vs %u visible per frame.",
+          mesh_count, refit_time * to_ms, bvh_time * to_ms, linear_time * to_ms, bvh_visible / frame_count, linear_visible / frame_count);
+
+    bvh_destroy(&tree);
+    kfree(ids, sizeof(u32) * mesh_count, MEMORY_TAG_ARRAY);
+    kfree(boxes, sizeof(extents_3d) * mesh_count, MEMORY_TAG_ARRAY);
+}
+
+u8 bvh_benchmark_scene_queries(void) {
+    run_scene_benchmark(10000);
+    run_scene_benchmark(100000);
+    return true;
+}
+
+void bvh_register_tests(void) {
+    test_manager_register_test(bvh_should_insert_query_and_remove, "BVH should insert, query and remove leaves.");
+    test_manager_register_test(bvh_should_only_restructure_when_leaving_fat_box, "BVH should only restructure when a leaf leaves its fat box.");
+    test_manager_register_test(bvh_should_stay_balanced_and_match_linear_scan, "BVH should stay balanced and find everything a linear scan does.");
+    test_manager_register_test(bvh_benchmark_scene_queries, "BVH benchmark of scene queries at 10K/100K meshes.");
+}
@@ -0,0 +1,316 @@
+#include "culling_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <defines.h>
+#include <core/kmemory.h>
+#include <core/logger.h>
+#include <math/culling.h>
+#include <math/kmath.h>
+#include <platform/platform.h>
+
+static frustum test_frustum(void) {
+    vec3 position = vec3_zero();
+    vec3 forward = vec3_forward();
+    vec3 right = vec3_right();
+    vec3 up = vec3_up();
+    return frustum_create(&position, &forward, &right, &up, 16.0f / 9.0f, deg_to_rad(45.0f), 0.1f, 1000.0f);
+}
+
+static void fill_random_bounds(bounds_soa* bounds, u32 count, u32 seed) {
+    bounds_soa_clear(bounds);
+    for (u32 i = 0; i < count; ++i) {
+        vec3 center = {random_range(&seed, -1000.0f, 1000.0f), random_range(&seed, -50.0f, 50.0f), random_range(&seed, -1000.0f, 1000.0f)};
+        vec3 half = {random_range(&seed, 0.1f, 5.0f), random_range(&seed, 0.1f, 5.0f), random_range(&seed, 0.1f, 5.0f)};
+        bounds_soa_push(bounds, center, half);
+    }
+}
+
+u8 culling_should_match_frustum_intersects_aabb(void) {
+    bounds_soa bounds;
+    expect_to_be_true(bounds_soa_create(1, &bounds));
+    // Capacity is padded to whole groups of 8.
+    expect_should_be(8, bounds.capacity);
+
+    frustum f = test_frustum();
+    // Counts that leave a partial group exercise the tail handling of each path.
+    u32 counts[] = {1, 3, 8, 13, 1000, 4099};
+    for (u32 c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        u32 count = counts[c];
+        fill_random_bounds(&bounds, count, 0xC0FFEE + c);
+        expect_should_be(count, bounds.count);
+
+        u32* simd = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+        u32* scalar = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+        u32 simd_count = frustum_cull_bounds(&f, &bounds, simd);
+        u32 scalar_count = frustum_cull_bounds_scalar(&f, &bounds, scalar);
+        expect_should_be(scalar_count, simd_count);
+
+        u32 expected_count = 0;
+        u32 mismatches = 0;
+        for (u32 i = 0; i < count; ++i) {
+            vec3 center = {bounds.center_x[i], bounds.center_y[i], bounds.center_z[i]};
+            vec3 half = {bounds.half_x[i], bounds.half_y[i], bounds.half_z[i]};
+            if (frustum_intersects_aabb(&f, &center, &half)) {
+                // Both paths list visible boxes in ascending order.
+                mismatches += expected_count >= simd_count || simd[expected_count] != i || scalar[expected_count] != i;
+                expected_count++;
+            }
+        }
+        expect_should_be(expected_count, simd_count);
+        expect_should_be(0, mismatches);
+
+        kfree(simd, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+        kfree(scalar, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    }
+
+    bounds_soa_destroy(&bounds);
+    expect_should_be(0, bounds.block);
+    return true;
+}
+
+u8 culling_orthographic_frustum_should_bound_its_box(void) {
+    // A light looking straight down from 10 units up, covering 20x20 units and 30 deep.
+    vec3 position = {0.0f, 10.0f, 0.0f};
+    vec3 forward = {0.0f, -1.0f, 0.0f};
+    vec3 right = vec3_right();
+    vec3 up = vec3_forward();
+    extents_3d view_extents = {{-10.0f, -10.0f, 0.0f}, {10.0f, 10.0f, 30.0f}};
+    frustum f = frustum_create_orthographic(&position, &forward, &right, &up, view_extents);
+
+    bounds_soa bounds;
+    bounds_soa_create(8, &bounds);
+    vec3 half = {0.5f, 0.5f, 0.5f};
+    bounds_soa_push(&bounds, (vec3){0.0f, 0.0f, 0.0f}, half);     // Inside.
+    bounds_soa_push(&bounds, (vec3){9.0f, -19.0f, -9.0f}, half);  // Inside, near a corner.
+    bounds_soa_push(&bounds, (vec3){12.0f, 0.0f, 0.0f}, half);    // Right of the box.
+    bounds_soa_push(&bounds, (vec3){0.0f, 0.0f, 12.0f}, half);    // Below the box in view space.
+    bounds_soa_push(&bounds, (vec3){0.0f, 12.0f, 0.0f}, half);    // Behind the light.
+    bounds_soa_push(&bounds, (vec3){0.0f, -22.0f, 0.0f}, half);   // Past the far plane.
+    bounds_soa_push(&bounds, (vec3){10.2f, 0.0f, 0.0f}, half);    // Straddling the right side.
+
+    u32 visible[7];
+    u32 visible_count = frustum_cull_bounds(&f, &bounds, visible);
+    expect_should_be(3, visible_count);
+    expect_should_be(0, visible[0]);
+    expect_should_be(1, visible[1]);
+    expect_should_be(6, visible[2]);
+
+    bounds_soa_destroy(&bounds);
+    return true;
+}
+
+u8 culling_bounds_set_should_move_boxes_in_place(void) {
+    bounds_soa bounds;
+    expect_to_be_true(bounds_soa_create(8, &bounds));
+    frustum f = test_frustum();
+    vec3 half = {1.0f, 1.0f, 1.0f};
+    vec3 in_view = vec3_mul_scalar(vec3_forward(), 10.0f);
+    vec3 behind = vec3_mul_scalar(vec3_forward(), -10.0f);
+
+    // Growing past the initial capacity keeps existing boxes.
+    for (u32 i = 0; i < 20; ++i) {
+        bounds_soa_push(&bounds, behind, half);
+    }
+    bounds_soa_set(&bounds, 5, in_view, half);
+    bounds_soa_set(&bounds, 13, in_view, half);
+
+    u32 visible[20];
+    u32 visible_count = frustum_cull_bounds(&f, &bounds, visible);
+    expect_should_be(2, visible_count);
+    expect_should_be(5, visible[0]);
+    expect_should_be(13, visible[1]);
+
+    bounds_soa_set(&bounds, 5, behind, half);
+    visible_count = frustum_cull_bounds(&f, &bounds, visible);
+    expect_should_be(20, bounds.count);
+    expect_should_be(1, visible_count);
+    expect_should_be(13, visible[0]);
+
+    bounds_soa_destroy(&bounds);
+    return true;
+}
+
+// A perspective frustum at a random position, looking in a random direction.
+static frustum random_frustum(u32* seed) {
+    vec3 position = {random_range(seed, -500.0f, 500.0f), random_range(seed, -20.0f, 20.0f), random_range(seed, -500.0f, 500.0f)};
+    vec3 forward = vec3_normalized((vec3){random_range(seed, -1.0f, 1.0f), random_range(seed, -0.3f, 0.3f), random_range(seed, -1.0f, 1.0f)});
+    vec3 right = vec3_normalized(vec3_cross(forward, vec3_up()));
+    vec3 up = vec3_cross(right, forward);
+    return frustum_create(&position, &forward, &right, &up, 16.0f / 9.0f, deg_to_rad(60.0f), 0.1f, 600.0f);
+}
+
+u8 culling_range_should_match_each_view(void) {
+    u32 seed = 0x51DE;
+    // More views than are tested together in one pass.
+    const u32 view_count = FRUSTUM_CULL_MAX_VIEWS + 3;
+    frustum frusta[FRUSTUM_CULL_MAX_VIEWS + 3];
+    for (u32 v = 0; v < view_count; ++v) {
+        frusta[v] = random_frustum(&seed);
+    }
+
+    u32 count = 10007;
+    bounds_soa bounds;
+    bounds_soa_create(count, &bounds);
+    fill_random_bounds(&bounds, count, 0xB0B);
+
+    u32* expected = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    u32* visible = kallocate(sizeof(u32) * count * view_count, MEMORY_TAG_ARRAY);
+    u32* outputs[FRUSTUM_CULL_MAX_VIEWS + 3];
+    u32 counts[FRUSTUM_CULL_MAX_VIEWS + 3];
+
+    // Chunks as the scene culls them, then one range covering everything.
+    u32 chunk_sizes[] = {1024, count};
+    for (u32 s = 0; s < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++s) {
+        u32 totals[FRUSTUM_CULL_MAX_VIEWS + 3] = {0};
+        for (u32 start = 0; start < count; start += chunk_sizes[s]) {
+            for (u32 v = 0; v < view_count; ++v) {
+                outputs[v] = visible + v * count + totals[v];
+            }
+            frustum_cull_bounds_range(frusta, view_count, &bounds, start, start + chunk_sizes[s], outputs, counts);
+            for (u32 v = 0; v < view_count; ++v) {
+                totals[v] += counts[v];
+            }
+        }
+
+        for (u32 v = 0; v < view_count; ++v) {
+            u32 expected_count = frustum_cull_bounds(&frusta[v], &bounds, expected);
+            expect_should_be(expected_count, totals[v]);
+            u32 mismatches = 0;
+            for (u32 i = 0; i < expected_count; ++i) {
+                mismatches += visible[v * count + i] != expected[i];
+            }
+            expect_should_be(0, mismatches);
+        }
+    }
+
+    kfree(expected, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    kfree(visible, sizeof(u32) * count * view_count, MEMORY_TAG_ARRAY);
+    bounds_soa_destroy(&bounds);
+    return true;
+}
+
+u8 culling_multi_view_benchmark(void) {
+    const u32 runs = 100;
+    const u32 count = 100000;
+    // A camera and four shadow cascades.
+    const u32 view_count = 5;
+    u32 seed = 0xCA5CADE;
+    frustum frusta[5];
+    for (u32 v = 0; v < view_count; ++v) {
+        frusta[v] = random_frustum(&seed);
+    }
+
+    bounds_soa bounds;
+    bounds_soa_create(count, &bounds);
+    fill_random_bounds(&bounds, count, 0xFACE);
+    u32* visible = kallocate(sizeof(u32) * count * view_count, MEMORY_TAG_ARRAY);
+    u32* outputs[5];
+    u32 counts[5];
+    for (u32 v = 0; v < view_count; ++v) {
+        outputs[v] = visible + v * count;
+    }
+
+    u32 separate_total = 0;
+    f64 start = platform_get_absolute_time();
+    for (u32 r = 0; r < runs; ++r) {
+        separate_total = 0;
+        for (u32 v = 0; v < view_count; ++v) {
+            separate_total += frustum_cull_bounds(&frusta[v], &bounds, outputs[v]);
+        }
+    }
+    f64 separate_time = (platform_get_absolute_time() - start) * 1000.0 / runs;
+
+    u32 together_total = 0;
+    start = platform_get_absolute_time();
+    for (u32 r = 0; r < runs; ++r) {
+        frustum_cull_bounds_range(frusta, view_count, &bounds, 0, count, outputs, counts);
+        together_total = 0;
+        for (u32 v = 0; v < view_count; ++v) {
+            together_total += counts[v];
+        }
+    }
+    f64 together_time = (platform_get_absolute_time() - start) * 1000.0 / runs;
+
+    DINFO("Multi-view culling benchmark (%u boxes, %u views, %u visible in total): one pass per view %.3f ms, all views in one pass %.3f ms.",
+          count, view_count, together_total, separate_time, together_time);
+    expect_should_be(separate_total, together_total);
+
+    kfree(visible, sizeof(u32) * count * view_count, MEMORY_TAG_ARRAY);
+    bounds_soa_destroy(&bounds);
+    return true;
+}
+
+u8 culling_benchmark(void) {
+    const u32 runs = 200;
+    u32 counts[] = {10000, 100000};
+    frustum f = test_frustum();
+
+    for (u32 c = 0; c < 2; ++c) {
+        u32 count = counts[c];
+        bounds_soa bounds;
+        bounds_soa_create(count, &bounds);
+        fill_random_bounds(&bounds, count, 0xFACE);
+        u32* visible = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+
+        // The previous approach: an array of structures tested one box at a time.
+        extents_3d* aos = kallocate(sizeof(extents_3d) * count, MEMORY_TAG_ARRAY);
+        for (u32 i = 0; i < count; ++i) {
+            vec3 center = {bounds.center_x[i], bounds.center_y[i], bounds.center_z[i]};
+            vec3 half = {bounds.half_x[i], bounds.half_y[i], bounds.half_z[i]};
+            aos[i].min = vec3_sub(center, half);
+            aos[i].max = vec3_add(center, half);
+        }
+
+        u32 aos_visible = 0;
+        f64 start = platform_get_absolute_time();
+        for (u32 r = 0; r < runs; ++r) {
+            u32 n = 0;
+            for (u32 i = 0; i < count; ++i) {
+                vec3 center = vec3_mul_scalar(vec3_add(aos[i].min, aos[i].max), 0.5f);
+                vec3 half = vec3_mul_scalar(vec3_sub(aos[i].max, aos[i].min), 0.5f);
+                if (frustum_intersects_aabb(&f, &center, &half)) {
+                    visible[n++] = i;
+                }
+            }
+            aos_visible = n;
+        }
+        f64 aos_time = platform_get_absolute_time() - start;
+
+        u32 scalar_visible = 0;
+        start = platform_get_absolute_time();
+        for (u32 r = 0; r < runs; ++r) {
+            scalar_visible = frustum_cull_bounds_scalar(&f, &bounds, visible);
+        }
+        f64 scalar_time = platform_get_absolute_time() - start;
+
+        u32 simd_visible = 0;
+        start = platform_get_absolute_time();
+        for (u32 r = 0; r < runs; ++r) {
+            simd_visible = frustum_cull_bounds(&f, &bounds, visible);
+        }
+        f64 simd_time = platform_get_absolute_time() - start;
+
+        f64 boxes = (f64)count * runs;
+        DINFO("Culling benchmark (%u boxes, %u visible): frustum_intersects_aabb %.3f boxes/ns, SoA scalar %.3f boxes/ns, SoA SIMD %.3f boxes/ns.",
+              count, simd_visible, boxes / (aos_time * 1e9), boxes / (scalar_time * 1e9), boxes / (simd_time * 1e9));
+
+        expect_should_be(aos_visible, simd_visible);
+        expect_should_be(scalar_visible, simd_visible);
+
+        kfree(aos, sizeof(extents_3d) * count, MEMORY_TAG_ARRAY);
+        kfree(visible, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+        bounds_soa_destroy(&bounds);
+    }
+    return true;
+}
+
+void culling_register_tests(void) {
+    test_manager_register_test(culling_should_match_frustum_intersects_aabb, "Batched culling should match frustum_intersects_aabb.");
+    test_manager_register_test(culling_orthographic_frustum_should_bound_its_box, "Orthographic frustum should cull outside its box.");
+    test_manager_register_test(culling_bounds_set_should_move_boxes_in_place, "Bounds should be replaceable in place.");
+    test_manager_register_test(culling_range_should_match_each_view, "Multi-view range culling should match culling each view.");
+    test_manager_register_test(culling_benchmark, "Culling benchmark at 10K/100K boxes.");
+    test_manager_register_test(culling_multi_view_benchmark, "Multi-view culling benchmark at 100K boxes.");
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void culling_register_tests(void);
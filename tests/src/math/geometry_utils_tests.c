@@ -0,0 +1,716 @@
+#include "geometry_utils_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <core/kmemory.h>
+#include <core/logger.h>
+#include <defines.h>
+#include <math/geometry_utils.h>
+#include <math/kmath.h>
+#include <platform/platform.h>
+#include <systems/geometry_system.h>
+#include <utils/ksort.h>
+
+#include <string.h>  // memcmp
+
+// The pairwise de-duplication geometry_weld_vertices replaced, kept as a reference for its results.
+static b8 legacy_vertex_equal(vertex_3d vert_0, vertex_3d vert_1) {
+    return vec3_compare(vert_0.position, vert_1.position, K_FLOAT_EPSILON) &&
+           vec3_compare(vert_0.normal, vert_1.normal, K_FLOAT_EPSILON) &&
+           vec2_compare(vert_0.texcoord, vert_1.texcoord, K_FLOAT_EPSILON) &&
+           vec4_compare(vert_0.colour, vert_1.colour, K_FLOAT_EPSILON) &&
+           vec3_compare(vert_0.tangent, vert_1.tangent, K_FLOAT_EPSILON);
+}
+
+static void legacy_reassign_index(u32 index_count, u32* indices, u32 from, u32 to) {
+    for (u32 i = 0; i < index_count; ++i) {
+        if (indices[i] == from) {
+            indices[i] = to;
+        } else if (indices[i] > from) {
+            indices[i]--;
+        }
+    }
+}
+
+static void legacy_deduplicate_vertices(u32 vertex_count, vertex_3d* vertices, u32 index_count, u32* indices, u32* out_vertex_count, vertex_3d** out_vertices) {
+    vertex_3d* unique_verts = kallocate(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    *out_vertex_count = 0;
+    u32 found_count = 0;
+    for (u32 v = 0; v < vertex_count; ++v) {
+        b8 found = false;
+        for (u32 u = 0; u < *out_vertex_count; ++u) {
+            if (legacy_vertex_equal(vertices[v], unique_verts[u])) {
+                legacy_reassign_index(index_count, indices, v - found_count, u);
+                found = true;
+                found_count++;
+                break;
+            }
+        }
+        if (!found) {
+            unique_verts[*out_vertex_count] = vertices[v];
+            (*out_vertex_count)++;
+        }
+    }
+    *out_vertices = kallocate(sizeof(vertex_3d) * (*out_vertex_count), MEMORY_TAG_ARRAY);
+    kcopy_memory(*out_vertices, unique_verts, sizeof(vertex_3d) * (*out_vertex_count));
+    kfree(unique_verts, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+}
+
+static vertex_3d grid_vertex(u32 x, u32 z, u32 size) {
+    vertex_3d v = {0};
+    v.position = (vec3){(f32)x * 0.37f, 0, (f32)z * 0.37f};
+    v.normal = (vec3){0, 1, 0};
+    v.texcoord = (vec2){(f32)x / size, (f32)z / size};
+    v.colour = vec4_one();
+    v.tangent = (vec3){1, 0, 0};
+    return v;
+}
+
+// Creates a grid of size x size quads as an OBJ import leaves it before de-duplication: every
+// triangle has its own 3 vertices, and the indices simply count up.
+static u32 create_triangle_soup(u32 size, vertex_3d** out_vertices, u32** out_indices) {
+    u32 count = size * size * 6;
+    vertex_3d* vertices = kallocate(sizeof(vertex_3d) * count, MEMORY_TAG_ARRAY);
+    u32* indices = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    u32 v = 0;
+    for (u32 z = 0; z < size; ++z) {
+        for (u32 x = 0; x < size; ++x) {
+            vertices[v++] = grid_vertex(x, z, size);
+            vertices[v++] = grid_vertex(x, z + 1, size);
+            vertices[v++] = grid_vertex(x + 1, z, size);
+            vertices[v++] = grid_vertex(x + 1, z, size);
+            vertices[v++] = grid_vertex(x, z + 1, size);
+            vertices[v++] = grid_vertex(x + 1, z + 1, size);
+        }
+    }
+    for (u32 i = 0; i < count; ++i) {
+        indices[i] = i;
+    }
+    *out_vertices = vertices;
+    *out_indices = indices;
+    return count;
+}
+
+u8 geometry_weld_should_match_pairwise_deduplication(void) {
+    vertex_3d* vertices = 0;
+    u32* indices = 0;
+    u32 count = create_triangle_soup(12, &vertices, &indices);
+    u32* legacy_indices = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    kcopy_memory(legacy_indices, indices, sizeof(u32) * count);
+
+    u32 unique_count = 0;
+    vertex_3d* unique = 0;
+    geometry_deduplicate_vertices(count, vertices, count, indices, &unique_count, &unique);
+    u32 legacy_unique_count = 0;
+    vertex_3d* legacy_unique = 0;
+    legacy_deduplicate_vertices(count, vertices, count, legacy_indices, &legacy_unique_count, &legacy_unique);
+
+    // Every corner of the grid is left once, in the same order, and the triangles still refer to them.
+    expect_should_be(13 * 13, unique_count);
+    expect_should_be(legacy_unique_count, unique_count);
+    for (u32 u = 0; u < unique_count; ++u) {
+        expect_to_be_true(legacy_vertex_equal(unique[u], legacy_unique[u]));
+    }
+    for (u32 i = 0; i < count; ++i) {
+        expect_should_be(legacy_indices[i], indices[i]);
+        expect_to_be_true(legacy_vertex_equal(unique[indices[i]], vertices[i]));
+    }
+
+    kfree(unique, sizeof(vertex_3d) * unique_count, MEMORY_TAG_ARRAY);
+    kfree(legacy_unique, sizeof(vertex_3d) * legacy_unique_count, MEMORY_TAG_ARRAY);
+    kfree(legacy_indices, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    kfree(indices, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    kfree(vertices, sizeof(vertex_3d) * count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 geometry_weld_should_respect_epsilon(void) {
+    const f32 epsilon = 0.001f;
+    vertex_3d vertices[6] = {0};
+    // 1 is within epsilon of 0 across a grid cell boundary, 2 is not. 3 differs only in its
+    // normal, 4 only in the sign of a zero, and 5 is within epsilon of 2 but not of 0.
+    vertices[0].position = (vec3){0.9995f, 0, 0};
+    vertices[1].position = (vec3){1.0004f, 0, 0};
+    vertices[2].position = (vec3){1.0015f, 0, 0};
+    vertices[3].position = (vec3){0.9995f, 0, 0};
+    vertices[3].normal = (vec3){0, 1, 0};
+    vertices[4].position = (vec3){0.9995f, -0.0f, 0};
+    vertices[5].position = (vec3){1.0008f, 0, 0};
+    u32 indices[6] = {0, 1, 2, 3, 4, 5};
+
+    u32 unique_count = 0;
+    vertex_3d* unique = 0;
+    geometry_weld_vertices(6, vertices, 6, indices, epsilon, &unique_count, &unique);
+    expect_should_be(3, unique_count);
+    u32 expected_indices[6] = {0, 0, 1, 2, 0, 1};
+    for (u32 i = 0; i < 6; ++i) {
+        expect_should_be(expected_indices[i], indices[i]);
+    }
+    kfree(unique, sizeof(vertex_3d) * unique_count, MEMORY_TAG_ARRAY);
+
+    // Without an epsilon, only the vertices differing in the sign of a zero are merged.
+    for (u32 i = 0; i < 6; ++i) {
+        indices[i] = i;
+    }
+    geometry_weld_vertices(6, vertices, 6, indices, 0.0f, &unique_count, &unique);
+    expect_should_be(5, unique_count);
+    expect_should_be(0, indices[4]);
+    kfree(unique, sizeof(vertex_3d) * unique_count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 geometry_weld_benchmark(void) {
+    // Grids of about 10K, 100K and 1M triangles. The pairwise search is quadratic, so it is only timed on the smallest.
+    u32 sizes[3] = {71, 224, 708};
+    for (u32 s = 0; s < 3; ++s) {
+        vertex_3d* vertices = 0;
+        u32* indices = 0;
+        u32 count = create_triangle_soup(sizes[s], &vertices, &indices);
+
+        u32 unique_count = 0;
+        vertex_3d* unique = 0;
+        f64 start = platform_get_absolute_time();
+        geometry_deduplicate_vertices(count, vertices, count, indices, &unique_count, &unique);
+        f64 weld_time = platform_get_absolute_time() - start;
+        expect_should_be((sizes[s] + 1) * (sizes[s] + 1), unique_count);
+        kfree(unique, sizeof(vertex_3d) * unique_count, MEMORY_TAG_ARRAY);
+
+        if (s == 0) {
+            for (u32 i = 0; i < count; ++i) {
+                indices[i] = i;
+            }
+            start = platform_get_absolute_time();
+            legacy_deduplicate_vertices(count, vertices, count, indices, &unique_count, &unique);
+            f64 legacy_time = platform_get_absolute_time() - start;
+            kfree(unique, sizeof(vertex_3d) * unique_count, MEMORY_TAG_ARRAY);
+            DINFO("Vertex weld benchmark (%u triangles, %u vertices): %.3f ms, pairwise %.3f ms (%.0fx).",
+                  count / 3, count, weld_time * 1000.0, legacy_time * 1000.0, legacy_time / weld_time);
+        } else {
+            DINFO("Vertex weld benchmark (%u triangles, %u vertices): %.3f ms.", count / 3, count, weld_time * 1000.0);
+        }
+
+        kfree(indices, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+        kfree(vertices, sizeof(vertex_3d) * count, MEMORY_TAG_ARRAY);
+    }
+    return true;
+}
+
+// A FIFO post-transform vertex cache, simulated entry by entry. Kept apart from
+// geometry_analyze_vertex_cache so that each checks the other. Returns the number of misses.
+static u32 simulate_vertex_cache(u32 index_count, const u32* indices, u32 cache_size) {
+    u32 cache[64];
+    u32 cache_count = 0;
+    u32 next = 0;
+    u32 misses = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        b8 hit = false;
+        for (u32 c = 0; c < cache_count; ++c) {
+            if (cache[c] == indices[i]) {
+                hit = true;
+                break;
+            }
+        }
+        if (!hit) {
+            misses++;
+            if (cache_count < cache_size) {
+                cache[cache_count++] = indices[i];
+            } else {
+                cache[next] = indices[i];
+                next = (next + 1) % cache_size;
+            }
+        }
+    }
+    return misses;
+}
+
+// Creates an indexed grid of size x size quads, with its triangles in rows as an OBJ file usually
+// lists them. Returns the index count.
+static u32 create_indexed_grid(u32 size, u32* out_vertex_count, vertex_3d** out_vertices, u32** out_indices) {
+    u32 vertex_count = (size + 1) * (size + 1);
+    u32 index_count = size * size * 6;
+    vertex_3d* vertices = kallocate(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    u32* indices = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    for (u32 z = 0; z <= size; ++z) {
+        for (u32 x = 0; x <= size; ++x) {
+            vertices[z * (size + 1) + x] = grid_vertex(x, z, size);
+        }
+    }
+    u32 i = 0;
+    for (u32 z = 0; z < size; ++z) {
+        for (u32 x = 0; x < size; ++x) {
+            u32 corner = z * (size + 1) + x;
+            indices[i++] = corner;
+            indices[i++] = corner + size + 1;
+            indices[i++] = corner + 1;
+            indices[i++] = corner + 1;
+            indices[i++] = corner + size + 1;
+            indices[i++] = corner + size + 2;
+        }
+    }
+    *out_vertex_count = vertex_count;
+    *out_vertices = vertices;
+    *out_indices = indices;
+    return index_count;
+}
+
+// Creates an indexed torus, which unlike a grid can hide parts of itself. Returns the index count.
+static u32 create_indexed_torus(u32 segments, u32 sides, u32* out_vertex_count, vertex_3d** out_vertices, u32** out_indices) {
+    u32 vertex_count = segments * sides;
+    u32 index_count = segments * sides * 6;
+    vertex_3d* vertices = kallocate(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    u32* indices = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    for (u32 s = 0; s < segments; ++s) {
+        f32 u = K_2PI * s / segments;
+        for (u32 t = 0; t < sides; ++t) {
+            f32 v = K_2PI * t / sides;
+            vertex_3d* vert = &vertices[s * sides + t];
+            vert->normal = (vec3){kcos(u) * kcos(v), ksin(v), ksin(u) * kcos(v)};
+            vert->position = vec3_add((vec3){kcos(u), 0, ksin(u)}, vec3_mul_scalar(vert->normal, 0.4f));
+            vert->texcoord = (vec2){(f32)s / segments, (f32)t / sides};
+            vert->colour = vec4_one();
+        }
+    }
+    u32 i = 0;
+    for (u32 s = 0; s < segments; ++s) {
+        for (u32 t = 0; t < sides; ++t) {
+            u32 a = s * sides + t;
+            u32 b = ((s + 1) % segments) * sides + t;
+            u32 c = s * sides + (t + 1) % sides;
+            u32 d = ((s + 1) % segments) * sides + (t + 1) % sides;
+            indices[i++] = a;
+            indices[i++] = c;
+            indices[i++] = b;
+            indices[i++] = b;
+            indices[i++] = c;
+            indices[i++] = d;
+        }
+    }
+    *out_vertex_count = vertex_count;
+    *out_vertices = vertices;
+    *out_indices = indices;
+    return index_count;
+}
+
+// Puts the triangles in a random order, as a poorly exported mesh might have them.
+static void shuffle_triangles(u32 index_count, u32* indices, u32 seed) {
+    for (u32 t = index_count / 3 - 1; t > 0; --t) {
+        u32 other = xorshift(&seed) % (t + 1);
+        for (u32 c = 0; c < 3; ++c) {
+            u32 temp = indices[t * 3 + c];
+            indices[t * 3 + c] = indices[other * 3 + c];
+            indices[other * 3 + c] = temp;
+        }
+    }
+}
+
+// Sorts a key for each triangle which is the same whichever corner it starts at, but not if its
+// winding changes. Indices must be below 2^21. Returns the sorted keys, which must be freed.
+static u64* sorted_triangle_keys(u32 index_count, const u32* indices) {
+    u32 count = index_count / 3;
+    u64* keys = kallocate(sizeof(u64) * count * 2, MEMORY_TAG_ARRAY);
+    u32* values = kallocate(sizeof(u32) * count * 2, MEMORY_TAG_ARRAY);
+    for (u32 t = 0; t < count; ++t) {
+        const u32* tri = &indices[t * 3];
+        u32 first = 0;
+        for (u32 c = 1; c < 3; ++c) {
+            if (tri[c] < tri[first]) {
+                first = c;
+            }
+        }
+        keys[t] = ((u64)tri[first] << 42) | ((u64)tri[(first + 1) % 3] << 21) | tri[(first + 2) % 3];
+    }
+    kradix_sort_u64(keys, values, count, keys + count, values + count);
+    kfree(values, sizeof(u32) * count * 2, MEMORY_TAG_ARRAY);
+    return keys;
+}
+
+static b8 same_triangles(u32 index_count, const u32* indices_0, const u32* indices_1) {
+    u64* keys_0 = sorted_triangle_keys(index_count, indices_0);
+    u64* keys_1 = sorted_triangle_keys(index_count, indices_1);
+    b8 result = true;
+    for (u32 t = 0; t < index_count / 3 && result; ++t) {
+        result = keys_0[t] == keys_1[t];
+    }
+    kfree(keys_0, sizeof(u64) * (index_count / 3) * 2, MEMORY_TAG_ARRAY);
+    kfree(keys_1, sizeof(u64) * (index_count / 3) * 2, MEMORY_TAG_ARRAY);
+    return result;
+}
+
+u8 geometry_vertex_cache_analysis_should_match_simulation(void) {
+    u32 vertex_count = 0;
+    vertex_3d* vertices = 0;
+    u32* indices = 0;
+    u32 index_count = create_indexed_grid(40, &vertex_count, &vertices, &indices);
+    shuffle_triangles(index_count, indices, 0xACE1);
+
+    u32 cache_sizes[3] = {3, GEOMETRY_VERTEX_CACHE_SIZE, 32};
+    for (u32 s = 0; s < 3; ++s) {
+        f32 acmr = 0;
+        f32 atvr = 0;
+        geometry_analyze_vertex_cache(vertex_count, index_count, indices, cache_sizes[s], &acmr, &atvr);
+        u32 misses = simulate_vertex_cache(index_count, indices, cache_sizes[s]);
+        expect_float_to_be((f32)misses / (index_count / 3), acmr);
+        expect_float_to_be((f32)misses / vertex_count, atvr);
+    }
+
+    kfree(indices, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 geometry_vertex_cache_optimization_should_reduce_misses(void) {
+    u32 vertex_count = 0;
+    vertex_3d* vertices = 0;
+    u32* indices = 0;
+    u32 index_count = create_indexed_grid(64, &vertex_count, &vertices, &indices);
+    shuffle_triangles(index_count, indices, 0x5EED);
+    u32* original = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(original, indices, sizeof(u32) * index_count);
+
+    u32 misses_before = simulate_vertex_cache(index_count, indices, GEOMETRY_VERTEX_CACHE_SIZE);
+    geometry_optimize_vertex_cache(vertex_count, index_count, indices);
+    u32 misses_after = simulate_vertex_cache(index_count, indices, GEOMETRY_VERTEX_CACHE_SIZE);
+
+    // Shuffled, nearly every vertex of every triangle misses. Afterwards each vertex is
+    // transformed little more than once.
+    expect_to_be_true(((f32)misses_before / (index_count / 3) > 2.5f));
+    expect_to_be_true(((f32)misses_after / (index_count / 3) < 0.8f));
+    expect_to_be_true(((f32)misses_after / vertex_count < 1.5f));
+    expect_to_be_true(same_triangles(index_count, original, indices));
+
+    kfree(original, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(indices, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 geometry_overdraw_optimization_should_keep_cache_efficiency(void) {
+    const f32 threshold = 1.05f;
+    u32 vertex_count = 0;
+    vertex_3d* vertices = 0;
+    u32* indices = 0;
+    u32 index_count = create_indexed_torus(96, 48, &vertex_count, &vertices, &indices);
+    shuffle_triangles(index_count, indices, 0x70F5);
+    geometry_optimize_vertex_cache(vertex_count, index_count, indices);
+    u32* optimized = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(optimized, indices, sizeof(u32) * index_count);
+
+    u32 misses_before = simulate_vertex_cache(index_count, indices, GEOMETRY_VERTEX_CACHE_SIZE);
+    geometry_optimize_overdraw(vertex_count, vertices, index_count, indices, threshold);
+    u32 misses_after = simulate_vertex_cache(index_count, indices, GEOMETRY_VERTEX_CACHE_SIZE);
+
+    // The clusters are reordered, but each keeps nearly the cache efficiency it had.
+    b8 reordered = false;
+    for (u32 i = 0; i < index_count && !reordered; ++i) {
+        reordered = indices[i] != optimized[i];
+    }
+    expect_to_be_true(reordered);
+    expect_to_be_true(same_triangles(index_count, optimized, indices));
+    expect_to_be_true(((f32)misses_after <= (f32)misses_before * threshold * 1.02f));
+
+    kfree(optimized, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(indices, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 geometry_vertex_fetch_optimization_should_order_vertices_by_use(void) {
+    u32 vertex_count = 0;
+    vertex_3d* vertices = 0;
+    u32* indices = 0;
+    u32 index_count = create_indexed_grid(20, &vertex_count, &vertices, &indices);
+    shuffle_triangles(index_count, indices, 0xFE7C);
+    // Leave one vertex unused.
+    for (u32 i = 0; i < index_count; ++i) {
+        if (indices[i] == 0) {
+            indices[i] = 1;
+        }
+    }
+    u32* original_indices = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(original_indices, indices, sizeof(u32) * index_count);
+    vertex_3d* original_vertices = kallocate(sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(original_vertices, vertices, sizeof(vertex_3d) * vertex_count);
+
+    geometry_optimize_vertex_fetch(vertex_count, vertices, index_count, indices);
+
+    // Each index is either one already seen or the next vertex, and refers to the same vertex as before.
+    u32 next = 0;
+    for (u32 i = 0; i < index_count; ++i) {
+        expect_to_be_true((indices[i] <= next));
+        if (indices[i] == next) {
+            next++;
+        }
+        expect_to_be_true(legacy_vertex_equal(vertices[indices[i]], original_vertices[original_indices[i]]));
+    }
+    // The unused vertex goes last.
+    expect_should_be(vertex_count - 1, next);
+    expect_to_be_true(legacy_vertex_equal(vertices[vertex_count - 1], original_vertices[0]));
+
+    kfree(original_vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    kfree(original_indices, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(indices, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 geometry_optimization_benchmark(void) {
+    // A grid of about 1M triangles, in rows as exported and in random order.
+    const u32 size = 708;
+    for (u32 shuffled = 0; shuffled < 2; ++shuffled) {
+        u32 vertex_count = 0;
+        vertex_3d* vertices = 0;
+        u32* indices = 0;
+        u32 index_count = create_indexed_grid(size, &vertex_count, &vertices, &indices);
+        if (shuffled) {
+            shuffle_triangles(index_count, indices, 0xB16B00B5);
+        }
+
+        f32 acmr_before = 0;
+        f32 atvr_before = 0;
+        geometry_analyze_vertex_cache(vertex_count, index_count, indices, GEOMETRY_VERTEX_CACHE_SIZE, &acmr_before, &atvr_before);
+        f64 start = platform_get_absolute_time();
+        geometry_optimize_vertex_cache(vertex_count, index_count, indices);
+        f64 cache_time = platform_get_absolute_time() - start;
+        f32 acmr_cache = 0;
+        f32 atvr_cache = 0;
+        geometry_analyze_vertex_cache(vertex_count, index_count, indices, GEOMETRY_VERTEX_CACHE_SIZE, &acmr_cache, &atvr_cache);
+        start = platform_get_absolute_time();
+        geometry_optimize_overdraw(vertex_count, vertices, index_count, indices, 1.05f);
+        f64 overdraw_time = platform_get_absolute_time() - start;
+        start = platform_get_absolute_time();
+        geometry_optimize_vertex_fetch(vertex_count, vertices, index_count, indices);
+        f64 fetch_time = platform_get_absolute_time() - start;
+        f32 acmr_after = 0;
+        f32 atvr_after = 0;
+        geometry_analyze_vertex_cache(vertex_count, index_count, indices, GEOMETRY_VERTEX_CACHE_SIZE, &acmr_after, &atvr_after);
+
+        DINFO("Mesh optimization benchmark (%u triangles, %s): ACMR %.3f -> %.3f (cache) -> %.3f (overdraw), ATVR %.3f -> %.3f -> %.3f.",
+              index_count / 3, shuffled ? "shuffled" : "in rows", acmr_before, acmr_cache, acmr_after, atvr_before, atvr_cache, atvr_after);
+        DINFO("Mesh optimization benchmark: vertex cache %.1f ms, overdraw %.1f ms, vertex fetch %.1f ms.",
+              cache_time * 1000.0, overdraw_time * 1000.0, fetch_time * 1000.0);
+
+        kfree(indices, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+        kfree(vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    }
+    return true;
+}
+
+// Counts the triangles which have lost their area or turned to face away from the normals of their vertices.
+static u32 count_bad_triangles(const vertex_3d* vertices, u32 index_count, const u32* indices) {
+    u32 bad = 0;
+    for (u32 i = 0; i < index_count; i += 3) {
+        const vertex_3d* a = &vertices[indices[i + 0]];
+        const vertex_3d* b = &vertices[indices[i + 1]];
+        const vertex_3d* c = &vertices[indices[i + 2]];
+        vec3 face = vec3_cross(vec3_sub(b->position, a->position), vec3_sub(c->position, a->position));
+        vec3 normal = vec3_add(vec3_add(a->normal, b->normal), c->normal);
+        if (indices[i + 0] == indices[i + 1] || indices[i + 1] == indices[i + 2] || indices[i + 0] == indices[i + 2] || vec3_dot(face, normal) <= 0) {
+            bad++;
+        }
+    }
+    return bad;
+}
+
+// Indicates if the given vertex is referred to by any of the indices.
+static b8 vertex_used(u32 vertex, u32 index_count, const u32* indices) {
+    for (u32 i = 0; i < index_count; ++i) {
+        if (indices[i] == vertex) {
+            return true;
+        }
+    }
+    return false;
+}
+
+u8 geometry_simplify_should_reduce_closed_surface_within_error(void) {
+    u32 vertex_count = 0;
+    vertex_3d* vertices = 0;
+    u32* indices = 0;
+    u32 index_count = create_indexed_torus(96, 48, &vertex_count, &vertices, &indices);
+    u32* simplified = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+
+    // Stops at the target count when the error allows.
+    const f32 target_error = 0.05f;
+    f32 error = 0;
+    u32 count = geometry_simplify(vertex_count, vertices, index_count, indices, index_count / 4, target_error, simplified, &error);
+    expect_to_be_true((count > 0));
+    expect_to_be_true((count <= index_count / 4));
+    expect_should_be(0, count % 3);
+    expect_to_be_true((error > 0 && error <= target_error));
+    expect_should_be(0, count_bad_triangles(vertices, count, simplified));
+
+    // The torus is closed and curved everywhere, so without a target count only the error limit holds it
+    // back, and a tighter limit stops sooner.
+    f32 loose_error = 0;
+    u32 loose_count = geometry_simplify(vertex_count, vertices, index_count, indices, 0, target_error, simplified, &loose_error);
+    expect_to_be_true((loose_count > 0));
+    expect_to_be_true((loose_count < count));
+    expect_to_be_true((loose_error <= target_error));
+    expect_should_be(0, count_bad_triangles(vertices, loose_count, simplified));
+    f32 tight_error = 0;
+    u32 tight_count = geometry_simplify(vertex_count, vertices, index_count, indices, 0, target_error * 0.1f, simplified, &tight_error);
+    expect_to_be_true((tight_count > loose_count));
+    expect_to_be_true((tight_error <= target_error * 0.1f));
+
+    kfree(simplified, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(indices, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 geometry_simplify_should_keep_borders_and_seams(void) {
+    const u32 size = 32;
+    u32 vertex_count = 0;
+    vertex_3d* grid_vertices = 0;
+    u32* indices = 0;
+    u32 index_count = create_indexed_grid(size, &vertex_count, &grid_vertices, &indices);
+
+    // Split the grid down the middle with a texture seam: the right half gets its own copy of the
+    // vertices along it, in the same place but with other texture coordinates.
+    u32 seam = size / 2;
+    vertex_3d* vertices = kallocate(sizeof(vertex_3d) * (vertex_count + size + 1), MEMORY_TAG_ARRAY);
+    kcopy_memory(vertices, grid_vertices, sizeof(vertex_3d) * vertex_count);
+    for (u32 z = 0; z <= size; ++z) {
+        vertices[vertex_count + z] = grid_vertex(seam, z, size);
+        vertices[vertex_count + z].texcoord.x += 0.5f;
+    }
+    for (u32 i = 0; i < index_count; i += 3) {
+        u32 right = 0;
+        for (u32 k = 0; k < 3; ++k) {
+            right += indices[i + k] % (size + 1) > seam;
+        }
+        for (u32 k = 0; k < 3 && right; ++k) {
+            if (indices[i + k] % (size + 1) == seam) {
+                indices[i + k] = vertex_count + indices[i + k] / (size + 1);
+            }
+        }
+    }
+    u32 split_vertex_count = vertex_count + size + 1;
+
+    // The grid is flat, so everything inside can go at no error.
+    u32* simplified = kallocate(sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    f32 error = 1;
+    u32 count = geometry_simplify(split_vertex_count, vertices, index_count, indices, 0, 0.001f, simplified, &error);
+    expect_to_be_true((count < index_count / 4));
+    expect_float_to_be(0.0f, error);
+    expect_should_be(0, count_bad_triangles(vertices, count, simplified));
+
+    // Every vertex on the outline and along the seam is still there.
+    u32 missing = 0;
+    for (u32 z = 0; z <= size; ++z) {
+        for (u32 x = 0; x <= size; ++x) {
+            if ((x == 0 || z == 0 || x == size || z == size || x == seam) && !vertex_used(z * (size + 1) + x, count, simplified)) {
+                missing++;
+            }
+        }
+        if (!vertex_used(vertex_count + z, count, simplified)) {
+            missing++;
+        }
+    }
+    expect_should_be(0, missing);
+
+    kfree(simplified, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(vertices, sizeof(vertex_3d) * split_vertex_count, MEMORY_TAG_ARRAY);
+    kfree(indices, sizeof(u32) * index_count, MEMORY_TAG_ARRAY);
+    kfree(grid_vertices, sizeof(vertex_3d) * vertex_count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+// Creates a geometry config owning an indexed torus.
+static geometry_config create_torus_config(u32 segments, u32 sides) {
+    geometry_config config = {0};
+    config.vertex_size = sizeof(vertex_3d);
+    config.index_size = sizeof(u32);
+    vertex_3d* vertices = 0;
+    u32* indices = 0;
+    config.index_count = create_indexed_torus(segments, sides, &config.vertex_count, &vertices, &indices);
+    config.vertices = vertices;
+    config.indices = indices;
+    config.min_extents = (vec3){-1.4f, -0.4f, -1.4f};
+    config.max_extents = (vec3){1.4f, 0.4f, 1.4f};
+    return config;
+}
+
+u8 geometry_lod_generation_should_append_coarser_ranges(void) {
+    geometry_config config = create_torus_config(96, 48);
+    u32 full_count = config.index_count;
+    u32* original = kallocate(sizeof(u32) * full_count, MEMORY_TAG_ARRAY);
+    kcopy_memory(original, config.indices, sizeof(u32) * full_count);
+
+    const f32 max_error = 0.02f;
+    geometry_generate_lods(&config, GEOMETRY_MAX_LODS, max_error);
+    expect_to_be_true((config.lod_count > 1));
+    expect_to_be_true((config.lod_count <= GEOMETRY_MAX_LODS));
+
+    // The full detail comes first, as it was.
+    expect_should_be(0, config.lods[0].index_offset);
+    expect_should_be(full_count, config.lods[0].index_count);
+    expect_float_to_be(0.0f, config.lods[0].error);
+    expect_should_be(0, memcmp(config.indices, original, sizeof(u32) * full_count));
+
+    // Each level follows the one before, with fewer triangles and more error, none beyond the limit.
+    f32 limit = max_error * vec3_distance(config.min_extents, config.max_extents);
+    for (u8 l = 1; l < config.lod_count; ++l) {
+        const geometry_lod* previous = &config.lods[l - 1];
+        const geometry_lod* lod = &config.lods[l];
+        expect_should_be(previous->index_offset + previous->index_count, lod->index_offset);
+        expect_to_be_true((lod->index_count <= previous->index_count / 4 * 3));
+        expect_to_be_true((lod->error >= previous->error));
+        expect_to_be_true((lod->error <= limit));
+        expect_should_be(0, count_bad_triangles(config.vertices, lod->index_count, (u32*)config.indices + lod->index_offset));
+    }
+    const geometry_lod* last = &config.lods[config.lod_count - 1];
+    expect_should_be(config.index_count, last->index_offset + last->index_count);
+
+    kfree(original, sizeof(u32) * full_count, MEMORY_TAG_ARRAY);
+    geometry_system_config_dispose(&config);
+    return true;
+}
+
+u8 geometry_lod_select_should_pick_coarsest_within_error(void) {
+    geometry_lod lods[4] = {{0, 600, 0.0f}, {600, 300, 0.01f}, {900, 150, 0.04f}, {1050, 75, 0.1f}};
+    expect_should_be(1, geometry_lod_select(4, lods, 100.0f, 1.0f));
+    expect_should_be(3, geometry_lod_select(4, lods, 10.0f, 1.0f));
+    expect_should_be(0, geometry_lod_select(4, lods, 1000.0f, 1.0f));
+    // A coarser pixel budget, as shadow views use, picks a coarser level at the same size.
+    expect_should_be(2, geometry_lod_select(4, lods, 100.0f, 4.0f));
+    expect_should_be(0, geometry_lod_select(1, lods, 1.0f, 1.0f));
+    return true;
+}
+
+u8 geometry_lod_benchmark(void) {
+    // A torus of about 1M triangles.
+    geometry_config config = create_torus_config(1024, 512);
+    u32 full_count = config.index_count;
+
+    f64 start = platform_get_absolute_time();
+    geometry_generate_lods(&config, GEOMETRY_MAX_LODS, 0.01f);
+    f64 time = platform_get_absolute_time() - start;
+
+    DINFO("Mesh LOD benchmark (%u triangles): %u levels generated in %.1f ms.", full_count / 3, config.lod_count, time * 1000.0);
+    for (u8 l = 0; l < config.lod_count; ++l) {
+        f32 acmr = 0;
+        geometry_analyze_vertex_cache(config.vertex_count, config.lods[l].index_count, (u32*)config.indices + config.lods[l].index_offset, GEOMETRY_VERTEX_CACHE_SIZE, &acmr, 0);
+        DINFO("Mesh LOD benchmark: level %u, %u triangles (%.1f%%), error %.5f, ACMR %.3f.",
+              l, config.lods[l].index_count / 3, 100.0f * config.lods[l].index_count / full_count, config.lods[l].error, acmr);
+    }
+
+    geometry_system_config_dispose(&config);
+    return true;
+}
+
+void geometry_utils_register_tests(void) {
+    test_manager_register_test(geometry_weld_should_match_pairwise_deduplication, "Vertex welding should match pairwise de-duplication.");
+    test_manager_register_test(geometry_weld_should_respect_epsilon, "Vertex welding should merge only vertices within epsilon.");
+    test_manager_register_test(geometry_weld_benchmark, "Vertex weld benchmark, 10K to 1M triangles.");
+    test_manager_register_test(geometry_vertex_cache_analysis_should_match_simulation, "Vertex cache analysis should match a simulated FIFO cache.");
+    test_manager_register_test(geometry_vertex_cache_optimization_should_reduce_misses, "Vertex cache optimization should reduce cache misses.");
+    test_manager_register_test(geometry_overdraw_optimization_should_keep_cache_efficiency, "Overdraw optimization should keep cache efficiency within the threshold.");
+    test_manager_register_test(geometry_vertex_fetch_optimization_should_order_vertices_by_use, "Vertex fetch optimization should order vertices by first use.");
+    test_manager_register_test(geometry_optimization_benchmark, "Mesh optimization benchmark, 1M triangles.");
+    test_manager_register_test(geometry_simplify_should_reduce_closed_surface_within_error, "Simplification should reduce a closed surface within the error limit.");
+    test_manager_register_test(geometry_simplify_should_keep_borders_and_seams, "Simplification should keep open borders and texture seams.");
+    test_manager_register_test(geometry_lod_generation_should_append_coarser_ranges, "LOD generation should append coarser index ranges.");
+    test_manager_register_test(geometry_lod_select_should_pick_coarsest_within_error, "LOD selection should pick the coarsest level within the pixel error.");
+    test_manager_register_test(geometry_lod_benchmark, "Mesh LOD generation benchmark, 1M triangles.");
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void geometry_utils_register_tests(void);
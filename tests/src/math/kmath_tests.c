@@ -0,0 +1,223 @@
+#include "kmath_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <defines.h>
+#include <core/kmemory.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <platform/platform.h>
+
+static quaterion random_quat(u32* seed) {
+    vec3 axis = {random_range(seed, -1.0f, 1.0f), random_range(seed, -1.0f, 1.0f), random_range(seed, -1.0f, 1.0f) + 2.0f};
+    return quat_from_axis_angle(axis, random_range(seed, -K_PI, K_PI), true);
+}
+
+// A typical model matrix: scale, rotation and translation.
+static matrix4 random_transform_matrix(u32* seed) {
+    vec3 scale = {random_range(seed, 0.25f, 4.0f), random_range(seed, 0.25f, 4.0f), random_range(seed, 0.25f, 4.0f)};
+    vec3 position = {random_range(seed, -100.0f, 100.0f), random_range(seed, -100.0f, 100.0f), random_range(seed, -100.0f, 100.0f)};
+    return mat4_mul(mat4_scale(scale), mat4_mul(quat_to_mat4_scalar(random_quat(seed)), mat4_translation(position)));
+}
+
+static matrix4 random_matrix(u32* seed) {
+    matrix4 m;
+    for (u32 i = 0; i < 16; ++i) {
+        m.data[i] = random_range(seed, -2.0f, 2.0f);
+    }
+    return m;
+}
+
+// The largest difference between a and b, relative to the magnitude of the reference b.
+static f32 max_relative_error(const f32* a, const f32* b, u32 count) {
+    f32 scale = 1.0f;
+    for (u32 i = 0; i < count; ++i) {
+        scale = KMAX(scale, kabs(b[i]));
+    }
+    f32 error = 0.0f;
+    for (u32 i = 0; i < count; ++i) {
+        error = KMAX(error, kabs(a[i] - b[i]) / scale);
+    }
+    return error;
+}
+
+// Differences allowed against the scalar reference. Plain SSE and NEON multiply and add in the
+// same order as the scalar code, but fused multiply-adds round once instead of twice, and the
+// SIMD inverse takes a different (block-wise) route to the same result.
+#define KMATH_TEST_TOLERANCE 1e-5f
+#define KMATH_TEST_INVERSE_TOLERANCE 1e-4f
+
+u8 kmath_simd_should_match_scalar(void) {
+    u32 seed = 0x1234567;
+    f32 worst_mul = 0, worst_inverse = 0, worst_vec = 0, worst_quat = 0;
+    for (u32 i = 0; i < 1000; ++i) {
+        matrix4 a = random_matrix(&seed);
+        matrix4 b = random_matrix(&seed);
+        matrix4 simd = mat4_mul(a, b);
+        matrix4 scalar = mat4_mul_scalar(a, b);
+        worst_mul = KMAX(worst_mul, max_relative_error(simd.data, scalar.data, 16));
+
+        matrix4 t = random_transform_matrix(&seed);
+        simd = mat4_inverse(t);
+        scalar = mat4_inverse_scalar(t);
+        worst_inverse = KMAX(worst_inverse, max_relative_error(simd.data, scalar.data, 16));
+        // And the inverse really is one.
+        matrix4 identity = mat4_identity();
+        matrix4 product = mat4_mul(t, simd);
+        worst_inverse = KMAX(worst_inverse, max_relative_error(product.data, identity.data, 16));
+
+        vec3 v3 = {random_range(&seed, -10.0f, 10.0f), random_range(&seed, -10.0f, 10.0f), random_range(&seed, -10.0f, 10.0f)};
+        vec3 v3_simd = vec3_mul_mat4(v3, t);
+        vec3 v3_scalar = vec3_mul_mat4_scalar(v3, t);
+        worst_vec = KMAX(worst_vec, max_relative_error(v3_simd.elements, v3_scalar.elements, 3));
+
+        vec4 v4 = {v3.x, v3.y, v3.z, random_range(&seed, -1.0f, 1.0f)};
+        vec4 v4_simd = vec4_mul_mat4(v4, a);
+        vec4 v4_scalar = vec4_mul_mat4_scalar(v4, a);
+        worst_vec = KMAX(worst_vec, max_relative_error(v4_simd.elements, v4_scalar.elements, 4));
+        v4_simd = mat4_mul_vec4(a, v4);
+        v4_scalar = mat4_mul_vec4_scalar(a, v4);
+        worst_vec = KMAX(worst_vec, max_relative_error(v4_simd.elements, v4_scalar.elements, 4));
+
+        // Not necessarily normalized.
+        quaterion q = random_quat(&seed);
+        q = (quaterion){q.x * 3.0f, q.y * 3.0f, q.z * 3.0f, q.w * 3.0f};
+        simd = quat_to_mat4(q);
+        scalar = quat_to_mat4_scalar(q);
+        worst_quat = KMAX(worst_quat, max_relative_error(simd.data, scalar.data, 16));
+    }
+
+    DINFO("kmath %s vs scalar, worst relative error: mat4_mul %g, mat4_inverse %g, vector transforms %g, quat_to_mat4 %g.",
+          KMATH_SIMD_NAME, worst_mul, worst_inverse, worst_vec, worst_quat);
+    expect_to_be_true((worst_mul <= KMATH_TEST_TOLERANCE));
+    expect_to_be_true((worst_inverse <= KMATH_TEST_INVERSE_TOLERANCE));
+    expect_to_be_true((worst_vec <= KMATH_TEST_TOLERANCE));
+    expect_to_be_true((worst_quat <= KMATH_TEST_TOLERANCE));
+    return true;
+}
+
+u8 kmath_batched_should_match_single(void) {
+    u32 seed = 0xBA7C4;
+    // Counts that leave partial groups exercise the tail handling.
+    u32 counts[] = {1, 3, 4, 7, 64, 1001};
+    for (u32 c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        u32 count = counts[c];
+        matrix4* a = kallocate(sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+        matrix4* b = kallocate(sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+        matrix4* out = kallocate(sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+        vec3* points = kallocate(sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+        vec3* out_points = kallocate(sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+        for (u32 i = 0; i < count; ++i) {
+            a[i] = random_transform_matrix(&seed);
+            b[i] = random_transform_matrix(&seed);
+            points[i] = (vec3){random_range(&seed, -10.0f, 10.0f), random_range(&seed, -10.0f, 10.0f), random_range(&seed, -10.0f, 10.0f)};
+        }
+        matrix4 m = random_transform_matrix(&seed);
+
+        mat4_mul_array(a, b, count, out);
+        vec3_transform_array(m, points, count, out_points);
+        f32 worst = 0;
+        for (u32 i = 0; i < count; ++i) {
+            matrix4 expected = mat4_mul_scalar(a[i], b[i]);
+            worst = KMAX(worst, max_relative_error(out[i].data, expected.data, 16));
+            vec3 expected_point = vec3_mul_mat4_scalar(points[i], m);
+            worst = KMAX(worst, max_relative_error(out_points[i].elements, expected_point.elements, 3));
+        }
+        expect_to_be_true((worst <= KMATH_TEST_TOLERANCE));
+
+        // In place.
+        mat4_mul_array(a, b, count, a);
+        vec3_transform_array(m, points, count, points);
+        u32 mismatches = 0;
+        for (u32 i = 0; i < count; ++i) {
+            for (u32 j = 0; j < 16; ++j) {
+                mismatches += a[i].data[j] != out[i].data[j];
+            }
+            for (u32 j = 0; j < 3; ++j) {
+                mismatches += points[i].elements[j] != out_points[i].elements[j];
+            }
+        }
+        expect_should_be(0, mismatches);
+
+        kfree(a, sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+        kfree(b, sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+        kfree(out, sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+        kfree(points, sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+        kfree(out_points, sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+    }
+    return true;
+}
+
+u8 kmath_benchmark(void) {
+    const u32 count = 4096;
+    const u32 runs = 200;
+    u32 seed = 0xF00D;
+    matrix4* a = kallocate(sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+    matrix4* b = kallocate(sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+    matrix4* out = kallocate(sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+    quaterion* quats = kallocate(sizeof(quaterion) * count, MEMORY_TAG_ARRAY);
+    vec3* points = kallocate(sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+    vec3* out_points = kallocate(sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < count; ++i) {
+        a[i] = random_transform_matrix(&seed);
+        b[i] = random_transform_matrix(&seed);
+        quats[i] = random_quat(&seed);
+        points[i] = (vec3){random_range(&seed, -10.0f, 10.0f), random_range(&seed, -10.0f, 10.0f), random_range(&seed, -10.0f, 10.0f)};
+    }
+    matrix4 m = a[0];
+    f64 ops = (f64)count * runs;
+    f64 start;
+
+// Times expr over every index i, in nanoseconds per call.
+#define KMATH_BENCH(out_ns, expr)                                \
+    start = platform_get_absolute_time();                       \
+    for (u32 r = 0; r < runs; ++r) {                            \
+        for (u32 i = 0; i < count; ++i) {                       \
+            expr;                                               \
+        }                                                       \
+    }                                                           \
+    out_ns = (platform_get_absolute_time() - start) * 1e9 / ops;
+
+    f64 mul_scalar, mul_simd, mul_array, inv_scalar, inv_simd, quat_scalar, quat_simd, vec_scalar, vec_simd, vec_array;
+    KMATH_BENCH(mul_scalar, out[i] = mat4_mul_scalar(a[i], b[i]));
+    KMATH_BENCH(mul_simd, out[i] = mat4_mul(a[i], b[i]));
+    KMATH_BENCH(inv_scalar, out[i] = mat4_inverse_scalar(a[i]));
+    KMATH_BENCH(inv_simd, out[i] = mat4_inverse(a[i]));
+    KMATH_BENCH(quat_scalar, out[i] = quat_to_mat4_scalar(quats[i]));
+    KMATH_BENCH(quat_simd, out[i] = quat_to_mat4(quats[i]));
+    KMATH_BENCH(vec_scalar, out_points[i] = vec3_mul_mat4_scalar(points[i], m));
+    KMATH_BENCH(vec_simd, out_points[i] = vec3_mul_mat4(points[i], m));
+#undef KMATH_BENCH
+
+    start = platform_get_absolute_time();
+    for (u32 r = 0; r < runs; ++r) {
+        mat4_mul_array(a, b, count, out);
+    }
+    mul_array = (platform_get_absolute_time() - start) * 1e9 / ops;
+
+    start = platform_get_absolute_time();
+    for (u32 r = 0; r < runs; ++r) {
+        vec3_transform_array(m, points, count, out_points);
+    }
+    vec_array = (platform_get_absolute_time() - start) * 1e9 / ops;
+
+    DINFO("kmath benchmark (%s, ns per op, scalar/SIMD): mat4_mul %.2f/%.2f (array %.2f), mat4_inverse %.2f/%.2f, quat_to_mat4 %.2f/%.2f, vec3_mul_mat4 %.2f/%.2f (array %.2f).",
+          KMATH_SIMD_NAME, mul_scalar, mul_simd, mul_array, inv_scalar, inv_simd, quat_scalar, quat_simd, vec_scalar, vec_simd, vec_array);
+    // Keep the results alive.
+    expect_to_be_true((out[count - 1].data[15] == out[count - 1].data[15] && out_points[0].x == out_points[0].x));
+
+    kfree(a, sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+    kfree(b, sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+    kfree(out, sizeof(matrix4) * count, MEMORY_TAG_ARRAY);
+    kfree(quats, sizeof(quaterion) * count, MEMORY_TAG_ARRAY);
+    kfree(points, sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+    kfree(out_points, sizeof(vec3) * count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+void kmath_register_tests(void) {
+    test_manager_register_test(kmath_simd_should_match_scalar, "kmath SIMD operations should match the scalar reference.");
+    test_manager_register_test(kmath_batched_should_match_single, "kmath batched operations should match single ones.");
+    test_manager_register_test(kmath_benchmark, "kmath benchmark, scalar vs SIMD.");
+}
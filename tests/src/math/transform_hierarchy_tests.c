@@ -0,0 +1,291 @@
+#include "transform_hierarchy_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <defines.h>
+#include <core/kmemory.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <math/transform.h>
+#include <math/transform_hierarchy.h>
+#include <platform/platform.h>
+
+static transform random_transform(u32* seed, f32 max_scale) {
+    vec3 position = {random_range(seed, -2.0f, 2.0f), random_range(seed, -2.0f, 2.0f), random_range(seed, -2.0f, 2.0f)};
+    quaterion rotation = quat_from_axis_angle(vec3_up(), random_range(seed, -0.5f, 0.5f), true);
+    vec3 scale = vec3_one();
+    if (max_scale > 1.0f) {
+        scale = (vec3){random_range(seed, 1.0f / max_scale, max_scale), random_range(seed, 1.0f / max_scale, max_scale), random_range(seed, 1.0f / max_scale, max_scale)};
+    }
+    return transform_from_position_rotation_scale(position, rotation, scale);
+}
+
+// The world matrix as transform_world_get used to produce it: rebuilt from scratch up the whole parent chain.
+static matrix4 reference_world(transform* t) {
+    matrix4 l = transform_local_get(t);
+    if (t->parent) {
+        return mat4_mul(l, reference_world(t->parent));
+    }
+    return l;
+}
+
+static b8 mat4_near(matrix4 a, matrix4 b) {
+    for (u32 i = 0; i < 16; ++i) {
+        if (kabs(a.data[i] - b.data[i]) > 0.001f * (1.0f + kabs(b.data[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Shuffles the given pointers, so that builds don't depend on being handed parents first.
+static void shuffle(transform** transforms, u32 count, u32 seed) {
+    for (u32 i = count - 1; i > 0; --i) {
+        u32 j = xorshift(&seed) % (i + 1);
+        transform* temp = transforms[i];
+        transforms[i] = transforms[j];
+        transforms[j] = temp;
+    }
+}
+
+u8 transform_world_get_should_cache_until_changed(void) {
+    transform parent = transform_from_position((vec3){1.0f, 0.0f, 0.0f});
+    transform child = transform_from_position((vec3){0.0f, 2.0f, 0.0f});
+    transform_parent_set(&child, &parent);
+
+    matrix4 world = transform_world_get(&child);
+    expect_float_to_be(1.0f, world.data[12]);
+    expect_float_to_be(2.0f, world.data[13]);
+    u32 version = child.world_version;
+
+    // Nothing changed, so nothing is recalculated.
+    transform_world_get(&child);
+    expect_should_be(version, child.world_version);
+
+    // Moving the parent invalidates the child.
+    transform_translate(&parent, (vec3){0.0f, 0.0f, 3.0f});
+    world = transform_world_get(&child);
+    expect_should_be(version + 1, child.world_version);
+    expect_float_to_be(3.0f, world.data[14]);
+
+    // As does reparenting.
+    transform_parent_set(&child, 0);
+    world = transform_world_get(&child);
+    expect_float_to_be(0.0f, world.data[12]);
+    expect_float_to_be(2.0f, world.data[13]);
+
+    // A mirrored parent flips the determinant of its children.
+    transform_parent_set(&child, &parent);
+    transform_scale_set(&parent, (vec3){-1.0f, 1.0f, 1.0f});
+    expect_to_be_true((transform_determinant_get(&child) < 0.0f));
+    expect_to_be_true((child.determinant < 0.0f));
+    return true;
+}
+
+u8 transform_hierarchy_should_match_recursive_world(void) {
+    const u32 count = 2000;
+    u32 seed = 0x5EED;
+    transform* storage = kallocate(sizeof(transform) * count, MEMORY_TAG_ARRAY);
+    transform** transforms = kallocate(sizeof(transform*) * count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < count; ++i) {
+        storage[i] = random_transform(&seed, 1.1f);
+        // Roughly one in eight is a root; the rest hang off an earlier transform.
+        if (i && (xorshift(&seed) & 7)) {
+            transform_parent_set(&storage[i], &storage[xorshift(&seed) % i]);
+        }
+        transforms[i] = &storage[i];
+    }
+    shuffle(transforms, count, 0xABCD);
+
+    transform_hierarchy hierarchy;
+    expect_to_be_true(transform_hierarchy_create(16, &hierarchy));
+    expect_to_be_true(transform_hierarchy_build(&hierarchy, transforms, count));
+    expect_should_be(count, hierarchy.count);
+    expect_should_be(count, hierarchy.level_offsets[hierarchy.level_count]);
+
+    // Every parent is at a lower level than its child.
+    u32 misordered = 0;
+    for (u32 level = 0; level < hierarchy.level_count; ++level) {
+        for (u32 i = hierarchy.level_offsets[level]; i < hierarchy.level_offsets[level + 1]; ++i) {
+            transform* t = hierarchy.transforms[i];
+            if (level == 0) {
+                misordered += t->parent != 0;
+            } else {
+                b8 found = false;
+                for (u32 j = hierarchy.level_offsets[level - 1]; j < hierarchy.level_offsets[level]; ++j) {
+                    found |= hierarchy.transforms[j] == t->parent;
+                }
+                misordered += !found;
+            }
+        }
+    }
+    expect_should_be(0, misordered);
+
+    expect_should_be(count, transform_hierarchy_update(&hierarchy));
+    u32 mismatches = 0;
+    for (u32 i = 0; i < count; ++i) {
+        matrix4 expected = reference_world(&storage[i]);
+        mismatches += !mat4_near(storage[i].world, expected);
+        mismatches += kabs(storage[i].determinant - mat4_determinant(expected)) > 0.001f * (1.0f + kabs(storage[i].determinant));
+    }
+    expect_should_be(0, mismatches);
+
+    // A second update has nothing to do.
+    expect_should_be(0, transform_hierarchy_update(&hierarchy));
+
+    // Moving one transform recalculates exactly it and its descendants.
+    transform* moved = &storage[count / 4];
+    transform_translate(moved, (vec3){5.0f, 0.0f, 0.0f});
+    u32 subtree = 0;
+    for (u32 i = 0; i < count; ++i) {
+        for (transform* t = &storage[i]; t; t = t->parent) {
+            if (t == moved) {
+                subtree++;
+                break;
+            }
+        }
+    }
+    expect_should_be(subtree, transform_hierarchy_update(&hierarchy));
+    for (u32 i = 0; i < count; ++i) {
+        mismatches += !mat4_near(transform_world_get(&storage[i]), reference_world(&storage[i]));
+    }
+    expect_should_be(0, mismatches);
+
+    transform_hierarchy_destroy(&hierarchy);
+    expect_to_be_true((hierarchy.transforms == 0));
+    kfree(transforms, sizeof(transform*) * count, MEMORY_TAG_ARRAY);
+    kfree(storage, sizeof(transform) * count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 transform_hierarchy_should_handle_external_parents_and_cycles(void) {
+    transform outside = transform_from_position((vec3){10.0f, 0.0f, 0.0f});
+    transform a = transform_from_position((vec3){1.0f, 0.0f, 0.0f});
+    transform b = transform_from_position((vec3){0.0f, 1.0f, 0.0f});
+    transform_parent_set(&a, &outside);
+    transform_parent_set(&b, &a);
+
+    transform_hierarchy hierarchy;
+    transform_hierarchy_create(2, &hierarchy);
+    transform* transforms[] = {&b, &a};
+    expect_to_be_true(transform_hierarchy_build(&hierarchy, transforms, 2));
+    expect_should_be(2, hierarchy.level_count);
+    expect_to_be_true((hierarchy.transforms[0] == &a));
+
+    // A parent outside the hierarchy is still taken into account.
+    transform_hierarchy_update(&hierarchy);
+    expect_float_to_be(11.0f, b.world.data[12]);
+    expect_float_to_be(1.0f, b.world.data[13]);
+    transform_translate(&outside, (vec3){1.0f, 0.0f, 0.0f});
+    expect_should_be(2, transform_hierarchy_update(&hierarchy));
+    expect_float_to_be(12.0f, b.world.data[12]);
+
+    // Cycles are rejected.
+    transform_parent_set(&a, &b);
+    expect_to_be_false(transform_hierarchy_build(&hierarchy, transforms, 2));
+    expect_should_be(0, hierarchy.count);
+    expect_should_be(0, transform_hierarchy_update(&hierarchy));
+
+    transform_hierarchy_destroy(&hierarchy);
+    return true;
+}
+
+typedef enum hierarchy_shape {
+    // 100 chains, each 1000 transforms deep.
+    HIERARCHY_SHAPE_DEEP,
+    // One root with 1000 children, each with 99 children of their own.
+    HIERARCHY_SHAPE_WIDE
+} hierarchy_shape;
+
+static u8 benchmark_shape(hierarchy_shape shape) {
+    const u32 count = 100000;
+    const u32 runs = 20;
+    u32 seed = 0xBE7C4;
+    transform* storage = kallocate(sizeof(transform) * count, MEMORY_TAG_ARRAY);
+    transform** transforms = kallocate(sizeof(transform*) * count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < count; ++i) {
+        storage[i] = random_transform(&seed, 1.0f);
+        transforms[i] = &storage[i];
+        if (shape == HIERARCHY_SHAPE_DEEP) {
+            if (i % 1000) {
+                transform_parent_set(&storage[i], &storage[i - 1]);
+            }
+        } else if (i) {
+            u32 group = (i - 1) / 100;
+            transform_parent_set(&storage[i], i - 1 == group * 100 ? &storage[0] : &storage[group * 100 + 1]);
+        }
+    }
+
+    // What every scene query paid before: each world matrix rebuilt from scratch up its chain.
+    // Deep chains make this quadratic, so only every 16th transform is timed and the result scaled.
+    const u32 stride = shape == HIERARCHY_SHAPE_DEEP ? 16 : 1;
+    f32 sink = 0;
+    f64 start = platform_get_absolute_time();
+    for (u32 i = 0; i < count; i += stride) {
+        matrix4 world = reference_world(&storage[i]);
+        sink += mat4_determinant(world);
+    }
+    f64 recursive_time = (platform_get_absolute_time() - start) * stride;
+
+    transform_hierarchy hierarchy;
+    transform_hierarchy_create(count, &hierarchy);
+    start = platform_get_absolute_time();
+    transform_hierarchy_build(&hierarchy, transforms, count);
+    f64 build_time = platform_get_absolute_time() - start;
+
+    // Every root moves each frame, so everything is recalculated.
+    u32 updated = 0;
+    start = platform_get_absolute_time();
+    for (u32 r = 0; r < runs; ++r) {
+        for (u32 i = hierarchy.level_offsets[0]; i < hierarchy.level_offsets[1]; ++i) {
+            transform_translate(hierarchy.transforms[i], (vec3){0.0f, 0.001f, 0.0f});
+        }
+        updated = transform_hierarchy_update(&hierarchy);
+    }
+    f64 full_time = (platform_get_absolute_time() - start) / runs;
+
+    // Nothing moves, so only the dirty checks remain.
+    start = platform_get_absolute_time();
+    for (u32 r = 0; r < runs; ++r) {
+        transform_hierarchy_update(&hierarchy);
+    }
+    f64 clean_time = (platform_get_absolute_time() - start) / runs;
+
+    // Reading back through transform_world_get, as the scene queries do, after an update.
+    start = platform_get_absolute_time();
+    for (u32 i = 0; i < count; i += stride) {
+        matrix4 world = transform_world_get(&storage[i]);
+        sink += world.data[0];
+    }
+    f64 cached_time = (platform_get_absolute_time() - start) * stride;
+
+    DINFO("Transform hierarchy benchmark (%s, %u transforms, %u levels): recursive world get %.3f ms, build %.3f ms, update all %.3f ms, update none %.3f ms, cached world get %.3f ms. (%f)",
+          shape == HIERARCHY_SHAPE_DEEP ? "deep" : "wide", count, hierarchy.level_count,
+          recursive_time * 1000.0, build_time * 1000.0, full_time * 1000.0, clean_time * 1000.0, cached_time * 1000.0, sink);
+
+    expect_should_be(count, updated);
+    u32 mismatches = 0;
+    for (u32 i = 0; i < count; i += 97) {
+        mismatches += !mat4_near(storage[i].world, reference_world(&storage[i]));
+    }
+    expect_should_be(0, mismatches);
+
+    transform_hierarchy_destroy(&hierarchy);
+    kfree(transforms, sizeof(transform*) * count, MEMORY_TAG_ARRAY);
+    kfree(storage, sizeof(transform) * count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+u8 transform_hierarchy_benchmark(void) {
+    expect_to_be_true(benchmark_shape(HIERARCHY_SHAPE_DEEP));
+    expect_to_be_true(benchmark_shape(HIERARCHY_SHAPE_WIDE));
+    return true;
+}
+
+void transform_hierarchy_register_tests(void) {
+    test_manager_register_test(transform_world_get_should_cache_until_changed, "Transform world matrix should be cached until it changes.");
+    test_manager_register_test(transform_hierarchy_should_match_recursive_world, "Transform hierarchy should match recursive world matrices.");
+    test_manager_register_test(transform_hierarchy_should_handle_external_parents_and_cycles, "Transform hierarchy should handle outside parents and cycles.");
+    test_manager_register_test(transform_hierarchy_benchmark, "Transform hierarchy benchmark, deep and wide at 100K.");
+}
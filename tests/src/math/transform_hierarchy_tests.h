@@ -0,0 +1,3 @@
+#pragma once
+
+void transform_hierarchy_register_tests(void);
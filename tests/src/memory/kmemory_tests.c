@@ -0,0 +1,212 @@
+#include "kmemory_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <defines.h>
+#include <algorithm/kalgorithm.h>
+#include <core/katomic.h>
+#include <core/kmemory.h>
+#include <core/thread.h>
+#include <platform/platform.h>
+
+#define STRESS_MAX_THREADS 16
+#define STRESS_LIVE_BLOCKS 256
+#define STRESS_OPS_PER_THREAD 40000
+
+typedef struct alloc_stress_thread {
+    kthread thread;
+    u32 seed;
+    volatile u32* start_flag;
+    // Latency of every operation, in nanoseconds.
+    i32* latencies;
+    u32 latency_count;
+    b8 corrupted;
+} alloc_stress_thread;
+
+static u64 stress_size(u32* seed) {
+    // Mostly small blocks, as strings, darrays and job payloads are, with the odd large one.
+    u32 r = xorshift(seed);
+    if ((r & 63) == 0) {
+        return 4096 + (r >> 8) % 16384;
+    }
+    return 8 + (r >> 8) % 504;
+}
+
+static u32 alloc_stress_thread_run(void* params) {
+    alloc_stress_thread* t = params;
+    void* blocks[STRESS_LIVE_BLOCKS] = {0};
+    u64 sizes[STRESS_LIVE_BLOCKS] = {0};
+
+    while (!katomic_load_u32(t->start_flag)) {
+        platform_sleep(0);
+    }
+
+    u32 seed = t->seed;
+    for (u32 op = 0; op < STRESS_OPS_PER_THREAD; ++op) {
+        u32 slot = xorshift(&seed) % STRESS_LIVE_BLOCKS;
+        f64 start = platform_get_absolute_time();
+        if (blocks[slot]) {
+            kfree(blocks[slot], sizes[slot], MEMORY_TAG_ARRAY);
+            blocks[slot] = 0;
+        } else {
+            sizes[slot] = stress_size(&seed);
+            blocks[slot] = kallocate(sizes[slot], MEMORY_TAG_ARRAY);
+        }
+        f64 end = platform_get_absolute_time();
+        t->latencies[t->latency_count++] = (i32)((end - start) * 1000000000.0);
+
+        if (blocks[slot]) {
+            // Stamp the block so overlapping allocations across threads would show up.
+            u8* bytes = blocks[slot];
+            if (bytes[0] != 0 || bytes[sizes[slot] - 1] != 0) {
+                t->corrupted = true;
+            }
+            bytes[0] = (u8)slot;
+            bytes[sizes[slot] - 1] = (u8)slot;
+        }
+    }
+
+    for (u32 i = 0; i < STRESS_LIVE_BLOCKS; ++i) {
+        if (blocks[i]) {
+            u8* bytes = blocks[i];
+            if (bytes[0] != (u8)i || bytes[sizes[i] - 1] != (u8)i) {
+                t->corrupted = true;
+            }
+            kfree(blocks[i], sizes[i], MEMORY_TAG_ARRAY);
+        }
+    }
+    kmemory_thread_cache_flush();
+    return 0;
+}
+
+u8 kmemory_should_serve_small_blocks_from_thread_cache(void) {
+    memory_system_configuration config = {0};
+    config.total_alloc_size = MEBIBYTES(4);
+    // Room for a single span, so the fallback to the dynamic allocator gets exercised.
+    config.small_block_arena_size = KIBIBYTES(64);
+    expect_to_be_true(memory_system_initialize(config));
+    u64 alloc_count_before = get_memory_alloc_count();
+
+    const u32 count = 100;
+    u8* blocks[100];
+    for (u32 i = 0; i < count; ++i) {
+        blocks[i] = kallocate(2000, MEMORY_TAG_ARRAY);
+        expect_should_not_be(0, blocks[i]);
+        if (i < 32) {
+            // The first span's worth come from the arena, so are 16-byte aligned.
+            expect_should_be(0, ((u64)blocks[i]) % 16);
+        }
+        for (u32 b = 0; b < 2000; ++b) {
+            if (blocks[i][b] != 0) {
+                DERROR("Block %u was not zeroed.", i);
+                return false;
+            }
+        }
+        kset_memory(blocks[i], (i32)i, 2000);
+    }
+    // No two blocks may overlap, whichever allocator they came from.
+    for (u32 i = 0; i < count; ++i) {
+        expect_should_be((u8)i, blocks[i][0]);
+        expect_should_be((u8)i, blocks[i][1999]);
+    }
+    expect_should_be(alloc_count_before + count, get_memory_alloc_count());
+
+    // Small blocks report their size class.
+    u64 size = 0;
+    u16 alignment = 0;
+    expect_to_be_true(kmemory_get_size_alignment(blocks[0], &size, &alignment));
+    expect_should_be(2048, size);
+    expect_should_be(1, alignment);
+
+    for (u32 i = 0; i < count; ++i) {
+        kfree(blocks[i], 2000, MEMORY_TAG_ARRAY);
+    }
+    expect_should_be(alloc_count_before, get_memory_alloc_count());
+
+    // Freed blocks are reused, and zeroed again unless asked not to be.
+    u8* reused = kallocate(2000, MEMORY_TAG_ARRAY);
+    expect_should_be(0, reused[0]);
+    kset_memory(reused, 0xAB, 2000);
+    kfree(reused, 2000, MEMORY_TAG_ARRAY);
+    u8* unzeroed = kallocate_no_zero(2000, MEMORY_TAG_ARRAY);
+    expect_should_be(reused, unzeroed);
+    // The start of a free block holds its free list links, so look further in.
+    expect_should_be(0xAB, unzeroed[100]);
+    kfree(unzeroed, 2000, MEMORY_TAG_ARRAY);
+
+    // Aligned requests go to the dynamic allocator, even small ones, so that the alignment reported
+    // is the one asked for, as a realloc (such as Vulkan's) must be given.
+    u16 alignments[3] = {4, 16, 64};
+    for (u32 i = 0; i < 3; ++i) {
+        void* aligned = kallocate_aligned(64, alignments[i], MEMORY_TAG_ARRAY);
+        expect_to_be_true(kmemory_get_size_alignment(aligned, &size, &alignment));
+        expect_should_be(alignments[i], alignment);
+        expect_should_be(0, (u64)aligned % alignments[i]);
+        kfree_aligned(aligned, 64, alignments[i], MEMORY_TAG_ARRAY);
+    }
+    expect_should_be(alloc_count_before, get_memory_alloc_count());
+
+    memory_system_shutdown(0);
+    return true;
+}
+
+u8 kmemory_benchmark_multithreaded_allocation(void) {
+    memory_system_configuration config = {0};
+    config.total_alloc_size = MEBIBYTES(256);
+    expect_to_be_true(memory_system_initialize(config));
+
+    u32 thread_counts[5] = {1, 2, 4, 8, 16};
+    for (u32 c = 0; c < 5; ++c) {
+        u32 thread_count = thread_counts[c];
+        u64 alloc_count_before = get_memory_alloc_count();
+        alloc_stress_thread threads[STRESS_MAX_THREADS] = {0};
+        volatile u32 start_flag = 0;
+        for (u32 i = 0; i < thread_count; ++i) {
+            threads[i].seed = 0x9E3779B9u * (i + 1);
+            threads[i].start_flag = &start_flag;
+            threads[i].latencies = kallocate(sizeof(i32) * STRESS_OPS_PER_THREAD, MEMORY_TAG_ARRAY);
+            expect_to_be_true(kthread_create(alloc_stress_thread_run, &threads[i], false, &threads[i].thread));
+        }
+
+        f64 start = platform_get_absolute_time();
+        katomic_store_u32(&start_flag, 1);
+        for (u32 i = 0; i < thread_count; ++i) {
+            kthread_wait(&threads[i].thread);
+        }
+        f64 elapsed = platform_get_absolute_time() - start;
+
+        // Gather every thread's samples for the percentiles.
+        u32 total_ops = thread_count * STRESS_OPS_PER_THREAD;
+        i32* all = kallocate(sizeof(i32) * total_ops, MEMORY_TAG_ARRAY);
+        u32 sample_count = 0;
+        b8 corrupted = false;
+        for (u32 i = 0; i < thread_count; ++i) {
+            kcopy_memory(all + sample_count, threads[i].latencies, sizeof(i32) * threads[i].latency_count);
+            sample_count += threads[i].latency_count;
+            corrupted |= threads[i].corrupted;
+            kfree(threads[i].latencies, sizeof(i32) * STRESS_OPS_PER_THREAD, MEMORY_TAG_ARRAY);
+        }
+        _quick_sort(all, 0, sample_count - 1);
+        DINFO("Allocation stress benchmark: %2u thread(s), %u ops in %.4f sec (%.0f ops/sec), latency p50 %d ns, p99 %d ns, max %d ns.",
+              thread_count,
+              sample_count,
+              elapsed,
+              sample_count / elapsed,
+              all[sample_count / 2],
+              all[(u32)(sample_count * 0.99)],
+              all[sample_count - 1]);
+        kfree(all, sizeof(i32) * total_ops, MEMORY_TAG_ARRAY);
+
+        expect_to_be_false(corrupted);
+        expect_should_be(alloc_count_before, get_memory_alloc_count());
+    }
+
+    memory_system_shutdown(0);
+    return true;
+}
+
+void kmemory_register_tests(void) {
+    test_manager_register_test(kmemory_should_serve_small_blocks_from_thread_cache, "Memory system serves small blocks from thread caches and falls back when the arena is full.");
+    test_manager_register_test(kmemory_benchmark_multithreaded_allocation, "Memory system benchmark: multithreaded allocation stress at 1-16 threads.");
+}
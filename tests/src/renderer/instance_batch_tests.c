@@ -0,0 +1,186 @@
+#include "instance_batch_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <defines.h>
+#include <core/frame_data.h>
+#include <core/kmemory.h>
+#include <core/logger.h>
+#include <math/kmath.h>
+#include <memory/linear_allocator.h>
+#include <platform/platform.h>
+#include <renderer/instance_batch.h>
+#include <renderer/render_queue.h>
+#include <renderer/renderer_types.h>
+#include <resources/resource_types.h>
+
+// Enough for the benchmark's queue, batches and models.
+#define TEST_FRAME_MEMORY_SIZE (16 * 1024 * 1024)
+
+// A draw of the given mesh, told apart by the translation of its model matrix.
+static geometry_render_data test_draw(material* m, u32 mesh, f32 id) {
+    geometry_render_data g = {0};
+    g.model = mat4_translation((vec3){id, 0, 0});
+    g.material = m;
+    g.vertex_buffer_offset = mesh * 4096;
+    g.vertex_count = 24;
+    g.index_buffer_offset = mesh * 1024;
+    g.index_count = 36;
+    return g;
+}
+
+// Obtains the id of the draw the given model matrix was taken from.
+static f32 model_id(const instance_batch_list* list, u32 index) {
+    return list->models[index].data[12];
+}
+
+u8 instance_batch_should_group_opaque_draws(void) {
+    linear_allocator_create(1024 * 1024, 0, &test_frame_memory);
+    material opaque = {0};
+    opaque.type = MATERIAL_TYPE_PBR;
+
+    // Mesh 1 and mesh 0 interleaved, all with the same material.
+    geometry_render_data draws[5] = {
+        test_draw(&opaque, 1, 0), test_draw(&opaque, 0, 1), test_draw(&opaque, 1, 2), test_draw(&opaque, 0, 3), test_draw(&opaque, 1, 4)};
+    instance_batch_list list;
+    expect_to_be_true(instance_batch_list_build(&test_frame_allocator, 5, draws, &list));
+
+    expect_should_be(2, list.batch_count);
+    expect_should_be(5, list.instance_count);
+    // Mesh 0's draws first, in the order they were given, then mesh 1's.
+    expect_should_be(0, list.batches[0].first_instance);
+    expect_should_be(2, list.batches[0].instance_count);
+    expect_to_be_true((list.batches[0].geometry->vertex_buffer_offset == 0));
+    expect_should_be(2, list.batches[1].first_instance);
+    expect_should_be(3, list.batches[1].instance_count);
+    expect_to_be_true((list.batches[1].geometry->vertex_buffer_offset == 4096));
+    f32 expected_ids[5] = {1, 3, 0, 2, 4};
+    for (u32 i = 0; i < 5; ++i) {
+        expect_float_to_be(expected_ids[i], model_id(&list, i));
+    }
+
+    test_frame_allocator.free_all();
+    linear_allocator_destroy(&test_frame_memory);
+    return true;
+}
+
+u8 instance_batch_should_not_merge_across_state(void) {
+    linear_allocator_create(1024 * 1024, 0, &test_frame_memory);
+    material a = {0};
+    a.type = MATERIAL_TYPE_PBR;
+    material b = {0};
+    b.type = MATERIAL_TYPE_PBR;
+
+    // The same mesh, but with different materials and windings, stays in separate batches and in order.
+    geometry_render_data draws[4] = {test_draw(&a, 0, 0), test_draw(&b, 0, 1), test_draw(&a, 0, 2), test_draw(&a, 0, 3)};
+    draws[3].winding_inverted = true;
+    instance_batch_list list;
+    expect_to_be_true(instance_batch_list_build(&test_frame_allocator, 4, draws, &list));
+
+    expect_should_be(4, list.batch_count);
+    for (u32 i = 0; i < 4; ++i) {
+        expect_should_be(i, list.batches[i].first_instance);
+        expect_should_be(1, list.batches[i].instance_count);
+        expect_float_to_be((f32)i, model_id(&list, i));
+    }
+
+    test_frame_allocator.free_all();
+    linear_allocator_destroy(&test_frame_memory);
+    return true;
+}
+
+u8 instance_batch_should_keep_transparent_order(void) {
+    linear_allocator_create(1024 * 1024, 0, &test_frame_memory);
+    texture glass_texture = {0};
+    glass_texture.flags = TEXTURE_FLAG_HAS_TRANSPARENCY;
+    texture_map glass_maps[1] = {0};
+    glass_maps[0].texture = &glass_texture;
+    material glass = {0};
+    glass.type = MATERIAL_TYPE_PBR;
+    glass.maps = glass_maps;
+
+    // Back to front: mesh 0 twice, mesh 1, then mesh 0 again. Only the first two can be merged.
+    geometry_render_data draws[4] = {test_draw(&glass, 0, 0), test_draw(&glass, 0, 1), test_draw(&glass, 1, 2), test_draw(&glass, 0, 3)};
+    instance_batch_list list;
+    expect_to_be_true(instance_batch_list_build(&test_frame_allocator, 4, draws, &list));
+
+    expect_should_be(3, list.batch_count);
+    expect_should_be(2, list.batches[0].instance_count);
+    expect_should_be(1, list.batches[1].instance_count);
+    expect_should_be(1, list.batches[2].instance_count);
+    for (u32 i = 0; i < 4; ++i) {
+        expect_float_to_be((f32)i, model_id(&list, i));
+    }
+
+    test_frame_allocator.free_all();
+    linear_allocator_destroy(&test_frame_memory);
+    return true;
+}
+
+u8 instance_batch_benchmark(void) {
+    linear_allocator_create(TEST_FRAME_MEMORY_SIZE, 0, &test_frame_memory);
+
+    // A forest-like scene: 50K instances of 40 props spread over 8 materials, sorted as the scene sorts them.
+    const u32 count = 50000;
+    const u32 material_count = 8;
+    const u32 mesh_count = 40;
+    material materials[8] = {0};
+    for (u32 i = 0; i < material_count; ++i) {
+        materials[i].type = MATERIAL_TYPE_PBR;
+        materials[i].id = i;
+    }
+    u32 seed = 0xF0E57;
+    geometry_render_data* unsorted = kallocate(sizeof(geometry_render_data) * count, MEMORY_TAG_ARRAY);
+    geometry_render_data* draws = kallocate(sizeof(geometry_render_data) * count, MEMORY_TAG_ARRAY);
+    render_queue queue;
+    render_queue_create(&test_frame_allocator, count, &queue);
+    for (u32 i = 0; i < count; ++i) {
+        u32 mesh = xorshift(&seed) % mesh_count;
+        // Each prop always uses the same material.
+        material* m = &materials[mesh % material_count];
+        unsorted[i] = test_draw(m, mesh, (f32)i);
+        f32 depth = (f32)(xorshift(&seed) & 0xFFFF) / 64.0f;
+        render_queue_push(&queue, render_key_create(RENDER_KEY_LAYER_OPAQUE, 0, m->id, false, depth), i);
+    }
+    render_queue_sort(&queue);
+    for (u32 i = 0; i < count; ++i) {
+        draws[i] = unsorted[queue.indices[i]];
+    }
+
+    // Time building the batches and gathering the model matrices, as the passes do every frame.
+    const u32 runs = 20;
+    instance_batch_list list;
+    f64 build_time = 0;
+    for (u32 r = 0; r < runs; ++r) {
+        test_frame_allocator.free_all();
+        f64 start = platform_get_absolute_time();
+        instance_batch_list_build(&test_frame_allocator, count, draws, &list);
+        build_time += platform_get_absolute_time() - start;
+    }
+    build_time = build_time * 1000.0 / runs;
+
+    // Every draw ends up in exactly one batch, and one batch per prop.
+    u32 total = 0;
+    for (u32 b = 0; b < list.batch_count; ++b) {
+        total += list.batches[b].instance_count;
+    }
+    expect_should_be(count, total);
+    expect_should_be(mesh_count, list.batch_count);
+
+    DINFO("Instance batch benchmark (%u instances, %u meshes, %u materials): %u draw calls batched into %u (%.0fx fewer), %.3f ms to batch and gather %.1f KiB of instance data.",
+          count, mesh_count, material_count, count, list.batch_count, (f64)count / list.batch_count, build_time, (f64)(sizeof(matrix4) * count) / 1024.0);
+
+    kfree(unsorted, sizeof(geometry_render_data) * count, MEMORY_TAG_ARRAY);
+    kfree(draws, sizeof(geometry_render_data) * count, MEMORY_TAG_ARRAY);
+    test_frame_allocator.free_all();
+    linear_allocator_destroy(&test_frame_memory);
+    return true;
+}
+
+void instance_batch_register_tests(void) {
+    test_manager_register_test(instance_batch_should_group_opaque_draws, "Instance batches should group opaque draws of the same geometry.");
+    test_manager_register_test(instance_batch_should_not_merge_across_state, "Instance batches should not merge draws with different state.");
+    test_manager_register_test(instance_batch_should_keep_transparent_order, "Instance batches should keep transparent draws in order.");
+    test_manager_register_test(instance_batch_benchmark, "Instance batch benchmark, 50K instances.");
+}
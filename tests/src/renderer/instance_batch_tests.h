@@ -0,0 +1,3 @@
+#pragma once
+
+void instance_batch_register_tests(void);
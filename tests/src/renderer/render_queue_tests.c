@@ -0,0 +1,228 @@
+#include "render_queue_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <defines.h>
+#include <core/frame_data.h>
+#include <core/kmemory.h>
+#include <core/logger.h>
+#include <memory/linear_allocator.h>
+#include <platform/platform.h>
+#include <renderer/render_queue.h>
+#include <renderer/renderer_types.h>
+#include <utils/ksort.h>
+
+// Enough for the largest benchmark queue, its scratch and the sorted render data.
+#define TEST_FRAME_MEMORY_SIZE (192 * 1024 * 1024)
+
+// A key and its original position, sorted by a plain insertion sort as the reference.
+typedef struct keyed_index {
+    u64 key;
+    u32 index;
+} keyed_index;
+
+static void reference_sort(keyed_index* entries, u32 count) {
+    for (u32 i = 1; i < count; ++i) {
+        keyed_index e = entries[i];
+        u32 j = i;
+        // Strictly greater only, so equal keys keep their order.
+        while (j > 0 && entries[j - 1].key > e.key) {
+            entries[j] = entries[j - 1];
+            --j;
+        }
+        entries[j] = e;
+    }
+}
+
+u8 kradix_sort_should_match_stable_reference(void) {
+    u32 seed = 0xC0FFEE;
+    u32 counts[] = {2, 3, 17, 256, 1001, 4096};
+    // Masks which leave some bytes the same across all keys, so their passes are skipped and
+    // the result ends up in scratch memory for an odd number of passes.
+    u64 masks[] = {0xFFFFFFFFFFFFFFFFull, 0x00000000000000FFull, 0xFF000000000000FFull, 0x0000FF0000FF00FFull, 0x0000000000000003ull};
+    for (u32 c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        for (u32 m = 0; m < sizeof(masks) / sizeof(masks[0]); ++m) {
+            u32 count = counts[c];
+            u64* keys = kallocate(sizeof(u64) * count, MEMORY_TAG_ARRAY);
+            u32* values = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+            u64* scratch_keys = kallocate(sizeof(u64) * count, MEMORY_TAG_ARRAY);
+            u32* scratch_values = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+            keyed_index* reference = kallocate(sizeof(keyed_index) * count, MEMORY_TAG_ARRAY);
+            for (u32 i = 0; i < count; ++i) {
+                u64 key = ((u64)xorshift(&seed) << 32 | xorshift(&seed)) & masks[m];
+                keys[i] = key;
+                values[i] = i;
+                reference[i] = (keyed_index){key, i};
+            }
+
+            kradix_sort_u64(keys, values, count, scratch_keys, scratch_values);
+            reference_sort(reference, count);
+
+            u32 mismatches = 0;
+            for (u32 i = 0; i < count; ++i) {
+                if (keys[i] != reference[i].key || values[i] != reference[i].index) {
+                    mismatches++;
+                }
+            }
+            expect_should_be(0, mismatches);
+
+            kfree(keys, sizeof(u64) * count, MEMORY_TAG_ARRAY);
+            kfree(values, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+            kfree(scratch_keys, sizeof(u64) * count, MEMORY_TAG_ARRAY);
+            kfree(scratch_values, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+            kfree(reference, sizeof(keyed_index) * count, MEMORY_TAG_ARRAY);
+        }
+    }
+    return true;
+}
+
+u8 render_key_should_order_draws(void) {
+    // Opaque draws always come before transparent ones.
+    expect_to_be_true((render_key_create(RENDER_KEY_LAYER_OPAQUE, 4095, 0xFFFFF, true, 1e30f) < render_key_create(RENDER_KEY_LAYER_TRANSPARENT, 0, 0, false, 0.0f)));
+
+    // Opaque draws are grouped by shader, then material, then drawn front to back.
+    expect_to_be_true((render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 900, false, 1000.0f) < render_key_create(RENDER_KEY_LAYER_OPAQUE, 2, 1, false, 0.1f)));
+    expect_to_be_true((render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 5, true, 1000.0f) < render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 6, false, 0.1f)));
+    expect_to_be_true((render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 5, false, 2.0f) < render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 5, false, 3.0f)));
+    expect_to_be_true((render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 5, false, 0.25f) < render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 5, false, 100.0f)));
+
+    // Transparent draws are drawn back to front, regardless of shader and material.
+    expect_to_be_true((render_key_create(RENDER_KEY_LAYER_TRANSPARENT, 9, 9, false, 50.0f) < render_key_create(RENDER_KEY_LAYER_TRANSPARENT, 1, 1, false, 10.0f)));
+    expect_to_be_true((render_key_create(RENDER_KEY_LAYER_TRANSPARENT, 1, 1, false, 10.5f) < render_key_create(RENDER_KEY_LAYER_TRANSPARENT, 1, 1, false, 10.0f)));
+
+    // Negative distances are treated as 0.
+    expect_should_be(render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 1, false, 0.0f), render_key_create(RENDER_KEY_LAYER_OPAQUE, 1, 1, false, -5.0f));
+    return true;
+}
+
+u8 render_queue_should_grow_and_sort_indices(void) {
+    linear_allocator_create(1024 * 1024, 0, &test_frame_memory);
+
+    render_queue queue;
+    render_queue_create(&test_frame_allocator, 4, &queue);
+    u32 seed = 0xABCDEF;
+    u32 count = 1000;
+    keyed_index reference[1000];
+    for (u32 i = 0; i < count; ++i) {
+        // Few distinct keys, so stability matters.
+        u64 key = render_key_create(xorshift(&seed) & 1, xorshift(&seed) & 3, xorshift(&seed) & 7, false, (f32)(xorshift(&seed) & 3));
+        render_queue_push(&queue, key, i);
+        reference[i] = (keyed_index){key, i};
+    }
+    expect_should_be(count, queue.count);
+    expect_to_be_true((queue.capacity >= count));
+
+    render_queue_sort(&queue);
+    reference_sort(reference, count);
+
+    u32 mismatches = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (queue.keys[i] != reference[i].key || queue.indices[i] != reference[i].index) {
+            mismatches++;
+        }
+    }
+    expect_should_be(0, mismatches);
+
+    test_frame_allocator.free_all();
+    linear_allocator_destroy(&test_frame_memory);
+    return true;
+}
+
+// Render data along with its key, sorted in place by kquick_sort as the baseline.
+typedef struct keyed_render_data {
+    geometry_render_data data;
+    u64 key;
+} keyed_render_data;
+
+// kquick_sort places entries comparing greater first, so this is reversed for ascending keys.
+static i32 keyed_render_data_compare(void* a, void* b) {
+    u64 a_key = ((keyed_render_data*)a)->key;
+    u64 b_key = ((keyed_render_data*)b)->key;
+    return a_key < b_key ? 1 : (a_key > b_key ? -1 : 0);
+}
+
+static u64 random_draw_key(u32* seed) {
+    // A scene-like mix: a handful of shaders, a few hundred materials, a tenth transparent.
+    render_key_layer layer = (xorshift(seed) % 10) == 0 ? RENDER_KEY_LAYER_TRANSPARENT : RENDER_KEY_LAYER_OPAQUE;
+    u32 shader_id = xorshift(seed) % 8;
+    u32 material_id = xorshift(seed) % 300;
+    f32 depth = (f32)(xorshift(seed) & 0xFFFFF) / 1024.0f;
+    return render_key_create(layer, shader_id, material_id, false, depth);
+}
+
+u8 render_queue_benchmark(void) {
+    linear_allocator_create(TEST_FRAME_MEMORY_SIZE, 0, &test_frame_memory);
+
+    u32 counts[] = {1000, 10000, 100000, 1000000};
+    for (u32 c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        u32 count = counts[c];
+        u32 runs = KMAX(1, 100000 / count);
+        u32 seed = 0x5EED + c;
+
+        // The draws as the scene produces them, in visibility order.
+        keyed_render_data* draws = kallocate(sizeof(keyed_render_data) * count, MEMORY_TAG_ARRAY);
+        keyed_render_data* baseline = kallocate(sizeof(keyed_render_data) * count, MEMORY_TAG_ARRAY);
+        for (u32 i = 0; i < count; ++i) {
+            kzero_memory(&draws[i].data, sizeof(geometry_render_data));
+            draws[i].data.unique_id = i;
+            draws[i].key = random_draw_key(&seed);
+        }
+
+        // Baseline: sort the render data itself by key.
+        f64 quick_time = 0;
+        for (u32 r = 0; r < runs; ++r) {
+            kcopy_memory(baseline, draws, sizeof(keyed_render_data) * count);
+            f64 start = platform_get_absolute_time();
+            kquick_sort(sizeof(keyed_render_data), baseline, 0, count - 1, keyed_render_data_compare);
+            quick_time += platform_get_absolute_time() - start;
+        }
+
+        // Queue the keys and indices, radix sort them, then copy the render data out once in order.
+        geometry_render_data* sorted = 0;
+        f64 radix_time = 0;
+        for (u32 r = 0; r < runs; ++r) {
+            test_frame_allocator.free_all();
+            f64 start = platform_get_absolute_time();
+            render_queue queue;
+            render_queue_create(&test_frame_allocator, count, &queue);
+            for (u32 i = 0; i < count; ++i) {
+                render_queue_push(&queue, draws[i].key, i);
+            }
+            render_queue_sort(&queue);
+            sorted = test_frame_allocator.allocate(sizeof(geometry_render_data) * count);
+            for (u32 i = 0; i < count; ++i) {
+                sorted[i] = draws[queue.indices[i]].data;
+            }
+            radix_time += platform_get_absolute_time() - start;
+        }
+
+        // Both produce the same key order. Equal keys may differ, as kquick_sort is not stable.
+        u32 mismatches = 0;
+        for (u32 i = 0; i < count; ++i) {
+            if (draws[sorted[i].unique_id].key != baseline[i].key) {
+                mismatches++;
+            }
+        }
+        expect_should_be(0, mismatches);
+
+        quick_time = quick_time * 1000.0 / runs;
+        radix_time = radix_time * 1000.0 / runs;
+        DINFO("Render queue benchmark (%u draws): kquick_sort of render data %.3f ms, radix sort of keys and indices with gather %.3f ms (%.1fx).",
+              count, quick_time, radix_time, quick_time / radix_time);
+
+        kfree(draws, sizeof(keyed_render_data) * count, MEMORY_TAG_ARRAY);
+        kfree(baseline, sizeof(keyed_render_data) * count, MEMORY_TAG_ARRAY);
+    }
+
+    test_frame_allocator.free_all();
+    linear_allocator_destroy(&test_frame_memory);
+    return true;
+}
+
+void render_queue_register_tests(void) {
+    test_manager_register_test(kradix_sort_should_match_stable_reference, "Radix sort should match a stable reference sort.");
+    test_manager_register_test(render_key_should_order_draws, "Render keys should order draws by layer, state and depth.");
+    test_manager_register_test(render_queue_should_grow_and_sort_indices, "Render queue should grow and sort indices stably.");
+    test_manager_register_test(render_queue_benchmark, "Render queue benchmark, radix vs kquick_sort at 1K-1M draws.");
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+void render_queue_register_tests(void);
@@ -0,0 +1,310 @@
+#include "ksm_file_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <defines.h>
+#include <math/geometry_utils.h>
+#include <math/kmath.h>
+#include <platform/filesystem.h>
+#include <platform/platform.h>
+#include <resources/loaders/ksm_file.h>
+#include <systems/geometry_system.h>
+
+#include <stdio.h>   // remove
+#include <string.h>  // memcmp
+
+#if defined(PLATFORM_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define TEST_KSM_PATH "ksm_file_test.ksm"
+
+// Creates geometries with random vertices and indices, all owned by the configs.
+static geometry_config* create_geometries(u32 count, u32 max_vertex_count, u32 seed) {
+    geometry_config* geometries = kallocate(sizeof(geometry_config) * count, MEMORY_TAG_ARRAY);
+    for (u32 i = 0; i < count; ++i) {
+        geometry_config* g = &geometries[i];
+        // Odd counts, so the arrays in the file need padding to stay aligned.
+        g->vertex_size = sizeof(vertex_3d);
+        g->vertex_count = (3 + xorshift(&seed) % max_vertex_count) | 1;
+        g->vertices = kallocate(sizeof(vertex_3d) * g->vertex_count, MEMORY_TAG_ARRAY);
+        vertex_3d* vertices = g->vertices;
+        for (u32 v = 0; v < g->vertex_count; ++v) {
+            vertices[v].position = (vec3){(f32)(xorshift(&seed) & 0xFFFF), (f32)v, (f32)i};
+            vertices[v].texcoord = (vec2){(f32)(xorshift(&seed) & 0xFF) / 255.0f, 0.5f};
+        }
+        g->index_size = sizeof(u32);
+        g->index_count = g->vertex_count * 3;
+        g->indices = kallocate(sizeof(u32) * g->index_count, MEMORY_TAG_ARRAY);
+        u32* indices = g->indices;
+        for (u32 x = 0; x < g->index_count; ++x) {
+            indices[x] = xorshift(&seed) % g->vertex_count;
+        }
+        // Every other geometry has a second level of detail, stored after the full detail.
+        if (i % 2) {
+            u32 full_count = (g->index_count / 9) * 6;
+            g->lod_count = 2;
+            g->lods[0] = (geometry_lod){0, full_count, 0.0f};
+            g->lods[1] = (geometry_lod){full_count, g->index_count - full_count, 0.25f * i};
+        }
+        g->center = (vec3){(f32)i, 1, 2};
+        g->min_extents = (vec3){-1, -2, -3};
+        g->max_extents = (vec3){1, 2, (f32)i};
+        string_format(g->name, "geometry_%u", i);
+        string_format(g->material_name, "material_%u", i % 7);
+    }
+    return geometries;
+}
+
+static void destroy_geometries(geometry_config* geometries, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        geometry_system_config_dispose(&geometries[i]);
+    }
+    kfree(geometries, sizeof(geometry_config) * count, MEMORY_TAG_ARRAY);
+}
+
+// Counts the geometries of a loaded file which differ from the originals. Versions before 5 keep
+// only the full detail of each geometry.
+static u32 count_mismatches(const ksm_file* file, const geometry_config* expected, u32 count) {
+    u32 mismatches = 0;
+    for (u32 i = 0; i < count; ++i) {
+        const geometry_config* a = &file->geometries[i];
+        const geometry_config* b = &expected[i];
+        b8 has_lods = file->version >= 0x0005U && b->lod_count > 0;
+        u32 index_count = (b->lod_count > 0 && !has_lods) ? b->lods[0].index_count : b->index_count;
+        if (a->lod_count != (has_lods ? b->lod_count : 0) || memcmp(a->lods, b->lods, sizeof(geometry_lod) * a->lod_count) != 0) {
+            mismatches++;
+            continue;
+        }
+        if (a->vertex_size != b->vertex_size || a->vertex_count != b->vertex_count || a->index_size != b->index_size || a->index_count != index_count ||
+            memcmp(a->vertices, b->vertices, (u64)b->vertex_size * b->vertex_count) != 0 ||
+            memcmp(a->indices, b->indices, (u64)b->index_size * index_count) != 0 ||
+            !strings_equal(a->name, b->name) || !strings_equal(a->material_name, b->material_name) ||
+            !vec3_compare(a->center, b->center, 0) || !vec3_compare(a->min_extents, b->min_extents, 0) || !vec3_compare(a->max_extents, b->max_extents, 0)) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+u8 ksm_file_should_round_trip_all_versions(void) {
+    const u32 count = 9;
+    geometry_config* geometries = create_geometries(count, 300, 0x12345);
+
+    // The vertex cache statistics over the full detail of all geometries, weighted by their triangles and vertices used.
+    f32 misses = 0;
+    f32 triangles = 0;
+    f32 used_vertices = 0;
+    for (u32 i = 0; i < count; ++i) {
+        f32 acmr = 0;
+        f32 atvr = 0;
+        u32 index_count = geometries[i].lod_count ? geometries[i].lods[0].index_count : geometries[i].index_count;
+        geometry_analyze_vertex_cache(geometries[i].vertex_count, index_count, geometries[i].indices, GEOMETRY_VERTEX_CACHE_SIZE, &acmr, &atvr);
+        misses += acmr * (index_count / 3);
+        triangles += index_count / 3;
+        used_vertices += acmr * (index_count / 3) / atvr;
+    }
+
+    u16 versions[4] = {0x0002U, 0x0003U, 0x0004U, KSM_VERSION_CURRENT};
+    for (u32 v = 0; v < 4; ++v) {
+        expect_to_be_true(ksm_file_write(TEST_KSM_PATH, "test_mesh", count, geometries, versions[v]));
+
+        ksm_file file;
+        expect_to_be_true(ksm_file_load(TEST_KSM_PATH, &file));
+        expect_should_be(versions[v], file.version);
+        expect_should_be(count, darray_length(file.geometries));
+        expect_should_be(0, count_mismatches(&file, geometries, count));
+
+        if (file.version >= 0x0004U) {
+            expect_float_to_be(misses / triangles, file.acmr);
+            expect_float_to_be(misses / used_vertices, file.atvr);
+        } else {
+            expect_float_to_be(0.0f, file.acmr);
+        }
+
+        if (file.version >= 0x0003U) {
+            // The data is used in place, straight from the aligned arrays in the mapping.
+            const u8* start = file.mapping.data;
+            const u8* end = start + file.mapping.size;
+            for (u32 i = 0; i < count; ++i) {
+                const u8* vertices = file.geometries[i].vertices;
+                const u8* indices = file.geometries[i].indices;
+                expect_to_be_true((vertices >= start && vertices < end && indices >= start && indices < end));
+                expect_should_be(0, (u64)vertices % KSM_BLOB_ALIGNMENT);
+                expect_should_be(0, (u64)indices % KSM_BLOB_ALIGNMENT);
+            }
+        }
+        ksm_file_unload(&file);
+        expect_to_be_true((file.geometries == 0 && file.mapping.data == 0));
+    }
+
+    remove(TEST_KSM_PATH);
+    destroy_geometries(geometries, count);
+    return true;
+}
+
+u8 ksm_file_should_reject_truncated_files(void) {
+    const u32 count = 4;
+    geometry_config* geometries = create_geometries(count, 100, 0xBEEF);
+    expect_to_be_true(ksm_file_write(TEST_KSM_PATH, "test_mesh", count, geometries, KSM_VERSION_CURRENT));
+
+    // Rewrite the file without its last bytes.
+    file_mapping mapping;
+    expect_to_be_true(filesystem_map(TEST_KSM_PATH, &mapping));
+    u64 truncated_size = mapping.size - 5;
+    u8* truncated = kallocate(truncated_size, MEMORY_TAG_ARRAY);
+    kcopy_memory(truncated, mapping.data, truncated_size);
+    filesystem_unmap(&mapping);
+
+    file_handle f;
+    u64 written = 0;
+    expect_to_be_true(filesystem_open(TEST_KSM_PATH, FILE_MODE_WRITE, true, &f));
+    expect_to_be_true(filesystem_write(&f, truncated_size, truncated, &written));
+    filesystem_close(&f);
+    kfree(truncated, truncated_size, MEMORY_TAG_ARRAY);
+
+    ksm_file file;
+    expect_to_be_true(!ksm_file_load(TEST_KSM_PATH, &file));
+    expect_to_be_true((file.geometries == 0 && file.mapping.data == 0));
+
+    remove(TEST_KSM_PATH);
+    destroy_geometries(geometries, count);
+    return true;
+}
+
+u8 ksm_file_should_upgrade_mapped_file_in_place(void) {
+    const u32 count = 6;
+    geometry_config* geometries = create_geometries(count, 200, 0xC0FFEE);
+    // Version 3 only holds the full detail, so that is all the upgrade can carry over.
+    for (u32 i = 0; i < count; ++i) {
+        geometries[i].lod_count = 0;
+    }
+    expect_to_be_true(ksm_file_write(TEST_KSM_PATH, "test_mesh", count, geometries, 0x0003U));
+
+    // The geometries of a version 3 file point into the mapping of the file being replaced.
+    ksm_file file;
+    expect_to_be_true(ksm_file_load(TEST_KSM_PATH, &file));
+    expect_should_be(0x0003U, file.version);
+    expect_to_be_true(file.mapping.is_mapped);
+
+    expect_to_be_true(ksm_file_upgrade(TEST_KSM_PATH, "test_mesh", &file));
+    expect_should_be(KSM_VERSION_CURRENT, file.version);
+    expect_should_be(count, darray_length(file.geometries));
+    expect_should_be(0, count_mismatches(&file, geometries, count));
+    expect_to_be_false(filesystem_exists(TEST_KSM_PATH ".tmp"));
+    ksm_file_unload(&file);
+
+    // The upgrade is on disk, so the next load needs none.
+    expect_to_be_true(ksm_file_load(TEST_KSM_PATH, &file));
+    expect_should_be(KSM_VERSION_CURRENT, file.version);
+    expect_should_be(0, count_mismatches(&file, geometries, count));
+    ksm_file_unload(&file);
+
+    remove(TEST_KSM_PATH);
+    destroy_geometries(geometries, count);
+    return true;
+}
+
+// Asks the OS to drop a file from its page cache, so the next load reads it from disk.
+static b8 evict_from_page_cache(const char* path) {
+#if defined(PLATFORM_LINUX)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    fdatasync(fd);
+    b8 result = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return result;
+#else
+    return false;
+#endif
+}
+
+// Loads the file and copies all of its data out, as creating the geometries does. Returns the time taken.
+static f64 timed_load(const char* path, u8* destination, b8 cold) {
+    if (cold) {
+        evict_from_page_cache(path);
+    }
+    f64 start = platform_get_absolute_time();
+    ksm_file file;
+    if (!ksm_file_load(path, &file)) {
+        return 0;
+    }
+    u64 offset = 0;
+    u32 count = darray_length(file.geometries);
+    for (u32 i = 0; i < count; ++i) {
+        const geometry_config* g = &file.geometries[i];
+        u64 vertices_size = (u64)g->vertex_size * g->vertex_count;
+        u64 indices_size = (u64)g->index_size * g->index_count;
+        kcopy_memory(destination + offset, g->vertices, vertices_size);
+        offset += vertices_size;
+        kcopy_memory(destination + offset, g->indices, indices_size);
+        offset += indices_size;
+    }
+    ksm_file_unload(&file);
+    return platform_get_absolute_time() - start;
+}
+
+u8 ksm_file_benchmark(void) {
+    // The Sponza model is not kept in the repository, so geometries of about its size are
+    // generated instead: a few hundred geometries, roughly 300K vertices and 900K indices.
+    const u32 count = 380;
+    geometry_config* geometries = create_geometries(count, 1600, 0x5B0A2A);
+    u64 data_size = 0;
+    for (u32 i = 0; i < count; ++i) {
+        data_size += (u64)geometries[i].vertex_size * geometries[i].vertex_count + (u64)geometries[i].index_size * geometries[i].index_count;
+    }
+    u8* destination = kallocate(data_size, MEMORY_TAG_ARRAY);
+
+    const char* paths[2] = {"ksm_file_bench_v2.ksm", "ksm_file_bench_mapped.ksm"};
+    u16 versions[2] = {0x0002U, KSM_VERSION_CURRENT};
+    for (u32 v = 0; v < 2; ++v) {
+        expect_to_be_true(ksm_file_write(paths[v], "bench_mesh", count, geometries, versions[v]));
+    }
+    b8 can_evict = evict_from_page_cache(paths[0]);
+
+    const u32 runs = 10;
+    f64 warm[2] = {0};
+    f64 cold[2] = {0};
+    for (u32 r = 0; r < runs; ++r) {
+        for (u32 v = 0; v < 2; ++v) {
+            warm[v] += timed_load(paths[v], destination, false);
+            if (can_evict) {
+                cold[v] += timed_load(paths[v], destination, true);
+            }
+        }
+    }
+
+    for (u32 v = 0; v < 2; ++v) {
+        warm[v] = warm[v] * 1000.0 / runs;
+        cold[v] = cold[v] * 1000.0 / runs;
+    }
+    DINFO("KSM load benchmark (%u geometries, %.1f MiB): warm cache v2 %.3f ms, mapped %.3f ms (%.1fx).",
+          count, (f64)data_size / (1024.0 * 1024.0), warm[0], warm[1], warm[0] / warm[1]);
+    if (can_evict) {
+        DINFO("KSM load benchmark: cold cache v2 %.3f ms, mapped %.3f ms (%.1fx).", cold[0], cold[1], cold[0] / cold[1]);
+    } else {
+        DINFO("KSM load benchmark: cold cache not measured, as files cannot be evicted from the page cache on this platform.");
+    }
+
+    for (u32 v = 0; v < 2; ++v) {
+        remove(paths[v]);
+    }
+    kfree(destination, data_size, MEMORY_TAG_ARRAY);
+    destroy_geometries(geometries, count);
+    return true;
+}
+
+void ksm_file_register_tests(void) {
+    test_manager_register_test(ksm_file_should_round_trip_all_versions, "KSM files should round trip in versions 2 to 5.");
+    test_manager_register_test(ksm_file_should_reject_truncated_files, "KSM files should be rejected when truncated.");
+    test_manager_register_test(ksm_file_should_upgrade_mapped_file_in_place, "KSM files should upgrade in place while mapped.");
+    test_manager_register_test(ksm_file_benchmark, "KSM load benchmark, v2 vs mapped on warm and cold cache.");
+}
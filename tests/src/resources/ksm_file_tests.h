@@ -0,0 +1,3 @@
+#pragma once
+
+void ksm_file_register_tests(void);
@@ -0,0 +1,394 @@
+#include "obj_file_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <defines.h>
+#include <math/geometry_utils.h>
+#include <math/kmath.h>
+#include <platform/filesystem.h>
+#include <platform/platform.h>
+#include <resources/loaders/ksm_file.h>
+#include <resources/loaders/obj_file.h>
+#include <systems/geometry_system.h>
+#include <systems/job_system.h>
+
+#include <stdio.h>   // remove, snprintf, sscanf
+#include <string.h>  // memcmp
+
+#define TEST_OBJ_PATH "obj_file_test.obj"
+#define TEST_KSM_PATH "obj_file_test.ksm"
+#define TEST_LEGACY_KSM_PATH "obj_file_test_legacy.ksm"
+
+// Matches the general job threads of a typical machine.
+#define TEST_JOB_THREAD_COUNT 4
+
+typedef struct obj_test_jobs {
+    void* memory;
+    u64 memory_requirement;
+} obj_test_jobs;
+
+static b8 obj_test_jobs_start(obj_test_jobs* out_jobs) {
+    u32 type_masks[TEST_JOB_THREAD_COUNT];
+    for (u32 i = 0; i < TEST_JOB_THREAD_COUNT; ++i) {
+        type_masks[i] = JOB_TYPE_GENERAL;
+    }
+    job_system_config config = {0};
+    config.max_job_thread_count = TEST_JOB_THREAD_COUNT;
+    config.type_masks = type_masks;
+
+    job_system_initialize(&out_jobs->memory_requirement, 0, &config);
+    out_jobs->memory = kallocate(out_jobs->memory_requirement, MEMORY_TAG_ENGINE);
+    return job_system_initialize(&out_jobs->memory_requirement, out_jobs->memory, &config);
+}
+
+static void obj_test_jobs_stop(obj_test_jobs* jobs) {
+    job_system_shutdown(jobs->memory);
+    kfree(jobs->memory, jobs->memory_requirement, MEMORY_TAG_ENGINE);
+}
+
+// The line by line importer obj_file_import replaced, less the material library, kept as a
+// reference for its output. The tangent is zeroed where the original left it uninitialized;
+// it is overwritten by tangent generation either way.
+typedef struct legacy_face {
+    u32 position_index[3];
+    u32 texcoord_index[3];
+    u32 normal_index[3];
+} legacy_face;
+
+static void legacy_process_subobject(vec3* positions, vec3* normals, vec2* tex_coords, legacy_face* faces, geometry_config* out_data) {
+    out_data->indices = darray_create(u32);
+    out_data->vertices = darray_create(vertex_3d);
+    b8 extent_set = false;
+    kzero_memory(&out_data->min_extents, sizeof(vec3));
+    kzero_memory(&out_data->max_extents, sizeof(vec3));
+
+    u64 face_count = darray_length(faces);
+    b8 skip_normals = darray_length(normals) == 0;
+    b8 skip_tex_coords = darray_length(tex_coords) == 0;
+    for (u64 f = 0; f < face_count; ++f) {
+        for (u64 i = 0; i < 3; ++i) {
+            darray_push(out_data->indices, (u32)(i + (f * 3)));
+            vertex_3d vert = {0};
+            vec3 pos = positions[faces[f].position_index[i] - 1];
+            vert.position = pos;
+            if (pos.x < out_data->min_extents.x || !extent_set) out_data->min_extents.x = pos.x;
+            if (pos.y < out_data->min_extents.y || !extent_set) out_data->min_extents.y = pos.y;
+            if (pos.z < out_data->min_extents.z || !extent_set) out_data->min_extents.z = pos.z;
+            if (pos.x > out_data->max_extents.x || !extent_set) out_data->max_extents.x = pos.x;
+            if (pos.y > out_data->max_extents.y || !extent_set) out_data->max_extents.y = pos.y;
+            if (pos.z > out_data->max_extents.z || !extent_set) out_data->max_extents.z = pos.z;
+            extent_set = true;
+            vert.normal = skip_normals ? vec3_create(0, 0, 1) : normals[faces[f].normal_index[i] - 1];
+            vert.texcoord = skip_tex_coords ? vec2_zero() : tex_coords[faces[f].texcoord_index[i] - 1];
+            vert.colour = vec4_one();
+            darray_push(out_data->vertices, vert);
+        }
+    }
+    for (u8 i = 0; i < 3; ++i) {
+        out_data->center.elements[i] = (out_data->min_extents.elements[i] + out_data->max_extents.elements[i]) / 2.0f;
+    }
+}
+
+static void legacy_flush_groups(legacy_face** groups, char (*material_names)[64], const char* name, vec3* positions, vec3* normals, vec2* tex_coords, geometry_config** out_geometries) {
+    u64 group_count = darray_length(groups);
+    for (u64 i = 0; i < group_count; ++i) {
+        geometry_config new_data = {0};
+        string_ncopy(new_data.name, name, 255);
+        if (i > 0) {
+            string_append_int(new_data.name, new_data.name, i);
+        }
+        string_ncopy(new_data.material_name, material_names[i], 255);
+        legacy_process_subobject(positions, normals, tex_coords, groups[i], &new_data);
+        new_data.vertex_count = darray_length(new_data.vertices);
+        new_data.vertex_size = sizeof(vertex_3d);
+        new_data.index_count = darray_length(new_data.indices);
+        new_data.index_size = sizeof(u32);
+        darray_push(*out_geometries, new_data);
+        darray_destroy(groups[i]);
+        kzero_memory(material_names[i], 64);
+    }
+}
+
+static b8 legacy_import_obj(const char* obj_path, const char* ksm_path) {
+    file_handle f;
+    if (!filesystem_open(obj_path, FILE_MODE_READ, false, &f)) {
+        return false;
+    }
+    vec3* positions = darray_reserve(vec3, 16384);
+    vec3* normals = darray_reserve(vec3, 16384);
+    vec2* tex_coords = darray_reserve(vec2, 16384);
+    legacy_face** groups = darray_reserve(legacy_face*, 4);
+    geometry_config* geometries = darray_create(geometry_config);
+    char name[512] = "";
+    char material_names[32][64] = {0};
+    u32 material_name_count = 0;
+    char line_buf[512] = "";
+    char* p = &line_buf[0];
+    u64 line_length = 0;
+    char t[8];
+    while (filesystem_read_line(&f, 511, &p, &line_length)) {
+        if (line_length < 1) {
+            continue;
+        }
+        switch (line_buf[0]) {
+            case 'v': {
+                if (line_buf[1] == ' ') {
+                    vec3 pos;
+                    sscanf(line_buf, "%s %f %f %f", t, &pos.x, &pos.y, &pos.z);
+                    darray_push(positions, pos);
+                } else if (line_buf[1] == 'n') {
+                    vec3 norm;
+                    sscanf(line_buf, "%s %f %f %f", t, &norm.x, &norm.y, &norm.z);
+                    darray_push(normals, norm);
+                } else if (line_buf[1] == 't') {
+                    vec2 tex_coord;
+                    sscanf(line_buf, "%s %f %f", t, &tex_coord.x, &tex_coord.y);
+                    darray_push(tex_coords, tex_coord);
+                }
+            } break;
+            case 'f': {
+                legacy_face face;
+                if (darray_length(normals) == 0 || darray_length(tex_coords) == 0) {
+                    sscanf(line_buf, "%s %d %d %d", t, &face.position_index[0], &face.position_index[1], &face.position_index[2]);
+                } else {
+                    sscanf(line_buf, "%s %d/%d/%d %d/%d/%d %d/%d/%d", t,
+                           &face.position_index[0], &face.texcoord_index[0], &face.normal_index[0],
+                           &face.position_index[1], &face.texcoord_index[1], &face.normal_index[1],
+                           &face.position_index[2], &face.texcoord_index[2], &face.normal_index[2]);
+                }
+                darray_push(groups[darray_length(groups) - 1], face);
+            } break;
+            case 'u': {
+                legacy_face* new_group = darray_reserve(legacy_face, 16384);
+                darray_push(groups, new_group);
+                sscanf(line_buf, "%s %s", t, material_names[material_name_count]);
+                material_name_count++;
+            } break;
+            case 'g': {
+                legacy_flush_groups(groups, material_names, name, positions, normals, tex_coords, &geometries);
+                material_name_count = 0;
+                darray_clear(groups);
+                kzero_memory(name, 512);
+                sscanf(line_buf, "%s %s", t, name);
+            } break;
+        }
+    }
+    legacy_flush_groups(groups, material_names, name, positions, normals, tex_coords, &geometries);
+    filesystem_close(&f);
+    darray_destroy(groups);
+    darray_destroy(positions);
+    darray_destroy(normals);
+    darray_destroy(tex_coords);
+
+    u32 count = darray_length(geometries);
+    for (u32 i = 0; i < count; ++i) {
+        geometry_config* g = &geometries[i];
+        u32 new_vert_count = 0;
+        vertex_3d* unique_verts = 0;
+        geometry_deduplicate_vertices(g->vertex_count, g->vertices, g->index_count, g->indices, &new_vert_count, &unique_verts);
+        darray_destroy(g->vertices);
+        g->vertices = unique_verts;
+        g->vertex_count = new_vert_count;
+        u32* indices = kallocate(sizeof(u32) * g->index_count, MEMORY_TAG_ARRAY);
+        kcopy_memory(indices, g->indices, sizeof(u32) * g->index_count);
+        darray_destroy(g->indices);
+        g->indices = indices;
+        geometry_generate_tangents(g->vertex_count, g->vertices, g->index_count, g->indices);
+    }
+
+    b8 result = ksm_file_write(ksm_path, name, count, geometries, KSM_VERSION_CURRENT);
+    for (u32 i = 0; i < count; ++i) {
+        geometry_system_config_dispose(&geometries[i]);
+    }
+    darray_destroy(geometries);
+    return result;
+}
+
+static b8 write_text_file(const char* path, const char* text, u64 length) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, true, &f)) {
+        return false;
+    }
+    u64 written = 0;
+    b8 result = filesystem_write(&f, length, text, &written);
+    filesystem_close(&f);
+    return result;
+}
+
+static b8 files_equal(const char* path_0, const char* path_1) {
+    file_mapping a;
+    file_mapping b;
+    if (!filesystem_map(path_0, &a)) {
+        return false;
+    }
+    if (!filesystem_map(path_1, &b)) {
+        filesystem_unmap(&a);
+        return false;
+    }
+    b8 result = a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+    filesystem_unmap(&a);
+    filesystem_unmap(&b);
+    return result;
+}
+
+static b8 import_and_write(const char* obj_path, const char* ksm_path) {
+    obj_file file;
+    if (!obj_file_import(obj_path, 0, &file)) {
+        return false;
+    }
+    b8 result = ksm_file_write(ksm_path, file.name, darray_length(file.geometries), file.geometries, KSM_VERSION_CURRENT);
+    obj_file_destroy(&file);
+    return result;
+}
+
+// Appends formatted text to a buffer known to be large enough.
+#define APPEND(buffer, length, ...) length += (u64)snprintf((buffer) + (length), 256, __VA_ARGS__)
+
+// Writes a grid of size x size quads, split into group_count groups with two materials each.
+// Returns the size of the file.
+static u64 write_grid_obj(const char* path, u32 size, u32 group_count) {
+    u32 corner_count = (size + 1) * (size + 1);
+    u64 capacity = (u64)corner_count * 3 * 48 + (u64)size * size * 2 * 64 + group_count * 256 + 256;
+    char* text = kallocate(capacity, MEMORY_TAG_STRING);
+    u64 length = 0;
+    APPEND(text, length, "# Generated grid\nmtllib grid.mtl\n");
+    for (u32 z = 0; z <= size; ++z) {
+        for (u32 x = 0; x <= size; ++x) {
+            APPEND(text, length, "v %f %f %f\n", x * 0.37f, (f32)((x * 7 + z * 13) % 17) * 0.01f, z * 0.37f);
+        }
+    }
+    for (u32 z = 0; z <= size; ++z) {
+        for (u32 x = 0; x <= size; ++x) {
+            APPEND(text, length, "vt %f %f\n", (f32)x / size, (f32)z / size);
+        }
+    }
+    for (u32 z = 0; z <= size; ++z) {
+        for (u32 x = 0; x <= size; ++x) {
+            APPEND(text, length, "vn %f %f %f\n", (f32)(x % 3) * 0.1f, 0.99f, (f32)(z % 5) * 0.05f);
+        }
+    }
+    u32 rows_per_group = (size + group_count - 1) / group_count;
+    for (u32 z = 0; z < size; ++z) {
+        if (z % rows_per_group == 0) {
+            APPEND(text, length, "g part_%u\r\n", z / rows_per_group);
+        }
+        if (z % rows_per_group == 0 || z % rows_per_group == rows_per_group / 2) {
+            APPEND(text, length, "usemtl material_%u\n", z % rows_per_group == 0 ? 0 : 1);
+        }
+        for (u32 x = 0; x < size; ++x) {
+            u32 i0 = z * (size + 1) + x + 1;
+            u32 i1 = i0 + size + 1;
+            APPEND(text, length, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i0, i0, i0, i1, i1, i1, i0 + 1, i0 + 1, i0 + 1);
+            APPEND(text, length, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i0 + 1, i0 + 1, i0 + 1, i1, i1, i1, i1 + 1, i1 + 1, i1 + 1);
+        }
+    }
+    write_text_file(path, text, length);
+    kfree(text, capacity, MEMORY_TAG_STRING);
+    return length;
+}
+
+u8 obj_file_should_match_legacy_import(void) {
+    // Two objects, several materials each, a Windows line ending and no newline at the end.
+    const char* text =
+        "# Test\n"
+        "mtllib test.mtl\n"
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0.5 0.25 -2.5e-1\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1 0\n"
+        "vn 0 0 1\nvn 0 0 -1\n"
+        "g first\r\n"
+        "usemtl red\n"
+        "f 1/1/1 2/2/1 3/3/1\nf 1/1/1 3/3/1 4/4/1\n"
+        "usemtl green\n"
+        "f 1/1/2 5/2/2 2/3/2\n"
+        "g second\n"
+        "usemtl blue\n"
+        "s off\n"
+        "f 4/4/1 3/3/1 5/1/1\n"
+        "usemtl red\n"
+        "f 5/1/2 3/3/2 1/1/2";
+    expect_to_be_true(write_text_file(TEST_OBJ_PATH, text, string_length(text)));
+
+    obj_test_jobs jobs;
+    expect_to_be_true(obj_test_jobs_start(&jobs));
+
+    obj_file file;
+    expect_to_be_true(obj_file_import(TEST_OBJ_PATH, 0, &file));
+    expect_should_be(4, darray_length(file.geometries));
+    expect_to_be_true(strings_equal("second", file.name));
+    expect_to_be_true(strings_equal("test.mtl", file.material_file_name));
+    const char* names[4] = {"first", "first1", "second", "second1"};
+    const char* materials[4] = {"red", "green", "blue", "red"};
+    u32 index_counts[4] = {6, 3, 3, 3};
+    for (u32 i = 0; i < 4; ++i) {
+        expect_to_be_true(strings_equal(names[i], file.geometries[i].name));
+        expect_to_be_true(strings_equal(materials[i], file.geometries[i].material_name));
+        expect_should_be(index_counts[i], file.geometries[i].index_count);
+    }
+    // The quad shares two of its corners.
+    expect_should_be(4, file.geometries[0].vertex_count);
+    expect_float_to_be(-0.25f, file.geometries[1].min_extents.z);
+    obj_file_destroy(&file);
+
+    expect_to_be_true(import_and_write(TEST_OBJ_PATH, TEST_KSM_PATH));
+    expect_to_be_true(legacy_import_obj(TEST_OBJ_PATH, TEST_LEGACY_KSM_PATH));
+    expect_to_be_true(files_equal(TEST_KSM_PATH, TEST_LEGACY_KSM_PATH));
+
+    obj_test_jobs_stop(&jobs);
+    remove(TEST_OBJ_PATH);
+    remove(TEST_KSM_PATH);
+    remove(TEST_LEGACY_KSM_PATH);
+    return true;
+}
+
+u8 obj_file_should_reject_bad_indices(void) {
+    const char* text = "v 0 0 0\nv 1 0 0\nv 1 1 0\nusemtl red\nf 1 2 3\nf 1 2 4\n";
+    expect_to_be_true(write_text_file(TEST_OBJ_PATH, text, string_length(text)));
+
+    obj_file file;
+    expect_to_be_true(!obj_file_import(TEST_OBJ_PATH, 0, &file));
+    expect_to_be_true((file.geometries == 0));
+
+    remove(TEST_OBJ_PATH);
+    return true;
+}
+
+u8 obj_file_benchmark(void) {
+    obj_test_jobs jobs;
+    expect_to_be_true(obj_test_jobs_start(&jobs));
+
+    // Grids of about 100K and 1M triangles.
+    u32 sizes[2] = {224, 708};
+    for (u32 s = 0; s < 2; ++s) {
+        u64 file_size = write_grid_obj(TEST_OBJ_PATH, sizes[s], 8);
+
+        f64 start = platform_get_absolute_time();
+        expect_to_be_true(legacy_import_obj(TEST_OBJ_PATH, TEST_LEGACY_KSM_PATH));
+        f64 legacy_time = platform_get_absolute_time() - start;
+
+        start = platform_get_absolute_time();
+        expect_to_be_true(import_and_write(TEST_OBJ_PATH, TEST_KSM_PATH));
+        f64 import_time = platform_get_absolute_time() - start;
+
+        b8 identical = files_equal(TEST_KSM_PATH, TEST_LEGACY_KSM_PATH);
+        expect_to_be_true(identical);
+        DINFO("OBJ import benchmark (%u triangles, %.1f MiB, %u job threads): line by line %.1f ms, chunked %.1f ms (%.1fx), KSM output %s.",
+              sizes[s] * sizes[s] * 2, (f64)file_size / (1024.0 * 1024.0), TEST_JOB_THREAD_COUNT, legacy_time * 1000.0, import_time * 1000.0,
+              legacy_time / import_time, identical ? "identical" : "different");
+    }
+
+    obj_test_jobs_stop(&jobs);
+    remove(TEST_OBJ_PATH);
+    remove(TEST_KSM_PATH);
+    remove(TEST_LEGACY_KSM_PATH);
+    return true;
+}
+
+void obj_file_register_tests(void) {
+    test_manager_register_test(obj_file_should_match_legacy_import, "OBJ import should match the line by line importer.");
+    test_manager_register_test(obj_file_should_reject_bad_indices, "OBJ import should reject faces with bad indices.");
+    test_manager_register_test(obj_file_benchmark, "OBJ import benchmark, 100K and 1M triangles.");
+}
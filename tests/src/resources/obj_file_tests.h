@@ -0,0 +1,3 @@
+#pragma once
+
+void obj_file_register_tests(void);
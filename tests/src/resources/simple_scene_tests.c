@@ -0,0 +1,97 @@
+#include "simple_scene_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../test_utils.h"
+
+#include <containers/darray.h>
+#include <core/frame_data.h>
+#include <core/kmemory.h>
+#include <defines.h>
+#include <math/culling.h>
+#include <math/kmath.h>
+#include <memory/linear_allocator.h>
+#include <renderer/renderer_types.h>
+#include <resources/resource_types.h>
+#include <resources/simple_scene.h>
+
+// A scene holding a single draw of a geometry with three levels of detail, far from the origin.
+typedef struct lod_test_scene {
+    simple_scene scene;
+    mesh m;
+    geometry g;
+    geometry* geometries[1];
+    simple_scene_geometry_ref refs[1];
+    geometry_render_data draws[1];
+    simple_scene_draw_flags draw_flags[1];
+} lod_test_scene;
+
+static void lod_test_scene_create(lod_test_scene* t) {
+    kzero_memory(t, sizeof(lod_test_scene));
+
+    t->g.index_count = 96;
+    t->g.index_element_size = sizeof(u32);
+    t->g.index_buffer_offset = 1024;
+    t->g.lod_count = 3;
+    t->g.lods[0] = (geometry_lod){0, 48, 0.0f};
+    t->g.lods[1] = (geometry_lod){48, 30, 0.5f};
+    t->g.lods[2] = (geometry_lod){78, 18, 1.0f};
+    t->geometries[0] = &t->g;
+    t->m.geometry_count = 1;
+    t->m.geometries = t->geometries;
+
+    // The cached draw holds the full detail.
+    t->draws[0].model = mat4_identity();
+    t->draws[0].index_count = t->g.lods[0].index_count;
+    t->draws[0].index_buffer_offset = t->g.index_buffer_offset;
+
+    t->scene.meshes = &t->m;
+    t->scene.geometry_refs = t->refs;
+    t->scene.draws = t->draws;
+    t->scene.draw_flags = t->draw_flags;
+    bounds_soa_create(8, &t->scene.geometry_bounds);
+    bounds_soa_push(&t->scene.geometry_bounds, (vec3){0, 0, 1000.0f}, (vec3){1, 1, 1});
+}
+
+static void lod_test_scene_destroy(lod_test_scene* t) {
+    bounds_soa_destroy(&t->scene.geometry_bounds);
+}
+
+u8 simple_scene_query_without_frustum_should_draw_full_detail(void) {
+    linear_allocator_create(1024 * 1024, 0, &test_frame_memory);
+    frame_data p_frame_data = {0};
+    p_frame_data.allocator = test_frame_allocator;
+
+    lod_test_scene t;
+    lod_test_scene_create(&t);
+
+    // Seen from far away, the draw switches to its coarsest level of detail.
+    u32 visible = 0;
+    simple_scene_view view = {0};
+    view.lod_scale = 100.0f;
+    view.lod_error_pixels = 1.0f;
+    view.visible = &visible;
+    view.visible_count = 1;
+    u32 count = 0;
+    geometry_render_data* out = darray_create(geometry_render_data);
+    expect_to_be_true(simple_scene_mesh_render_data_from_views(&t.scene, 1, &view, vec3_zero(), &p_frame_data, &count, &out));
+    expect_should_be(1, count);
+    expect_should_be(t.g.lods[2].index_count, out[0].index_count);
+    expect_should_be(t.g.index_buffer_offset + t.g.lods[2].index_offset * sizeof(u32), out[0].index_buffer_offset);
+
+    // Without a frustum there is no view to judge the error from, so the full detail is drawn.
+    darray_clear(out);
+    count = 0;
+    expect_to_be_true(simple_scene_mesh_render_data_query(&t.scene, 0, vec3_zero(), &p_frame_data, &count, &out));
+    expect_should_be(1, count);
+    expect_should_be(t.g.lods[0].index_count, out[0].index_count);
+    expect_should_be(t.g.index_buffer_offset, out[0].index_buffer_offset);
+
+    darray_destroy(out);
+    lod_test_scene_destroy(&t);
+    linear_allocator_destroy(&test_frame_memory);
+    return true;
+}
+
+void simple_scene_register_tests(void) {
+    test_manager_register_test(simple_scene_query_without_frustum_should_draw_full_detail, "Scene queries without a frustum should draw the full detail.");
+}
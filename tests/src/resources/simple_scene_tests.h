@@ -0,0 +1,3 @@
+#pragma once
+
+void simple_scene_register_tests(void);
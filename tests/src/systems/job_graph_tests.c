@@ -0,0 +1,149 @@
+#include "job_graph_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <core/katomic.h>
+#include <core/kmemory.h>
+#include <systems/job_graph.h>
+#include <systems/job_system.h>
+
+#define TEST_GRAPH_THREAD_COUNT 4
+#define TEST_GRAPH_TASK_COUNT 8
+
+typedef struct graph_test_state {
+    void* memory;
+    u64 memory_requirement;
+} graph_test_state;
+
+typedef struct graph_task_data {
+    // The order in which each task finished, starting at 1. 0 means it has not run.
+    volatile u32 finish_order[TEST_GRAPH_TASK_COUNT];
+    volatile u32 next_order;
+    volatile u32 run_count[TEST_GRAPH_TASK_COUNT];
+} graph_task_data;
+
+typedef struct graph_task_userdata {
+    graph_task_data* data;
+    u32 index;
+} graph_task_userdata;
+
+static b8 graph_test_start(graph_test_state* out_state) {
+    u32 type_masks[TEST_GRAPH_THREAD_COUNT];
+    for (u32 i = 0; i < TEST_GRAPH_THREAD_COUNT; ++i) {
+        type_masks[i] = JOB_TYPE_GENERAL;
+    }
+
+    job_system_config config = {0};
+    config.max_job_thread_count = TEST_GRAPH_THREAD_COUNT;
+    config.type_masks = type_masks;
+
+    job_system_initialize(&out_state->memory_requirement, 0, &config);
+    out_state->memory = kallocate(out_state->memory_requirement, MEMORY_TAG_ENGINE);
+    return job_system_initialize(&out_state->memory_requirement, out_state->memory, &config);
+}
+
+static void graph_test_stop(graph_test_state* state) {
+    job_system_shutdown(state->memory);
+    kfree(state->memory, state->memory_requirement, MEMORY_TAG_ENGINE);
+}
+
+static void graph_task_record(void* userdata) {
+    graph_task_userdata* typed = userdata;
+    katomic_fetch_add_u32(&typed->data->run_count[typed->index], 1);
+    u32 order = katomic_fetch_add_u32(&typed->data->next_order, 1) + 1;
+    katomic_store_u32(&typed->data->finish_order[typed->index], order);
+}
+
+/**
+ * Builds a graph shaped like a frame: 0 -> (1, 2, 3) -> 4 -> (5, 6) -> 7, with 3 also
+ * feeding 6 directly.
+ */
+static b8 build_frame_graph(job_graph* graph, graph_task_userdata* userdata, graph_task_data* data) {
+    if (!job_graph_create(graph)) {
+        return false;
+    }
+    for (u32 i = 0; i < TEST_GRAPH_TASK_COUNT; ++i) {
+        userdata[i].data = data;
+        userdata[i].index = i;
+        if (job_graph_task_add(graph, graph_task_record, &userdata[i]) != i) {
+            return false;
+        }
+    }
+    u32 edges[][2] = {{1, 0}, {2, 0}, {3, 0}, {4, 1}, {4, 2}, {4, 3}, {5, 4}, {6, 4}, {6, 3}, {7, 5}, {7, 6}};
+    for (u32 i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+        if (!job_graph_dependency_add(graph, edges[i][0], edges[i][1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static b8 verify_frame_graph(graph_task_data* data, u32 expected_runs) {
+    u32 edges[][2] = {{1, 0}, {2, 0}, {3, 0}, {4, 1}, {4, 2}, {4, 3}, {5, 4}, {6, 4}, {6, 3}, {7, 5}, {7, 6}};
+    for (u32 i = 0; i < TEST_GRAPH_TASK_COUNT; ++i) {
+        expect_should_be(expected_runs, data->run_count[i]);
+    }
+    for (u32 i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+        expect_to_be_true((data->finish_order[edges[i][0]] > data->finish_order[edges[i][1]]));
+    }
+    return true;
+}
+
+u8 job_graph_should_respect_dependencies(void) {
+    graph_test_state state;
+    expect_to_be_true(graph_test_start(&state));
+
+    job_graph graph;
+    graph_task_userdata userdata[TEST_GRAPH_TASK_COUNT];
+    graph_task_data data = {0};
+    expect_to_be_true(build_frame_graph(&graph, userdata, &data));
+
+    // The graph is static, so executing it repeatedly must give the same result each time.
+    for (u32 run = 1; run <= 100; ++run) {
+        kzero_memory((void*)data.finish_order, sizeof(data.finish_order));
+        data.next_order = 0;
+        job_graph_execute(&graph);
+        expect_to_be_true(verify_frame_graph(&data, run));
+    }
+
+    job_graph_destroy(&graph);
+    graph_test_stop(&state);
+    return true;
+}
+
+u8 job_graph_should_run_without_job_system(void) {
+    job_graph graph;
+    graph_task_userdata userdata[TEST_GRAPH_TASK_COUNT];
+    graph_task_data data = {0};
+    expect_to_be_true(build_frame_graph(&graph, userdata, &data));
+
+    job_graph_execute(&graph);
+    expect_to_be_true(verify_frame_graph(&data, 1));
+
+    job_graph_destroy(&graph);
+    return true;
+}
+
+u8 job_graph_should_reject_forward_dependencies(void) {
+    job_graph graph;
+    graph_task_userdata userdata[2] = {0};
+    expect_to_be_true(job_graph_create(&graph));
+    expect_should_be(0, job_graph_task_add(&graph, graph_task_record, &userdata[0]));
+    expect_should_be(1, job_graph_task_add(&graph, graph_task_record, &userdata[1]));
+
+    DDEBUG("The following errors are intentionally caused by this test.");
+    expect_to_be_false(job_graph_dependency_add(&graph, 0, 1));
+    expect_to_be_false(job_graph_dependency_add(&graph, 1, 1));
+    expect_to_be_false(job_graph_dependency_add(&graph, 2, 0));
+    expect_to_be_true(job_graph_dependency_add(&graph, 1, 0));
+
+    job_graph_destroy(&graph);
+    return true;
+}
+
+void job_graph_register_tests(void) {
+    test_manager_register_test(job_graph_should_respect_dependencies, "Job graph runs every task after its dependencies, repeatedly.");
+    test_manager_register_test(job_graph_should_run_without_job_system, "Job graph runs in order when the job system is not running.");
+    test_manager_register_test(job_graph_should_reject_forward_dependencies, "Job graph rejects dependencies that could form a cycle.");
+}
@@ -0,0 +1,600 @@
+#include "job_system_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+#include <core/clock.h>
+#include <core/katomic.h>
+#include <core/kmemory.h>
+#include <math/kmath.h>
+#include <math/transform.h>
+#include <platform/platform.h>
+#include <systems/job_system.h>
+
+// Mirrors the thread layout set up by the systems manager: one GPU thread,
+// one resource loading thread and the rest for general work.
+#define TEST_JOB_THREAD_COUNT 8
+
+typedef struct job_test_state {
+    void* memory;
+    u64 memory_requirement;
+} job_test_state;
+
+typedef struct tiny_job_params {
+    f64 submit_time;
+} tiny_job_params;
+
+static volatile u64 completed_count;
+static volatile u64 total_latency_ns;
+static volatile u64 max_latency_ns;
+static volatile u32 callback_count;
+
+static b8 job_system_test_start(job_test_state* out_state) {
+    u32 type_masks[TEST_JOB_THREAD_COUNT];
+    for (u32 i = 0; i < TEST_JOB_THREAD_COUNT; ++i) {
+        type_masks[i] = JOB_TYPE_GENERAL;
+    }
+    type_masks[0] = JOB_TYPE_GPU_RESOURCE;
+    type_masks[1] = JOB_TYPE_RESOURCE_LOAD;
+
+    job_system_config config = {0};
+    config.max_job_thread_count = TEST_JOB_THREAD_COUNT;
+    config.type_masks = type_masks;
+
+    job_system_initialize(&out_state->memory_requirement, 0, &config);
+    out_state->memory = kallocate(out_state->memory_requirement, MEMORY_TAG_ENGINE);
+    return job_system_initialize(&out_state->memory_requirement, out_state->memory, &config);
+}
+
+// Starts the job system with only general job threads.
+static b8 job_system_test_start_general(job_test_state* out_state, u8 thread_count) {
+    // The job system supports up to 32 threads.
+    u32 type_masks[32];
+    for (u32 i = 0; i < thread_count; ++i) {
+        type_masks[i] = JOB_TYPE_GENERAL;
+    }
+
+    job_system_config config = {0};
+    config.max_job_thread_count = thread_count;
+    config.type_masks = type_masks;
+
+    job_system_initialize(&out_state->memory_requirement, 0, &config);
+    out_state->memory = kallocate(out_state->memory_requirement, MEMORY_TAG_ENGINE);
+    return job_system_initialize(&out_state->memory_requirement, out_state->memory, &config);
+}
+
+static void job_system_test_stop(job_test_state* state) {
+    job_system_shutdown(state->memory);
+    kfree(state->memory, state->memory_requirement, MEMORY_TAG_ENGINE);
+}
+
+static b8 tiny_job_start(void* params, void* result_data) {
+    tiny_job_params* typed_params = params;
+    clock now;
+    clock_start(&now);
+    u64 latency = (u64)((now.start_time - typed_params->submit_time) * 1000000000.0);
+
+    katomic_fetch_add_u64(&total_latency_ns, latency);
+    u64 current_max = katomic_load_u64(&max_latency_ns);
+    while (latency > current_max && !katomic_compare_exchange_u64(&max_latency_ns, &current_max, latency)) {
+    }
+    katomic_fetch_add_u64(&completed_count, 1);
+    return true;
+}
+
+static b8 counting_job_start(void* params, void* result_data) {
+    *(u32*)result_data = *(u32*)params;
+    return true;
+}
+
+static void counting_job_complete(void* result_data) {
+    callback_count += *(u32*)result_data;
+}
+
+typedef struct fork_join_params {
+    u32 index;
+    u32* outputs;
+} fork_join_params;
+
+static b8 fork_join_job_start(void* params, void* result_data) {
+    fork_join_params* typed_params = params;
+    typed_params->outputs[typed_params->index] = typed_params->index * 2;
+    return true;
+}
+
+typedef struct nested_fork_params {
+    u32 child_count;
+    volatile u32* sum;
+} nested_fork_params;
+
+static b8 nested_child_job_start(void* params, void* result_data) {
+    katomic_fetch_add_u32(*(volatile u32**)params, 1);
+    return true;
+}
+
+static b8 nested_parent_job_start(void* params, void* result_data) {
+    nested_fork_params* typed_params = params;
+    // Fan out from within a job and wait, which must help rather than deadlock.
+    job_counter counter = {0};
+    for (u32 i = 0; i < typed_params->child_count; ++i) {
+        job_system_submit_with_counter(job_create(nested_child_job_start, 0, 0, &typed_params->sum, sizeof(volatile u32*), 0), &counter);
+    }
+    job_system_wait_for_counter(&counter);
+    return true;
+}
+
+static void wait_for_completed(u64 count) {
+    while (katomic_load_u64(&completed_count) < count) {
+        platform_sleep(0);
+    }
+}
+
+u8 job_system_should_run_all_types_and_priorities(void) {
+    job_test_state state;
+    expect_to_be_true(job_system_test_start(&state));
+
+    callback_count = 0;
+    const u32 job_count = 300;
+    job_type types[3] = {JOB_TYPE_GENERAL, JOB_TYPE_RESOURCE_LOAD, JOB_TYPE_GPU_RESOURCE};
+    for (u32 i = 0; i < job_count; ++i) {
+        u32 value = 1;
+        job_info job = job_create_priority(counting_job_start, counting_job_complete, 0, &value, sizeof(u32), sizeof(u32), types[i % 3], (job_priority)(i % 3));
+        job_system_submit(job);
+    }
+
+    // Callbacks are delivered on the main thread during updates.
+    clock timeout;
+    clock_start(&timeout);
+    while (callback_count < job_count && timeout.elapsed < 10.0) {
+        job_system_update(state.memory, 0);
+        platform_sleep(1);
+        clock_update(&timeout);
+    }
+
+    expect_should_be(job_count, callback_count);
+
+    job_system_test_stop(&state);
+    return true;
+}
+
+u8 job_system_should_fork_and_join_with_counter(void) {
+    job_test_state state;
+    expect_to_be_true(job_system_test_start(&state));
+
+    const u32 job_count = 5000;
+    u32* outputs = kallocate(sizeof(u32) * job_count, MEMORY_TAG_ARRAY);
+    job_counter counter = {0};
+    for (u32 i = 0; i < job_count; ++i) {
+        fork_join_params params = {i, outputs};
+        job_system_submit_with_counter(job_create(fork_join_job_start, 0, 0, &params, sizeof(fork_join_params), 0), &counter);
+    }
+    job_system_wait_for_counter(&counter);
+
+    // All results must be visible as soon as the wait returns, without a job_system_update.
+    expect_should_be(0, counter.count);
+    for (u32 i = 0; i < job_count; ++i) {
+        expect_should_be(i * 2, outputs[i]);
+    }
+    kfree(outputs, sizeof(u32) * job_count, MEMORY_TAG_ARRAY);
+
+    // Nested fork-join from within jobs.
+    volatile u32 sum = 0;
+    const u32 parent_count = 16;
+    nested_fork_params params = {64, &sum};
+    job_counter parent_counter = {0};
+    for (u32 i = 0; i < parent_count; ++i) {
+        job_system_submit_with_counter(job_create(nested_parent_job_start, 0, 0, &params, sizeof(nested_fork_params), 0), &parent_counter);
+    }
+    job_system_wait_for_counter(&parent_counter);
+    expect_should_be(parent_count * params.child_count, sum);
+
+    job_system_test_stop(&state);
+    return true;
+}
+
+static b8 empty_job_start(void* params, void* result_data) {
+    return true;
+}
+
+u8 job_system_soak_should_recycle_handles(void) {
+    job_test_state state;
+    expect_to_be_true(job_system_test_start(&state));
+
+    // More jobs than fit in any 16-bit or slot-sized identifier space, waited on in batches.
+    const u64 total_job_count = 10500000;
+    const u32 batch_size = 1024;
+    u32 handles[1024];
+    u64 submitted = 0;
+    while (submitted < total_job_count) {
+        job_counter counter = {0};
+        for (u32 i = 0; i < batch_size; ++i) {
+            job_info job = job_create(empty_job_start, 0, 0, 0, 0, 0);
+            handles[i] = job.id;
+            expect_should_not_be(INVALID_ID, job.id);
+            job_system_submit_with_counter(job, &counter);
+        }
+        job_system_wait_for_counter(&counter);
+        submitted += batch_size;
+
+        // Every handle from the batch must read as complete, even though slots are already being reused.
+        for (u32 i = 0; i < batch_size; ++i) {
+            if (!job_system_query_job_complete(handles[i])) {
+                DERROR("Job handle %#x not complete after wait (after %llu jobs).", handles[i], submitted);
+                return false;
+            }
+        }
+
+        // A newly created job must never alias a handle that was just retired.
+        job_info probe = job_create(empty_job_start, 0, 0, 0, 0, 0);
+        expect_to_be_false(job_system_query_job_complete(probe.id));
+        for (u32 i = 0; i < batch_size; ++i) {
+            if (probe.id == handles[i]) {
+                DERROR("Job handle %#x was reissued while still referenced.", probe.id);
+                return false;
+            }
+        }
+        job_counter probe_counter = {0};
+        job_system_submit_with_counter(probe, &probe_counter);
+        job_system_wait_for_counter(&probe_counter);
+        expect_to_be_true(job_system_query_job_complete(probe.id));
+        submitted++;
+    }
+
+    DINFO("Job soak: %llu jobs created and completed.", submitted);
+
+    job_system_test_stop(&state);
+    return true;
+}
+
+u8 job_system_should_not_reissue_handles_on_generation_wrap(void) {
+    job_test_state state;
+    expect_to_be_true(job_system_test_start(&state));
+
+    // One job at a time, so a stack of free slots would hand the same slot to every job. More jobs
+    // are run than a slot has generations, so that slot's generation would wrap around. Both the
+    // first handle and a stale handle from a later generation must read as complete throughout, and
+    // never be reissued.
+    // Late enough that the stale handle is from a slot's second use, whichever slot it gets.
+    const u32 stale_job = 4096 + 5;
+    const u32 job_count = (1U << 20) + stale_job + 16;
+    u32 first_id = INVALID_ID;
+    u32 stale_id = INVALID_ID;
+    for (u32 i = 0; i < job_count; ++i) {
+        job_info job = job_create(empty_job_start, 0, 0, 0, 0, 0);
+        expect_should_not_be(INVALID_ID, job.id);
+        if (i == 0) {
+            first_id = job.id;
+        } else if (job.id == first_id || job.id == stale_id) {
+            DERROR("Job handle %#x was reissued after %u jobs.", job.id, i);
+            return false;
+        }
+        if (i == stale_job) {
+            stale_id = job.id;
+        }
+        job_counter counter = {0};
+        job_system_submit_with_counter(job, &counter);
+        job_system_wait_for_counter(&counter);
+        expect_to_be_true(job_system_query_job_complete(first_id));
+        expect_to_be_true(job_system_query_job_complete(stale_id));
+    }
+
+    job_system_test_stop(&state);
+    return true;
+}
+
+static u32 submit_counting_jobs_and_wait(u32 job_count) {
+    job_counter counter = {0};
+    for (u32 i = 0; i < job_count; ++i) {
+        u32 value = 1;
+        job_system_submit_with_counter(job_create(counting_job_start, counting_job_complete, 0, &value, sizeof(u32), sizeof(u32)), &counter);
+    }
+    job_system_wait_for_counter(&counter);
+    return job_count;
+}
+
+u8 job_system_should_not_drop_results_under_backpressure(void) {
+    job_test_state state;
+    expect_to_be_true(job_system_test_start(&state));
+
+    // More completions than the result channel holds, all before a single update.
+    callback_count = 0;
+    const u32 job_count = 10000;
+    DDEBUG("The following warning about the job result channel is intentional.");
+    submit_counting_jobs_and_wait(job_count);
+    job_system_update(state.memory, 0);
+    expect_should_be(job_count, callback_count);
+
+    job_system_test_stop(&state);
+    return true;
+}
+
+u8 job_system_benchmark_update_overhead(void) {
+    job_test_state state;
+    expect_to_be_true(job_system_test_start(&state));
+
+    u32 completion_counts[3] = {0, 10, 4000};
+    const u32 frame_count = 100;
+    for (u32 c = 0; c < 3; ++c) {
+        callback_count = 0;
+        f64 total_update_time = 0;
+        for (u32 f = 0; f < frame_count; ++f) {
+            submit_counting_jobs_and_wait(completion_counts[c]);
+
+            clock update_time;
+            clock_start(&update_time);
+            job_system_update(state.memory, 0);
+            clock_update(&update_time);
+            total_update_time += update_time.elapsed;
+        }
+        expect_should_be(completion_counts[c] * frame_count, callback_count);
+        DINFO("Job update benchmark: %u completions per frame, %.3f us per update.", completion_counts[c], (total_update_time / frame_count) * 1000000.0);
+    }
+
+    job_system_test_stop(&state);
+    return true;
+}
+
+typedef struct payload_job_params {
+    f32 values[12];
+} payload_job_params;
+
+typedef struct payload_job_result {
+    f32 sum;
+    f32 padding[7];
+} payload_job_result;
+
+static b8 payload_job_start(void* params, void* result_data) {
+    payload_job_params* typed_params = params;
+    payload_job_result* result = result_data;
+    result->sum = 0;
+    for (u32 i = 0; i < 12; ++i) {
+        result->sum += typed_params->values[i];
+    }
+    return true;
+}
+
+static void payload_job_complete(void* result_data) {
+    callback_count++;
+}
+
+u8 job_system_benchmark_payload_jobs(void) {
+    // Run through the engine allocator, as the engine does, so per-job allocations show up.
+    memory_system_configuration memory_config = {0};
+    memory_config.total_alloc_size = MEBIBYTES(64);
+    expect_to_be_true(memory_system_initialize(memory_config));
+
+    job_test_state state;
+    expect_to_be_true(job_system_test_start(&state));
+
+    callback_count = 0;
+    const u32 job_count = 196608;
+    const u32 batch_size = 2048;
+    payload_job_params params = {0};
+    clock total_time;
+    clock_start(&total_time);
+    for (u32 submitted = 0; submitted < job_count; submitted += batch_size) {
+        job_counter counter = {0};
+        for (u32 i = 0; i < batch_size; ++i) {
+            job_system_submit_with_counter(job_create(payload_job_start, payload_job_complete, 0, &params, sizeof(payload_job_params), sizeof(payload_job_result)), &counter);
+        }
+        job_system_wait_for_counter(&counter);
+        job_system_update(state.memory, 0);
+    }
+    clock_update(&total_time);
+
+    u32 completed = callback_count;
+    DINFO("Job payload benchmark: %u jobs with %u-byte params and %u-byte results in %.4f sec (%.0f jobs/sec), %llu live allocations.",
+          completed,
+          (u32)sizeof(payload_job_params),
+          (u32)sizeof(payload_job_result),
+          total_time.elapsed,
+          completed / total_time.elapsed,
+          get_memory_alloc_count());
+
+    job_system_test_stop(&state);
+    memory_system_shutdown(0);
+    expect_should_be(job_count, completed);
+    return true;
+}
+
+typedef struct parallel_for_test_data {
+    volatile u32* visits;
+    volatile u32 chunk_count;
+    u32 grain;
+    b8 chunk_too_large;
+} parallel_for_test_data;
+
+static void parallel_for_visit(u32 start, u32 end, void* userdata) {
+    parallel_for_test_data* data = userdata;
+    if (end - start > data->grain) {
+        data->chunk_too_large = true;
+    }
+    for (u32 i = start; i < end; ++i) {
+        katomic_fetch_add_u32(&data->visits[i], 1);
+    }
+    katomic_fetch_add_u32(&data->chunk_count, 1);
+}
+
+static void parallel_for_nested(u32 start, u32 end, void* userdata) {
+    parallel_for_test_data* data = userdata;
+    for (u32 i = start; i < end; ++i) {
+        // Each outer item covers its own 100-item stretch.
+        parallel_for_test_data inner = *data;
+        inner.visits = data->visits + (i * 100);
+        inner.chunk_count = 0;
+        job_parallel_for(100, 7, parallel_for_visit, &inner);
+    }
+}
+
+u8 job_system_parallel_for_should_visit_every_item_once(void) {
+    job_test_state state;
+    expect_to_be_true(job_system_test_start(&state));
+
+    const u32 count = 10007;
+    volatile u32* visits = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+
+    // A count which is not a multiple of the grain.
+    parallel_for_test_data data = {visits, 0, 64, false};
+    job_parallel_for(count, 64, parallel_for_visit, &data);
+    for (u32 i = 0; i < count; ++i) {
+        expect_should_be(1, visits[i]);
+    }
+    expect_should_be((count + 63) / 64, data.chunk_count);
+    expect_to_be_false(data.chunk_too_large);
+
+    // Fewer items than the grain runs as a single chunk.
+    kzero_memory((void*)visits, sizeof(u32) * count);
+    data.chunk_count = 0;
+    job_parallel_for(10, 64, parallel_for_visit, &data);
+    expect_should_be(1, data.chunk_count);
+    expect_should_be(1, visits[9]);
+    expect_should_be(0, visits[10]);
+
+    // Nested from within chunks, which must help rather than deadlock.
+    kzero_memory((void*)visits, sizeof(u32) * count);
+    data.grain = 7;
+    job_parallel_for(100, 3, parallel_for_nested, &data);
+    for (u32 i = 0; i < 100 * 100; ++i) {
+        expect_should_be(1, visits[i]);
+    }
+
+    kfree((void*)visits, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    job_system_test_stop(&state);
+    return true;
+}
+
+u8 job_system_parallel_for_should_run_without_job_system(void) {
+    const u32 count = 1000;
+    volatile u32* visits = kallocate(sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    parallel_for_test_data data = {visits, 0, count, false};
+    job_parallel_for(count, 10, parallel_for_visit, &data);
+    expect_should_be(1, data.chunk_count);
+    for (u32 i = 0; i < count; ++i) {
+        expect_should_be(1, visits[i]);
+    }
+    kfree((void*)visits, sizeof(u32) * count, MEMORY_TAG_ARRAY);
+    return true;
+}
+
+typedef struct transform_kernel_data {
+    transform* transforms;
+    matrix4* worlds;
+    quaterion spin;
+} transform_kernel_data;
+
+static void transform_kernel(u32 start, u32 end, void* userdata) {
+    transform_kernel_data* data = userdata;
+    for (u32 i = start; i < end; ++i) {
+        transform_rotate(&data->transforms[i], data->spin);
+        data->worlds[i] = transform_world_get(&data->transforms[i]);
+    }
+}
+
+u8 job_system_benchmark_parallel_for_transforms(void) {
+    const u32 transform_count = 65536;
+    const u32 grain = 1024;
+    const u32 iterations = 20;
+
+    transform_kernel_data data;
+    data.transforms = kallocate(sizeof(transform) * transform_count, MEMORY_TAG_TRANSFORM);
+    data.worlds = kallocate(sizeof(matrix4) * transform_count, MEMORY_TAG_TRANSFORM);
+    data.spin = quat_from_axis_angle(vec3_up(), 0.01f, true);
+    for (u32 i = 0; i < transform_count; ++i) {
+        data.transforms[i] = transform_from_position(vec3_create((f32)(i % 256), 0, (f32)(i / 256)));
+    }
+
+    // Total participating threads, the calling thread included.
+    u32 thread_counts[5] = {1, 2, 4, 8, KMAX(1, KMIN(platform_get_processor_count(), 32))};
+    f64 single_thread_time = 0;
+    for (u32 t = 0; t < 5; ++t) {
+        job_test_state state;
+        expect_to_be_true(job_system_test_start_general(&state, (u8)(thread_counts[t] - 1)));
+
+        clock time;
+        clock_start(&time);
+        for (u32 i = 0; i < iterations; ++i) {
+            job_parallel_for(transform_count, grain, transform_kernel, &data);
+        }
+        clock_update(&time);
+        job_system_test_stop(&state);
+
+        f64 per_iteration = time.elapsed / iterations;
+        if (t == 0) {
+            single_thread_time = per_iteration;
+        }
+        DINFO("Parallel-for transform benchmark: %u transforms, %u thread(s)%s, %.3f ms per update (%.2fx).",
+              transform_count,
+              thread_counts[t],
+              t == 4 ? " (all cores)" : "",
+              per_iteration * 1000.0,
+              single_thread_time / per_iteration);
+    }
+
+    kfree(data.transforms, sizeof(transform) * transform_count, MEMORY_TAG_TRANSFORM);
+    kfree(data.worlds, sizeof(matrix4) * transform_count, MEMORY_TAG_TRANSFORM);
+    return true;
+}
+
+static b8 run_tiny_job_benchmark(u64 job_count) {
+    job_test_state state;
+    if (!job_system_test_start(&state)) {
+        return false;
+    }
+
+    completed_count = 0;
+    total_latency_ns = 0;
+    max_latency_ns = 0;
+
+    clock total_time;
+    clock_start(&total_time);
+    for (u64 i = 0; i < job_count; ++i) {
+        tiny_job_params params;
+        clock now;
+        clock_start(&now);
+        params.submit_time = now.start_time;
+        job_system_submit(job_create(tiny_job_start, 0, 0, &params, sizeof(tiny_job_params), 0));
+    }
+    wait_for_completed(job_count);
+    clock_update(&total_time);
+
+    DINFO("Job benchmark: %llu jobs in %.4f sec (%.0f jobs/sec), queue latency avg %.2f us, max %.2f us.",
+          job_count,
+          total_time.elapsed,
+          job_count / total_time.elapsed,
+          (total_latency_ns / (f64)job_count) / 1000.0,
+          max_latency_ns / 1000.0);
+
+    job_system_test_stop(&state);
+    return katomic_load_u64(&completed_count) == job_count;
+}
+
+u8 job_system_benchmark_10k_tiny_jobs(void) {
+    expect_to_be_true(run_tiny_job_benchmark(10000));
+    return true;
+}
+
+u8 job_system_benchmark_100k_tiny_jobs(void) {
+    expect_to_be_true(run_tiny_job_benchmark(100000));
+    return true;
+}
+
+u8 job_system_benchmark_1m_tiny_jobs(void) {
+    expect_to_be_true(run_tiny_job_benchmark(1000000));
+    return true;
+}
+
+void job_system_register_tests(void) {
+    test_manager_register_test(job_system_should_run_all_types_and_priorities, "Job system runs jobs of every type and priority and delivers callbacks.");
+    test_manager_register_test(job_system_should_fork_and_join_with_counter, "Job system fork-join with counters, including nested waits.");
+    test_manager_register_test(job_system_should_not_drop_results_under_backpressure, "Job system keeps results when the result channel is full.");
+    test_manager_register_test(job_system_parallel_for_should_visit_every_item_once, "Job parallel-for visits every item exactly once, including nested.");
+    test_manager_register_test(job_system_parallel_for_should_run_without_job_system, "Job parallel-for runs inline when the job system is not running.");
+    test_manager_register_test(job_system_benchmark_parallel_for_transforms, "Job system benchmark: parallel-for transform update at 1, 2, 4, 8 and all threads.");
+    test_manager_register_test(job_system_benchmark_update_overhead, "Job system benchmark: update overhead per completion count.");
+    test_manager_register_test(job_system_benchmark_payload_jobs, "Job system benchmark: jobs with param and result payloads.");
+    test_manager_register_test(job_system_should_not_reissue_handles_on_generation_wrap, "Job system never reissues a stale handle, even over more jobs than a slot has generations.");
+    test_manager_register_test(job_system_soak_should_recycle_handles, "Job system soak: over 10 million jobs with recycled handles.");
+    test_manager_register_test(job_system_benchmark_10k_tiny_jobs, "Job system benchmark: 10k tiny jobs.");
+    test_manager_register_test(job_system_benchmark_100k_tiny_jobs, "Job system benchmark: 100k tiny jobs.");
+    test_manager_register_test(job_system_benchmark_1m_tiny_jobs, "Job system benchmark: 1M tiny jobs.");
+}
@@ -0,0 +1,17 @@
+#include "test_utils.h"
+
+linear_allocator test_frame_memory;
+
+static void* test_frame_allocate(u64 size) {
+    return linear_allocator_allocate(&test_frame_memory, size);
+}
+
+static void test_frame_free(void* block, u64 size) {
+    // Frame memory is only freed all at once.
+}
+
+static void test_frame_free_all(void) {
+    linear_allocator_free_all(&test_frame_memory, false);
+}
+
+const frame_allocator_int test_frame_allocator = {test_frame_allocate, test_frame_free, test_frame_free_all};
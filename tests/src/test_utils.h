@@ -0,0 +1,41 @@
+#pragma once
+
+#include <defines.h>
+#include <core/frame_data.h>
+#include <memory/linear_allocator.h>
+
+/**
+ * @brief Backing memory for test_frame_allocator. Each test creates it at the size it needs with
+ * linear_allocator_create and destroys it when done.
+ */
+extern linear_allocator test_frame_memory;
+
+/** @brief A frame allocator over test_frame_memory, for code that takes a frame_allocator_int. */
+extern const frame_allocator_int test_frame_allocator;
+
+/**
+ * @brief xorshift32, for repeatable test data. krandom is not used as it is not thread safe.
+ *
+ * @param state A pointer to the generator state. Must be non-zero.
+ * @returns The next pseudo-random value.
+ */
+static inline u32 xorshift(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Returns a pseudo-random value in [min, max] drawn from xorshift.
+ *
+ * @param state A pointer to the generator state. Must be non-zero.
+ * @param min The minimum value.
+ * @param max The maximum value.
+ * @returns The value.
+ */
+static inline f32 random_range(u32* state, f32 min, f32 max) {
+    return min + (max - min) * ((f32)(xorshift(state) & 0xFFFFFF) / (f32)0xFFFFFF);
+}
@@ -179,8 +179,9 @@ void *vulkan_alloc_reallocation(void *user_data, void *original, size_t size,
         DTRACE("Block %p reallocated to %p, copying data...", original, result);
 #endif
 
-        // Copy over the original memory.
-        kcopy_memory(result, original, alloc_size);
+        // Copy over the original memory. The reported size can be larger than the new one, as
+        // small blocks report their size class.
+        kcopy_memory(result, original, KMIN(alloc_size, size));
 #ifdef KVULKAN_ALLOCATOR_TRACE
         DTRACE("Freeing original aligned block %p...", original);
 #endif
@@ -1864,6 +1865,10 @@ static b8 shader_create_modules_and_pipelines(renderer_plugin *plugin, shader *s
         pipeline_config.stride = s->attribute_stride;
         pipeline_config.attribute_count = darray_length(s->attributes);
         pipeline_config.attributes = internal_shader->attributes;
+        if (s->flags & SHADER_FLAG_INSTANCED) {
+            pipeline_config.attribute_count += 4;
+            pipeline_config.instance_stride = sizeof(matrix4);
+        }
         pipeline_config.descriptor_set_layout_count = internal_shader->descriptor_set_count;
         pipeline_config.descriptor_set_layouts = internal_shader->descriptor_set_layouts;
         pipeline_config.stage_count = internal_shader->stage_count;
@@ -1981,6 +1986,12 @@ b8 vulkan_renderer_shader_initialize(renderer_plugin *plugin, shader *s) {
 
     // Process attributes
     u32 attribute_count = darray_length(s->attributes);
+    // Instanced shaders also need 4 locations for the per-instance model matrix.
+    u32 total_attribute_count = attribute_count + ((s->flags & SHADER_FLAG_INSTANCED) ? 4 : 0);
+    if (total_attribute_count > VULKAN_SHADER_MAX_ATTRIBUTES) {
+        DERROR("vulkan_shader_initialize: Shader '%s' needs %u attributes, more than the maximum of %u.", s->name, total_attribute_count, VULKAN_SHADER_MAX_ATTRIBUTES);
+        return false;
+    }
     u32 offset = 0;
     for (u32 i = 0; i < attribute_count; ++i) {
         // Setup the new attribute.
@@ -1996,6 +2007,19 @@ b8 vulkan_renderer_shader_initialize(renderer_plugin *plugin, shader *s) {
         offset += s->attributes[i].size;
     }
 
+    // Instanced shaders take a model matrix per instance from binding 1, in the locations after
+    // the vertex attributes. A mat4 takes one location per column.
+    if (s->flags & SHADER_FLAG_INSTANCED) {
+        for (u32 c = 0; c < 4; ++c) {
+            VkVertexInputAttributeDescription attribute;
+            attribute.location = attribute_count + c;
+            attribute.binding = 1;
+            attribute.offset = sizeof(vec4) * c;
+            attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            internal_shader->attributes[attribute_count + c] = attribute;
+        }
+    }
+
     // Descriptor pool.
     VkDescriptorPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
     pool_info.poolSizeCount = internal_shader->pool_size_count;
@@ -3482,6 +3506,17 @@ b8 vulkan_buffer_create_internal(renderer_plugin *plugin, renderbuffer *buffer)
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
             break;
+        case RENDERBUFFER_TYPE_INSTANCE: {
+            // Written by the host every frame, so kept host visible like uniforms.
+            u32 device_local_bits = context->device.supports_device_local_host_visible
+                                        ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                        : 0;
+            // Also a transfer source so its contents can be copied over when it is grown.
+            internal_buffer.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            internal_buffer.memory_property_flags =
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | device_local_bits;
+        } break;
         case RENDERBUFFER_TYPE_STORAGE:
             DERROR("Storage buffer not yet supported.");
             return false;
@@ -3918,6 +3953,38 @@ b8 vulkan_buffer_draw(renderer_plugin *plugin, renderbuffer *buffer, u64 offset,
     }
 }
 
+b8 vulkan_buffer_draw_instanced(renderer_plugin *plugin, renderbuffer *buffer, u64 offset,
+                                u32 element_count, renderbuffer *instance_buffer,
+                                u64 instance_offset, u32 instance_count) {
+    vulkan_context *context = (vulkan_context *)plugin->internal_context;
+    vulkan_command_buffer *command_buffer =
+        &context->graphics_command_buffers[context->image_index];
+
+    // Per-instance data always comes from binding 1.
+    VkDeviceSize instance_offsets[1] = {instance_offset};
+    vkCmdBindVertexBuffers(command_buffer->handle, 1, 1,
+                           &((vulkan_buffer *)instance_buffer->internal_data)->handle,
+                           instance_offsets);
+
+    if (buffer->type == RENDERBUFFER_TYPE_VERTEX) {
+        VkDeviceSize offsets[1] = {offset};
+        vkCmdBindVertexBuffers(command_buffer->handle, 0, 1,
+                               &((vulkan_buffer *)buffer->internal_data)->handle,
+                               offsets);
+        vkCmdDraw(command_buffer->handle, element_count, instance_count, 0, 0);
+        return true;
+    } else if (buffer->type == RENDERBUFFER_TYPE_INDEX) {
+        vkCmdBindIndexBuffer(command_buffer->handle,
+                             ((vulkan_buffer *)buffer->internal_data)->handle,
+                             offset, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(command_buffer->handle, element_count, instance_count, 0, 0, 0);
+        return true;
+    } else {
+        DERROR("Cannot draw buffer of type: %i", buffer->type);
+        return false;
+    }
+}
+
 void vulkan_renderer_wait_for_idle(renderer_plugin *plugin) {
     if (plugin) {
         vulkan_context *context = plugin->internal_context;
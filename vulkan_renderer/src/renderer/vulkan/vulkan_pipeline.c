@@ -145,15 +145,19 @@ b8 vulkan_graphics_pipeline_create(vulkan_context* context, const vulkan_pipelin
     dynamic_state_create_info.pDynamicStates = dynamic_states;
 
     // Vertex input
-    VkVertexInputBindingDescription binding_description;
-    binding_description.binding = 0;  // Binding index
-    binding_description.stride = config->stride;
-    binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;  // Move to next data entry for each vertex.
+    VkVertexInputBindingDescription binding_descriptions[2];
+    binding_descriptions[0].binding = 0;  // Binding index
+    binding_descriptions[0].stride = config->stride;
+    binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;  // Move to next data entry for each vertex.
+    // Per-instance data, if used.
+    binding_descriptions[1].binding = 1;
+    binding_descriptions[1].stride = config->instance_stride;
+    binding_descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;  // Move to next data entry for each instance.
 
     // Attributes
     VkPipelineVertexInputStateCreateInfo vertex_input_info = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &binding_description;
+    vertex_input_info.vertexBindingDescriptionCount = config->instance_stride ? 2 : 1;
+    vertex_input_info.pVertexBindingDescriptions = binding_descriptions;
     vertex_input_info.vertexAttributeDescriptionCount = config->attribute_count;
     vertex_input_info.pVertexAttributeDescriptions = config->attributes;
 
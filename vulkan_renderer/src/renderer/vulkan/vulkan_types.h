@@ -288,6 +288,8 @@ typedef struct vulkan_pipeline_config {
     u32 attribute_count;
     /** @brief An array of attributes. */
     VkVertexInputAttributeDescription* attributes;
+    /** @brief The stride of the per-instance data bound at binding 1. 0 if not instanced. */
+    u32 instance_stride;
     /** @brief The number of descriptor set layouts. */
     u32 descriptor_set_layout_count;
     /** @brief An array of descriptor set layouts. */
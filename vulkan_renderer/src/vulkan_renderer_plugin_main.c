@@ -88,6 +88,7 @@ b8 plugin_create(renderer_plugin* out_plugin) {
     out_plugin->renderbuffer_load_range = vulkan_buffer_load_range;
     out_plugin->renderbuffer_copy_range = vulkan_buffer_copy_range;
     out_plugin->renderbuffer_draw = vulkan_buffer_draw;
+    out_plugin->renderbuffer_draw_instanced = vulkan_buffer_draw_instanced;
     out_plugin->wait_for_idle = vulkan_renderer_wait_for_idle;
 
     DINFO("Vulkan Renderer Plugin Creation successful (%s).", DVERSION);